@@ -19,10 +19,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 
 #include "gamer.h"
+#include "parallel.h"
 
 namespace gamer {
 
@@ -102,5 +108,248 @@ public:
     bool res = diagonalizeSelfAdjointMatrix(m, eigenvalues, eigenvectors);
     return res;
   }
+
+  /// Number of matrices processed together by the batched solver
+  static constexpr std::size_t BatchWidth = 16;
+
+  /**
+   * @brief      Diagonalize a batch of upper triangular 3x3 covariance
+   *             matrices.
+   *
+   * Uses the same closed-form (trigonometric) algorithm as Eigen's
+   * SelfAdjointEigenSolver::computeDirect. Matrices are processed in blocks
+   * of BatchWidth, transposed into structure-of-arrays form. The loops that
+   * shift, scale and extract the eigenvectors contain only arithmetic and
+   * selects and can be vectorized by the compiler (see the VECTORIZE CMake
+   * option). The roots of the characteristic polynomial need atan2, cos and
+   * sin, which are left scalar. Eigenvalues are sorted in increasing order
+   * and eigenvectors are the corresponding columns.
+   *
+   * @param[in]  cov           Array of n upper triangular matrices
+   * @param[in]  n             Number of matrices
+   * @param[out] eigenvalues   Array of n resulting eigenvalue vectors
+   * @param[out] eigenvectors  Array of n resulting eigenvector matrices
+   * @param[in]  nthreads      Number of threads (0 uses all hardware threads)
+   */
+  static void diagonalizeSelfAdjointCovMatrices(const CovarianceMatrix *cov,
+                                                std::size_t n,
+                                                _EigenVector *eigenvalues,
+                                                _EigenMatrix *eigenvectors,
+                                                std::size_t nthreads = 1) {
+    static_assert(dim == 3, "The batched solver only supports 3x3 matrices");
+    const std::size_t nblocks = (n + BatchWidth - 1) / BatchWidth;
+    parallel::for_each_chunk(
+        0, nblocks, nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end) {
+          for (std::size_t b = begin; b < end; ++b) {
+            std::size_t first = b * BatchWidth;
+            std::size_t count =
+                (n - first < BatchWidth) ? n - first : BatchWidth;
+            diagonalizeBlock(cov + first, count, eigenvalues + first,
+                             eigenvectors + first);
+          }
+        });
+  }
+
+private:
+  /// Structure of arrays of three component vectors
+  struct _Lanes3 {
+    T x[BatchWidth], y[BatchWidth], z[BatchWidth];
+  };
+
+  /**
+   * @brief      Kernel of a rank 2 symmetric matrix, lane-wise.
+   *
+   * Mirrors the extract_kernel step of Eigen's direct solver: the column with
+   * the largest diagonal entry is crossed with the two other columns and the
+   * longer result is normalized.
+   */
+  static void extractKernel(const T *m00, const T *m01, const T *m02,
+                            const T *m11, const T *m12, const T *m22,
+                            const T *shift, std::size_t count, _Lanes3 &res,
+                            _Lanes3 &representative) {
+    for (std::size_t l = 0; l < count; ++l) {
+      // Columns of (M - shift*I)
+      const T a0 = m00[l] - shift[l], a1 = m01[l], a2 = m02[l];
+      const T b0 = m01[l], b1 = m11[l] - shift[l], b2 = m12[l];
+      const T c0 = m02[l], c1 = m12[l], c2 = m22[l] - shift[l];
+
+      const T d0 = std::abs(a0), d1 = std::abs(b1), d2 = std::abs(c2);
+      const bool i0 = d0 >= d1 && d0 >= d2;
+      const bool i1 = !i0 && d1 >= d2;
+
+      // Rotate the columns so that r is column i0
+      const T r0 = i0 ? a0 : (i1 ? b0 : c0);
+      const T r1 = i0 ? a1 : (i1 ? b1 : c1);
+      const T r2 = i0 ? a2 : (i1 ? b2 : c2);
+      const T p0 = i0 ? b0 : (i1 ? c0 : a0);
+      const T p1 = i0 ? b1 : (i1 ? c1 : a1);
+      const T p2 = i0 ? b2 : (i1 ? c2 : a2);
+      const T q0 = i0 ? c0 : (i1 ? a0 : b0);
+      const T q1 = i0 ? c1 : (i1 ? a1 : b1);
+      const T q2 = i0 ? c2 : (i1 ? a2 : b2);
+
+      const T x0 = r1 * p2 - r2 * p1, y0 = r2 * p0 - r0 * p2,
+              z0 = r0 * p1 - r1 * p0;
+      const T x1 = r1 * q2 - r2 * q1, y1 = r2 * q0 - r0 * q2,
+              z1 = r0 * q1 - r1 * q0;
+      const T n0 = x0 * x0 + y0 * y0 + z0 * z0;
+      const T n1 = x1 * x1 + y1 * y1 + z1 * z1;
+      const bool first = n0 > n1;
+      const T inv = T(1) / std::sqrt(first ? n0 : n1);
+
+      res.x[l] = (first ? x0 : x1) * inv;
+      res.y[l] = (first ? y0 : y1) * inv;
+      res.z[l] = (first ? z0 : z1) * inv;
+      representative.x[l] = r0;
+      representative.y[l] = r1;
+      representative.z[l] = r2;
+    }
+  }
+
+  /**
+   * @brief      Diagonalize up to BatchWidth matrices
+   */
+  static void diagonalizeBlock(const CovarianceMatrix *cov, std::size_t count,
+                               _EigenVector *eigenvalues,
+                               _EigenMatrix *eigenvectors) {
+    const T eps = std::numeric_limits<T>::epsilon();
+    const T sqrt3 = std::sqrt(T(3));
+
+    // Lanes past count stay zero so that no uninitialized value is read
+    T m00[BatchWidth] = {}, m01[BatchWidth] = {}, m02[BatchWidth] = {};
+    T m11[BatchWidth] = {}, m12[BatchWidth] = {}, m22[BatchWidth] = {};
+    T shift[BatchWidth] = {}, scale[BatchWidth] = {};
+    T ev0[BatchWidth] = {}, ev1[BatchWidth] = {}, ev2[BatchWidth] = {};
+
+    // Transpose into lanes
+    for (std::size_t l = 0; l < count; ++l) {
+      m00[l] = cov[l][0];
+      m01[l] = cov[l][1];
+      m02[l] = cov[l][2];
+      m11[l] = cov[l][3];
+      m12[l] = cov[l][4];
+      m22[l] = cov[l][5];
+    }
+
+    // Shift and scale to avoid over/underflow
+    for (std::size_t l = 0; l < count; ++l) {
+      shift[l] = (m00[l] + m11[l] + m22[l]) / T(3);
+      m00[l] -= shift[l];
+      m11[l] -= shift[l];
+      m22[l] -= shift[l];
+      T s = std::max(std::max(std::abs(m00[l]), std::abs(m11[l])),
+                     std::max(std::abs(m22[l]), std::abs(m01[l])));
+      s = std::max(s, std::max(std::abs(m02[l]), std::abs(m12[l])));
+      scale[l] = s;
+      const T inv = (s > 0) ? T(1) / s : T(1);
+      m00[l] *= inv;
+      m01[l] *= inv;
+      m02[l] *= inv;
+      m11[l] *= inv;
+      m12[l] *= inv;
+      m22[l] *= inv;
+    }
+
+    // Roots of the characteristic polynomial
+    for (std::size_t l = 0; l < count; ++l) {
+      const T c0 = m00[l] * m11[l] * m22[l] + T(2) * m01[l] * m02[l] * m12[l] -
+                   m00[l] * m12[l] * m12[l] - m11[l] * m02[l] * m02[l] -
+                   m22[l] * m01[l] * m01[l];
+      const T c1 = m00[l] * m11[l] - m01[l] * m01[l] + m00[l] * m22[l] -
+                   m02[l] * m02[l] + m11[l] * m22[l] - m12[l] * m12[l];
+      const T c2 = m00[l] + m11[l] + m22[l];
+
+      const T c2_over_3 = c2 / T(3);
+      const T a_over_3 = std::max((c2 * c2_over_3 - c1) / T(3), T(0));
+      const T half_b =
+          T(0.5) * (c0 + c2_over_3 * (T(2) * c2_over_3 * c2_over_3 - c1));
+      const T q = std::max(a_over_3 * a_over_3 * a_over_3 - half_b * half_b,
+                           T(0));
+      const T rho = std::sqrt(a_over_3);
+      const T theta = std::atan2(std::sqrt(q), half_b) / T(3);
+      const T cos_theta = std::cos(theta);
+      const T sin_theta = std::sin(theta);
+
+      const T r0 = c2_over_3 - rho * (cos_theta + sqrt3 * sin_theta);
+      const T r1 = c2_over_3 - rho * (cos_theta - sqrt3 * sin_theta);
+      const T r2 = c2_over_3 + T(2) * rho * cos_theta;
+
+      // Sorting network
+      const T lo = std::min(r0, r1), hi = std::max(r0, r1);
+      ev2[l] = std::max(hi, r2);
+      const T mid = std::min(hi, r2);
+      ev0[l] = std::min(lo, mid);
+      ev1[l] = std::max(lo, mid);
+    }
+
+    // The most isolated eigenvalue (k) is resolved first, then l, and the
+    // middle eigenvector is their cross product.
+    T evk[BatchWidth] = {}, evl[BatchWidth] = {};
+    bool topIsolated[BatchWidth] = {};
+    for (std::size_t l = 0; l < count; ++l) {
+      const T d0 = ev2[l] - ev1[l];
+      const T d1 = ev1[l] - ev0[l];
+      topIsolated[l] = d0 > d1;
+      evk[l] = topIsolated[l] ? ev2[l] : ev0[l];
+      evl[l] = topIsolated[l] ? ev0[l] : ev2[l];
+    }
+
+    _Lanes3 vk = {}, vl = {}, repk = {}, repl = {};
+    extractKernel(m00, m01, m02, m11, m12, m22, evk, count, vk, repk);
+    extractKernel(m00, m01, m02, m11, m12, m22, evl, count, vl, repl);
+
+    for (std::size_t l = 0; l < count; ++l) {
+      const T d0 = ev2[l] - ev1[l];
+      const T d1 = ev1[l] - ev0[l];
+      const T gap = topIsolated[l] ? d1 : d0;
+      const T other = topIsolated[l] ? d0 : d1;
+
+      // If the two remaining eigenvalues are numerically the same, any unit
+      // vector orthogonal to vk will do. Orthonormalize the saved column.
+      T ox = repk.x[l], oy = repk.y[l], oz = repk.z[l];
+      const T dot = ox * vk.x[l] + oy * vk.y[l] + oz * vk.z[l];
+      ox -= dot * vk.x[l];
+      oy -= dot * vk.y[l];
+      oz -= dot * vk.z[l];
+      const T on = std::sqrt(ox * ox + oy * oy + oz * oz);
+      const T oinv = (on > 0) ? T(1) / on : T(0);
+      const bool degenerate = gap <= T(2) * eps * other;
+      const T lx = degenerate ? ox * oinv : vl.x[l];
+      const T ly = degenerate ? oy * oinv : vl.y[l];
+      const T lz = degenerate ? oz * oinv : vl.z[l];
+
+      // Columns 0 and 2
+      const T e0x = topIsolated[l] ? lx : vk.x[l];
+      const T e0y = topIsolated[l] ? ly : vk.y[l];
+      const T e0z = topIsolated[l] ? lz : vk.z[l];
+      const T e2x = topIsolated[l] ? vk.x[l] : lx;
+      const T e2y = topIsolated[l] ? vk.y[l] : ly;
+      const T e2z = topIsolated[l] ? vk.z[l] : lz;
+
+      // Column 1 = col2 x col0
+      T e1x = e2y * e0z - e2z * e0y;
+      T e1y = e2z * e0x - e2x * e0z;
+      T e1z = e2x * e0y - e2y * e0x;
+      const T n1 = std::sqrt(e1x * e1x + e1y * e1y + e1z * e1z);
+      e1x /= n1;
+      e1y /= n1;
+      e1z /= n1;
+
+      _EigenMatrix &V = eigenvectors[l];
+      _EigenVector &D = eigenvalues[l];
+      if (ev2[l] - ev0[l] <= eps) {
+        // All eigenvalues are the same
+        V.setIdentity();
+      } else {
+        V(0, 0) = e0x, V(1, 0) = e0y, V(2, 0) = e0z;
+        V(0, 1) = e1x, V(1, 1) = e1y, V(2, 1) = e1z;
+        V(0, 2) = e2x, V(1, 2) = e2y, V(2, 2) = e2z;
+      }
+      D(0) = ev0[l] * scale[l] + shift[l];
+      D(1) = ev1[l] * scale[l] + shift[l];
+      D(2) = ev2[l] * scale[l] + shift[l];
+    }
+  }
 }; // end class EigenDiagonalizeTraits
 } // end namespace gamer
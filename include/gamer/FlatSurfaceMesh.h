@@ -0,0 +1,309 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+/**
+ * @file FlatSurfaceMesh.h
+ * @brief Flat array snapshot of a SurfaceMesh for read-only analysis
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "gamer/SurfaceMesh.h"
+#include "gamer/gamer.h"
+
+/// Namespace for all things gamer
+namespace gamer {
+
+/**
+ * @brief      Read-only snapshot of a SurfaceMesh packed into contiguous
+ *             arrays.
+ *
+ * Vertices are renumbered 0..N-1 in the iteration order of the source mesh
+ * and edges and faces refer to these dense indices. Faces keep the sorted key
+ * order of the simplicial complex, their orientation is stored alongside.
+ * The snapshot does not track later changes to the mesh.
+ */
+struct FlatSurfaceMesh {
+  /// Vertex positions
+  std::vector<Vector> positions;
+  /// Vertex markers
+  std::vector<int> vertexMarkers;
+  /// Vertex selection flags
+  std::vector<char> vertexSelected;
+  /// Key of each vertex in the source SurfaceMesh
+  std::vector<SurfaceMesh::KeyType> vertexKeys;
+
+  /// Pairs of vertex indices
+  std::vector<std::array<int, 2>> edges;
+
+  /// Triples of vertex indices in sorted key order
+  std::vector<std::array<int, 3>> faces;
+  /// Face orientation (1, -1, or 0 if undefined) relative to faces
+  std::vector<int> faceOrientations;
+  /// Face markers
+  std::vector<int> faceMarkers;
+  /// Face selection flags
+  std::vector<char> faceSelected;
+
+  /// Number of vertices
+  std::size_t nVertices() const { return positions.size(); }
+  /// Number of edges
+  std::size_t nEdges() const { return edges.size(); }
+  /// Number of faces
+  std::size_t nFaces() const { return faces.size(); }
+
+  /**
+   * @brief      Get the vertex indices of a face ordered according to its
+   *             orientation.
+   *
+   * Matches the ordering used by SurfaceMesh.to_ndarray: faces with
+   * orientation other than 1 are reversed.
+   *
+   * @param[in]  i     Face index
+   *
+   * @return     Oriented vertex indices
+   */
+  std::array<int, 3> orientedFace(std::size_t i) const {
+    const auto &f = faces[i];
+    if (faceOrientations[i] == 1)
+      return f;
+    return {f[2], f[1], f[0]};
+  }
+};
+
+/**
+ * @brief      Pack a SurfaceMesh into a FlatSurfaceMesh
+ *
+ * @param[in]  mesh  The mesh
+ *
+ * @return     Flat snapshot of the mesh
+ */
+FlatSurfaceMesh flatten(const SurfaceMesh &mesh);
+
+/**
+ * @brief      Print angle, edge length, and valence distributions.
+ *
+ * @param[in]  mesh  The flat mesh
+ */
+void generateHistogram(const FlatSurfaceMesh &mesh);
+
+/**
+ * @brief      Gets the minimum maximum angles.
+ *
+ * @param[in]  mesh         The flat mesh
+ * @param[in]  maxMinAngle  The maximum minimum angle
+ * @param[in]  minMaxAngle  The minimum maximum angle
+ *
+ * @return     The minimum maximum angles.
+ */
+std::tuple<double, double, int, int>
+getMinMaxAngles(const FlatSurfaceMesh &mesh, double maxMinAngle,
+                double minMaxAngle);
+
+/**
+ * @brief      Gets the area.
+ *
+ * @param[in]  mesh  The flat mesh
+ *
+ * @return     The area.
+ */
+double getArea(const FlatSurfaceMesh &mesh);
+
+/**
+ * @brief      Gets the volume.
+ *
+ * @param[in]  mesh  The flat mesh
+ *
+ * @return     The volume.
+ */
+double getVolume(const FlatSurfaceMesh &mesh);
+
+/**
+ * @brief      Compressed vertex adjacency of a FlatSurfaceMesh
+ *
+ * The neighbors of vertex i are nbors[offsets[i]] up to but excluding
+ * nbors[offsets[i+1]], in increasing index order.
+ */
+struct VertexAdjacency {
+  /// Start of the neighbors of each vertex, nVertices+1 entries
+  std::vector<std::size_t> offsets;
+  /// Concatenated neighbor lists
+  std::vector<int> nbors;
+};
+
+/**
+ * @brief      Build the vertex adjacency from the edges
+ *
+ * @param[in]  mesh  The flat mesh
+ *
+ * @return     The adjacency
+ */
+VertexAdjacency vertexAdjacency(const FlatSurfaceMesh &mesh);
+
+/**
+ * @brief      Unnormalized vertex normals, the sum of the incident face
+ *             normals as in getNormal.
+ *
+ * @param[in]  mesh  The flat mesh with oriented faces
+ *
+ * @return     Normal of each vertex
+ */
+std::vector<Vector> vertexNormals(const FlatSurfaceMesh &mesh);
+
+/**
+ * @brief      Per vertex coarsening criteria of coarse
+ *
+ * Each array is indexed by vertex index. The score is the product of the
+ * sparseness and flatness ratios and vertices with a score below the coarse
+ * rate are removed. Unselected vertices are never removed and score NaN.
+ */
+struct CoarseScores {
+  /// Average edge length the sparseness is relative to
+  REAL avgLen = 0;
+  /// Longest incident edge over avgLen raised to denseWeight, or 1
+  std::vector<REAL> sparseness;
+  /// LST eigenvalue ratio raised to flatRate, or 1
+  std::vector<REAL> flatness;
+  /// Product of the two ratios, NaN if the vertex is not selected
+  std::vector<REAL> score;
+};
+
+/**
+ * @brief      Evaluate the coarse criteria of all vertices.
+ *
+ * The longest edges are taken from the vertex adjacency. The local structure
+ * tensors are summed from the normals of the rings around each vertex,
+ * including the vertex itself, and diagonalized together by the batched
+ * eigensolver. Vertices are split among threads.
+ *
+ * @param[in]  mesh         The flat mesh with oriented faces
+ * @param[in]  flatRate     The flat rate, 0 to skip the flatness
+ * @param[in]  denseWeight  The dense weight, 0 to skip the sparseness
+ * @param[in]  rings        Number of neighborhood rings to consider for LST
+ * @param[in]  nthreads     Number of threads (0 uses all hardware threads)
+ *
+ * @return     The scores
+ */
+CoarseScores coarseScores(const FlatSurfaceMesh &mesh, REAL flatRate,
+                          REAL denseWeight, std::size_t rings = 2,
+                          std::size_t nthreads = 1);
+
+/**
+ * @brief      Decimate a mesh by quadric error edge collapses.
+ *
+ * Edges are collapsed in order of increasing Garland-Heckbert quadric error,
+ * scaled by the average weight of their endpoints, until the mesh has at most
+ * targetFaces faces or the least cost exceeds maxError. Collapses which would
+ * make the mesh non-manifold or flip a face are skipped. Unselected vertices
+ * stay in place, edges only collapse between vertices with equal markers, and
+ * boundaries and face marker boundaries are kept by constraint planes and by
+ * only sliding vertices along them.
+ *
+ * Surviving vertices keep their order, keys, markers, and selection. Faces
+ * keep their orientation, markers, and selection.
+ *
+ * @param[in]  mesh         The flat mesh with oriented faces
+ * @param[in]  targetFaces  Stop once there are no more faces than this
+ * @param[in]  maxError     Stop once the least cost exceeds this
+ * @param[in]  weights      Optional per vertex cost weights
+ * @param[in]  verbose      Print additional info
+ *
+ * @return     The decimated mesh
+ */
+FlatSurfaceMesh
+decimateQuadric(const FlatSurfaceMesh &mesh, std::size_t targetFaces,
+                REAL maxError = std::numeric_limits<REAL>::infinity(),
+                const std::vector<REAL> &weights = {}, bool verbose = false);
+
+/**
+ * @brief      Per vertex curvatures of a FlatSurfaceMesh
+ *
+ * Each array is indexed by vertex index.
+ */
+struct Curvatures {
+  /// Mean curvature
+  std::vector<REAL> kh;
+  /// Gaussian curvature
+  std::vector<REAL> kg;
+  /// First principal curvature
+  std::vector<REAL> k1;
+  /// Second principal curvature
+  std::vector<REAL> k2;
+};
+
+/**
+ * @brief      Compute the curvature using the Meyer, Desbrun, Schröder, Barr
+ *             algorithms.
+ *
+ * Vertices are split into contiguous ranges, one per thread. Each thread
+ * visits the faces around its vertices in ascending order and accumulates
+ * the mixed areas, angle sums, mean curvature normals, and vertex normals of
+ * its own vertices only. Faces on the border of two ranges are visited by
+ * both threads. Every vertex sums its terms in face order, so the result
+ * does not depend on the number of threads, and the memory used besides the
+ * result is one accumulator and the vertex to face incidence.
+ *
+ * @param[in]  mesh      The flat mesh
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @return     The curvatures
+ */
+Curvatures curvaturesViaMDSB(const FlatSurfaceMesh &mesh,
+                             std::size_t nthreads = 1);
+
+/**
+ * @brief      Compute the curvature using the Cazals-Pouget algorithm.
+ *
+ * Each vertex is fit independently from itself and its nearest rings of
+ * neighbors, gathered in breadth first order until the jet has enough points.
+ * Vertices are split among threads and each thread reuses one fitting
+ * workspace. Vertices without enough neighbors are set to NaN.
+ *
+ * @param[in]  mesh      The flat mesh
+ * @param[in]  dJet      Fit with a d-Jet
+ * @param[in]  dPrime    Maximal order differential to compute
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @return     The curvatures
+ */
+Curvatures curvaturesViaJets(const FlatSurfaceMesh &mesh, std::size_t dJet = 2,
+                             std::size_t dPrime = 2, std::size_t nthreads = 1);
+
+/**
+ * @brief      Compute the curvature using the Meyer, Desbrun, Schröder, Barr
+ *             algorithms.
+ *
+ * The returned arrays are indexed by vertex index and the map takes vertex
+ * keys of the source mesh to vertex indices. Prefer curvaturesViaMDSB, which
+ * does not hand out raw arrays.
+ *
+ * @param[in]  mesh    The flat mesh
+ */
+std::tuple<
+    REAL *, REAL *, REAL *, REAL *,
+    std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType>>
+curvatureViaMDSB(const FlatSurfaceMesh &mesh);
+} // end namespace gamer
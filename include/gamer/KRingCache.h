@@ -0,0 +1,212 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+/**
+ * @file KRingCache.h
+ * @brief Compressed k-ring vertex neighborhoods of a SurfaceMesh
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "gamer/SurfaceMesh.h"
+
+/// Namespace for all things gamer
+namespace gamer {
+
+/**
+ * @brief      Cache of the k-ring vertex neighborhoods of a SurfaceMesh.
+ *
+ * Vertices are assigned dense indices and their k-rings, as returned by
+ * casc::kneighbors_up, are stored in a single compressed (CSR-like) index
+ * array. The cache remains valid as long as the topology of the mesh does not
+ * change; moving vertices does not affect it.
+ *
+ * Local topology changes are supported through invalidate(). Call it on a
+ * vertex *before* modifying the mesh within its one ring (flipping an edge
+ * incident to it or decimating it). Every neighborhood which may change is
+ * marked dirty and recomputed by the next call to update(). Refreshed
+ * neighborhoods are appended to the index array and the array is compacted
+ * once more than half of it is stale.
+ */
+class KRingCache {
+public:
+  /// Contiguous range of neighbor indices
+  struct Range {
+    const std::uint32_t *first;
+    const std::uint32_t *last;
+
+    const std::uint32_t *begin() const { return first; }
+    const std::uint32_t *end() const { return last; }
+    std::size_t size() const { return last - first; }
+  };
+
+  KRingCache() = default;
+
+  /**
+   * @brief      Build the cache for all vertices of a mesh
+   *
+   * @param[in]  mesh      The mesh
+   * @param[in]  rings     Number of neighborhood rings
+   * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+   */
+  KRingCache(const SurfaceMesh &mesh, std::size_t rings,
+             std::size_t nthreads = 1);
+
+  /**
+   * @brief      Discard the current contents and rebuild from a mesh
+   *
+   * @param[in]  mesh      The mesh
+   * @param[in]  rings     Number of neighborhood rings
+   * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+   */
+  void rebuild(const SurfaceMesh &mesh, std::size_t rings,
+               std::size_t nthreads = 1);
+
+  /// Number of neighborhood rings cached
+  std::size_t rings() const { return _rings; }
+
+  /// Number of index slots, including erased vertices
+  std::size_t size() const { return _vertices.size(); }
+
+  /**
+   * @brief      Get the dense index of a vertex
+   *
+   * @param[in]  mesh      The mesh
+   * @param[in]  vertexID  The vertex
+   *
+   * @return     Index of the vertex in the cache
+   */
+  std::uint32_t index(const SurfaceMesh &mesh,
+                      SurfaceMesh::SimplexID<1> vertexID) const;
+
+  /// SimplexID of the vertex at an index
+  SurfaceMesh::SimplexID<1> vertex(std::uint32_t i) const {
+    return _vertices[i];
+  }
+
+  /// Indices of the k-ring of vertex i. Only valid if !dirty(i).
+  Range neighbors(std::uint32_t i) const {
+    return Range{_nbors.data() + _begin[i], _nbors.data() + _end[i]};
+  }
+
+  /// Whether the neighborhood of vertex i must be recomputed
+  bool dirty(std::uint32_t i) const { return _dirty[i]; }
+
+  /**
+   * @brief      Mark all neighborhoods that a change to the one ring of a
+   *             vertex may affect.
+   *
+   * Must be called before the topology is changed.
+   *
+   * @param[in]  mesh      The mesh
+   * @param[in]  vertexID  The vertex whose one ring will change
+   */
+  void invalidate(const SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID);
+
+  /**
+   * @brief      Remove a vertex which is about to be deleted from the mesh
+   *
+   * @param[in]  mesh      The mesh
+   * @param[in]  vertexID  The vertex to be deleted
+   */
+  void erase(const SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID);
+
+  /**
+   * @brief      Recompute all dirty neighborhoods
+   *
+   * @param[in]  mesh      The mesh
+   * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+   */
+  void update(const SurfaceMesh &mesh, std::size_t nthreads = 1);
+
+  /**
+   * @brief      Recompute the neighborhood of a single vertex if it is dirty
+   *
+   * @param[in]  mesh  The mesh
+   * @param[in]  i     Index of the vertex
+   */
+  void update(const SurfaceMesh &mesh, std::uint32_t i);
+
+private:
+  void gather(const SurfaceMesh &mesh, std::uint32_t i,
+              std::vector<std::uint32_t> &out) const;
+  void compact();
+
+  std::size_t _rings = 0;
+  std::vector<SurfaceMesh::SimplexID<1>> _vertices;
+  std::unordered_map<SurfaceMesh::KeyType, std::uint32_t> _index;
+  std::vector<std::size_t> _begin;
+  std::vector<std::size_t> _end;
+  std::vector<std::uint32_t> _nbors;
+  std::vector<char> _dirty;
+  std::vector<char> _erased;
+  /// Whether an index is already in _dirtyList
+  std::vector<char> _queued;
+  std::vector<std::uint32_t> _dirtyList;
+  /// Number of entries of _nbors referenced by live neighborhoods
+  std::size_t _used = 0;
+};
+
+namespace surfacemesh_detail {
+/**
+ * @brief      Computes the local structure tensor using cached neighborhoods
+ *
+ * @param[in]  mesh   Surface mesh of interest
+ * @param[in]  cache  Up to date k-ring cache of the mesh
+ * @param[in]  i      Cache index of the vertex of interest
+ *
+ * @return     The local structure tensor.
+ */
+tensor<double, 3, 2> computeLocalStructureTensor(const SurfaceMesh &mesh,
+                                                 const KRingCache &cache,
+                                                 std::uint32_t i);
+
+/**
+ * @brief      Computes the local structure tensor from cached normals and
+ *             cached neighborhoods
+ *
+ * @param[in]  mesh   Surface mesh of interest
+ * @param[in]  cache  Up to date k-ring cache of the mesh
+ * @param[in]  i      Cache index of the vertex of interest
+ *
+ * @return     The local structure tensor.
+ */
+tensor<double, 3, 2> computeLSTFromCache(const SurfaceMesh &mesh,
+                                         const KRingCache &cache,
+                                         std::uint32_t i);
+
+/**
+ * @brief      Compute the weightedVertexSmooth displacement using cached
+ *             neighborhoods for the LST.
+ *
+ * @param      mesh      SurfaceMesh of interest.
+ * @param[in]  cache     Up to date k-ring cache of the mesh
+ * @param[in]  vertexID  SimplexID of the vertex to move.
+ *
+ * @return     Displacement of the vertex
+ */
+Vector weightedVertexSmoothCache(SurfaceMesh &mesh, const KRingCache &cache,
+                                 SurfaceMesh::SimplexID<1> vertexID);
+} // end namespace surfacemesh_detail
+} // end namespace gamer
@@ -26,11 +26,16 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <bitset>
+#include <cstdint>
+#include <limits>
 #include <type_traits>
-#include <queue>
+#include <vector>
 #include "gamer/gamer.h"
+#include "gamer/SparseVolume.h"
 #include "gamer/SurfaceMesh.h"
+#include "gamer/parallel.h"
 
 /// Namespace for all things gamer
 namespace gamer
@@ -331,529 +336,1429 @@ static const int triTable[256][16] =
     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}};
 
 
+namespace marchingcubes_detail
+{
+// Marching cubes vertex indices and edges convention
+//		   v4_________e4_________v5
+//			/|                  /|
+//		e7 / |                 / |
+//		  /  |             e5 /  |
+//		 /   | e8            /	 | e9
+//	  v7/____|_____e6_______/v6	 |
+//		|	 |              |	 |
+//	    |  v0|______e0______|____|v1
+//	e11 |	/               |   /
+//		|  /			e10	|  /
+//		| /	e3				| / e1
+//		|/					|/
+//	  v3/_________e2________/v2
+//
+
+/// Offset of each cell vertex from the cell origin
+static const int cornerOffset[8][3] = {
+    {0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0},
+    {0, 0, 1}, {0, 1, 1}, {1, 1, 1}, {1, 0, 1}};
+
+/// Cell vertices spanned by each edge, the first owns the edge
+static const int edgeCorner[12][2] = {
+    {0, 1}, {1, 2}, {3, 2}, {0, 3}, {4, 5}, {5, 6},
+    {7, 6}, {4, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+/// Axis along which each edge runs
+static const int edgeAxis[12] = {1, 0, 1, 0, 1, 0, 1, 0, 2, 2, 2, 2};
+
+/// Number of cells along each side of an activity block
+static const int BlockSize = 8;
+
 /**
- * @brief      Marching cubes algorithm
+ * @brief      Coarse map of the cells which may intersect the surface.
  *
- * @param      dataset    Voxel array to mesh
- * @param[in]  maxval     Maximum value in the dataset
- * @param[in]  dim        Dimension of the dataset
- * @param[in]  span       Real space size of a voxel
- * @param[in]  isovalue   Isovalue to contour at
- * @param[in]  holelist   Inserter to append holes
+ * The cells are grouped into BlockSize^3 blocks. A block is active if the
+ * mask is not uniform over the nodes of its cells.
+ */
+struct ActiveBlocks
+{
+    Vector3i          dim;
+    std::vector<char> active;
+
+    /// Whether the block containing cell (i, j, k) is active
+    bool operator()(int i, int j, int k) const
+    {
+        return active[Vect2Index(i/BlockSize, j/BlockSize, k/BlockSize, dim)];
+    }
+};
+
+/**
+ * @brief      Find the blocks of cells which contain the surface
  *
- * @tparam     NumType    Numerical typename
- * @tparam     <unnamed>  Check to ensure NumType is numerical
- * @tparam     Inserter   Typename of the inserter
+ * @param[in]  inside    inside(i, j, k) is the inside/outside flag of a voxel
+ * @param[in]  uniform   uniform(bi, bj, bk) may return true if the flag is
+ *                       known to be uniform over the block, skipping its scan
+ * @param[in]  dim       Dimension of the dataset
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
  *
- * @return     Surface mesh
+ * @tparam     Inside    Typename of the flag accessor
+ * @tparam     Uniform   Typename of the uniform block predicate
+ *
+ * @return     The active blocks
  */
-template <typename NumType, typename = std::enable_if_t<std::is_arithmetic<NumType>::value>,
-          class Inserter>
-std::unique_ptr<SurfaceMesh> marchingCubes(
-    NumType       * dataset,
-    NumType         maxval,
+template <typename Inside, typename Uniform>
+ActiveBlocks findActiveBlocks(
+    const Inside   &inside,
+    const Uniform  &uniform,
     const Vector3i &dim,
-    const Vector3f &span,
-    NumType         isovalue,
-    Inserter        holelist
+    std::size_t     nthreads
     )
 {
-    std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
-    bool* mask = new bool[dim[0]*dim[1]*dim[2]];
-    for (int i = 0; i < dim[0]*dim[1]*dim[2]; ++i){
-        mask[i] = false;
-    }
-
-    std::cout << "Isolating isosurface" << std::endl;
-
-    // TODO: (4) is it necessary to go through this three step masking process?
-
-    // Mask all of the vertices connected to {0,0,0} outside of isosurface
-    std::deque<Vector3i> visit = {Vector3i({0, 0, 0})};
-    while (!visit.empty())
+    ActiveBlocks blocks;
+    for (int d = 0; d < 3; ++d)
     {
-        const Vector3i tmp = visit.front();
-        visit.pop_front();
-
-        // Look at the neighbor vertices
-        for (int k = std::max(tmp[2]-1, 0); k <= std::min(tmp[2]+1, dim[2]-1); ++k)
-        {
-            for (int j = std::max(tmp[1]-1, 0); j <= std::min(tmp[1]+1, dim[1]-1); ++j)
-            {
-                for (int i = std::max(tmp[0]-1, 0); i <= std::min(tmp[0]+1, dim[0]-1); ++i)
-                {
-                    if ((dataset[Vect2Index(i, j, k, dim)] < isovalue)
-                        && !mask[Vect2Index(i, j, k, dim)])
-                    {
-                        mask[Vect2Index(i, j, k, dim)] = true;
-                        visit.push_back(Vector3i({i, j, k}));
-                    }
-                }
-            }
-        }
+        blocks.dim[d] = std::max(dim[d]-2, 0)/BlockSize + 1;
     }
+    blocks.active.assign(blocks.dim[0]*blocks.dim[1]*blocks.dim[2], 0);
 
-    // Find internal holes
-    for (int n = 0; n < dim[2]; n++)
+    parallel::for_each_chunk(0, blocks.dim[2], nthreads,
+        [&](std::size_t, std::size_t bkBegin, std::size_t bkEnd)
     {
-        for (int m = 0; m < dim[1]; m++)
+        for (int bk = bkBegin; bk < static_cast<int>(bkEnd); ++bk)
         {
-            for (int l = 0; l < dim[0]; l++)
+            for (int bj = 0; bj < blocks.dim[1]; ++bj)
             {
-                if ((dataset[Vect2Index(l, m, n, dim)] < isovalue)
-                    && !mask[Vect2Index(l, m, n, dim)])
+                for (int bi = 0; bi < blocks.dim[0]; ++bi)
                 {
-                    int holesize = 1;
-                    visit.push_back(Vector3i({l, m, n}));
-
-                    std::vector<int> holevoxels;
-
-                    while (!visit.empty())
+                    if (uniform(bi, bj, bk))
+                        continue;
+                    const int i0 = bi*BlockSize, j0 = bj*BlockSize, k0 = bk*BlockSize;
+                    const int i1 = std::min(i0 + BlockSize, dim[0]-1);
+                    const int j1 = std::min(j0 + BlockSize, dim[1]-1);
+                    const int k1 = std::min(k0 + BlockSize, dim[2]-1);
+                    const bool first = inside(i0, j0, k0);
+                    bool active = false;
+                    for (int k = k0; k <= k1 && !active; ++k)
                     {
-                        const Vector3i tmp = visit.front();
-                        visit.pop_front();
-
-                        // Look at the neighbor vertices
-                        for (int i = std::max(tmp[0]-1, 0); i <= std::min(tmp[0]+1, dim[0]-1); ++i)
+                        for (int j = j0; j <= j1 && !active; ++j)
                         {
-                            for (int j = std::max(tmp[1]-1, 0); j <= std::min(tmp[1]+1, dim[1]-1); ++j)
+                            for (int i = i0; i <= i1; ++i)
                             {
-                                for (int k = std::max(tmp[2]-1, 0); k <= std::min(tmp[2]+1, dim[2]-1); ++k)
+                                if (inside(i, j, k) != first)
                                 {
-                                    if ((dataset[Vect2Index(i, j, k, dim)] < isovalue)
-                                        && !mask[Vect2Index(i, j, k, dim)])
-                                    {
-                                        int idx = Vect2Index(i, j, k, dim);
-                                        holevoxels.push_back(idx);
-
-                                        mask[idx] = true;
-                                        visit.push_back(Vector3i({i, j, k}));
-                                        holesize++;
-                                    }
+                                    active = true;
+                                    break;
                                 }
                             }
                         }
                     }
-                    std::cout << "Hole size: " << holesize << std::endl;
-
-                    if (holesize < MIN_VOLUME)
-                    {
-                        for (auto idx : holevoxels)
-                        {
-                            dataset[idx] = maxval;
-                            mask[idx] = false;
-                        }
-                    }
-                    else
-                    {
-                        Vector v = Vector({static_cast<double>(l),
-                                           static_cast<double>(m),
-                                           static_cast<double>(n)}).ElementwiseProduct(span);
-                        *holelist++ = v;
-                        std::cout << "Hole real size: " << v << std::endl;
-                    }
+                    blocks.active[Vect2Index(bi, bj, bk, blocks.dim)] = active;
                 }
             }
         }
-    }
-    std::cout << "Done isolating isosurface" << std::endl;
+    });
+    return blocks;
+}
 
-    size_t              vertexNum = 0;
-    size_t              triNum = 0;
-    std::array<int, 3>* triangles = new std::array<int, 3>[dim[0]*dim[1]*dim[2]];
-    Vector3i          * edges = new Vector3i[dim[0]*dim[1]*dim[2]];
-    Vector            * vertices = new Vector[dim[0]*dim[1]*dim[2]];
+/**
+ * @brief      Vertices and triangles extracted from a contiguous range of
+ *             cells.
+ *
+ * Vertex indices are local to the slab. Negative indices -1-n refer to
+ * external[n], the edge slot (3*node + axis) within lastPlane of the
+ * preceding slab.
+ */
+struct Slab
+{
+    std::vector<Vector>             vertices;
+    std::vector<std::array<int, 3>> triangles;
+    std::vector<std::size_t>        external;
+    /// Vertex index of each edge owned by the nodes of the plane i == iEnd
+    std::vector<Vector3i>           lastPlane;
+    /// Storage of the second rolling plane, kept for the next march
+    std::vector<Vector3i>           scratch;
+};
 
-    // This section in particular is weird...
-    for (int k = 0; k < dim[2]-1; k++)
-    {
-        for (int j = 0; j < dim[1]-1; j++)
-        {
-            for (int i = 0; i < dim[0]-1; i++)
-            {
-                int idx = Vect2Index(i, j, k, dim);
-                // If isovalue is within tolerance make it bigger
-                if ((dataset[idx] > isovalue - 0.0001) && (dataset[idx] < isovalue + 0.0001))
-                    dataset[idx] = isovalue + 0.0001;
-                edges[idx] = Vector3i({-1, -1, -1});
+/**
+ * @brief      March over the cells with first index in [iBegin, iEnd)
+ *
+ * Cells are visited in the same i, j, k order as a single pass over the grid
+ * so that concatenating consecutive slabs reproduces the serial numbering.
+ * Edge vertices are tracked in two rolling planes of nodes, so the memory
+ * used besides the output is proportional to a single grid plane. Edges in
+ * the plane i == iBegin are created by the cells i == iBegin-1. When `shared`
+ * is set they belong to the preceding slab and are recorded as external
+ * references. Inactive blocks of cells are skipped. The slab is cleared
+ * first and its storage is reused.
+ *
+ * @param[in]  value     value(i, j, k) is the value of a voxel
+ * @param[in]  inside    inside(i, j, k) is the inside/outside flag of a voxel
+ * @param[in]  blocks    Active blocks of cells
+ * @param[in]  dim       Dimension of the dataset
+ * @param[in]  span      Real space size of a voxel
+ * @param[in]  isovalue  Isovalue to contour at
+ * @param[in]  iBegin    First cell index along x
+ * @param[in]  iEnd      One past the last cell index along x
+ * @param[in]  shared    Whether the plane i == iBegin belongs to another slab
+ * @param      slab      Output
+ *
+ * @tparam     NumType   Numerical typename
+ * @tparam     Value     Typename of the value accessor
+ * @tparam     Inside    Typename of the flag accessor
+ */
+template <typename NumType, typename Value, typename Inside>
+void marchSlab(
+    const Value        &value,
+    const Inside       &inside,
+    const ActiveBlocks &blocks,
+    const Vector3i     &dim,
+    const Vector3f     &span,
+    NumType             isovalue,
+    int                 iBegin,
+    int                 iEnd,
+    bool                shared,
+    Slab               &slab
+    )
+{
+    slab.vertices.clear();
+    slab.triangles.clear();
+    slab.external.clear();
 
-                if (dataset[idx] >= isovalue)
-                {
-                    mask[idx] = false;
-                }
-                else
-                {
-                    mask[idx] = true;
-                }
-            }
-        }
-    }
+    // Edge vertices of the nodes in the planes i and i+1, indexed by k*dim[1]+j
+    const std::size_t planeSize = static_cast<std::size_t>(dim[1])*dim[2];
+    std::vector<Vector3i> planes[2];
+    planes[0].swap(slab.lastPlane);
+    planes[1].swap(slab.scratch);
+    for (auto &plane : planes)
+        plane.assign(planeSize, Vector3i({-1, -1, -1}));
 
-    std::cout << "Marching..." << std::endl;
-    // Marching cubes vertex indices and edges convention
-    //		   v4_________e4_________v5
-    //			/|                  /|
-    //		e7 / |                 / |
-    //		  /  |             e5 /  |
-    //		 /   | e8            /	 | e9
-    //	  v7/____|_____e6_______/v6	 |
-    //		|	 |              |	 |
-    //	    |  v0|______e0______|____|v1
-    //	e11 |	/               |   /
-    //		|  /			e10	|  /
-    //		| /	e3				| / e1
-    //		|/					|/
-    //	  v3/_________e2________/v2
-    //
-    for (int i = 0; i < dim[0]-1; i++)
+    for (int i = iBegin; i < iEnd; i++)
     {
         for (int j = 0; j < dim[1]-1; j++)
         {
             for (int k = 0; k < dim[2]-1; k++)
             {
+                if (!blocks(i, j, k))
+                {
+                    // Jump to the last cell of the block
+                    k = std::min((k/BlockSize + 1)*BlockSize, dim[2]-1) - 1;
+                    continue;
+                }
 
                 // List of vertices for the current cell
                 int cellVertices[12];
                 std::fill_n(cellVertices, 12, -1);
 
-                // Table of integer indices to overall dataset array
-                int indexTable[8];
-                indexTable[0] = Vect2Index(i, j, k, dim);
-                indexTable[1] = Vect2Index(i, j+1, k, dim);
-                indexTable[2] = Vect2Index(i+1, j+1, k, dim);
-                indexTable[3] = Vect2Index(i+1, j, k, dim);
-                indexTable[4] = Vect2Index(i, j, k+1, dim);
-                indexTable[5] = Vect2Index(i, j+1, k+1, dim);
-                indexTable[6] = Vect2Index(i+1, j+1, k+1, dim);
-                indexTable[7] = Vect2Index(i+1, j, k+1, dim);
-
                 int cellIndex = 0;  // Bitmask for intersections
                 for (int idx = 0; idx < 8; ++idx)
                 {
-                    if (mask[indexTable[idx]])
+                    if (inside(i + cornerOffset[idx][0],
+                               j + cornerOffset[idx][1],
+                               k + cornerOffset[idx][2]))
                     {
                         cellIndex |= (1 << idx);
                     }
                 }
-                // std::cout << std::bitset<8>(cellIndex) << std::endl;
 
-                NumType den1, den2;
-
-                if (edgeTable[cellIndex] & (1 << 0))
+                for (int e = 0; e < 12; ++e)
                 {
-                    auto &edgeIdx = edges[indexTable[0]][1];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[0]];
-                        den2 = dataset[indexTable[1]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i),
-                                                      static_cast<double>(j) + ratio,
-                                                      static_cast<double>(k)
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[0] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[0] = edgeIdx;
-                    }
-                }
+                    if (!(edgeTable[cellIndex] & (1 << e)))
+                        continue;
 
-                if (edgeTable[cellIndex] & (1 << 1))
-                {
-                    auto &edgeIdx = edges[indexTable[1]][0];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[1]];
-                        den2 = dataset[indexTable[2]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + ratio,
-                                                      static_cast<double>(j) + 1,
-                                                      static_cast<double>(k)
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[1] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[1] = edgeIdx;
-                    }
-                }
+                    const int a = edgeCorner[e][0];
+                    const int b = edgeCorner[e][1];
+                    const int axis = edgeAxis[e];
+                    const std::size_t node = (k + cornerOffset[a][2])*dim[1]
+                                             + j + cornerOffset[a][1];
 
-                if (edgeTable[cellIndex] & (1 << 2))
-                {
-                    auto &edgeIdx = edges[indexTable[3]][1];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[3]];
-                        den2 = dataset[indexTable[2]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + 1,
-                                                      static_cast<double>(j) + ratio,
-                                                      static_cast<double>(k)
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[2] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
+                    if (shared && i == iBegin && cornerOffset[a][0] == 0 && axis != 0)
                     {
-                        cellVertices[2] = edgeIdx;
+                        cellVertices[e] = -1 - static_cast<int>(slab.external.size());
+                        slab.external.push_back(3*node + axis);
+                        continue;
                     }
-                }
 
-                if (edgeTable[cellIndex] & (1 << 3))
-                {
-                    auto &edgeIdx = edges[indexTable[0]][0];
+                    auto &edgeIdx = planes[cornerOffset[a][0]][node][axis];
                     if (edgeIdx == -1)
                     {
-                        den1 = dataset[indexTable[0]];
-                        den2 = dataset[indexTable[3]];
+                        NumType den1 = value(i + cornerOffset[a][0],
+                                             j + cornerOffset[a][1],
+                                             k + cornerOffset[a][2]);
+                        NumType den2 = value(i + cornerOffset[b][0],
+                                             j + cornerOffset[b][1],
+                                             k + cornerOffset[b][2]);
                         NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + ratio,
-                                                      static_cast<double>(j),
-                                                      static_cast<double>(k)
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[3] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[3] = edgeIdx;
+                        double pos[3] = {static_cast<double>(i + cornerOffset[a][0]),
+                                         static_cast<double>(j + cornerOffset[a][1]),
+                                         static_cast<double>(k + cornerOffset[a][2])};
+                        pos[axis] += ratio;
+                        edgeIdx = slab.vertices.size();
+                        slab.vertices.push_back(
+                            Vector({pos[0], pos[1], pos[2]}).ElementwiseProduct(span));
                     }
+                    cellVertices[e] = edgeIdx;
                 }
 
-                if (edgeTable[cellIndex] & (1 << 4))
+                int ii = 0;
+                while (triTable[cellIndex][ii] != -1)
                 {
-                    auto &edgeIdx = edges[indexTable[4]][1];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[4]];
-                        den2 = dataset[indexTable[5]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i),
-                                                      static_cast<double>(j) + ratio,
-                                                      static_cast<double>(k) + 1
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[4] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[4] = edgeIdx;
-                    }
+                    slab.triangles.push_back({cellVertices[triTable[cellIndex][ii]],
+                                              cellVertices[triTable[cellIndex][ii+1]],
+                                              cellVertices[triTable[cellIndex][ii+2]]});
+                    ii += 3;
                 }
+            }
+        }
+        // Advance the rolling planes
+        planes[0].swap(planes[1]);
+        std::fill(planes[1].begin(), planes[1].end(), Vector3i({-1, -1, -1}));
+    }
+    slab.lastPlane.swap(planes[0]);
+    slab.scratch.swap(planes[1]);
+}
 
-                if (edgeTable[cellIndex] & (1 << 5))
-                {
-                    auto &edgeIdx = edges[indexTable[5]][0];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[5]];
-                        den2 = dataset[indexTable[6]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + ratio,
-                                                      static_cast<double>(j) + 1,
-                                                      static_cast<double>(k) + 1
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[5] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[5] = edgeIdx;
-                    }
-                }
+/**
+ * @brief      March over all cells in parallel slabs along x
+ *
+ * @param[in]  value     value(i, j, k) is the value of a voxel
+ * @param[in]  inside    inside(i, j, k) is the inside/outside flag of a voxel
+ * @param[in]  uniform   uniform(bi, bj, bk) may return true if the flag is
+ *                       known to be uniform over an activity block
+ * @param[in]  dim       Dimension of the dataset
+ * @param[in]  span      Real space size of a voxel
+ * @param[in]  isovalue  Isovalue to contour at
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ * @param      slabs     The slabs, to be merged by mergeSlabs. Their storage
+ *                       is reused.
+ *
+ * @tparam     NumType   Numerical typename
+ * @tparam     Value     Typename of the value accessor
+ * @tparam     Inside    Typename of the flag accessor
+ * @tparam     Uniform   Typename of the uniform block predicate
+ */
+template <typename NumType, typename Value, typename Inside, typename Uniform>
+void marchSlabs(
+    const Value       &value,
+    const Inside      &inside,
+    const Uniform     &uniform,
+    const Vector3i    &dim,
+    const Vector3f    &span,
+    NumType            isovalue,
+    std::size_t        nthreads,
+    std::vector<Slab> &slabs
+    )
+{
+    // Split the cells into slabs along the outermost loop index so that the
+    // slabs concatenate to the serial vertex and triangle order.
+    const std::size_t nCells = (dim[0] > 1) ? dim[0]-1 : 0;
+    const std::size_t nt = parallel::numThreads(nthreads, nCells);
+    const auto blocks = findActiveBlocks(inside, uniform, dim, nthreads);
+    slabs.resize(nt);
+    parallel::for_each_chunk(0, nCells, nt,
+        [&](std::size_t tid, std::size_t iBegin, std::size_t iEnd)
+    {
+        marchSlab<NumType>(value, inside, blocks, dim, span, isovalue,
+                           iBegin, iEnd, tid > 0, slabs[tid]);
+    });
+}
 
-                if (edgeTable[cellIndex] & (1 << 6))
-                {
-                    auto &edgeIdx = edges[indexTable[7]][1];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[7]];
-                        den2 = dataset[indexTable[6]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + 1,
-                                                      static_cast<double>(j) + ratio,
-                                                      static_cast<double>(k) + 1
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[6] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[6] = edgeIdx;
-                    }
-                }
+/**
+ * @brief      March over all cells in parallel slabs along x
+ *
+ * @param[in]  value     value(i, j, k) is the value of a voxel
+ * @param[in]  inside    inside(i, j, k) is the inside/outside flag of a voxel
+ * @param[in]  uniform   uniform(bi, bj, bk) may return true if the flag is
+ *                       known to be uniform over an activity block
+ * @param[in]  dim       Dimension of the dataset
+ * @param[in]  span      Real space size of a voxel
+ * @param[in]  isovalue  Isovalue to contour at
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     NumType   Numerical typename
+ * @tparam     Value     Typename of the value accessor
+ * @tparam     Inside    Typename of the flag accessor
+ * @tparam     Uniform   Typename of the uniform block predicate
+ *
+ * @return     The slabs, to be merged by mergeSlabs
+ */
+template <typename NumType, typename Value, typename Inside, typename Uniform>
+std::vector<Slab> marchSlabs(
+    const Value    &value,
+    const Inside   &inside,
+    const Uniform  &uniform,
+    const Vector3i &dim,
+    const Vector3f &span,
+    NumType         isovalue,
+    std::size_t     nthreads
+    )
+{
+    std::vector<Slab> slabs;
+    marchSlabs<NumType>(value, inside, uniform, dim, span, isovalue, nthreads,
+                        slabs);
+    return slabs;
+}
 
-                if (edgeTable[cellIndex] & (1 << 7))
-                {
-                    auto &edgeIdx = edges[indexTable[4]][0];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[4]];
-                        den2 = dataset[indexTable[7]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + ratio,
-                                                      static_cast<double>(j),
-                                                      static_cast<double>(k) + 1
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[7] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[7] = edgeIdx;
-                    }
-                }
+/**
+ * @brief      Merge the slabs of marchSlabs into flat buffers
+ *
+ * @param[in]  slabs      The slabs
+ * @param      vertices   Output vertex positions. The storage is reused.
+ * @param      triangles  Output triangles. The storage is reused.
+ */
+inline void mergeSlabs(
+    const std::vector<Slab>         &slabs,
+    std::vector<Vector>             &vertices,
+    std::vector<std::array<int, 3>> &triangles
+    )
+{
+    const std::size_t nt = slabs.size();
 
-                if (edgeTable[cellIndex] & (1 << 8))
+    // Merge the slabs. Local indices are shifted by the number of vertices in
+    // the preceding slabs and external references are looked up in the last
+    // plane of the preceding slab.
+    std::vector<std::size_t> vertexOffset(nt+1, 0);
+    std::vector<std::size_t> triangleOffset(nt+1, 0);
+    for (std::size_t t = 0; t < nt; ++t)
+    {
+        vertexOffset[t+1]   = vertexOffset[t] + slabs[t].vertices.size();
+        triangleOffset[t+1] = triangleOffset[t] + slabs[t].triangles.size();
+    }
+    vertices.resize(vertexOffset[nt]);
+    triangles.resize(triangleOffset[nt]);
+    parallel::for_each_chunk(0, nt, nt,
+        [&](std::size_t, std::size_t tBegin, std::size_t tEnd)
+    {
+        for (std::size_t t = tBegin; t < tEnd; ++t)
+        {
+            const auto &slab = slabs[t];
+            std::copy(slab.vertices.begin(), slab.vertices.end(),
+                      vertices.begin() + vertexOffset[t]);
+            for (std::size_t n = 0; n < slab.triangles.size(); ++n)
+            {
+                auto &tri = triangles[triangleOffset[t] + n];
+                for (int v = 0; v < 3; ++v)
                 {
-                    auto &edgeIdx = edges[indexTable[0]][2];
-                    if (edgeIdx == -1)
+                    int local = slab.triangles[n][v];
+                    if (local >= 0)
                     {
-                        den1 = dataset[indexTable[0]];
-                        den2 = dataset[indexTable[4]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i),
-                                                      static_cast<double>(j),
-                                                      static_cast<double>(k) + ratio
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[8] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
+                        tri[v] = vertexOffset[t] + local;
                     }
                     else
                     {
-                        cellVertices[8] = edgeIdx;
+                        std::size_t slot = slab.external[-1 - local];
+                        tri[v] = vertexOffset[t-1] + slabs[t-1].lastPlane[slot/3][slot%3];
                     }
                 }
+            }
+        }
+    });
+}
 
-                if (edgeTable[cellIndex] & (1 << 9))
-                {
-                    auto &edgeIdx = edges[indexTable[1]][2];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[1]];
-                        den2 = dataset[indexTable[5]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i),
-                                                      static_cast<double>(j) + 1,
-                                                      static_cast<double>(k) + ratio
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[9] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[9] = edgeIdx;
-                    }
-                }
+/**
+ * @brief      Build a SurfaceMesh from flat vertex and triangle buffers
+ *
+ * @param[in]  vertices   Vertex positions
+ * @param[in]  triangles  Triangles as triples of vertex indices
+ *
+ * @return     Surface mesh
+ */
+inline std::unique_ptr<SurfaceMesh> buildMesh(
+    const std::vector<Vector>             &vertices,
+    const std::vector<std::array<int, 3>> &triangles
+    )
+{
+    // Vertices and triangles are tightly packed so they can be handed to the
+    // builder as flat buffers.
+    static_assert(sizeof(Vector) == 3*sizeof(REAL),
+                  "Vector must be three contiguous REALs");
+    static_assert(sizeof(std::array<int, 3>) == 3*sizeof(int),
+                  "std::array<int,3> must be three contiguous ints");
+    return buildSurfaceMesh(
+        reinterpret_cast<const REAL*>(vertices.data()), vertices.size(),
+        reinterpret_cast<const int*>(triangles.data()), triangles.size());
+}
 
-                if (edgeTable[cellIndex] & (1 << 10))
-                {
-                    auto &edgeIdx = edges[indexTable[2]][2];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[2]];
-                        den2 = dataset[indexTable[6]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + 1,
-                                                      static_cast<double>(j) + 1,
-                                                      static_cast<double>(k) + ratio
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[10] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[10] = edgeIdx;
-                    }
-                }
+/**
+ * @brief      Merge the slabs of marchSlabs into a SurfaceMesh
+ *
+ * @param      slabs  The slabs, cleared on return
+ *
+ * @return     Surface mesh
+ */
+inline std::unique_ptr<SurfaceMesh> mergeSlabs(std::vector<Slab> &slabs)
+{
+    std::vector<Vector>             vertices;
+    std::vector<std::array<int, 3>> triangles;
+    mergeSlabs(slabs, vertices, triangles);
+    slabs.clear();
+    return buildMesh(vertices, triangles);
+}
+} // end namespace marchingcubes_detail
 
-                if (edgeTable[cellIndex] & (1 << 11))
-                {
-                    auto &edgeIdx = edges[indexTable[3]][2];
-                    if (edgeIdx == -1)
-                    {
-                        den1 = dataset[indexTable[3]];
-                        den2 = dataset[indexTable[7]];
-                        NumType ratio = (den1 != den2) ? (isovalue-den1)/(den2-den1) : 0;
-                        // std::cout << den1 << " " << den2 << " " << ratio <<
-                        // std::endl;
-                        vertices[vertexNum] = Vector({static_cast<double>(i) + 1,
-                                                      static_cast<double>(j),
-                                                      static_cast<double>(k) + ratio
-                                                     }).ElementwiseProduct(span);
-                        cellVertices[11] = vertexNum;
-                        edgeIdx = vertexNum;
-                        vertexNum++;
-                    }
-                    else
-                    {
-                        cellVertices[11] = edgeIdx;
-                    }
-                }
 
-                int ii = 0;
-                while (triTable[cellIndex][ii] != -1)
-                {
-                    triangles[triNum] = {cellVertices[triTable[cellIndex][ii++]],
-                                         cellVertices[triTable[cellIndex][ii++]],
-                                         cellVertices[triTable[cellIndex][ii++]]};
-                    triNum++;
-                }
-            }
-        }
-    }
+/**
+ * @brief      Connected components of the voxels below an isovalue
+ *
+ * Voxels are connected through their 26 neighbors. Components are numbered
+ * in memory order of their first voxel.
+ */
+struct VoxelComponents
+{
+    /// Label of voxels which do not belong to any component
+    static constexpr std::uint32_t NoComponent = std::numeric_limits<std::uint32_t>::max();
 
-    for (int i = 0; i < vertexNum; ++i)
-    {
-        mesh->insert<1>({i}, SMVertex(vertices[i]));
-    }
-    for (int i = 0; i < triNum; ++i)
+    /// Component of each voxel or NoComponent if at or above the isovalue
+    std::vector<std::uint32_t> labels;
+    /// Number of voxels in each component
+    std::vector<std::size_t>   sizes;
+    /// First voxel of each component in memory order
+    std::vector<Vector3i>      representatives;
+
+    /// Number of components
+    std::size_t size() const { return sizes.size(); }
+};
+
+
+/**
+ * @brief      Label the 26-connected components of the voxels below an
+ *             isovalue.
+ *
+ * Union-find over the voxels where each union links the larger root to the
+ * smaller one, so the root of a component is its first voxel. Slabs along z
+ * are labeled concurrently and joined across the slab boundaries afterwards.
+ * The result does not depend on the number of threads.
+ *
+ * @param[in]  dataset   Voxel array
+ * @param[in]  dim       Dimension of the dataset
+ * @param[in]  isovalue  Voxels strictly below it are labeled
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ * @param      result    The components. The storage is reused.
+ *
+ * @tparam     NumType   Numerical typename
+ */
+template <typename NumType>
+void labelComponents(
+    const NumType   *dataset,
+    const Vector3i  &dim,
+    NumType          isovalue,
+    std::size_t      nthreads,
+    VoxelComponents &result
+    )
+{
+    const std::size_t n = static_cast<std::size_t>(dim[0])*dim[1]*dim[2];
+    if (n >= VoxelComponents::NoComponent)
     {
-        mesh->insert<3>(triangles[i]);
+        gamer_runtime_error("Grid is too large to label its components.");
     }
 
-    delete[] vertices;
-    delete[] triangles;
-    delete[] mask;
-    delete[] edges;
+    auto &parent = result.labels;
+    parent.resize(n);
+    result.sizes.clear();
+    result.representatives.clear();
 
-    compute_orientation(*mesh);
-    return mesh;
+    auto find = [&parent](std::uint32_t x)
+    {
+        while (parent[x] != x)
+        {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+    auto unite = [&](std::uint32_t a, std::uint32_t b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a < b)
+            parent[b] = a;
+        else if (b < a)
+            parent[a] = b;
+    };
+    // Unite a voxel with its neighbors in the plane k-1, or with the earlier
+    // neighbors in its own plane.
+    auto uniteBackward = [&](int i, int j, int k, bool previousPlane)
+    {
+        const std::uint32_t idx = Vect2Index(i, j, k, dim);
+        const int dkBegin = previousPlane ? -1 : 0;
+        for (int dk = dkBegin; dk <= dkBegin; ++dk)
+        {
+            for (int dj = -1; dj <= (previousPlane ? 1 : 0); ++dj)
+            {
+                for (int di = -1; di <= 1; ++di)
+                {
+                    if (!previousPlane && dj == 0 && di >= 0)
+                        break;
+                    int ni = i + di, nj = j + dj, nk = k + dk;
+                    if (ni < 0 || ni >= dim[0] || nj < 0 || nj >= dim[1])
+                        continue;
+                    std::uint32_t nidx = Vect2Index(ni, nj, nk, dim);
+                    if (parent[nidx] != VoxelComponents::NoComponent)
+                        unite(idx, nidx);
+                }
+            }
+        }
+    };
+
+    // Label each slab on its own. Unions stay within the slab.
+    const std::size_t nt = parallel::numThreads(nthreads, dim[2]);
+    std::vector<int> slabBegin(nt, 0);
+    parallel::for_each_chunk(0, dim[2], nt,
+        [&](std::size_t tid, std::size_t kBegin, std::size_t kEnd)
+    {
+        slabBegin[tid] = kBegin;
+        for (int k = kBegin; k < static_cast<int>(kEnd); ++k)
+        {
+            for (int j = 0; j < dim[1]; ++j)
+            {
+                for (int i = 0; i < dim[0]; ++i)
+                {
+                    const std::uint32_t idx = Vect2Index(i, j, k, dim);
+                    if (!(dataset[idx] < isovalue))
+                    {
+                        parent[idx] = VoxelComponents::NoComponent;
+                        continue;
+                    }
+                    parent[idx] = idx;
+                    uniteBackward(i, j, k, false);
+                    if (k > static_cast<int>(kBegin))
+                        uniteBackward(i, j, k, true);
+                }
+            }
+        }
+    });
+
+    // Join the slabs
+    for (std::size_t t = 1; t < nt; ++t)
+    {
+        const int k = slabBegin[t];
+        for (int j = 0; j < dim[1]; ++j)
+        {
+            for (int i = 0; i < dim[0]; ++i)
+            {
+                if (parent[Vect2Index(i, j, k, dim)] != VoxelComponents::NoComponent)
+                    uniteBackward(i, j, k, true);
+            }
+        }
+    }
+
+    // Parents always precede their children in memory so a single ascending
+    // pass replaces each parent by the final component label.
+    for (std::size_t idx = 0; idx < n; ++idx)
+    {
+        const std::uint32_t p = parent[idx];
+        if (p == VoxelComponents::NoComponent)
+            continue;
+        if (p == idx)
+        {
+            parent[idx] = result.sizes.size();
+            result.sizes.push_back(1);
+            const int i = idx % dim[0];
+            const int j = (idx / dim[0]) % dim[1];
+            const int k = idx / (static_cast<std::size_t>(dim[0])*dim[1]);
+            result.representatives.push_back(Vector3i({i, j, k}));
+        }
+        else
+        {
+            parent[idx] = parent[p];
+            ++result.sizes[parent[idx]];
+        }
+    }
+}
+
+/**
+ * @brief      Label the 26-connected components of the voxels below an
+ *             isovalue.
+ *
+ * @param[in]  dataset   Voxel array
+ * @param[in]  dim       Dimension of the dataset
+ * @param[in]  isovalue  Voxels strictly below it are labeled
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     NumType   Numerical typename
+ *
+ * @return     The components
+ */
+template <typename NumType>
+VoxelComponents labelComponents(
+    const NumType  *dataset,
+    const Vector3i &dim,
+    NumType         isovalue,
+    std::size_t     nthreads = 1
+    )
+{
+    VoxelComponents result;
+    labelComponents(dataset, dim, isovalue, nthreads, result);
+    return result;
+}
+
+
+/**
+ * @brief      Buffers of the dense marchingCubes which are kept between calls
+ *
+ * Meshing many grids of the same size, such as the frames of a trajectory,
+ * with one workspace allocates the buffers once.
+ */
+struct MarchingCubesWorkspace
+{
+    /// Inside flag of each voxel
+    std::vector<char>                         mask;
+    /// Components of the voxels below the isovalue
+    VoxelComponents                           components;
+    /// Per thread output of the extraction
+    std::vector<marchingcubes_detail::Slab>   slabs;
+    /// Vertex positions of the last surface
+    std::vector<Vector>                       vertices;
+    /// Triangles of the last surface as triples of vertex indices
+    std::vector<std::array<int, 3>>           triangles;
+};
+
+
+/**
+ * @brief      Marching cubes algorithm
+ *
+ * Cavities, components below the isovalue which do not touch the origin,
+ * are set to maxval when they have fewer than MIN_VOLUME voxels. Larger
+ * cavities are kept and their first voxel is appended to holelist.
+ *
+ * @param      dataset    Voxel array to mesh
+ * @param[in]  maxval     Maximum value in the dataset
+ * @param[in]  dim        Dimension of the dataset
+ * @param[in]  span       Real space size of a voxel
+ * @param[in]  isovalue   Isovalue to contour at
+ * @param[in]  holelist   Inserter to append holes
+ * @param      workspace  Buffers to reuse. The surface is left in its
+ *                        vertices and triangles.
+ * @param[in]  nthreads   Number of threads used for the extraction (0 uses all
+ *                        hardware threads). The mesh does not depend on it.
+ *
+ * @tparam     NumType    Numerical typename
+ * @tparam     <unnamed>  Check to ensure NumType is numerical
+ * @tparam     Inserter   Typename of the inserter
+ */
+template <typename NumType, typename = std::enable_if_t<std::is_arithmetic<NumType>::value>,
+          class Inserter>
+void marchingCubes(
+    NumType                * dataset,
+    NumType                  maxval,
+    const Vector3i          &dim,
+    const Vector3f          &span,
+    NumType                  isovalue,
+    Inserter                 holelist,
+    MarchingCubesWorkspace  &workspace,
+    std::size_t              nthreads = 1
+    )
+{
+    const std::size_t nNodes = static_cast<std::size_t>(dim[0])*dim[1]*dim[2];
+    auto &mask = workspace.mask;
+    mask.assign(nNodes, false);
+
+    std::cout << "Isolating isosurface" << std::endl;
+
+    // The components touching the origin are the outside. The others are
+    // cavities, which are filled unless they are large enough to be holes.
+    VoxelComponents &components = workspace.components;
+    labelComponents(dataset, dim, isovalue, nthreads, components);
+    std::vector<char> fill(components.size(), 1);
+    for (int k = 0; k <= std::min(1, dim[2]-1); ++k)
+    {
+        for (int j = 0; j <= std::min(1, dim[1]-1); ++j)
+        {
+            for (int i = 0; i <= std::min(1, dim[0]-1); ++i)
+            {
+                auto label = components.labels[Vect2Index(i, j, k, dim)];
+                if (label != VoxelComponents::NoComponent)
+                    fill[label] = 0;
+            }
+        }
+    }
+
+    std::size_t nFilled = 0;
+    for (std::size_t c = 0; c < components.size(); ++c)
+    {
+        if (!fill[c])
+            continue;
+        if (components.sizes[c] < MIN_VOLUME)
+        {
+            ++nFilled;
+        }
+        else
+        {
+            fill[c] = 0;
+            std::cout << "Hole size: " << components.sizes[c] << std::endl;
+            const Vector3i &r = components.representatives[c];
+            Vector v = Vector({static_cast<double>(r[0]),
+                               static_cast<double>(r[1]),
+                               static_cast<double>(r[2])}).ElementwiseProduct(span);
+            *holelist++ = v;
+            std::cout << "Hole real size: " << v << std::endl;
+        }
+    }
+    std::cout << "Filled " << nFilled << " cavities smaller than "
+              << MIN_VOLUME << " voxels" << std::endl;
+
+    parallel::for_each_chunk(0, nNodes, nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t idx = begin; idx < end; ++idx)
+        {
+            auto label = components.labels[idx];
+            if (label == VoxelComponents::NoComponent)
+                continue;
+            if (fill[label])
+                dataset[idx] = maxval;
+            else
+                mask[idx] = true;
+        }
+    });
+    std::cout << "Done isolating isosurface" << std::endl;
+
+    // This section in particular is weird...
+    parallel::for_each_chunk(0, dim[2]-1, nthreads,
+        [&](std::size_t, std::size_t kBegin, std::size_t kEnd)
+    {
+        for (int k = kBegin; k < static_cast<int>(kEnd); k++)
+        {
+            for (int j = 0; j < dim[1]-1; j++)
+            {
+                for (int i = 0; i < dim[0]-1; i++)
+                {
+                    int idx = Vect2Index(i, j, k, dim);
+                    // If isovalue is within tolerance make it bigger
+                    if ((dataset[idx] > isovalue - 0.0001) && (dataset[idx] < isovalue + 0.0001))
+                        dataset[idx] = isovalue + 0.0001;
+
+                    if (dataset[idx] >= isovalue)
+                    {
+                        mask[idx] = false;
+                    }
+                    else
+                    {
+                        mask[idx] = true;
+                    }
+                }
+            }
+        }
+    });
+
+    std::cout << "Marching..." << std::endl;
+    auto value = [dataset, &dim](int i, int j, int k)
+    {
+        return dataset[Vect2Index(i, j, k, dim)];
+    };
+    auto inside = [&mask, &dim](int i, int j, int k)
+    {
+        return mask[Vect2Index(i, j, k, dim)];
+    };
+    marchingcubes_detail::marchSlabs<NumType>(value, inside,
+        [](int, int, int) { return false; }, dim, span, isovalue, nthreads,
+        workspace.slabs);
+    marchingcubes_detail::mergeSlabs(workspace.slabs, workspace.vertices,
+                                     workspace.triangles);
+}
+
+
+/**
+ * @brief      Marching cubes algorithm
+ *
+ * @param      dataset    Voxel array to mesh
+ * @param[in]  maxval     Maximum value in the dataset
+ * @param[in]  dim        Dimension of the dataset
+ * @param[in]  span       Real space size of a voxel
+ * @param[in]  isovalue   Isovalue to contour at
+ * @param[in]  holelist   Inserter to append holes
+ * @param[in]  nthreads   Number of threads used for the extraction (0 uses all
+ *                        hardware threads). The mesh does not depend on it.
+ *
+ * @tparam     NumType    Numerical typename
+ * @tparam     <unnamed>  Check to ensure NumType is numerical
+ * @tparam     Inserter   Typename of the inserter
+ *
+ * @return     Surface mesh
+ */
+template <typename NumType, typename = std::enable_if_t<std::is_arithmetic<NumType>::value>,
+          class Inserter>
+std::unique_ptr<SurfaceMesh> marchingCubes(
+    NumType       * dataset,
+    NumType         maxval,
+    const Vector3i &dim,
+    const Vector3f &span,
+    NumType         isovalue,
+    Inserter        holelist,
+    std::size_t     nthreads = 1
+    )
+{
+    MarchingCubesWorkspace workspace;
+    marchingCubes(dataset, maxval, dim, span, isovalue, holelist, workspace,
+                  nthreads);
+    // Free the grid sized buffers before the mesh is built
+    workspace.mask       = std::vector<char>();
+    workspace.components = VoxelComponents();
+    workspace.slabs      = std::vector<marchingcubes_detail::Slab>();
+    return marchingcubes_detail::buildMesh(workspace.vertices,
+                                           workspace.triangles);
+}
+namespace marchingcubes_detail
+{
+/// Whether marchingCubes raises a value above the isovalue
+template <typename NumType>
+bool inBand(NumType value, NumType isovalue)
+{
+    return (value > isovalue - 0.0001) && (value < isovalue + 0.0001);
+}
+
+/// Side of the isovalue of a value: -1 below, 1 above, 0 within the band
+template <typename NumType>
+int side(NumType value, NumType isovalue)
+{
+    if (inBand(value, isovalue))
+        return 0;
+    return (value < isovalue) ? -1 : 1;
+}
+
+/// Side of the isovalue of all values in a range, 0 if they are not all on
+/// the same side outside of the band
+template <typename NumType>
+int side(const ValueRange<NumType> &range, NumType isovalue)
+{
+    if (side(range.max, isovalue) == -1)
+        return -1;
+    if (side(range.min, isovalue) == 1)
+        return 1;
+    return 0;
+}
+
+/**
+ * @brief      Replace the bricks which cannot touch the isosurface by uniform
+ *             bricks.
+ *
+ * A brick is collapsed if its voxels and the voxels bordering its faces are
+ * all on the same side of the isovalue and outside of the tolerance band. No
+ * edge crossing the isosurface then ends in the brick, so its values are never
+ * interpolated, and its voxels are connected among themselves. The brick
+ * ranges decide most bricks without reading their voxels; only the voxels
+ * bordering the faces of a brick are read, when a neighboring brick straddles
+ * the isovalue.
+ *
+ * @param      volume    The volume
+ * @param[in]  ranges    Range of the values of each brick
+ * @param[in]  isovalue  Isovalue to contour at
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     NumType   Numerical typename
+ */
+template <typename NumType>
+void collapseBricks(
+    SparseVolume<NumType>         &volume,
+    const BrickRanges<NumType>    &ranges,
+    NumType                        isovalue,
+    std::size_t                    nthreads
+    )
+{
+    const int       B   = SparseVolume<NumType>::BrickSize;
+    const Vector3i &dim = volume.dim();
+    const Vector3i &nb  = volume.bricks();
+
+    std::vector<char> collapse(volume.size(), 0);
+    parallel::for_each_chunk(0, volume.size(), nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t b = begin; b < end; ++b)
+        {
+            if (!volume.allocated(b))
+                continue;
+            const int lo[3] = {static_cast<int>(b % nb[0])*B,
+                               static_cast<int>((b / nb[0]) % nb[1])*B,
+                               static_cast<int>(b / (static_cast<std::size_t>(nb[0])*nb[1]))*B};
+            const int hi[3] = {std::min(lo[0] + B, dim[0]),
+                               std::min(lo[1] + B, dim[1]),
+                               std::min(lo[2] + B, dim[2])};
+            const int s = side(ranges.bricks[b], isovalue);
+            if (s == 0)
+                continue;
+            // The face neighbors entirely on the same side spare the scan
+            const int bi[3] = {lo[0]/B, lo[1]/B, lo[2]/B};
+            bool neighbors = true;
+            for (int d = 0; d < 3 && neighbors; ++d)
+            {
+                for (int step = -1; step <= 1; step += 2)
+                {
+                    int n[3] = {bi[0], bi[1], bi[2]};
+                    n[d] += step;
+                    if (n[d] < 0 || n[d] >= nb[d])
+                        continue;
+                    if (side(ranges.bricks[volume.brick(n[0], n[1], n[2])], isovalue) != s)
+                    {
+                        neighbors = false;
+                        break;
+                    }
+                }
+            }
+            if (neighbors)
+            {
+                collapse[b] = true;
+                continue;
+            }
+            bool same = true;
+            for (int k = std::max(lo[2]-1, 0); k < std::min(hi[2]+1, dim[2]) && same; ++k)
+            {
+                for (int j = std::max(lo[1]-1, 0); j < std::min(hi[1]+1, dim[1]) && same; ++j)
+                {
+                    for (int i = std::max(lo[0]-1, 0); i < std::min(hi[0]+1, dim[0]); ++i)
+                    {
+                        // Only the voxels bordering the faces are read, the
+                        // range of the brick covers its own voxels
+                        const int outside = (i < lo[0] || i >= hi[0])
+                                          + (j < lo[1] || j >= hi[1])
+                                          + (k < lo[2] || k >= hi[2]);
+                        if (outside != 1)
+                            continue;
+                        if (side(volume(i, j, k), isovalue) != s)
+                        {
+                            same = false;
+                            break;
+                        }
+                    }
+                }
+            }
+            collapse[b] = same;
+        }
+    });
+
+    for (std::size_t b = 0; b < volume.size(); ++b)
+    {
+        if (collapse[b])
+            volume.setUniform(b, volume.data(b)[0]);
+    }
+}
+
+/**
+ * @brief      Fill the cavities of a sparse volume and report the holes
+ *
+ * Same as the cavity filling of the dense marchingCubes. Each voxel of an
+ * allocated brick and each uniform brick is a node of the union-find, so the
+ * memory used is proportional to the allocated bricks. Components are ordered
+ * by their first voxel in memory order as in labelComponents.
+ *
+ * @param      volume    The volume
+ * @param[in]  maxval    Value of the filled voxels
+ * @param[in]  span      Real space size of a voxel
+ * @param[in]  isovalue  Voxels strictly below it are labeled
+ * @param      holelist  Inserter to append holes
+ *
+ * @tparam     NumType   Numerical typename
+ * @tparam     Inserter  Typename of the inserter
+ */
+template <typename NumType, class Inserter>
+void fillCavities(
+    SparseVolume<NumType> &volume,
+    NumType                maxval,
+    const Vector3f        &span,
+    NumType                isovalue,
+    Inserter              &holelist
+    )
+{
+    const int       B   = SparseVolume<NumType>::BrickSize;
+    const Vector3i &dim = volume.dim();
+    const Vector3i &nb  = volume.bricks();
+    const std::uint32_t None = VoxelComponents::NoComponent;
+
+    // First node of each brick
+    std::vector<std::size_t> first(volume.size()+1, 0);
+    for (std::size_t b = 0; b < volume.size(); ++b)
+    {
+        first[b+1] = first[b] + (volume.allocated(b) ? SparseVolume<NumType>::BrickVoxels : 1);
+    }
+    if (first.back() >= None)
+    {
+        gamer_runtime_error("Grid is too large to label its components.");
+    }
+    auto node = [&](int i, int j, int k) -> std::uint32_t
+    {
+        const std::size_t b = volume.brickOf(i, j, k);
+        return first[b] + (volume.allocated(b) ? SparseVolume<NumType>::local(i, j, k) : 0);
+    };
+    auto brickBox = [&](std::size_t b, int lo[3], int hi[3])
+    {
+        lo[0] = static_cast<int>(b % nb[0])*B;
+        lo[1] = static_cast<int>((b / nb[0]) % nb[1])*B;
+        lo[2] = static_cast<int>(b / (static_cast<std::size_t>(nb[0])*nb[1]))*B;
+        for (int d = 0; d < 3; ++d)
+            hi[d] = std::min(lo[d] + B, dim[d]);
+    };
+
+    std::vector<std::uint32_t> parent(first.back(), None);
+    auto find = [&parent](std::uint32_t x)
+    {
+        while (parent[x] != x)
+        {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+    auto unite = [&](std::uint32_t a, std::uint32_t b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a < b)
+            parent[b] = a;
+        else if (b < a)
+            parent[a] = b;
+    };
+
+    int lo[3], hi[3];
+    for (std::size_t b = 0; b < volume.size(); ++b)
+    {
+        brickBox(b, lo, hi);
+        if (!volume.allocated(b))
+        {
+            if (volume.uniform(b) < isovalue)
+                parent[first[b]] = first[b];
+            continue;
+        }
+        for (int k = lo[2]; k < hi[2]; ++k)
+            for (int j = lo[1]; j < hi[1]; ++j)
+                for (int i = lo[0]; i < hi[0]; ++i)
+                    if (volume(i, j, k) < isovalue)
+                        parent[node(i, j, k)] = node(i, j, k);
+    }
+
+    // Join the 26 neighbors of each labeled voxel. Pairs of uniform bricks
+    // are joined brick by brick.
+    for (std::size_t b = 0; b < volume.size(); ++b)
+    {
+        brickBox(b, lo, hi);
+        if (!volume.allocated(b))
+        {
+            if (parent[first[b]] == None)
+                continue;
+            const int bi = lo[0]/B, bj = lo[1]/B, bk = lo[2]/B;
+            for (int dk = -1; dk <= 1; ++dk)
+                for (int dj = -1; dj <= 1; ++dj)
+                    for (int di = -1; di <= 1; ++di)
+                    {
+                        const int ni = bi+di, nj = bj+dj, nk = bk+dk;
+                        if (ni < 0 || ni >= nb[0] || nj < 0 || nj >= nb[1] || nk < 0 || nk >= nb[2])
+                            continue;
+                        const std::size_t n = volume.brick(ni, nj, nk);
+                        if (!volume.allocated(n) && parent[first[n]] != None)
+                            unite(first[b], first[n]);
+                    }
+            continue;
+        }
+        for (int k = lo[2]; k < hi[2]; ++k)
+            for (int j = lo[1]; j < hi[1]; ++j)
+                for (int i = lo[0]; i < hi[0]; ++i)
+                {
+                    const std::uint32_t idx = node(i, j, k);
+                    if (parent[idx] == None)
+                        continue;
+                    for (int dk = -1; dk <= 1; ++dk)
+                        for (int dj = -1; dj <= 1; ++dj)
+                            for (int di = -1; di <= 1; ++di)
+                            {
+                                const int ni = i+di, nj = j+dj, nk = k+dk;
+                                if (ni < 0 || ni >= dim[0] || nj < 0 || nj >= dim[1] || nk < 0 || nk >= dim[2])
+                                    continue;
+                                const std::uint32_t nidx = node(ni, nj, nk);
+                                if (parent[nidx] != None)
+                                    unite(idx, nidx);
+                            }
+                }
+    }
+
+    // Size and first voxel of each component, keyed by its root
+    struct Component
+    {
+        std::size_t size  = 0;
+        std::size_t first = std::numeric_limits<std::size_t>::max();
+    };
+    std::vector<std::uint32_t> roots;
+    std::vector<Component> components;
+    std::vector<std::uint32_t> rootComponent(first.back(), None);
+    auto addVoxels = [&](std::uint32_t idx, std::size_t count, std::size_t firstVoxel)
+    {
+        const std::uint32_t root = find(idx);
+        if (rootComponent[root] == None)
+        {
+            rootComponent[root] = components.size();
+            components.emplace_back();
+        }
+        auto &c = components[rootComponent[root]];
+        c.size += count;
+        c.first = std::min(c.first, firstVoxel);
+    };
+    for (std::size_t b = 0; b < volume.size(); ++b)
+    {
+        brickBox(b, lo, hi);
+        if (!volume.allocated(b))
+        {
+            if (parent[first[b]] != None)
+            {
+                addVoxels(first[b],
+                          static_cast<std::size_t>(hi[0]-lo[0])*(hi[1]-lo[1])*(hi[2]-lo[2]),
+                          Vect2Index(lo[0], lo[1], lo[2], dim));
+            }
+            continue;
+        }
+        for (int k = lo[2]; k < hi[2]; ++k)
+            for (int j = lo[1]; j < hi[1]; ++j)
+                for (int i = lo[0]; i < hi[0]; ++i)
+                    if (parent[node(i, j, k)] != None)
+                        addVoxels(node(i, j, k), 1, Vect2Index(i, j, k, dim));
+    }
+
+    // The components touching the origin are the outside. The others are
+    // cavities, which are filled unless they are large enough to be holes.
+    std::vector<char> fill(components.size(), 1);
+    for (int k = 0; k <= std::min(1, dim[2]-1); ++k)
+    {
+        for (int j = 0; j <= std::min(1, dim[1]-1); ++j)
+        {
+            for (int i = 0; i <= std::min(1, dim[0]-1); ++i)
+            {
+                const std::uint32_t idx = node(i, j, k);
+                if (parent[idx] != None)
+                    fill[rootComponent[find(idx)]] = 0;
+            }
+        }
+    }
+
+    std::vector<std::size_t> order(components.size());
+    for (std::size_t c = 0; c < order.size(); ++c)
+        order[c] = c;
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+    {
+        return components[a].first < components[b].first;
+    });
+
+    std::size_t nFilled = 0;
+    for (std::size_t c : order)
+    {
+        if (!fill[c])
+            continue;
+        if (components[c].size < MIN_VOLUME)
+        {
+            ++nFilled;
+        }
+        else
+        {
+            fill[c] = 0;
+            std::cout << "Hole size: " << components[c].size << std::endl;
+            const std::size_t r = components[c].first;
+            Vector v = Vector({static_cast<double>(r % dim[0]),
+                               static_cast<double>((r / dim[0]) % dim[1]),
+                               static_cast<double>(r / (static_cast<std::size_t>(dim[0])*dim[1]))}).ElementwiseProduct(span);
+            *holelist++ = v;
+            std::cout << "Hole real size: " << v << std::endl;
+        }
+    }
+    std::cout << "Filled " << nFilled << " cavities smaller than "
+              << MIN_VOLUME << " voxels" << std::endl;
+
+    for (std::size_t b = 0; b < volume.size(); ++b)
+    {
+        if (!volume.allocated(b))
+        {
+            if (parent[first[b]] != None && fill[rootComponent[find(first[b])]])
+                volume.setUniform(b, maxval);
+            continue;
+        }
+        NumType *values = volume.data(b);
+        for (int l = 0; l < SparseVolume<NumType>::BrickVoxels; ++l)
+        {
+            const std::uint32_t idx = first[b] + l;
+            if (parent[idx] != None && fill[rootComponent[find(idx)]])
+                values[l] = maxval;
+        }
+    }
+}
+
+/**
+ * @brief      Marching cubes on a sparse volume with known brick ranges
+ *
+ * @param      volume    Volume to mesh
+ * @param[in]  ranges    Range of the values of each brick
+ * @param[in]  maxval    Value of the filled cavities
+ * @param[in]  span      Real space size of a voxel
+ * @param[in]  isovalue  Isovalue to contour at
+ * @param[in]  holelist  Inserter to append holes
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     NumType   Numerical typename
+ * @tparam     Inserter  Typename of the inserter
+ *
+ * @return     Surface mesh
+ */
+template <typename NumType, class Inserter>
+std::unique_ptr<SurfaceMesh> marchSparse(
+    SparseVolume<NumType>      &volume,
+    const BrickRanges<NumType> &ranges,
+    NumType                     maxval,
+    const Vector3f             &span,
+    NumType                     isovalue,
+    Inserter                    holelist,
+    std::size_t                 nthreads
+    )
+{
+    const int       B   = SparseVolume<NumType>::BrickSize;
+    const Vector3i &dim = volume.dim();
+    const Vector3i &nb  = volume.bricks();
+
+    std::cout << "Isolating isosurface" << std::endl;
+    collapseBricks(volume, ranges, isovalue, nthreads);
+    std::cout << "Bricks near the surface: " << volume.allocatedBricks()
+              << " of " << volume.size() << std::endl;
+    fillCavities(volume, maxval, span, isovalue, holelist);
+
+    // If isovalue is within tolerance make it bigger. The last plane along
+    // each axis is left as is. Filling only sets voxels to maxval, so a brick
+    // whose range misses the band needs no visit unless maxval is in it.
+    const bool filledInBand = inBand(maxval, isovalue);
+    for (std::size_t b = 0; b < volume.size(); ++b)
+    {
+        if (volume.allocated(b) && !filledInBand &&
+            side(ranges.bricks[b], isovalue) != 0)
+            continue;
+        const int lo[3] = {static_cast<int>(b % nb[0])*B,
+                           static_cast<int>((b / nb[0]) % nb[1])*B,
+                           static_cast<int>(b / (static_cast<std::size_t>(nb[0])*nb[1]))*B};
+        if (!volume.allocated(b))
+        {
+            if (!inBand(volume.uniform(b), isovalue))
+                continue;
+            if (lo[0]+B < dim[0] && lo[1]+B < dim[1] && lo[2]+B < dim[2])
+            {
+                volume.setUniform(b, isovalue + 0.0001);
+                continue;
+            }
+            volume.allocate(b);
+        }
+        NumType *values = volume.data(b);
+        for (int k = lo[2]; k < std::min(lo[2]+B, dim[2]-1); ++k)
+        {
+            for (int j = lo[1]; j < std::min(lo[1]+B, dim[1]-1); ++j)
+            {
+                for (int i = lo[0]; i < std::min(lo[0]+B, dim[0]-1); ++i)
+                {
+                    NumType &v = values[SparseVolume<NumType>::local(i, j, k)];
+                    if (inBand(v, isovalue))
+                        v = isovalue + 0.0001;
+                }
+            }
+        }
+    }
+    std::cout << "Done isolating isosurface" << std::endl;
+
+    std::cout << "Marching..." << std::endl;
+    auto value = [&volume](int i, int j, int k)
+    {
+        return volume(i, j, k);
+    };
+    auto inside = [&volume, isovalue](int i, int j, int k)
+    {
+        return !(volume(i, j, k) >= isovalue);
+    };
+    // A block of cells reaches into the next brick along each axis
+    auto uniform = [&](int bi, int bj, int bk)
+    {
+        const std::size_t b = volume.brick(bi, bj, bk);
+        if (volume.allocated(b))
+            return false;
+        const bool flag = !(volume.uniform(b) >= isovalue);
+        for (int dk = 0; dk <= ((bk+1)*B <= dim[2]-1); ++dk)
+        {
+            for (int dj = 0; dj <= ((bj+1)*B <= dim[1]-1); ++dj)
+            {
+                for (int di = 0; di <= ((bi+1)*B <= dim[0]-1); ++di)
+                {
+                    const std::size_t n = volume.brick(bi+di, bj+dj, bk+dk);
+                    if (volume.allocated(n) || !(volume.uniform(n) >= isovalue) != flag)
+                        return false;
+                }
+            }
+        }
+        return true;
+    };
+    auto slabs = marchSlabs<NumType>(value, inside, uniform, dim, span,
+        isovalue, nthreads);
+    return mergeSlabs(slabs);
+}
+} // end namespace marchingcubes_detail
+
+
+/**
+ * @brief      Marching cubes algorithm on a sparse volume
+ *
+ * Produces the same mesh as the dense marchingCubes on the same values. The
+ * bricks which cannot touch the isosurface are collapsed first, so the
+ * labeling of cavities and the marching only visit the bricks near the
+ * surface. The volume is modified.
+ *
+ * @param      volume     Volume to mesh
+ * @param[in]  maxval     Maximum value in the volume
+ * @param[in]  span       Real space size of a voxel
+ * @param[in]  isovalue   Isovalue to contour at
+ * @param[in]  holelist   Inserter to append holes
+ * @param[in]  nthreads   Number of threads (0 uses all hardware threads). The
+ *                        mesh does not depend on it.
+ *
+ * @tparam     NumType    Numerical typename
+ * @tparam     <unnamed>  Check to ensure NumType is numerical
+ * @tparam     Inserter   Typename of the inserter
+ *
+ * @return     Surface mesh
+ */
+template <typename NumType, typename = std::enable_if_t<std::is_arithmetic<NumType>::value>,
+          class Inserter>
+std::unique_ptr<SurfaceMesh> marchingCubes(
+    SparseVolume<NumType> &volume,
+    NumType                maxval,
+    const Vector3f        &span,
+    NumType                isovalue,
+    Inserter               holelist,
+    std::size_t            nthreads = 1
+    )
+{
+    return marchingcubes_detail::marchSparse(volume,
+        brickRanges(volume, nthreads), maxval, span, isovalue, holelist,
+        nthreads);
+}
+
+
+/**
+ * @brief      Marching cubes algorithm on a sparse volume with known brick
+ *             ranges
+ *
+ * Same as the sparse marchingCubes, with the range of each brick supplied by
+ * the caller, e.g. as reduced by blurAtoms while splatting, so the volume is
+ * not scanned for it. The maximum of the ranges fills the cavities.
+ *
+ * @param      volume     Volume to mesh
+ * @param[in]  ranges     Range of the values of each brick of volume
+ * @param[in]  span       Real space size of a voxel
+ * @param[in]  isovalue   Isovalue to contour at
+ * @param[in]  holelist   Inserter to append holes
+ * @param[in]  nthreads   Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     NumType    Numerical typename
+ * @tparam     <unnamed>  Check to ensure NumType is numerical
+ * @tparam     Inserter   Typename of the inserter
+ *
+ * @return     Surface mesh
+ */
+template <typename NumType, typename = std::enable_if_t<std::is_arithmetic<NumType>::value>,
+          class Inserter>
+std::unique_ptr<SurfaceMesh> marchingCubes(
+    SparseVolume<NumType>      &volume,
+    const BrickRanges<NumType> &ranges,
+    const Vector3f             &span,
+    NumType                     isovalue,
+    Inserter                    holelist,
+    std::size_t                 nthreads = 1
+    )
+{
+    if (ranges.bricks.size() != volume.size())
+    {
+        gamer_runtime_error("Brick ranges do not match the volume.");
+    }
+    return marchingcubes_detail::marchSparse(volume, ranges,
+        ranges.total.max, span, isovalue, holelist, nthreads);
 }
 } // end namespace gamer
@@ -274,6 +274,11 @@ public:
   /**
    * @brief      Function call
    *
+   * The iterators dereference twice to a vertex or to a Vector, e.g. vertex
+   * IDs or pointers to positions. An object can be reused for many fits, the
+   * buffers of the least squares system are only reallocated when the number
+   * of points or the order changes.
+   *
    * @param[in]  begin          Iterator to first vertex and origin of fitting
    * @param[in]  end            Iterator just past the end
    * @param[in]  dJet           Order of jet fitting
@@ -309,31 +314,30 @@ public:
     // Initialize MongeForm
     MongeForm monge_form(dPrime);
 
-    // Assemble the linear system
-    EigenMatrixN M(nb_input_pts, nb_d_jet_coeff);
-    EigenVectorN Z(nb_input_pts);
+    // Assemble the linear system. The buffers are kept between calls so
+    // repeated fits of the same size do not allocate.
+    m_M.resize(nb_input_pts, nb_d_jet_coeff);
+    m_Z.resize(nb_input_pts);
 
     // Compute
     compute_PCA(begin, end);
-    fill_matrix(begin, end, dJet, M, Z); // with precond
-
-    // std::cout << "M:" << std::endl << M << std::endl;
-    // std::cout << "Z:" << std::endl << Z << std::endl;
-    // Solve MA=Z in the ls sense. The solution A is stored in Z.
-    Eigen::JacobiSVD<
-        Eigen::Matrix<REAL, Eigen::Dynamic, Eigen::Dynamic, Eigen::DontAlign>>
-        jacobiSvd(M, Eigen::ComputeThinU | Eigen::ComputeThinV);
-    Z = jacobiSvd.solve(EigenVectorN(Z));
-    condition_nb = jacobiSvd.singularValues().array().abs().maxCoeff() /
-                   jacobiSvd.singularValues().array().abs().minCoeff();
+    fill_matrix(begin, end, dJet, m_M, m_Z); // with precond
+
+    // std::cout << "M:" << std::endl << m_M << std::endl;
+    // std::cout << "Z:" << std::endl << m_Z << std::endl;
+    // Solve MA=Z in the ls sense.
+    m_svd.compute(m_M, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    m_A = m_svd.solve(m_Z);
+    condition_nb = m_svd.singularValues().array().abs().maxCoeff() /
+                   m_svd.singularValues().array().abs().minCoeff();
 
     for (int k = 0; k <= deg; k++)
       for (int i = 0; i <= k; i++)
-        Z(k * (k + 1) / 2 + i) /= std::pow(preconditionning, k);
+        m_A(k * (k + 1) / 2 + i) /= std::pow(preconditionning, k);
 
-    compute_Monge_basis(Z.data(), monge_form);
+    compute_Monge_basis(m_A.data(), monge_form);
     if (dPrime >= 3)
-      compute_Monge_coefficients(Z.data(), dPrime, monge_form);
+      compute_Monge_coefficients(m_A.data(), dPrime, monge_form);
     return monge_form;
   }
 
@@ -367,6 +371,25 @@ protected:
 
   std::vector<std::pair<REAL, Vector>> m_pca_basis;
 
+  /// Matrix type of the least squares system
+  using FitMatrix =
+      Eigen::Matrix<REAL, Eigen::Dynamic, Eigen::Dynamic, Eigen::DontAlign>;
+  /// Least squares system M A = Z
+  FitMatrix m_M;
+  EigenVectorN m_Z;
+  EigenVectorN m_A;
+  Eigen::JacobiSVD<FitMatrix> m_svd;
+  /// Input points in the fitting basis
+  std::vector<Vector> m_points;
+
+  /// Position of a vertex
+  template <typename T> static const Vector &position(const T &vertex) {
+    return vertex.position;
+  }
+
+  /// Position given directly
+  static const Vector &position(const Vector &point) { return point; }
+
   /// Translate the points such that p0 (the first point) is at the origin
   Eigen::Affine3d p02origin;
   /// Rotate local orientation to PCA
@@ -390,7 +413,7 @@ protected:
                   xy, xz, yz;
 
     for (; begin != end; begin++) {
-      Vector lp = (**begin).position;
+      Vector lp = position(**begin);
       x = lp[0];
       y = lp[1];
       z = lp[2];
@@ -463,9 +486,9 @@ protected:
   // Preconditionning is computed, M and Z are filled
   template <class InputIterator>
   void fill_matrix(InputIterator begin, InputIterator end, std::size_t d,
-                   EigenMatrixN &M, EigenVectorN &Z) {
+                   FitMatrix &M, EigenVectorN &Z) {
     // origin of fitting coord system = first input data point
-    Vector point0 = (**begin).position;
+    Vector point0 = position(**begin);
     // std::cout << "point0: " << point0 << std::endl;
     // transform coordinates of sample points with a
     // translation ($-p$) and multiplication by $ P_{W\rightarrow F}$.
@@ -477,11 +500,11 @@ protected:
     Eigen::Affine3d transf_points = world2pca * p02origin;
 
     // compute and store transformed points
-    std::vector<Vector> pts_in_fitting_basis;
-    pts_in_fitting_basis.reserve(nb_input_pts);
+    std::vector<Vector> &pts_in_fitting_basis = m_points;
+    pts_in_fitting_basis.clear();
 
     for (auto it = begin; it != end; ++it) {
-      Vector cur_pt = (**it).position;
+      Vector cur_pt = position(**it);
       cur_pt = transf_points * EigenMap(cur_pt);
       pts_in_fitting_basis.push_back(cur_pt);
     }
@@ -26,14 +26,22 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include "gamer/Vertex.h"
 #include "gamer/gamer.h"
+#include "gamer/SparseVolume.h"
 #include "gamer/SurfaceMesh.h"
+#include "gamer/parallel.h"
 
 /// Namespace for all things gamer
 namespace gamer {
@@ -48,8 +56,8 @@ static const std::regex PQR(".*.pqr", std::regex::icase | std::regex::optimize);
 /// Regular expression for parsing XYZR file extension
 static const std::regex XYZR(".*.xyzr",
                              std::regex::icase | std::regex::optimize);
-/// Regular expression to parse for lines starting with ATOM
-static const std::regex atom("ATOM.*\n*", std::regex::optimize);
+/// Regular expression for parsing mmCIF file extension
+static const std::regex CIF(".*.cif", std::regex::icase | std::regex::optimize);
 
 /**
  * @brief      PDB element information
@@ -240,10 +248,6 @@ static PDBelementInformation PDBelementTable[MAX_BIOCHEM_ELEMENTS] = {
     // {"SI  ", "UNL", 1.875f, 1.0f, 1.0f, 1.0f,  1, 27 },
     // {" O  ", "UNL", 1.480f, 1.0f, 0.0f, 0.0f,  1, 27 }
 };
-
-/// Map of residueName, atomName to PDBelementInformation
-static std::map<std::string, std::map<std::string, PDBelementInformation>>
-    PDBelementMap;
 } // End namespace pdbreader_detail
 /// @endcond
 
@@ -256,21 +260,193 @@ struct Atom {
 };
 
 /**
- * @brief      Initialize the element map
+ * @brief      Grid resolution of the volumetric molecular surface builders
+ *
+ * Grids span the padded bounding box of the atoms with `scale` points per
+ * Angstrom along each axis. If a memory budget is given the scale is lowered
+ * to the finest one whose estimated peak memory fits the budget. The scale is
+ * never raised above `scale`, so set it as well to allow grids finer than the
+ * default.
  */
-static void initElementMap() {
-  // If the element map is empty build it...
-  if (pdbreader_detail::PDBelementMap.size() == 0) {
-    for (int i = 0; i < pdbreader_detail::MAX_BIOCHEM_ELEMENTS; ++i) {
-      const std::string atomName =
-          pdbreader_detail::PDBelementTable[i].atomName;
-      const std::string residueName =
-          pdbreader_detail::PDBelementTable[i].residueName;
-      pdbreader_detail::PDBelementMap[residueName][atomName] =
-          pdbreader_detail::PDBelementTable[i];
-    }
-  }
-}
+struct GridResolution {
+  /// Grid points per Angstrom, 0 selects the default of the builder
+  double scale = 0;
+  /// Peak memory budget in bytes, 0 disables the automatic resolution
+  std::size_t memoryBudget = 0;
+};
+
+/**
+ * @brief      Estimated memory use of a molecular surface builder
+ */
+struct GridMemoryEstimate {
+  Vector3i dim;          /**< @brief grid dimension */
+  double scale;          /**< @brief grid points per Angstrom */
+  std::size_t gridBytes; /**< @brief peak memory of grids and working arrays */
+  std::size_t meshBytes; /**< @brief memory of the output mesh */
+
+  /// Estimated peak memory
+  std::size_t total() const { return gridBytes + meshBytes; }
+};
+
+/**
+ * @brief      Print a GridMemoryEstimate
+ *
+ * @param      output    The output stream
+ * @param[in]  estimate  The estimate
+ *
+ * @return     The output stream
+ */
+std::ostream &operator<<(std::ostream &output,
+                         const GridMemoryEstimate &estimate);
+
+/**
+ * @brief      Surface of one frame of a trajectory
+ *
+ * The buffers belong to the trajectory mesher and are overwritten by the next
+ * frame. Copy them or call mesh() to keep the surface.
+ */
+struct TrajectoryFrame {
+  /// Index of the frame, counting from zero
+  std::size_t index;
+  /// Vertex positions in the coordinates of the atoms
+  const std::vector<Vector> &vertices;
+  /// Triangles as triples of vertex indices
+  const std::vector<std::array<int, 3>> &triangles;
+
+  /// Build a SurfaceMesh of the frame
+  std::unique_ptr<SurfaceMesh> mesh() const;
+};
+
+/// Called with each frame of a trajectory in order. Return false to stop.
+using TrajectoryCallback = std::function<bool(const TrajectoryFrame &)>;
+
+/// @cond detail
+namespace pdbreader_detail {
+/**
+ * @brief      Parse the ATOM records of a PDB or PQR file
+ *
+ * The file is memory mapped where supported and scanned once. Coordinates
+ * (and PQR radii) are read from their fixed columns. PDB radii are looked up
+ * by residue and atom name in a sorted table built from PDBelementTable;
+ * unknown residues and atom types fall back to a radius of 1 and are
+ * reported once per name with a count at the end.
+ *
+ * @param[in]  filename  File to parse
+ * @param[in]  pqr       Read radii from the file instead of the table
+ * @param      atoms     Parsed atoms are appended
+ *
+ * @return     True if the file could be read
+ */
+bool readAtoms(const std::string &filename, bool pqr, std::vector<Atom> &atoms);
+
+/**
+ * @brief      Parse the ATOM records of each model of a PDB or PQR file
+ *
+ * Models end at ENDMDL records. Atoms after the last ENDMDL, or all atoms of
+ * a file without MODEL records, form a final model. Atoms are read as in
+ * readAtoms.
+ *
+ * @param[in]  filename  File to parse
+ * @param[in]  pqr       Read radii from the file instead of the table
+ * @param[in]  model     Called with the atoms of each model in order. The
+ *                       vector is reused for the next model. Return false to
+ *                       stop reading.
+ * @param[in]  report    Whether to report unknown residues and atom types
+ *
+ * @return     True if the file could be read
+ */
+bool readModels(const std::string &filename, bool pqr,
+                const std::function<bool(const std::vector<Atom> &)> &model,
+                bool report = true);
+
+/**
+ * @brief      Parse the _atom_site category of an mmCIF file
+ *
+ * The file is memory mapped where supported and tokenized in place, so rows
+ * are turned into atoms without copying their values. As for PDB files only
+ * ATOM records are read. Radii are looked up by label_comp_id and
+ * label_atom_id (or their auth_ counterparts) in PDBelementTable with the
+ * column padding of the PDB atom names removed. Unknown names fall back to a
+ * radius of 1 and are reported once per name with a count at the end.
+ *
+ * @param[in]  filename  File to parse
+ * @param      atoms     Parsed atoms are appended
+ *
+ * @return     True if the file could be read
+ */
+bool readCIFAtoms(const std::string &filename, std::vector<Atom> &atoms);
+
+/**
+ * @brief      Parse the _atom_site category of each model of an mmCIF file
+ *
+ * Models are consecutive rows with the same pdbx_PDB_model_num. Atoms are
+ * read as in readCIFAtoms.
+ *
+ * @param[in]  filename  File to parse
+ * @param[in]  model     Called with the atoms of each model in order. The
+ *                       vector is reused for the next model. Return false to
+ *                       stop reading.
+ * @param[in]  report    Whether to report unknown residues and atom types
+ *
+ * @return     True if the file could be read
+ */
+bool readCIFModels(const std::string &filename,
+                   const std::function<bool(const std::vector<Atom> &)> &model,
+                   bool report = true);
+
+/**
+ * @brief      Copy packed coordinate and radius buffers into atoms
+ *
+ * Throws if the buffers are missing or hold no atoms.
+ *
+ * @param[in]  xyz     Atom coordinates packed as x0,y0,z0,x1,... (3*nAtoms)
+ * @param[in]  radii   Atom radii (nAtoms)
+ * @param[in]  nAtoms  Number of atoms
+ *
+ * @return     The atoms
+ */
+std::vector<Atom> makeAtoms(const float *xyz, const float *radii,
+                            std::size_t nAtoms);
+
+/// Approximate footprint of a SurfaceMesh vertex with its edges and faces
+const double MESH_BYTES_PER_VERTEX = 2560;
+
+/**
+ * @brief      Memory model of a molecular surface builder
+ */
+struct GridCost {
+  double defaultScale;         /**< @brief default grid points per Angstrom */
+  double bytesPerVoxel;        /**< @brief bytes of grids per voxel */
+  double bytesPerSurfaceVoxel; /**< @brief working bytes per surface voxel */
+};
+
+/**
+ * @brief      Estimate the molecular surface area of atoms
+ *
+ * Atom centers are binned on a coarse grid and the exposed faces of the
+ * occupied bins are summed. This is only meant for sizing allocations.
+ *
+ * @param[in]  atoms  The atoms
+ *
+ * @return     Estimated area in square Angstroms
+ */
+double estimateSurfaceArea(const std::vector<Atom> &atoms);
+
+/**
+ * @brief      Pick the grid of a builder and estimate its memory use
+ *
+ * @param[in]  extent      Size of the padded bounding box in Angstroms
+ * @param[in]  area        Estimated surface area in square Angstroms
+ * @param[in]  cost        Memory model of the builder
+ * @param[in]  resolution  Requested resolution
+ *
+ * @return     The chosen grid. Throws if no grid fits the memory budget.
+ */
+GridMemoryEstimate chooseGrid(const Vector3f &extent, double area,
+                              const GridCost &cost,
+                              const GridResolution &resolution);
+} // End namespace pdbreader_detail
+/// @endcond
 
 /**
  * @brief      Extracts out x, y, z, radius of atoms in PDB file.
@@ -284,51 +460,11 @@ static void initElementMap() {
  */
 template <typename Inserter>
 bool readPDB(const std::string &filename, Inserter inserter) {
-  std::ifstream infile(filename);
-  std::string line;
-
-  initElementMap(); // Init the element map if it
-
-  if (infile.is_open()) {
-    while (std::getline(infile, line)) {
-      std::smatch match;
-      if (std::regex_match(line, match, pdbreader_detail::atom)) {
-        Atom atom;
-        // See PDB file formatting guidelines
-        float x = std::atof(line.substr(30, 8).c_str());
-        float y = std::atof(line.substr(38, 8).c_str());
-        float z = std::atof(line.substr(46, 8).c_str());
-        atom.pos = Vector({x, y, z});
-
-        atom.radius = 1.0f; // default radius
-        std::string atomName = line.substr(12, 4);
-        std::string residueName = line.substr(17, 3);
-
-        auto innerMapIT = pdbreader_detail::PDBelementMap.find(residueName);
-
-        if (innerMapIT != pdbreader_detail::PDBelementMap.end()) {
-          auto innerMap = innerMapIT->second;
-          auto typeIT = innerMap.find(atomName);
-          if (typeIT != innerMap.end()) {
-            atom.radius = typeIT->second.radius;
-          } else {
-            std::cout << "Could not find atomtype of '" << atomName
-                      << "' in residue '" << residueName << "'. "
-                      << "Using default radius." << std::endl;
-          }
-        } else {
-          std::cout << "Could not find ResidueName '" << residueName
-                    << "' in table. "
-                    << "Using default radius." << std::endl;
-        }
-        *inserter++ = atom;
-      }
-    }
-    return true;
-  } else {
-    std::cerr << "Unable to open \"" << filename << "\"" << std::endl;
+  std::vector<Atom> atoms;
+  if (!pdbreader_detail::readAtoms(filename, false, atoms))
     return false;
-  }
+  std::copy(atoms.begin(), atoms.end(), inserter);
+  return true;
 }
 
 /**
@@ -343,30 +479,30 @@ bool readPDB(const std::string &filename, Inserter inserter) {
  */
 template <typename Inserter>
 bool readPQR(const std::string &filename, Inserter inserter) {
-  std::ifstream infile(filename);
-  std::string line;
-
-  initElementMap(); // Init the element map if it
-
-  if (infile.is_open()) {
-    while (std::getline(infile, line)) {
-      std::smatch match;
-      if (std::regex_match(line, match, pdbreader_detail::atom)) {
-        Atom atom;
-        // See PDB file formatting guidelines
-        float x = std::atof(line.substr(30, 8).c_str());
-        float y = std::atof(line.substr(38, 8).c_str());
-        float z = std::atof(line.substr(46, 8).c_str());
-        atom.pos = Vector({x, y, z});
-        atom.radius = std::atof(line.substr(62, 7).c_str());
-        *inserter++ = atom;
-      }
-    }
-    return true;
-  } else {
-    std::cerr << "Unable to open \"" << filename << "\"" << std::endl;
+  std::vector<Atom> atoms;
+  if (!pdbreader_detail::readAtoms(filename, true, atoms))
     return false;
-  }
+  std::copy(atoms.begin(), atoms.end(), inserter);
+  return true;
+}
+
+/**
+ * @brief      Reads mmCIF file and appends
+ *
+ * @param[in]  filename  File to parse
+ * @param[in]  inserter  Container insertion iterator
+ *
+ * @tparam     Inserter  Typename of an insertion iterator
+ *
+ * @return     True on success
+ */
+template <typename Inserter>
+bool readCIF(const std::string &filename, Inserter inserter) {
+  std::vector<Atom> atoms;
+  if (!pdbreader_detail::readCIFAtoms(filename, atoms))
+    return false;
+  std::copy(atoms.begin(), atoms.end(), inserter);
+  return true;
 }
 
 template <typename Iterator, typename BlurFunc>
@@ -408,90 +544,269 @@ void getMinMax(Iterator begin, Iterator end, Vector3f &min, Vector3f &max,
   max += Vector3f({maxRad, maxRad, maxRad});
 }
 
+/// @cond detail
+namespace pdbreader_detail {
+/**
+ * @brief      Truncated gaussian of an atom on the grid
+ */
+struct Footprint {
+  Vector3f pos;   /**< @brief atom position */
+  float maxRad;   /**< @brief truncation radius */
+  double scale;   /**< @brief exp(-blobbyness * radius^2) */
+  double maxRad2; /**< @brief squared truncation radius */
+  Vector3i amin;  /**< @brief first voxel of the bounding box */
+  Vector3i amax;  /**< @brief last voxel of the bounding box */
+};
+
 /**
- * @brief      Apply a gaussian blur to a list of atoms
+ * @brief      Compute the footprints of atoms on a grid
  *
  * @param[in]  begin       Iterator to the first atom
- * @param[in]  end         Iterator to the last ato
- * @param      dataset     The dataset
- * @param[in]  min         The minimum
- * @param[in]  maxMin      The maximum minimum
- * @param[in]  dim         The dim
+ * @param[in]  end         Iterator past the last atom
+ * @param[in]  min         Position of the first voxel
+ * @param[in]  span        Size of a voxel
+ * @param[in]  dim         Dimension of the grid
  * @param[in]  blobbyness  The blobbyness
  *
  * @tparam     Iterator    Typename of the iterator
+ *
+ * @return     Footprint of each atom
  */
 template <typename Iterator>
-void blurAtoms(Iterator begin, Iterator end, float *dataset,
-               const Vector3f &min, const Vector3f &maxMin, const Vector3i &dim,
-               float blobbyness) {
-
-  // Functor to calculate gaussian blur
-  auto evalDensity = [blobbyness](const Atom &atom, Vector3f &pnt,
-                                  float maxRadius) -> float {
-    double expval;
-
-    Vector3f tmp = atom.pos - pnt;
-    double r = tmp | tmp;
-    double r0 = atom.radius * atom.radius;
-
-    // expval = BLOBBYNESS*(r/r0 - 1.0);
-    expval = blobbyness * (r - r0);
-
-    // Truncate gaussian
-    if (sqrt(r) > maxRadius) {
-      return 0.0;
-    }
-    return (float)exp(expval);
-  };
-
-  Vector3f span;
-  span = (maxMin).ElementwiseDivision(
-      static_cast<Vector3f>((dim - Vector3i({1, 1, 1}))));
-
+std::vector<Footprint> footprints(Iterator begin, Iterator end,
+                                  const Vector3f &min, const Vector3f &span,
+                                  const Vector3i &dim, float blobbyness) {
   float radFactor =
       sqrt(1.0 + log(pdbreader_detail::EPSILON) / (2.0 * blobbyness));
 
+  std::vector<Footprint> rval;
   for (auto curr = begin; curr != end; ++curr) {
-    float maxRad = curr->radius * radFactor;
+    Footprint fp;
+    fp.pos = curr->pos;
+    fp.maxRad = curr->radius * radFactor;
+    fp.maxRad2 = static_cast<double>(fp.maxRad) * fp.maxRad;
+    fp.scale =
+        exp(-blobbyness * static_cast<double>(curr->radius * curr->radius));
     // compute the dataset coordinates of the atom's center
     Vector3f tmpVec = (curr->pos - min).ElementwiseDivision(span);
     Vector3i c;
     std::transform(tmpVec.begin(), tmpVec.end(), c.begin(),
                    [](float v) -> int { return round(v); });
 
-    // std::cout << "Max Radius: " << maxRad << std::endl;
-
     // compute the bounding box of the atom (maxRad^3)
-    Vector3i amin;
-    Vector3i amax;
     for (int j = 0; j < 3; ++j) {
       int tmp;
-      float tmpRad = maxRad / span[j];
+      float tmpRad = fp.maxRad / span[j];
 
       tmp = (int)(c[j] - tmpRad - 1);
-      amin[j] = (tmp < 0) ? 0 : tmp; // check if tmp is < 0
+      fp.amin[j] = (tmp < 0) ? 0 : tmp; // check if tmp is < 0
       tmp = (int)(c[j] + tmpRad + 1);
-      amax[j] = (tmp > (dim[j] - 1)) ? (dim[j] - 1) : tmp;
+      fp.amax[j] = (tmp > (dim[j] - 1)) ? (dim[j] - 1) : tmp;
     }
+    rval.push_back(fp);
+  }
+  return rval;
+}
+
+/**
+ * @brief      Accumulate the footprints overlapping the planes [kBegin, kEnd)
+ *
+ * Atoms are accumulated in input order so the result of a voxel does not
+ * depend on how the planes are split.
+ *
+ * @param[in]  footprints  The footprints
+ * @param[in]  min         Position of the first voxel
+ * @param[in]  span        Size of a voxel
+ * @param[in]  blobbyness  The blobbyness
+ * @param[in]  kBegin      First plane
+ * @param[in]  kEnd        One past the last plane
+ * @param      row         row(j, k) returns an object indexed by i which
+ *                         refers to voxel (i, j, k)
+ *
+ * @tparam     RowFunc     Typename of the row accessor
+ */
+template <typename RowFunc>
+void splatFootprints(const std::vector<Footprint> &footprints,
+                     const Vector3f &min, const Vector3f &span,
+                     float blobbyness, int kBegin, int kEnd, RowFunc &&row) {
+  // Squared distances and exponential factors along each axis
+  std::vector<float> d2[3];
+  std::vector<double> e[3];
 
-    // std::cout << amin << " " << amax << std::endl;
+  for (const auto &fp : footprints) {
+    const int lo[3] = {fp.amin[0], fp.amin[1], std::max(fp.amin[2], kBegin)};
+    const int hi[3] = {fp.amax[0], fp.amax[1], std::min(fp.amax[2], kEnd - 1)};
+    if (lo[2] > hi[2] || lo[0] > hi[0] || lo[1] > hi[1])
+      continue;
 
-    // Blur kernel in bounding box
-    for (int k = amin[2]; k <= amax[2]; k++) {
-      for (int j = amin[1]; j <= amax[1]; j++) {
-        for (int i = amin[0]; i <= amax[0]; i++) {
-          Vector3f pnt =
-              min + Vector3f({static_cast<float>(i), static_cast<float>(j),
-                              static_cast<float>(k)})
-                        .ElementwiseProduct(span);
-          dataset[Vect2Index(i, j, k, dim)] += evalDensity(*curr, pnt, maxRad);
+    for (int d = 0; d < 3; ++d) {
+      const int n = hi[d] - lo[d] + 1;
+      d2[d].resize(n);
+      e[d].resize(n);
+      for (int i = 0; i < n; ++i) {
+        float x = min[d] + static_cast<float>(lo[d] + i) * span[d];
+        float dx = fp.pos[d] - x;
+        d2[d][i] = dx * dx;
+        e[d][i] = exp(blobbyness * static_cast<double>(d2[d][i]));
+      }
+    }
+
+    // Truncate the gaussian at maxRad. The squared distance is summed
+    // in x, y, z order as in (atom.pos - pnt) | (atom.pos - pnt).
+    const int nx = hi[0] - lo[0] + 1;
+    const float *dx2 = d2[0].data();
+    const double *ex = e[0].data();
+    for (int k = lo[2]; k <= hi[2]; k++) {
+      const float dz2 = d2[2][k - lo[2]];
+      const double ez = fp.scale * e[2][k - lo[2]];
+      for (int j = lo[1]; j <= hi[1]; j++) {
+        const float dy2 = d2[1][j - lo[1]];
+        if (dy2 + dz2 > fp.maxRad2)
+          continue;
+        const double ezy = ez * e[1][j - lo[1]];
+        auto &&voxels = row(j, k);
+        for (int i = 0; i < nx; i++) {
+          float r = (dx2[i] + dy2) + dz2;
+          voxels[lo[0] + i] +=
+              (r <= fp.maxRad2) ? static_cast<float>(ezy * ex[i]) : 0.0f;
         }
       }
     }
   }
 }
 
+/**
+ * @brief      Row of a SparseVolume which allocates bricks when written
+ */
+class SparseRow {
+public:
+  SparseRow(SparseVolume<float> &volume, int j, int k)
+      : _volume(volume), _j(j), _k(k) {}
+
+  float &operator[](int i) {
+    return _volume.allocate(_volume.brickOf(i, _j, _k))
+        [SparseVolume<float>::local(i, _j, _k)];
+  }
+
+private:
+  SparseVolume<float> &_volume;
+  int _j, _k;
+};
+} // End namespace pdbreader_detail
+/// @endcond
+
+/**
+ * @brief      Apply a gaussian blur to a list of atoms
+ *
+ * The grid is split into slabs along z and each thread accumulates the atoms
+ * overlapping its own slab, in input order, so the result does not depend on
+ * the number of threads. The truncated gaussian of an atom is evaluated from
+ * per axis exponential factors. Each thread reduces the range of its slab
+ * right after splatting it so callers need not rescan the grid.
+ *
+ * @param[in]  begin       Iterator to the first atom
+ * @param[in]  end         Iterator to the last ato
+ * @param      dataset     The dataset
+ * @param[in]  min         The minimum
+ * @param[in]  maxMin      The maximum minimum
+ * @param[in]  dim         The dim
+ * @param[in]  blobbyness  The blobbyness
+ * @param[in]  nthreads    Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     Iterator    Typename of the iterator
+ *
+ * @return     Range of the blurred densities
+ */
+template <typename Iterator>
+ValueRange<float> blurAtoms(Iterator begin, Iterator end, float *dataset,
+               const Vector3f &min, const Vector3f &maxMin, const Vector3i &dim,
+               float blobbyness, std::size_t nthreads = 1) {
+  Vector3f span;
+  span = (maxMin).ElementwiseDivision(
+      static_cast<Vector3f>((dim - Vector3i({1, 1, 1}))));
+
+  const auto fps =
+      pdbreader_detail::footprints(begin, end, min, span, dim, blobbyness);
+
+  std::vector<ValueRange<float>> ranges(
+      parallel::numThreads(nthreads, dim[2]));
+  parallel::for_each_chunk(
+      0, dim[2], nthreads,
+      [&](std::size_t tid, std::size_t kBegin, std::size_t kEnd) {
+        pdbreader_detail::splatFootprints(
+            fps, min, span, blobbyness, kBegin, kEnd,
+            [&](int j, int k) { return dataset + Vect2Index(0, j, k, dim); });
+        const float *first = dataset + Vect2Index(0, 0, kBegin, dim);
+        const float *last = dataset + Vect2Index(0, 0, kEnd, dim);
+        for (const float *value = first; value != last; ++value) {
+          ranges[tid].add(*value);
+        }
+      });
+
+  ValueRange<float> total;
+  for (const auto &range : ranges) {
+    total.add(range);
+  }
+  return total;
+}
+
+/**
+ * @brief      Apply a gaussian blur to a list of atoms in a sparse volume
+ *
+ * Only the bricks within the truncated gaussians of the atoms are allocated.
+ * Threads accumulate whole layers of bricks and the values are identical to
+ * those of the dense blurAtoms. The range of each brick is reduced by its
+ * thread once the layer is splatted, while the bricks are still in cache.
+ *
+ * @param[in]  begin       Iterator to the first atom
+ * @param[in]  end         Iterator past the last atom
+ * @param      volume      The volume, zero initialized
+ * @param[in]  min         The minimum
+ * @param[in]  maxMin      The maximum minimum
+ * @param[in]  blobbyness  The blobbyness
+ * @param[in]  nthreads    Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     Iterator    Typename of the iterator
+ *
+ * @return     Range of the blurred densities of each brick
+ */
+template <typename Iterator>
+BrickRanges<float> blurAtoms(Iterator begin, Iterator end,
+                             SparseVolume<float> &volume, const Vector3f &min,
+                             const Vector3f &maxMin, float blobbyness,
+                             std::size_t nthreads = 1) {
+  const Vector3i &dim = volume.dim();
+  Vector3f span;
+  span = (maxMin).ElementwiseDivision(
+      static_cast<Vector3f>((dim - Vector3i({1, 1, 1}))));
+
+  const auto fps =
+      pdbreader_detail::footprints(begin, end, min, span, dim, blobbyness);
+
+  const int brickSize = SparseVolume<float>::BrickSize;
+  const std::size_t layer =
+      static_cast<std::size_t>(volume.bricks()[0]) * volume.bricks()[1];
+  BrickRanges<float> ranges;
+  ranges.bricks.resize(volume.size());
+  parallel::for_each_chunk(
+      0, volume.bricks()[2], nthreads,
+      [&](std::size_t, std::size_t bkBegin, std::size_t bkEnd) {
+        pdbreader_detail::splatFootprints(
+            fps, min, span, blobbyness, bkBegin * brickSize,
+            std::min<int>(bkEnd * brickSize, dim[2]), [&](int j, int k) {
+              return pdbreader_detail::SparseRow(volume, j, k);
+            });
+        for (std::size_t b = bkBegin * layer; b < bkEnd * layer; ++b) {
+          ranges.bricks[b] = brickRange(volume, b);
+        }
+      });
+
+  for (const auto &range : ranges.bricks) {
+    ranges.total.add(range);
+  }
+  return ranges;
+}
+
 /**
  * @brief      Compute the grid based Solvent Accessible Area.
  *
@@ -597,17 +912,294 @@ void gridSES(const Iterator begin, const Iterator end, const Vector3i &dim,
   }
 }
 
-// TODO: (1) these functions should all take arrays of x,y,z,r instead of
-// filenames
+/**
+ * @brief      Exact squared Euclidean distance transform of a sampled
+ *             function.
+ *
+ *             Computes D(p) = min_q (|p - q|^2 + f(q)) over all voxels q, in
+ *             grid units, using the separable lower envelope of parabolas
+ *             algorithm of Felzenszwalb and Huttenlocher. The cost is linear
+ *             in the number of voxels and each of the three passes runs in
+ *             parallel over the grid lines along one axis.
+ *
+ * @param      f         Sampled function, +infinity where there is no seed.
+ *                       Overwritten with D.
+ * @param      labels    Label of each seed. Overwritten with the label of the
+ *                       minimizing seed, or -1 if the grid has no seeds.
+ * @param[in]  dim       Dimension of the grid
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ */
+void distanceTransform(float *f, int *labels, const Vector3i &dim,
+                       std::size_t nthreads = 1);
+
+/**
+ * @brief      Compute the grid based Solvent Accessible Area using a distance
+ *             transform.
+ *
+ *             Alternative to gridSAS whose cost is linear in the number of
+ *             voxels. Each voxel is assigned the atom minimizing the power
+ *             distance |x - c|^2 - r^2, with c the atom center rounded to the
+ *             grid. Voxels take the largest value r - |x - pos| among the
+ *             atoms assigned to them and their neighbors. On the surface of
+ *             the union of spheres the power distance selects the same atom
+ *             as gridSAS, so both fields agree there up to the rounding of
+ *             the centers.
+ *
+ *             Assumes that the domain is in the {+,+,+} octant.
+ *
+ * @param[in]  begin     Iterator to first atom
+ * @param[in]  end       Just past the end iterator
+ * @param[in]  dim       Dimension of the dataset
+ * @param      dataset   Volume of densities
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     Iterator  Typename of the iterator
+ */
+template <typename Iterator>
+void gridSAS_EDT(const Iterator begin, const Iterator end, const Vector3i &dim,
+                 float *dataset, std::size_t nthreads = 1) {
+  const std::size_t nx = dim[0];
+  const std::size_t nxy = nx * dim[1];
+  const std::size_t n = nxy * dim[2];
+  std::vector<float> f(n, std::numeric_limits<float>::infinity());
+  std::vector<int> labels(n, -1);
+  std::vector<Vector3f> centers;
+  std::vector<float> radii;
+
+  // Seed the voxel nearest to each atom center with its power distance
+  for (auto curr = begin; curr != end; ++curr) {
+    Vector3i c;
+    for (int j = 0; j < 3; ++j) {
+      int tmp = static_cast<int>(std::round(curr->pos[j]));
+      c[j] = std::min(std::max(tmp, 0), dim[j] - 1);
+    }
+    const float radius = curr->radius;
+    const std::size_t idx = c[2] * nxy + c[1] * nx + c[0];
+    if (-radius * radius < f[idx]) {
+      f[idx] = -radius * radius;
+      labels[idx] = static_cast<int>(centers.size());
+    }
+    centers.push_back(curr->pos);
+    radii.push_back(radius);
+  }
+
+  distanceTransform(f.data(), labels.data(), dim, nthreads);
+
+  // Rounding the centers shifts the power diagram by up to a voxel, so
+  // also consider the atoms assigned to the neighboring voxels.
+  parallel::for_each_chunk(
+      0, dim[2], nthreads,
+      [&](std::size_t, std::size_t kbegin, std::size_t kend) {
+        for (int k = kbegin; k < static_cast<int>(kend); ++k) {
+          for (int j = 0; j < dim[1]; ++j) {
+            for (int i = 0; i < dim[0]; ++i) {
+              const Vector3f coord =
+                  Vector3f({static_cast<float>(i), static_cast<float>(j),
+                            static_cast<float>(k)});
+              float best = -std::numeric_limits<float>::infinity();
+              int last = -1;
+              for (int dk = std::max(k - 1, 0);
+                   dk <= std::min(k + 1, dim[2] - 1); ++dk) {
+                for (int dj = std::max(j - 1, 0);
+                     dj <= std::min(j + 1, dim[1] - 1); ++dj) {
+                  for (int di = std::max(i - 1, 0);
+                       di <= std::min(i + 1, dim[0] - 1); ++di) {
+                    const int a = labels[dk * nxy + dj * nx + di];
+                    if (a < 0 || a == last)
+                      continue;
+                    last = a;
+                    Vector3f d = coord - centers[a];
+                    best = std::max(best, radii[a] - std::sqrt(d | d));
+                  }
+                }
+              }
+              float &value = dataset[k * nxy + j * nx + i];
+              if (best > value) {
+                value = best;
+              }
+            }
+          }
+        }
+      });
+}
+
+/**
+ * @brief      Compute the grid based Solvent Excluded Surface using a
+ *             distance transform.
+ *
+ *             The solvent excluded region is the part of the solvent
+ *             accessible region farther than the probe radius from its
+ *             boundary. Each voxel is assigned the nearest voxel outside of
+ *             the SAS by an exact distance transform and the distance to the
+ *             SAS boundary is refined by the SAS value of that voxel. Unlike
+ *             gridSES no intermediate SAS mesh is needed and the cost is
+ *             linear in the number of voxels.
+ *
+ * @param[in]  sas       SAS field in grid units, positive inside, as computed
+ *                       by gridSAS or gridSAS_EDT
+ * @param[in]  dim       Dimension of the dataset
+ * @param      dataset   Volume of densities, positive inside the SES
+ * @param[in]  radius    Probe radius in grid units
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ */
+void gridSES_EDT(const float *sas, const Vector3i &dim, float *dataset,
+                 const float radius, std::size_t nthreads = 1);
+
+/**
+ * @brief      Estimate the grid and memory of meshAtoms_molsurf
+ *
+ * @param[in]  atoms       Atom positions and radii
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     The grid meshAtoms_molsurf would allocate
+ */
+GridMemoryEstimate
+estimateMemory_molsurf(const std::vector<Atom> &atoms,
+                       const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Generate a molecular surface mesh from atoms in memory
+ *
+ * Each call owns its working state, so meshes may be generated concurrently
+ * from multiple threads.
+ *
+ * @param[in]  atoms       Atom positions and radii
+ * @param[in]  resolution  Grid resolution and memory budget. The default
+ *                         scale is DIM_SCALE.
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+meshAtoms_molsurf(const std::vector<Atom> &atoms,
+                  const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Generate a molecular surface mesh from atom buffers
+ *
+ * @param[in]  xyz         Atom coordinates packed as x0,y0,z0,x1,...
+ *                         (3*nAtoms)
+ * @param[in]  radii       Atom radii (nAtoms)
+ * @param[in]  nAtoms      Number of atoms
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+meshAtoms_molsurf(const float *xyz, const float *radii, std::size_t nAtoms,
+                  const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Estimate the grid and memory of meshAtoms_gauss
+ *
+ * @param[in]  atoms       Atom positions and radii
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     The grid meshAtoms_gauss would allocate
+ */
+GridMemoryEstimate
+estimateMemory_gauss(const std::vector<Atom> &atoms, float blobbyness,
+                     const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Generate a mesh from atoms in memory by Gaussian kernel
+ *
+ * @param[in]  atoms       Atom positions and radii
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  resolution  Grid resolution and memory budget. The default
+ *                         scale is one point per Angstrom.
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+meshAtoms_gauss(const std::vector<Atom> &atoms, float blobbyness,
+                float isovalue,
+                const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Generate a mesh from atom buffers by Gaussian kernel
+ *
+ * @param[in]  xyz         Atom coordinates packed as x0,y0,z0,x1,...
+ *                         (3*nAtoms)
+ * @param[in]  radii       Atom radii (nAtoms)
+ * @param[in]  nAtoms      Number of atoms
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+meshAtoms_gauss(const float *xyz, const float *radii, std::size_t nAtoms,
+                float blobbyness, float isovalue,
+                const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Estimate the grid and memory of meshAtoms_distgrid
+ *
+ * @param[in]  atoms       Atom positions and radii
+ * @param[in]  radius      Radius in Angstroms of ball to roll over surface
+ * @param[in]  useEDT      Build the fields with distance transforms
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     The grid meshAtoms_distgrid would allocate
+ */
+GridMemoryEstimate
+estimateMemory_distgrid(const std::vector<Atom> &atoms, const float radius,
+                        const bool useEDT = false,
+                        const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      [WIP] Compute the Connolly surface of atoms in memory using a
+ *             distance grid based strategy
+ *
+ * @param[in]  atoms       Atom positions and radii
+ * @param[in]  radius      Radius in Angstroms of ball to roll over surface
+ * @param[in]  useEDT      Build the SAS and SES fields with distance
+ *                         transforms (gridSAS_EDT, gridSES_EDT) instead of
+ *                         gridSAS and gridSES
+ * @param[in]  resolution  Grid resolution and memory budget. The default
+ *                         scale is one point per Angstrom.
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+meshAtoms_distgrid(const std::vector<Atom> &atoms, const float radius,
+                   const bool useEDT = false,
+                   const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      [WIP] Compute the Connolly surface of atom buffers using a
+ *             distance grid based strategy
+ *
+ * @param[in]  xyz         Atom coordinates packed as x0,y0,z0,x1,...
+ *                         (3*nAtoms)
+ * @param[in]  radii       Atom radii (nAtoms)
+ * @param[in]  nAtoms      Number of atoms
+ * @param[in]  radius      Radius in Angstroms of ball to roll over surface
+ * @param[in]  useEDT      Build the SAS and SES fields with distance
+ *                         transforms
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+meshAtoms_distgrid(const float *xyz, const float *radii, std::size_t nAtoms,
+                   const float radius, const bool useEDT = false,
+                   const GridResolution &resolution = GridResolution());
 
 /**
  * @brief      Generate a mesh from PDB
  *
- * @param[in]  filename  File to open
+ * @param[in]  filename    File to open
+ * @param[in]  resolution  Grid resolution and memory budget
  *
  * @return     Meshed object
  */
-std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &filename);
+std::unique_ptr<SurfaceMesh>
+readPDB_molsurf(const std::string &filename,
+                const GridResolution &resolution = GridResolution());
 
 /**
  * @brief      Generate a mesh from PDB by Gaussian kernel
@@ -615,32 +1207,42 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &filename);
  * @param[in]  filename    File to open
  * @param[in]  blobbyness  Blobbyness of the applied Gaussian
  * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  resolution  Grid resolution and memory budget
  *
  * @return     Meshed object
  */
-std::unique_ptr<SurfaceMesh> readPDB_gauss(const std::string &filename,
-                                           float blobbyness, float isovalue);
+std::unique_ptr<SurfaceMesh>
+readPDB_gauss(const std::string &filename, float blobbyness, float isovalue,
+              const GridResolution &resolution = GridResolution());
 
 /**
  * @brief      [WIP] Compute the Connolly surface using a distance grid based
  *             strategy
  *
- * @param[in]  filename  File to open
- * @param[in]  radius    Radius in Angstroms of ball to roll over surface
+ * @param[in]  filename    File to open
+ * @param[in]  radius      Radius in Angstroms of ball to roll over surface
+ * @param[in]  useEDT      Build the SAS and SES fields with distance
+ *                         transforms
+ * @param[in]  resolution  Grid resolution and memory budget
  *
  * @return     Meshed object
  */
-std::unique_ptr<SurfaceMesh> readPDB_distgrid(const std::string &filename,
-                                              const float radius);
+std::unique_ptr<SurfaceMesh>
+readPDB_distgrid(const std::string &filename, const float radius,
+                 const bool useEDT = false,
+                 const GridResolution &resolution = GridResolution());
 
 /**
  * @brief      Generate a mesh from PQR
  *
- * @param[in]  filename  File to open
+ * @param[in]  filename    File to open
+ * @param[in]  resolution  Grid resolution and memory budget
  *
  * @return     Meshed object
  */
-std::unique_ptr<SurfaceMesh> readPQR_molsurf(const std::string &filename);
+std::unique_ptr<SurfaceMesh>
+readPQR_molsurf(const std::string &filename,
+                const GridResolution &resolution = GridResolution());
 
 /**
  * @brief      Generate a mesh from PQR
@@ -648,10 +1250,133 @@ std::unique_ptr<SurfaceMesh> readPQR_molsurf(const std::string &filename);
  * @param[in]  filename    File to open
  * @param[in]  blobbyness  Blobbyness of the applied Gaussian
  * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+readPQR_gauss(const std::string &filename, float blobbyness, float isovalue,
+              const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Generate a mesh from mmCIF
+ *
+ * @param[in]  filename    File to open
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+readCIF_molsurf(const std::string &filename,
+                const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Generate a mesh from mmCIF by Gaussian kernel
+ *
+ * @param[in]  filename    File to open
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Meshed object
+ */
+std::unique_ptr<SurfaceMesh>
+readCIF_gauss(const std::string &filename, float blobbyness, float isovalue,
+              const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      [WIP] Compute the Connolly surface of an mmCIF using a distance
+ *             grid based strategy
+ *
+ * @param[in]  filename    File to open
+ * @param[in]  radius      Radius in Angstroms of ball to roll over surface
+ * @param[in]  useEDT      Build the SAS and SES fields with distance
+ *                         transforms
+ * @param[in]  resolution  Grid resolution and memory budget
  *
  * @return     Meshed object
  */
-std::unique_ptr<SurfaceMesh> readPQR_gauss(const std::string &filename,
-                                           float blobbyness, float isovalue);
+std::unique_ptr<SurfaceMesh>
+readCIF_distgrid(const std::string &filename, const float radius,
+                 const bool useEDT = false,
+                 const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Mesh each frame of a trajectory by Gaussian kernel
+ *
+ * All frames are meshed on one grid which contains every frame, so the grid
+ * and the mesh buffers are allocated once. The isovalue is lowered per frame
+ * as in meshAtoms_gauss.
+ *
+ * @param[in]  xyz         Atom coordinates of each frame packed as
+ *                         x0,y0,z0,x1,... (3*nAtoms*nFrames)
+ * @param[in]  radii       Atom radii, the same for all frames (nAtoms)
+ * @param[in]  nAtoms      Number of atoms
+ * @param[in]  nFrames     Number of frames
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  callback    Called with the surface of each frame
+ * @param[in]  resolution  Grid resolution and memory budget. The budget
+ *                         applies to a single frame.
+ *
+ * @return     Number of frames meshed
+ */
+std::size_t
+meshTrajectory_gauss(const float *xyz, const float *radii, std::size_t nAtoms,
+                     std::size_t nFrames, float blobbyness, float isovalue,
+                     const TrajectoryCallback &callback,
+                     const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Mesh each model of a multi-model PDB by Gaussian kernel
+ *
+ * Models are delimited by ENDMDL records and meshed as the frames of
+ * meshTrajectory_gauss. A file without models is a single frame. Models
+ * without ATOM records are skipped and do not count as frames.
+ *
+ * @param[in]  filename    File to open
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  callback    Called with the surface of each model
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Number of models meshed, 0 if the file could not be read
+ */
+std::size_t
+readPDBTrajectory_gauss(const std::string &filename, float blobbyness,
+                        float isovalue, const TrajectoryCallback &callback,
+                        const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Mesh each model of a multi-model PQR by Gaussian kernel
+ *
+ * @param[in]  filename    File to open
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  callback    Called with the surface of each model
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Number of models meshed, 0 if the file could not be read
+ */
+std::size_t
+readPQRTrajectory_gauss(const std::string &filename, float blobbyness,
+                        float isovalue, const TrajectoryCallback &callback,
+                        const GridResolution &resolution = GridResolution());
+
+/**
+ * @brief      Mesh each model of a multi-model mmCIF by Gaussian kernel
+ *
+ * @param[in]  filename    File to open
+ * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+ * @param[in]  isovalue    Isovalue to extract
+ * @param[in]  callback    Called with the surface of each model
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     Number of models meshed, 0 if the file could not be read
+ */
+std::size_t
+readCIFTrajectory_gauss(const std::string &filename, float blobbyness,
+                        float isovalue, const TrajectoryCallback &callback,
+                        const GridResolution &resolution = GridResolution());
 
 } // end namespace gamer
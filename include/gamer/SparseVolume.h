@@ -0,0 +1,277 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+/**
+ * @file SparseVolume.h
+ * @brief Bricked volume which only stores the bricks that were written
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "gamer/gamer.h"
+#include "gamer/parallel.h"
+
+/// Namespace for all things gamer
+namespace gamer {
+
+/**
+ * @brief      Volume split into BrickSize^3 bricks allocated on demand.
+ *
+ * A brick is either allocated, holding one value per voxel, or uniform with
+ * all of its voxels equal to a single value. All bricks start uniform with
+ * the background value. Bricks on the upper faces of the volume are clipped
+ * to its dimension.
+ *
+ * Distinct bricks may be written concurrently. Writing to the same brick,
+ * including allocating it, must be synchronized by the caller.
+ *
+ * @tparam     T     Voxel value typename
+ */
+template <typename T> class SparseVolume {
+public:
+  /// Number of voxels along each side of a brick
+  static constexpr int BrickSize = 8;
+  /// Number of voxels in a brick
+  static constexpr int BrickVoxels = BrickSize * BrickSize * BrickSize;
+
+  /**
+   * @brief      Create a volume with all voxels set to the background
+   *
+   * @param[in]  dim         Dimension of the volume
+   * @param[in]  background  Initial value of the voxels
+   */
+  explicit SparseVolume(const Vector3i &dim, T background = T(0))
+      : _dim(dim) {
+    for (std::size_t d = 0; d < 3; ++d) {
+      _bricks[d] = (dim[d] + BrickSize - 1) / BrickSize;
+    }
+    const std::size_t n =
+        static_cast<std::size_t>(_bricks[0]) * _bricks[1] * _bricks[2];
+    _data.resize(n);
+    _uniform.assign(n, background);
+  }
+
+  /// Dimension of the volume
+  const Vector3i &dim() const { return _dim; }
+
+  /// Number of bricks along each axis
+  const Vector3i &bricks() const { return _bricks; }
+
+  /// Number of bricks
+  std::size_t size() const { return _data.size(); }
+
+  /// Index of brick (bi, bj, bk)
+  std::size_t brick(int bi, int bj, int bk) const {
+    return (static_cast<std::size_t>(bk) * _bricks[1] + bj) * _bricks[0] + bi;
+  }
+
+  /// Index of the brick containing voxel (i, j, k)
+  std::size_t brickOf(int i, int j, int k) const {
+    return brick(i / BrickSize, j / BrickSize, k / BrickSize);
+  }
+
+  /// Offset of voxel (i, j, k) within its brick
+  static int local(int i, int j, int k) {
+    return ((k % BrickSize) * BrickSize + j % BrickSize) * BrickSize +
+           i % BrickSize;
+  }
+
+  /// Whether brick b holds per voxel values
+  bool allocated(std::size_t b) const { return _data[b] != nullptr; }
+
+  /// Value of the voxels of a uniform brick b
+  T uniform(std::size_t b) const { return _uniform[b]; }
+
+  /// Values of brick b or nullptr if it is uniform
+  T *data(std::size_t b) { return _data[b].get(); }
+
+  /// Values of brick b or nullptr if it is uniform
+  const T *data(std::size_t b) const { return _data[b].get(); }
+
+  /**
+   * @brief      Allocate brick b if it is uniform
+   *
+   * @param[in]  b     Brick index
+   *
+   * @return     Values of the brick, initialized to its uniform value
+   */
+  T *allocate(std::size_t b) {
+    if (!_data[b]) {
+      _data[b].reset(new T[BrickVoxels]);
+      std::fill_n(_data[b].get(), BrickVoxels, _uniform[b]);
+    }
+    return _data[b].get();
+  }
+
+  /**
+   * @brief      Free brick b and set all of its voxels to a value
+   *
+   * @param[in]  b      Brick index
+   * @param[in]  value  New value of the voxels
+   */
+  void setUniform(std::size_t b, T value) {
+    _data[b].reset();
+    _uniform[b] = value;
+  }
+
+  /// Value of voxel (i, j, k)
+  T operator()(int i, int j, int k) const {
+    const std::size_t b = brickOf(i, j, k);
+    const T *values = _data[b].get();
+    return values ? values[local(i, j, k)] : _uniform[b];
+  }
+
+  /// Reference to voxel (i, j, k), allocating its brick if needed
+  T &at(int i, int j, int k) {
+    return allocate(brickOf(i, j, k))[local(i, j, k)];
+  }
+
+  /// Number of allocated bricks
+  std::size_t allocatedBricks() const {
+    return std::count_if(
+        _data.begin(), _data.end(),
+        [](const std::unique_ptr<T[]> &values) { return values != nullptr; });
+  }
+
+  /// Memory held by the volume in bytes
+  std::size_t bytes() const {
+    return allocatedBricks() * BrickVoxels * sizeof(T) +
+           _data.size() * (sizeof(std::unique_ptr<T[]>) + sizeof(T));
+  }
+
+private:
+  Vector3i _dim;
+  Vector3i _bricks;
+  std::vector<std::unique_ptr<T[]>> _data;
+  std::vector<T> _uniform;
+};
+
+template <typename T> constexpr int SparseVolume<T>::BrickSize;
+template <typename T> constexpr int SparseVolume<T>::BrickVoxels;
+
+/**
+ * @brief      Smallest and largest of a set of values
+ *
+ * @tparam     T     Value typename
+ */
+template <typename T> struct ValueRange {
+  T min = std::numeric_limits<T>::max();
+  T max = std::numeric_limits<T>::lowest();
+
+  /// Extend the range to include a value
+  void add(T value) {
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+
+  /// Extend the range to include another range
+  void add(const ValueRange &other) {
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+};
+
+/**
+ * @brief      Range of the values of each brick of a SparseVolume and of the
+ *             whole volume
+ *
+ * Voxels of the bricks on the upper faces which lie outside of the volume are
+ * not included.
+ *
+ * @tparam     T     Value typename
+ */
+template <typename T> struct BrickRanges {
+  /// Range of each brick
+  std::vector<ValueRange<T>> bricks;
+  /// Range of the volume
+  ValueRange<T> total;
+};
+
+/**
+ * @brief      Range of the values of a brick
+ *
+ * @param[in]  volume  The volume
+ * @param[in]  b       Brick index
+ *
+ * @tparam     T       Value typename
+ *
+ * @return     The range
+ */
+template <typename T>
+ValueRange<T> brickRange(const SparseVolume<T> &volume, std::size_t b) {
+  const int B = SparseVolume<T>::BrickSize;
+  ValueRange<T> range;
+  const T *values = volume.data(b);
+  if (!values) {
+    range.add(volume.uniform(b));
+    return range;
+  }
+  const Vector3i &dim = volume.dim();
+  const Vector3i &nb = volume.bricks();
+  const int lo[3] = {
+      static_cast<int>(b % nb[0]) * B,
+      static_cast<int>((b / nb[0]) % nb[1]) * B,
+      static_cast<int>(b / (static_cast<std::size_t>(nb[0]) * nb[1])) * B};
+  const int n[3] = {std::min(B, dim[0] - lo[0]), std::min(B, dim[1] - lo[1]),
+                    std::min(B, dim[2] - lo[2])};
+  for (int k = 0; k < n[2]; ++k) {
+    for (int j = 0; j < n[1]; ++j) {
+      const T *row = values + (k * B + j) * B;
+      for (int i = 0; i < n[0]; ++i) {
+        range.add(row[i]);
+      }
+    }
+  }
+  return range;
+}
+
+/**
+ * @brief      Compute the range of each brick of a volume
+ *
+ * @param[in]  volume    The volume
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
+ *
+ * @tparam     T         Value typename
+ *
+ * @return     The ranges
+ */
+template <typename T>
+BrickRanges<T> brickRanges(const SparseVolume<T> &volume,
+                           std::size_t nthreads = 1) {
+  BrickRanges<T> ranges;
+  ranges.bricks.resize(volume.size());
+  parallel::for_each_chunk(
+      0, volume.size(), nthreads,
+      [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+          ranges.bricks[b] = brickRange(volume, b);
+        }
+      });
+  for (const auto &range : ranges.bricks) {
+    ranges.total.add(range);
+  }
+  return ranges;
+}
+} // end namespace gamer
@@ -24,19 +24,24 @@
 
 #pragma once
 
+#include <array>
+#include <exception>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 #include <casc/casc>
 
 #include "gamer/Vertex.h"
+#include "gamer/parallel.h"
 
 /// Namespace for all things gamer
 namespace gamer {
@@ -283,6 +288,21 @@ namespace surfacemesh_detail {
 void decimateVertex(SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID,
                     std::size_t rings = 2);
 
+/**
+ * @brief      Remove a vertex from mesh and triangulate the resulting hole
+ *             without smoothing the surrounding vertices.
+ *
+ * Only the star of the vertex changes, so calls on vertices whose one rings
+ * do not touch leave each other unaffected.
+ *
+ * @param      mesh      Surface mesh of interest
+ * @param[in]  vertexID  The vertex id
+ *
+ * @return     The one ring of the removed vertex
+ */
+std::set<SurfaceMesh::SimplexID<1>>
+removeAndTriangulate(SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID);
+
 /**
  * @brief      Computes the local structure tensor
  *
@@ -526,10 +546,27 @@ void edgeFlipCache(SurfaceMesh &mesh, SurfaceMesh::SimplexID<2> edgeID);
 /**
  * @brief      Select edges which are good candidates for flipping
  *
+ * Edges are walked serially in mesh order and greedily accepted into an
+ * independent set: an edge which passes the boundary, tetrahedron, ridge, and
+ * user criteria is accepted and excludes all edges within its 3-ring. Flips
+ * in the returned set touch disjoint neighborhoods, but applying them is left
+ * to the caller and remains serial.
+ *
+ * Only the candidate tests can run in parallel. With more than one thread
+ * every selected edge is tested up front as a pre-check, including edges the
+ * walk later skips because an earlier edge excludes them, so the total work
+ * is larger than the serial path and only the wall time can shrink. Building
+ * the set stays serial and its result is identical for any thread count.
+ * An error raised by a pre-check, for instance on an edge shared by more than
+ * two faces, is only rethrown if the walk reaches the edge, so errors are
+ * also the same for any thread count.
+ *
  * @param[in]  mesh            SurfaceMesh to operate on.
  * @param[in]  preserveRidges  Whether or not to try preserving ridges.
  * @param[in]  checkFlip       Functor specifying flip criteria
  * @param[in]  iter            Inserter for container of edges to flip
+ * @param[in]  nthreads        Number of threads for the candidate pre-check
+ *                             (0 uses all hardware threads)
  *
  * @tparam     Inserter        Typename of the inserter.
  */
@@ -538,62 +575,98 @@ void selectFlipEdges(
     const SurfaceMesh &mesh, bool preserveRidges,
     std::function<bool(const SurfaceMesh &, const SurfaceMesh::SimplexID<2> &)>
         &&checkFlip,
-    Inserter iter) {
-  casc::NodeSet<SurfaceMesh::SimplexID<2>> ignoredEdges;
+    Inserter iter, std::size_t nthreads = 1) {
+  // Test if an edge could be flipped ignoring its neighbors
+  auto isCandidate = [&](const SurfaceMesh::SimplexID<2> edgeID) {
+    auto up = mesh.get_cover(edgeID);
+    // The mesh is not a surface mesh...
+    if (up.size() > 2) {
+      // std::cerr << "This edge participates in more than 2
+      // faces. "
+      //           << "Returning..." << std::endl;
+      gamer_runtime_error("SurfaceMesh is not pseudomanifold. Found "
+                          "an edge connected to more than 2 faces.");
+    } else if (up.size() < 2) // Edge is a boundary
+    {
+      // std::cerr << "This edge participates in fewer than 2
+      // faces. "
+      //           << "Returning..." << std::endl;
+      return false;
+    }
 
-  for (auto edgeID : mesh.get_level_id<2>()) {
-    if ((*edgeID).selected == true) {
-      if (!ignoredEdges.count(edgeID)) {
-        auto up = mesh.get_cover(edgeID);
-        // The mesh is not a surface mesh...
-        if (up.size() > 2) {
-          // std::cerr << "This edge participates in more than 2
-          // faces. "
-          //           << "Returning..." << std::endl;
-          gamer_runtime_error("SurfaceMesh is not pseudomanifold. Found "
-                              "an edge connected to more than 2 faces.");
-        } else if (up.size() < 2) // Edge is a boundary
-        {
-          // std::cerr << "This edge participates in fewer than 2
-          // faces. "
-          //           << "Returning..." << std::endl;
-          continue;
-        }
+    // Check if the edge is a part of a tetrahedron.
+    if (mesh.exists<2>({up[0], up[1]})) {
+      // std::cerr << "Found a tetrahedron cannot edge flip."
+      //           << std::endl;
+      return false;
+    }
 
-        // Check if the edge is a part of a tetrahedron.
-        if (mesh.exists<2>({up[0], up[1]})) {
-          // std::cerr << "Found a tetrahedron cannot edge flip."
-          //           << std::endl;
-          continue;
-        }
+    // Check if we're on a ridge. This prevents folding also.
+    if (preserveRidges) {
+      auto a = getNormal(mesh, mesh.get_simplex_up(edgeID, up[0]));
+      auto b = getNormal(mesh, mesh.get_simplex_up(edgeID, up[1]));
+      auto val = angle(a, b);
+      if (val > 60) {
+        return false;
+      }
+    }
 
-        // Check if we're on a ridge. This prevents folding also.
-        if (preserveRidges) {
-          auto a = getNormal(mesh, mesh.get_simplex_up(edgeID, up[0]));
-          auto b = getNormal(mesh, mesh.get_simplex_up(edgeID, up[1]));
-          auto val = angle(a, b);
-          if (val > 60) {
-            continue;
-          }
-        }
+    // Check the flip using user function
+    return checkFlip(mesh, edgeID);
+  };
 
-        // Check the flip using user function
-        if (checkFlip(mesh, edgeID)) {
-          *iter++ = edgeID; // Insert into edges to flip
+  std::vector<SurfaceMesh::SimplexID<2>> edges;
+  for (auto edgeID : mesh.get_level_id<2>()) {
+    if ((*edgeID).selected == true) {
+      edges.push_back(edgeID);
+    }
+  }
 
-          // The local topology will be changed by edge flip.
-          // Don't flip edges which share a common face.
-          std::set<SurfaceMesh::SimplexID<2>> tmpIgnored;
-          kneighbors(mesh, edgeID, 3, tmpIgnored);
-          ignoredEdges.insert(tmpIgnored.begin(), tmpIgnored.end());
+  // Pre-check all candidates when threaded. This also tests edges that an
+  // earlier flip excludes, which the lazy serial path never checks. Errors
+  // are kept per edge and only raised once the walk below reaches the edge,
+  // as the serial path would.
+  std::vector<char> candidate;
+  std::vector<std::exception_ptr> errors;
+  const bool threaded = parallel::numThreads(nthreads, edges.size()) > 1;
+  if (threaded) {
+    candidate.resize(edges.size());
+    errors.resize(edges.size());
+    parallel::for_each_chunk(
+        0, edges.size(), nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end) {
+          for (std::size_t i = begin; i < end; ++i) {
+            try {
+              candidate[i] = isCandidate(edges[i]);
+            } catch (...) {
+              errors[i] = std::current_exception();
+            }
+          }
+        });
+  }
 
-          // Local neighborhood append. Larger neighborhood selected
-          // above appears to work better...
-          // neighbors(mesh, edgeID, std::inserter(ignoredEdges,
-          // ignoredEdges.end()));
-        }
-      }
-    }
+  casc::NodeSet<SurfaceMesh::SimplexID<2>> ignoredEdges;
+  for (std::size_t i = 0; i < edges.size(); ++i) {
+    auto edgeID = edges[i];
+    if (ignoredEdges.count(edgeID))
+      continue;
+    if (threaded && errors[i])
+      std::rethrow_exception(errors[i]);
+    if (threaded ? !candidate[i] : !isCandidate(edgeID))
+      continue;
+
+    *iter++ = edgeID; // Insert into edges to flip
+
+    // The local topology will be changed by edge flip.
+    // Don't flip edges which share a common face.
+    std::set<SurfaceMesh::SimplexID<2>> tmpIgnored;
+    kneighbors(mesh, edgeID, 3, tmpIgnored);
+    ignoredEdges.insert(tmpIgnored.begin(), tmpIgnored.end());
+
+    // Local neighborhood append. Larger neighborhood selected
+    // above appears to work better...
+    // neighbors(mesh, edgeID, std::inserter(ignoredEdges,
+    // ignoredEdges.end()));
   }
 }
 
@@ -770,6 +843,46 @@ void vertexGrabber(const Complex &F, int need,
 } // end namespace surfacemesh_detail
 /// @endcond
 
+/**
+ * @brief      Build a SurfaceMesh from flat vertex and triangle buffers
+ *
+ * Vertex i is inserted with key i. Face indices are validated before the
+ * complex is touched, so a bad buffer raises an error instead of leaving a
+ * half built mesh. casc owns the node storage and has no bulk insertion, so
+ * the simplices are inserted one at a time with the same cost as calling
+ * insert directly. This is a single checked entry point, not a faster one.
+ *
+ * @param[in]  vertices   Array of 3*nVertices coordinates (x0,y0,z0,x1,...)
+ * @param[in]  nVertices  Number of vertices
+ * @param[in]  faces      Array of 3*nFaces vertex indices
+ * @param[in]  nFaces     Number of faces
+ * @param[in]  markers    Optional array of nFaces face markers
+ * @param[in]  orient     Whether to compute the orientation
+ *
+ * @return     Unique pointer to the new SurfaceMesh
+ */
+std::unique_ptr<SurfaceMesh>
+buildSurfaceMesh(const REAL *vertices, std::size_t nVertices, const int *faces,
+                 std::size_t nFaces, const int *markers = nullptr,
+                 bool orient = true);
+
+/**
+ * @brief      Build a SurfaceMesh from vertex data and triangle indices
+ *
+ * Same as the buffer overload but copies the full vertex and face data.
+ *
+ * @param[in]  vertices  Vertex data, vertex i is inserted with key i
+ * @param[in]  faces     Vertex indices of each face
+ * @param[in]  faceData  Optional data of each face, empty for defaults
+ * @param[in]  orient    Whether to compute the orientation
+ *
+ * @return     Unique pointer to the new SurfaceMesh
+ */
+std::unique_ptr<SurfaceMesh>
+buildSurfaceMesh(const std::vector<SMVertex> &vertices,
+                 const std::vector<std::array<int, 3>> &faces,
+                 const std::vector<SMFace> &faceData = {}, bool orient = true);
+
 /**
  * @brief      Reads in a GeomView OFF file
  *
@@ -933,15 +1046,19 @@ curvatureViaMDSB(const SurfaceMesh &mesh);
 /**
  * @brief      Compute the curvature using the Cazals-Pouget algorithm.
  *
- * @param[in]  dJet    Fit with a d-Jet
- * @param[in]  dPrime  Maximal order differential to compute
- * @param[in]  mesh    The mesh
+ * Every vertex has a slot in the returned arrays. Vertices without enough
+ * neighbors to fit the jet are set to NaN.
+ *
+ * @param[in]  dJet      Fit with a d-Jet
+ * @param[in]  dPrime    Maximal order differential to compute
+ * @param[in]  mesh      The mesh
+ * @param[in]  nthreads  Number of threads (0 uses all hardware threads)
  */
 std::tuple<
     REAL *, REAL *, REAL *, REAL *,
     std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType>>
 curvatureViaJets(const SurfaceMesh &mesh, std::size_t dJet = 2,
-                 std::size_t dPrime = 2);
+                 std::size_t dPrime = 2, std::size_t nthreads = 1);
 
 // void osculatingJets(const SurfaceMesh&mesh, std::size_t dJet = 2, std::size_t
 // dPrime = 2);
@@ -1008,13 +1125,20 @@ void centeralize(SurfaceMesh &mesh);
  * @param[in]  preserveRidges  Whether or not to preserve ridges
  * @param[in]  rings           Number of neighborhood rings to consider for LST
  * @param[in]  verbose         Print additional information
+ * @param[in]  nthreads        Number of threads for the vertex update and
+ *                             edge flip candidate pre-check (0 uses all
+ *                             hardware threads)
  */
 void smoothMesh(SurfaceMesh &mesh, int maxIter, bool preserveRidges,
-                std::size_t rings = 2, bool verbose = false);
+                std::size_t rings = 2, bool verbose = false,
+                std::size_t nthreads = 1);
 
 /**
  * @brief      Coarsens the mesh
  *
+ * The criteria of all vertices are evaluated up front by coarseScores and
+ * only the vertices near a decimation are rescored when visited.
+ *
  * @param      mesh         The mesh
  * @param[in]  coarseRate   The coarse rate
  * @param[in]  flatRate     The flat rate
@@ -1025,6 +1149,28 @@ void smoothMesh(SurfaceMesh &mesh, int maxIter, bool preserveRidges,
 void coarse(SurfaceMesh &mesh, double coarseRate, double flatRate,
             double denseWeight, std::size_t rings = 2, bool verbose = false);
 
+/**
+ * @brief      Decimate the mesh by quadric error edge collapses
+ *
+ * Unlike coarse, vertices are not removed by a threshold but edges are
+ * collapsed in order of increasing error until a face budget or an error
+ * bound is reached. See decimateQuadric(const FlatSurfaceMesh&, ...).
+ *
+ * @param[in]  mesh         The mesh
+ * @param[in]  targetFaces  Stop once there are no more faces than this
+ * @param[in]  maxError     Stop once the least cost exceeds this
+ * @param[in]  flatRate     Weight costs by the LST flatness ratio raised to
+ *                          this power, 0 to disable
+ * @param[in]  rings        Number of neighborhood rings to consider for LST
+ * @param[in]  verbose      Print additional info
+ *
+ * @return     The decimated mesh
+ */
+std::unique_ptr<SurfaceMesh>
+decimateQuadric(const SurfaceMesh &mesh, std::size_t targetFaces,
+                REAL maxError = std::numeric_limits<REAL>::infinity(),
+                REAL flatRate = 0, std::size_t rings = 2, bool verbose = false);
+
 /**
  * @brief      Coarsens the mesh by selecting vertices first.
  *
@@ -1049,6 +1195,29 @@ void coarse_dense(SurfaceMesh &mesh, REAL threshold, REAL weight,
 void coarse_flat(SurfaceMesh &mesh, REAL threshold, REAL weight,
                  std::size_t rings = 2, bool verbose = false);
 
+/**
+ * @brief      Coarsens the mesh by removing independent sets of vertices
+ *
+ * Uses the sparseness and flatness criteria of coarse but works in rounds.
+ * Each round rescores pending vertices near earlier decimations in parallel,
+ * picks the candidates below the threshold whose neighborhoods do not
+ * overlap, lowest score first, removes them, and smooths around each filled
+ * hole in parallel. Candidates blocked by a neighbor are reconsidered in the
+ * next round. Removing and retriangulating changes the complex and is done
+ * serially. The result does not depend on the number of threads.
+ *
+ * @param      mesh         The mesh
+ * @param[in]  coarseRate   The coarse rate
+ * @param[in]  flatRate     The flat rate
+ * @param[in]  denseWeight  The dense weight
+ * @param[in]  rings        Number of neighborhood rings to consider for LST
+ * @param[in]  verbose      Print additional info
+ * @param[in]  nthreads     Number of threads (0 uses all hardware threads)
+ */
+void coarse_parallel(SurfaceMesh &mesh, double coarseRate, double flatRate,
+                     double denseWeight, std::size_t rings = 2,
+                     bool verbose = false, std::size_t nthreads = 1);
+
 /**
  * @brief      Perform smoothing of the mesh normals
  *
@@ -0,0 +1,115 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+/**
+ * @file parallel.h
+ * @brief Minimal std::thread based helpers for data parallel loops
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Namespace for all things gamer
+namespace gamer {
+
+/// Namespace for threading utilities
+namespace parallel {
+/**
+ * @brief      Resolve a requested number of threads
+ *
+ * A request of zero threads maps to the hardware concurrency. The result is
+ * never larger than the number of work items and never smaller than one.
+ *
+ * @param[in]  nthreads  Requested number of threads
+ * @param[in]  nitems    Number of work items to distribute
+ *
+ * @return     Number of threads to spawn
+ */
+inline std::size_t numThreads(std::size_t nthreads, std::size_t nitems) {
+  if (nthreads == 0) {
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return std::max<std::size_t>(1, std::min(nthreads, nitems));
+}
+
+/**
+ * @brief      Split [begin, end) into contiguous chunks and process them
+ *             concurrently.
+ *
+ * The functor is called as `func(tid, chunkBegin, chunkEnd)` where `tid` is
+ * in [0, numThreads(nthreads, end-begin)). Chunk boundaries only depend on the
+ * range and the thread count so callers can merge per-thread results in a
+ * deterministic order. The calling thread processes the first chunk. If any
+ * worker throws, the first exception is rethrown after all threads join.
+ *
+ * @param[in]  begin     First index
+ * @param[in]  end       One past the last index
+ * @param[in]  nthreads  Requested number of threads (0 for hardware default)
+ * @param      func      Functor taking (std::size_t, std::size_t, std::size_t)
+ */
+template <typename Func>
+void for_each_chunk(std::size_t begin, std::size_t end, std::size_t nthreads,
+                    Func &&func) {
+  if (end <= begin)
+    return;
+  const std::size_t n = end - begin;
+  const std::size_t nt = numThreads(nthreads, n);
+  if (nt == 1) {
+    func(std::size_t(0), begin, end);
+    return;
+  }
+
+  const std::size_t chunk = n / nt;
+  const std::size_t extra = n % nt;
+  auto chunkBegin = [&](std::size_t tid) {
+    return begin + tid * chunk + std::min(tid, extra);
+  };
+
+  std::vector<std::exception_ptr> errors(nt);
+  std::vector<std::thread> workers;
+  workers.reserve(nt - 1);
+  for (std::size_t tid = 1; tid < nt; ++tid) {
+    workers.emplace_back([&, tid]() {
+      try {
+        func(tid, chunkBegin(tid), chunkBegin(tid + 1));
+      } catch (...) {
+        errors[tid] = std::current_exception();
+      }
+    });
+  }
+  try {
+    func(std::size_t(0), chunkBegin(0), chunkBegin(1));
+  } catch (...) {
+    errors[0] = std::current_exception();
+  }
+  for (auto &worker : workers)
+    worker.join();
+  for (auto &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+}
+} // namespace parallel
+} // namespace gamer
@@ -17,12 +17,15 @@
 // or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
 // Boston, MA 02111-1307 USA
 
+#include <cmath>
+
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include <pybind11/iostream.h>
 
 #include "gamer/SurfaceMesh.h"
+#include "gamer/FlatSurfaceMesh.h"
 
 /// Namespace for all things gamer
 namespace gamer
@@ -30,6 +33,77 @@ namespace gamer
 
 namespace py = pybind11;
 
+namespace {
+/**
+ * @brief      Hand a vector over to numpy without copying
+ *
+ * @param      values  The values, moved into the array
+ *
+ * @return     Array owning the values
+ */
+py::array_t<REAL> ownedArray(std::vector<REAL>& values){
+    auto owned = new std::vector<REAL>(std::move(values));
+    auto free_owned = py::capsule(
+                        owned,
+                        [](void *owned) {
+                            delete reinterpret_cast<std::vector<REAL>*>(owned);
+                     });
+    return py::array_t<REAL>(
+                std::array<std::size_t, 1>({owned->size()}),
+                {sizeof(REAL)},
+                owned->data(),
+                free_owned);
+}
+
+/**
+ * @brief      Smooth curvatures and hand them over to numpy
+ *
+ * Each smoothing iteration replaces a value by the average of itself and its
+ * neighbors. NaN values, left by vertices which could not be fit, are
+ * excluded from the averages.
+ *
+ * @param[in]  flat        Flat mesh the curvatures are indexed by
+ * @param      curvatures  The curvatures, moved into the arrays
+ * @param[in]  nIter       Number of smoothing iterations
+ *
+ * @return     Tuple of mean, Gaussian, first and second principal curvatures
+ */
+py::tuple curvatureArrays(const FlatSurfaceMesh& flat, Curvatures& curvatures,
+                          std::size_t nIter){
+    std::vector<REAL> sum;
+    std::vector<std::size_t> count;
+    for(auto values : {&curvatures.kh, &curvatures.kg,
+                       &curvatures.k1, &curvatures.k2}){
+        for(std::size_t round = 0; round < nIter; ++round){
+            sum.assign(flat.nVertices(), 0);
+            count.assign(flat.nVertices(), 0);
+            auto add = [&](std::size_t i, REAL value){
+                if(!std::isnan(value)){
+                    sum[i] += value;
+                    ++count[i];
+                }
+            };
+            for(std::size_t i = 0; i < flat.nVertices(); ++i){
+                add(i, (*values)[i]);
+            }
+            for(const auto& edge : flat.edges){
+                add(edge[0], (*values)[edge[1]]);
+                add(edge[1], (*values)[edge[0]]);
+            }
+            for(std::size_t i = 0; i < flat.nVertices(); ++i){
+                if(count[i] > 0)
+                    (*values)[i] = sum[i]/static_cast<REAL>(count[i]);
+            }
+        }
+    }
+
+    return py::make_tuple(ownedArray(curvatures.kh),
+                          ownedArray(curvatures.kg),
+                          ownedArray(curvatures.k1),
+                          ownedArray(curvatures.k2));
+}
+} // end anonymous namespace
+
 void init_SurfaceMesh(py::module& mod){
     // Bindings for SurfaceMesh
     py::class_<SurfaceMesh> SurfMeshCls(mod, "SurfaceMesh",
@@ -377,48 +451,31 @@ void init_SurfaceMesh(py::module& mod){
 
     SurfMeshCls.def("to_ndarray",
         [](const SurfaceMesh& mesh){
-            std::map<typename SurfaceMesh::KeyType,typename SurfaceMesh::KeyType> sigma;
+            FlatSurfaceMesh flat = flatten(mesh);
 
-            double *vertices = new double[3*mesh.size<1>()];
-            int    *edges = new int[2*mesh.size<2>()];
-            int    *faces = new int[3*mesh.size<3>()];
+            double *vertices = new double[3*flat.nVertices()];
+            int    *edges = new int[2*flat.nEdges()];
+            int    *faces = new int[3*flat.nFaces()];
 
-            std::size_t i = 0;
-            for(const auto vertexID : mesh.get_level_id<1>()){
+            for(std::size_t i = 0; i < flat.nVertices(); ++i){
                 std::size_t o = 3*i;
-                sigma[mesh.get_name(vertexID)[0]] = i++;
-                auto vertex = vertexID.data();
-                vertices[o]     = vertex[0];
-                vertices[o+1]   = vertex[1];
-                vertices[o+2]   = vertex[2];
+                vertices[o]     = flat.positions[i][0];
+                vertices[o+1]   = flat.positions[i][1];
+                vertices[o+2]   = flat.positions[i][2];
             }
 
-            i = 0;
-            for(const auto edgeID : mesh.get_level_id<2>()){
+            for(std::size_t i = 0; i < flat.nEdges(); ++i){
                 std::size_t o = 2*i;
-                auto name = mesh.get_name(edgeID);
-
-                edges[o]    = sigma[name[0]];
-                edges[o+1]  = sigma[name[1]];
-                ++i;
+                edges[o]    = flat.edges[i][0];
+                edges[o+1]  = flat.edges[i][1];
             }
 
-            i = 0;
-            for(const auto faceID : mesh.get_level_id<3>()){
+            for(std::size_t i = 0; i < flat.nFaces(); ++i){
                 std::size_t o = 3*i;
-                auto name = mesh.get_name(faceID);
-                int orient = (*faceID).orientation;
-                if(orient == 1){
-                    faces[o]    = sigma[name[0]];
-                    faces[o+1]  = sigma[name[1]];
-                    faces[o+2]  = sigma[name[2]];
-                }
-                else{
-                    faces[o]    = sigma[name[2]];
-                    faces[o+1]  = sigma[name[1]];
-                    faces[o+2]  = sigma[name[0]];
-                }
-                ++i;
+                auto face = flat.orientedFace(i);
+                faces[o]    = face[0];
+                faces[o+1]  = face[1];
+                faces[o+2]  = face[2];
             }
 
             auto free_vertices  = py::capsule(
@@ -466,6 +523,44 @@ void init_SurfaceMesh(py::module& mod){
     );
 
 
+    SurfMeshCls.def_static("from_ndarray",
+        [](py::array_t<REAL, py::array::c_style | py::array::forcecast> vertices,
+           py::array_t<int, py::array::c_style | py::array::forcecast> faces,
+           py::object markers){
+            if (vertices.ndim() != 2 || vertices.shape(1) != 3)
+                throw std::invalid_argument("vertices must have shape (nVertices, 3).");
+            if (faces.ndim() != 2 || faces.shape(1) != 3)
+                throw std::invalid_argument("faces must have shape (nFaces, 3).");
+
+            py::array_t<int, py::array::c_style | py::array::forcecast> markerArr;
+            const int *markerPtr = nullptr;
+            if (!markers.is_none()){
+                markerArr = py::array_t<int, py::array::c_style | py::array::forcecast>::ensure(markers);
+                if (!markerArr || markerArr.ndim() != 1 || markerArr.shape(0) != faces.shape(0))
+                    throw std::invalid_argument("markers must have shape (nFaces,).");
+                markerPtr = markerArr.data();
+            }
+            return buildSurfaceMesh(vertices.data(), vertices.shape(0),
+                                    faces.data(), faces.shape(0), markerPtr);
+        },
+        py::arg("vertices"), py::arg("faces"), py::arg("markers") = py::none(),
+        R"delim(
+            Construct a Surface Mesh from numpy arrays.
+
+            Vertex i of the array is inserted with key i. C-contiguous
+            arrays of matching dtype are read in place without a copy.
+
+            Args:
+                vertices (:py:class:`numpy.ndarray`): (nVertices, 3) array of vertex coordinates.
+                faces (:py:class:`numpy.ndarray`): (nFaces, 3) array of indices of vertices making up faces.
+                markers (:py:class:`numpy.ndarray`, optional): (nFaces,) array of face markers.
+
+            Returns:
+                :py:class:`SurfaceMesh`: The new mesh.
+        )delim"
+    );
+
+
     SurfMeshCls.def("onBoundary",
         py::overload_cast<const SurfaceMesh::SimplexID<1>>(&SurfaceMesh::onBoundary<1>, py::const_),
         R"delim(
@@ -561,128 +656,18 @@ void init_SurfaceMesh(py::module& mod){
 
 
     SurfMeshCls.def("curvatureViaMDSB",
-        [](const SurfaceMesh& mesh, std::size_t nIter){
-            double* kh;
-            double* kg;
-            double* k1;
-            double* k2;
-            std::map<typename SurfaceMesh::KeyType,typename SurfaceMesh::KeyType> sigma;
-
-            std::tie(kh,kg,k1,k2,sigma) = curvatureViaMDSB(mesh);
-
-            auto free_kh  = py::capsule(
-                                kh,
-                                [](void *kh) {
-                                    delete[] reinterpret_cast<double*>(kh);
-                             });
-            auto free_kg  = py::capsule(
-                                kg,
-                                [](void *kg) {
-                                    delete[] reinterpret_cast<double*>(kg);
-                             });
-            auto free_k1  = py::capsule(
-                                k1,
-                                [](void *k1) {
-                                    delete[] reinterpret_cast<double*>(k1);
-                             });
-            auto free_k2  = py::capsule(
-                                k2,
-                                [](void *k2) {
-                                    delete[] reinterpret_cast<double*>(k2);
-                             });
-
-            if(nIter > 0){
-                double* smoothedkh = new double[mesh.size<1>()];
-                double* smoothedkg = new double[mesh.size<1>()];
-                double* smoothedk1 = new double[mesh.size<1>()];
-                double* smoothedk2 = new double[mesh.size<1>()];
-
-                for(std::size_t round = 0; round < nIter; ++round){
-                    // Smoothing
-                    for(const auto vertexID : mesh.get_level_id<1>()) {
-                        std::size_t i = sigma[vertexID.indices()[0]];
-                        // double value = scale*kh[i];
-
-                        double valuekh = kh[i];
-                        double valuekg = kg[i];
-                        double valuek1 = k1[i];
-                        double valuek2 = k2[i];
-
-                        auto neighbors = vertexID.cover();
-                        for(std::size_t nbor : neighbors) {
-                            valuekh += kh[sigma[nbor]];
-                            valuekg += kg[sigma[nbor]];
-                            valuek1 += k1[sigma[nbor]];
-                            valuek2 += k2[sigma[nbor]];
-                            // value += (1-scale)/static_cast<double>(neighbors.size())*kh[sigma[nbor]];
-                        }
-                        // smoothed[i] = value;
-                        smoothedkh[i] = valuekh/static_cast<double>(neighbors.size()+1);
-                        smoothedkg[i] = valuekg/static_cast<double>(neighbors.size()+1);
-                        smoothedk1[i] = valuek1/static_cast<double>(neighbors.size()+1);
-                        smoothedk2[i] = valuek2/static_cast<double>(neighbors.size()+1);
-                    }
-                    std::copy(smoothedkh, smoothedkh+mesh.size<1>(), kh);
-                    std::copy(smoothedkg, smoothedkg+mesh.size<1>(), kg);
-                    std::copy(smoothedk1, smoothedk1+mesh.size<1>(), k1);
-                    std::copy(smoothedk2, smoothedk2+mesh.size<1>(), k2);
-                }
-
-                // // Smooth Gaussian curvature
-                // // double scale = 0.7;
-                // for(std::size_t round = 0; round < nIter; ++round){
-                //     // Smoothing
-                //     for(const auto vertexID : mesh.get_level_id<1>()) {
-                //         std::size_t i = sigma[vertexID.indices()[0]];
-                //         // double value = scale*kg[i];
-                //         double value = kg[i];
-                //         auto neighbors = vertexID.cover();
-                //         for(std::size_t nbor : neighbors) {
-                //             value += kg[sigma[nbor]];
-                //             // value += (1-scale)/static_cast<double>(neighbors.size())*kg[sigma[nbor]];
-                //         }
-                //         // smoothed[i] = value;
-                //         smoothed[i] = value/static_cast<double>(neighbors.size()+1);
-                //     }
-                //     for(std::size_t i = 0; i < mesh.size<1>(); ++i){
-                //         kg[i] = smoothed[i];
-                //     }
-                // }
-
-                delete[] smoothedkh;
-                delete[] smoothedkg;
-                delete[] smoothedk1;
-                delete[] smoothedk2;
-            }
-
-            return  std::make_tuple(
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            kh,
-                            free_kh),
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            kg,
-                            free_kg),
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            k1,
-                            free_k1),
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            k2,
-                            free_k2)
-                    );
+        [](const SurfaceMesh& mesh, std::size_t nIter, std::size_t nthreads){
+            FlatSurfaceMesh flat = flatten(mesh);
+            Curvatures curvatures = curvaturesViaMDSB(flat, nthreads);
+            return curvatureArrays(flat, curvatures, nIter);
         },
+        py::arg("nIter"), py::arg("nthreads") = 0,
         R"delim(
             Compute the mean, Gaussian, and principal curvatures of the mesh.
 
             Args:
                 nIter (:py:class:`int`): Number of smoothing iterations to run
+                nthreads (:py:class:`int`): Number of threads, 0 uses all hardware threads
 
             Returns:
                 tuple(:py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`): Tuple of arrays containing Mean, Gaussian, First Prinicipal, and Second Principal curvatures.
@@ -690,128 +675,24 @@ void init_SurfaceMesh(py::module& mod){
     );
 
     SurfMeshCls.def("curvatureViaJets",
-        [](const SurfaceMesh& mesh, std::size_t nIter){
-            double* kh;
-            double* kg;
-            double* k1;
-            double* k2;
-            std::map<typename SurfaceMesh::KeyType,typename SurfaceMesh::KeyType> sigma;
-
-            std::tie(kh,kg,k1,k2,sigma) = curvatureViaJets(mesh, 2, 2);
-
-            auto free_kh  = py::capsule(
-                                kh,
-                                [](void *kh) {
-                                    delete[] reinterpret_cast<double*>(kh);
-                             });
-            auto free_kg  = py::capsule(
-                                kg,
-                                [](void *kg) {
-                                    delete[] reinterpret_cast<double*>(kg);
-                             });
-            auto free_k1  = py::capsule(
-                                k1,
-                                [](void *k1) {
-                                    delete[] reinterpret_cast<double*>(k1);
-                             });
-            auto free_k2  = py::capsule(
-                                k2,
-                                [](void *k2) {
-                                    delete[] reinterpret_cast<double*>(k2);
-                             });
-
-           if(nIter > 0){
-                double* smoothedkh = new double[mesh.size<1>()];
-                double* smoothedkg = new double[mesh.size<1>()];
-                double* smoothedk1 = new double[mesh.size<1>()];
-                double* smoothedk2 = new double[mesh.size<1>()];
-
-                for(std::size_t round = 0; round < nIter; ++round){
-                    // Smoothing
-                    for(const auto vertexID : mesh.get_level_id<1>()) {
-                        std::size_t i = sigma[vertexID.indices()[0]];
-                        // double value = scale*kh[i];
-
-                        double valuekh = kh[i];
-                        double valuekg = kg[i];
-                        double valuek1 = k1[i];
-                        double valuek2 = k2[i];
-
-                        auto neighbors = vertexID.cover();
-                        for(std::size_t nbor : neighbors) {
-                            valuekh += kh[sigma[nbor]];
-                            valuekg += kg[sigma[nbor]];
-                            valuek1 += k1[sigma[nbor]];
-                            valuek2 += k2[sigma[nbor]];
-                            // value += (1-scale)/static_cast<double>(neighbors.size())*kh[sigma[nbor]];
-                        }
-                        // smoothed[i] = value;
-                        smoothedkh[i] = valuekh/static_cast<double>(neighbors.size()+1);
-                        smoothedkg[i] = valuekg/static_cast<double>(neighbors.size()+1);
-                        smoothedk1[i] = valuek1/static_cast<double>(neighbors.size()+1);
-                        smoothedk2[i] = valuek2/static_cast<double>(neighbors.size()+1);
-                    }
-                    std::copy(smoothedkh, smoothedkh+mesh.size<1>(), kh);
-                    std::copy(smoothedkg, smoothedkg+mesh.size<1>(), kg);
-                    std::copy(smoothedk1, smoothedk1+mesh.size<1>(), k1);
-                    std::copy(smoothedk2, smoothedk2+mesh.size<1>(), k2);
-                }
-
-                // // Smooth Gaussian curvature
-                // // double scale = 0.7;
-                // for(std::size_t round = 0; round < nIter; ++round){
-                //     // Smoothing
-                //     for(const auto vertexID : mesh.get_level_id<1>()) {
-                //         std::size_t i = sigma[vertexID.indices()[0]];
-                //         // double value = scale*kg[i];
-                //         double value = kg[i];
-                //         auto neighbors = vertexID.cover();
-                //         for(std::size_t nbor : neighbors) {
-                //             value += kg[sigma[nbor]];
-                //             // value += (1-scale)/static_cast<double>(neighbors.size())*kg[sigma[nbor]];
-                //         }
-                //         // smoothed[i] = value;
-                //         smoothed[i] = value/static_cast<double>(neighbors.size()+1);
-                //     }
-                //     for(std::size_t i = 0; i < mesh.size<1>(); ++i){
-                //         kg[i] = smoothed[i];
-                //     }
-                // }
-
-                delete[] smoothedkh;
-                delete[] smoothedkg;
-                delete[] smoothedk1;
-                delete[] smoothedk2;
-            }
-
-            return  std::make_tuple(
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            kh,
-                            free_kh),
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            kg,
-                            free_kg),
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            k1,
-                            free_k1),
-                        py::array_t<double>(
-                            std::array<std::size_t, 1>({mesh.size<1>()}),
-                            {sizeof(double)},
-                            k2,
-                            free_k2)
-                    );
+        [](const SurfaceMesh& mesh, std::size_t nIter, std::size_t dJet,
+           std::size_t dPrime, std::size_t nthreads){
+            FlatSurfaceMesh flat = flatten(mesh);
+            Curvatures curvatures = curvaturesViaJets(flat, dJet, dPrime, nthreads);
+            return curvatureArrays(flat, curvatures, nIter);
         },
+        py::arg("nIter"), py::arg("dJet") = 2, py::arg("dPrime") = 2,
+        py::arg("nthreads") = 0,
         R"delim(
             Compute the mean, Gaussian, and principal curvatures of the mesh.
 
+            Vertices without enough neighbors to fit the jet are NaN.
+
             Args:
                 nIter (:py:class:`int`): Number of smoothing iterations to run
+                dJet (:py:class:`int`): Order of the fitted jet
+                dPrime (:py:class:`int`): Maximal order differential to compute
+                nthreads (:py:class:`int`): Number of threads, 0 uses all hardware threads
 
             Returns:
                 tuple(:py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`): Tuple of arrays containing Mean, Gaussian, First Prinicipal, and Second Principal curvatures.
@@ -950,6 +831,7 @@ void init_SurfaceMesh(py::module& mod){
      ************************************/
     SurfMeshCls.def("smooth", &smoothMesh,
         py::arg("max_iter")=6, py::arg("preserve_ridges")=false, py::arg("rings")=2, py::arg("verbose")=false,
+        py::arg("threads")=1,
         py::call_guard<py::scoped_ostream_redirect,
                 py::scoped_estream_redirect>(),
         R"delim(
@@ -963,6 +845,9 @@ void init_SurfaceMesh(py::module& mod){
                 preserveRidges (bool):  Prevent flipping of edges along ridges.
                 rings (int): Number of LST rings to consider.
                 verbose (bool): Print details.
+                threads (int): Number of threads for the vertex update and
+                    edge flip candidate pre-check. Use 0 for all available
+                    cores.
         )delim"
     );
 
@@ -985,6 +870,81 @@ void init_SurfaceMesh(py::module& mod){
     );
 
 
+    SurfMeshCls.def("decimate_quadric",
+        [](const SurfaceMesh& mesh, std::size_t targetFaces, REAL maxError, REAL flatRate, std::size_t rings, bool verbose){
+            return decimateQuadric(mesh, targetFaces, maxError, flatRate, rings, verbose);
+        },
+        py::arg("targetFaces")=0, py::arg("maxError")=std::numeric_limits<REAL>::infinity(),
+        py::arg("flatRate")=0, py::arg("rings")=2, py::arg("verbose")=false,
+        R"delim(
+            Decimate a surface mesh by quadric error edge collapses.
+
+            Edges are collapsed in order of increasing error until the mesh
+            has at most targetFaces faces or the least error exceeds
+            maxError. Unselected vertices, boundaries, and marker boundaries
+            are preserved.
+
+            Args:
+                targetFaces (int): Stop once there are no more faces than this.
+                maxError (float): Stop once the least error exceeds this.
+                flatRate (float): Priority of decimating flat regions, 0 to disable.
+                rings (int): Number of LST rings to consider.
+                verbose (bool): Print details.
+
+            Returns:
+                :py:class:`SurfaceMesh`: The decimated mesh
+        )delim"
+    );
+
+
+    SurfMeshCls.def("coarse_scores",
+        [](const SurfaceMesh& mesh, REAL flatRate, REAL denseWeight, std::size_t rings, std::size_t nthreads){
+            CoarseScores scores = coarseScores(flatten(mesh), flatRate, denseWeight, rings, nthreads);
+            return py::make_tuple(ownedArray(scores.score),
+                                  ownedArray(scores.sparseness),
+                                  ownedArray(scores.flatness));
+        },
+        py::arg("flatRate"), py::arg("denseWeight"), py::arg("rings")=2, py::arg("nthreads")=0,
+        R"delim(
+            Evaluate the coarsening criteria without changing the mesh.
+
+            The arrays are indexed like the vertices of to_ndarray. Vertices
+            with a score below the rate passed to coarse are candidates for
+            removal. Unselected vertices are never removed and score NaN.
+
+            Args:
+                flatRate (float): Priority of decimating flat regions.
+                denseWeight (float): Priority of decimating dense regions.
+                rings (int): Number of LST rings to consider.
+                nthreads (int): Number of threads, 0 uses all hardware threads.
+
+            Returns:
+                tuple(:py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`, :py:class:`numpy.ndarray`): Tuple of arrays containing the score, sparseness, and flatness of each vertex.
+        )delim"
+    );
+
+
+    SurfMeshCls.def("coarse_parallel", &coarse_parallel,
+        py::arg("rate"), py::arg("flatRate"), py::arg("denseWeight"), py::arg("rings")=2,
+        py::arg("verbose")=false, py::arg("nthreads")=0,
+        R"delim(
+            Coarsen a surface mesh by removing independent sets of vertices.
+
+            Uses the same criteria as coarse but scores vertices in parallel
+            and removes vertices with non-overlapping neighborhoods in rounds.
+            The result does not depend on the number of threads.
+
+            Args:
+                rate (float): Threshold value for coarsening.
+                flatRate (float): Priority of decimating flat regions.
+                denseWeight (float): Priority of decimating dense regions.
+                rings (int): Number of LST and smoothing rings to consider.
+                verbose (bool): Print details.
+                nthreads (int): Number of threads, 0 uses all hardware threads.
+        )delim"
+    );
+
+
     SurfMeshCls.def("coarse_flat",
         [](SurfaceMesh& mesh, double rate, int niter, std::size_t rings, bool verbose){
             for(int i = 0; i < niter; ++i) coarse_flat(mesh, rate, 0.5, rings, verbose);
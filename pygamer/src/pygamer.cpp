@@ -17,7 +17,11 @@
 // or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
 // Boston, MA 02111-1307 USA
 
+#include <array>
+#include <sstream>
+
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include <pybind11/iostream.h>
 
@@ -32,6 +36,51 @@ namespace gamer
 
 namespace py = pybind11;
 
+/// C-contiguous float array. Matching numpy arrays are read in place.
+using AtomArray = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+/**
+ * @brief      Check the shapes of atom coordinate and radius arrays
+ *
+ * @param[in]  xyz    (nAtoms, 3) array of atom coordinates
+ * @param[in]  radii  (nAtoms,) array of atom radii
+ *
+ * @return     Number of atoms
+ */
+static std::size_t checkAtomArrays(const AtomArray &xyz, const AtomArray &radii)
+{
+    if (xyz.ndim() != 2 || xyz.shape(1) != 3)
+        throw std::invalid_argument("xyz must have shape (nAtoms, 3).");
+    if (radii.ndim() != 1 || radii.shape(0) != xyz.shape(0))
+        throw std::invalid_argument("radii must have shape (nAtoms,).");
+    return xyz.shape(0);
+}
+
+/**
+ * @brief      Wrap a Python callable as a TrajectoryCallback
+ *
+ * The callable receives the frame index and copies of the (nVertices, 3)
+ * vertex and (nFaces, 3) face arrays. Returning False stops the trajectory,
+ * any other value including None continues it.
+ *
+ * @param[in]  callback  The Python callable
+ *
+ * @return     The callback
+ */
+static TrajectoryCallback trajectoryCallback(py::function callback)
+{
+    return [callback](const TrajectoryFrame &frame){
+        py::array_t<REAL> vertices(
+            std::array<std::size_t, 2>({frame.vertices.size(), 3}),
+            reinterpret_cast<const REAL*>(frame.vertices.data()));
+        py::array_t<int> faces(
+            std::array<std::size_t, 2>({frame.triangles.size(), 3}),
+            reinterpret_cast<const int*>(frame.triangles.data()));
+        py::object result = callback(frame.index, vertices, faces);
+        return result.is_none() || result.cast<bool>();
+    };
+}
+
 // Forward function declarations
 void init_Vector(py::module &);
 void init_SMGlobal(py::module &);
@@ -103,13 +152,68 @@ PYBIND11_MODULE(pygamer, pygamer) {
     );
 
 
+    py::class_<GridResolution> resolution(pygamer, "GridResolution",
+        R"delim(
+            Grid resolution of the molecular surface builders.
+
+            With a nonzero memory budget the finest scale, up to
+            ``scale``, whose estimated peak memory fits the budget is
+            used.
+        )delim"
+    );
+    resolution.def(py::init([](double scale, std::size_t memoryBudget){
+            GridResolution rval;
+            rval.scale = scale;
+            rval.memoryBudget = memoryBudget;
+            return rval;
+        }),
+        py::arg("scale") = 0,
+        py::arg("memoryBudget") = 0
+    );
+    resolution.def_readwrite("scale", &GridResolution::scale,
+        "Grid points per Angstrom, 0 selects the default of the builder.");
+    resolution.def_readwrite("memoryBudget", &GridResolution::memoryBudget,
+        "Peak memory budget in bytes, 0 disables the automatic resolution.");
+
+    py::class_<GridMemoryEstimate> estimate(pygamer, "GridMemoryEstimate",
+        R"delim(
+            Grid and estimated memory use of a molecular surface builder.
+        )delim"
+    );
+    estimate.def_property_readonly("dim",
+        [](const GridMemoryEstimate &e){
+            return py::make_tuple(e.dim[0], e.dim[1], e.dim[2]);
+        },
+        "Grid dimension.");
+    estimate.def_readonly("scale", &GridMemoryEstimate::scale,
+        "Grid points per Angstrom.");
+    estimate.def_readonly("gridBytes", &GridMemoryEstimate::gridBytes,
+        "Peak memory of grids and working arrays in bytes.");
+    estimate.def_readonly("meshBytes", &GridMemoryEstimate::meshBytes,
+        "Memory of the output mesh in bytes.");
+    estimate.def("total", &GridMemoryEstimate::total,
+        "Estimated peak memory in bytes.");
+    estimate.def("__repr__",
+        [](const GridMemoryEstimate &e){
+            std::ostringstream out;
+            out << e;
+            return out.str();
+        });
+
+
     pygamer.def("readPDB_molsurf", &readPDB_molsurf,
         py::arg("filename"),
+        py::arg("resolution") = GridResolution(),
+        py::call_guard<py::gil_scoped_release>(),
         R"delim(
             Read a PDB file into a mesh
 
+            The GIL is released so several meshes can be built
+            concurrently from Python threads.
+
             Args:
                 filename (:py:class:`str`): PDB file to read.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
 
             Returns:
                 :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
@@ -119,12 +223,16 @@ PYBIND11_MODULE(pygamer, pygamer) {
     pygamer.def("readPDB_distgrid", &readPDB_distgrid,
         py::arg("filename"),
         py::arg("radius") = 1.4,
+        py::arg("use_edt") = false,
+        py::arg("resolution") = GridResolution(),
         R"delim(
             Compute the Connolly surface using a distance grid based strategy
 
             Args:
                 filename (:py:class:`str`): PDB file to read.
                 radius (:py:class:`float`): Radius in Angstroms of ball to roll over surface.
+                use_edt (:py:class:`bool`): Build the distance grids with linear time Euclidean distance transforms.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
             
             Returns:
                 :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
@@ -135,6 +243,7 @@ PYBIND11_MODULE(pygamer, pygamer) {
         py::arg("filename"),
         py::arg("blobbyness") = -0.2,
         py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
         R"delim(
             Read a PDB file into a mesh
 
@@ -142,6 +251,7 @@ PYBIND11_MODULE(pygamer, pygamer) {
                 filename (:py:class:`str`): PDB file to read.
                 blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
                 isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
 
             Returns:
                 :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
@@ -151,11 +261,17 @@ PYBIND11_MODULE(pygamer, pygamer) {
 
     pygamer.def("readPQR_molsurf", &readPQR_molsurf,
         py::arg("filename"),
+        py::arg("resolution") = GridResolution(),
+        py::call_guard<py::gil_scoped_release>(),
         R"delim(
             Read a PQR file into a mesh
 
+            The GIL is released so several meshes can be built
+            concurrently from Python threads.
+
             Args:
                 filename (:py:class:`str`): PQR file to read
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget
             Returns:
                 :py:class:`surfacemesh.SurfaceMesh`: Meshed object
         )delim"
@@ -166,6 +282,7 @@ PYBIND11_MODULE(pygamer, pygamer) {
         py::arg("filename"),
         py::arg("blobbyness") = -0.2,
         py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
         R"delim(
             Read a PQR file into a mesh
 
@@ -173,6 +290,7 @@ PYBIND11_MODULE(pygamer, pygamer) {
                 filename (:py:class:`str`): PQR file to read.
                 blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
                 isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
 
             Returns:
                 :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
@@ -180,6 +298,338 @@ PYBIND11_MODULE(pygamer, pygamer) {
     );
 
 
+    pygamer.def("readCIF_molsurf", &readCIF_molsurf,
+        py::arg("filename"),
+        py::arg("resolution") = GridResolution(),
+        py::call_guard<py::gil_scoped_release>(),
+        R"delim(
+            Read an mmCIF file into a mesh
+
+            The GIL is released so several meshes can be built
+            concurrently from Python threads.
+
+            Args:
+                filename (:py:class:`str`): mmCIF file to read
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget
+            Returns:
+                :py:class:`surfacemesh.SurfaceMesh`: Meshed object
+        )delim"
+    );
+
+
+    pygamer.def("readCIF_gauss", &readCIF_gauss,
+        py::arg("filename"),
+        py::arg("blobbyness") = -0.2,
+        py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Read an mmCIF file into a mesh
+
+            Args:
+                filename (:py:class:`str`): mmCIF file to read.
+                blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
+                isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
+        )delim"
+    );
+
+
+    pygamer.def("readCIF_distgrid", &readCIF_distgrid,
+        py::arg("filename"),
+        py::arg("radius") = 1.4,
+        py::arg("use_edt") = false,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Compute the Connolly surface of an mmCIF file using a distance grid based strategy
+
+            Args:
+                filename (:py:class:`str`): mmCIF file to read.
+                radius (:py:class:`float`): Radius in Angstroms of ball to roll over surface.
+                use_edt (:py:class:`bool`): Build the distance grids with linear time Euclidean distance transforms.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
+        )delim"
+    );
+
+
+    pygamer.def("meshAtoms_molsurf",
+        [](const AtomArray &xyz, const AtomArray &radii, const GridResolution &resolution){
+            std::size_t n = checkAtomArrays(xyz, radii);
+            const float *xyzData = xyz.data();
+            const float *radiiData = radii.data();
+            // Only release the GIL once the arrays are no longer touched as
+            // Python objects, their references are held by the caller
+            py::gil_scoped_release release;
+            return meshAtoms_molsurf(xyzData, radiiData, n, resolution);
+        },
+        py::arg("xyz"), py::arg("radii"),
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Mesh the molecular surface of atoms held in memory
+
+            The GIL is released so several meshes can be built
+            concurrently from Python threads.
+
+            Args:
+                xyz (:py:class:`numpy.ndarray`): (nAtoms, 3) array of atom coordinates.
+                radii (:py:class:`numpy.ndarray`): (nAtoms,) array of atom radii.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
+        )delim"
+    );
+
+
+    pygamer.def("meshAtoms_gauss",
+        [](AtomArray xyz, AtomArray radii, float blobbyness, float isovalue,
+           const GridResolution &resolution){
+            std::size_t n = checkAtomArrays(xyz, radii);
+            return meshAtoms_gauss(xyz.data(), radii.data(), n, blobbyness, isovalue,
+                                   resolution);
+        },
+        py::arg("xyz"), py::arg("radii"),
+        py::arg("blobbyness") = -0.2,
+        py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Mesh atoms held in memory using a Gaussian kernel
+
+            Args:
+                xyz (:py:class:`numpy.ndarray`): (nAtoms, 3) array of atom coordinates.
+                radii (:py:class:`numpy.ndarray`): (nAtoms,) array of atom radii.
+                blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
+                isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
+        )delim"
+    );
+
+
+    pygamer.def("meshAtoms_distgrid",
+        [](AtomArray xyz, AtomArray radii, float radius, bool useEDT,
+           const GridResolution &resolution){
+            std::size_t n = checkAtomArrays(xyz, radii);
+            return meshAtoms_distgrid(xyz.data(), radii.data(), n, radius, useEDT,
+                                      resolution);
+        },
+        py::arg("xyz"), py::arg("radii"),
+        py::arg("radius") = 1.4,
+        py::arg("use_edt") = false,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Compute the Connolly surface of atoms held in memory using a
+            distance grid based strategy
+
+            Args:
+                xyz (:py:class:`numpy.ndarray`): (nAtoms, 3) array of atom coordinates.
+                radii (:py:class:`numpy.ndarray`): (nAtoms,) array of atom radii.
+                radius (:py:class:`float`): Radius in Angstroms of ball to roll over surface.
+                use_edt (:py:class:`bool`): Build the distance grids with linear time Euclidean distance transforms.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`surfacemesh.SurfaceMesh`: Meshed object.
+        )delim"
+    );
+
+
+    pygamer.def("estimateMemory_molsurf",
+        [](AtomArray xyz, AtomArray radii, const GridResolution &resolution){
+            std::size_t n = checkAtomArrays(xyz, radii);
+            return estimateMemory_molsurf(
+                pdbreader_detail::makeAtoms(xyz.data(), radii.data(), n), resolution);
+        },
+        py::arg("xyz"), py::arg("radii"),
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Estimate the grid and memory of meshAtoms_molsurf
+
+            Args:
+                xyz (:py:class:`numpy.ndarray`): (nAtoms, 3) array of atom coordinates.
+                radii (:py:class:`numpy.ndarray`): (nAtoms,) array of atom radii.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`GridMemoryEstimate`: Grid that would be allocated.
+        )delim"
+    );
+
+
+    pygamer.def("estimateMemory_gauss",
+        [](AtomArray xyz, AtomArray radii, float blobbyness,
+           const GridResolution &resolution){
+            std::size_t n = checkAtomArrays(xyz, radii);
+            return estimateMemory_gauss(
+                pdbreader_detail::makeAtoms(xyz.data(), radii.data(), n), blobbyness,
+                resolution);
+        },
+        py::arg("xyz"), py::arg("radii"),
+        py::arg("blobbyness") = -0.2,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Estimate the grid and memory of meshAtoms_gauss
+
+            Args:
+                xyz (:py:class:`numpy.ndarray`): (nAtoms, 3) array of atom coordinates.
+                radii (:py:class:`numpy.ndarray`): (nAtoms,) array of atom radii.
+                blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`GridMemoryEstimate`: Grid that would be allocated.
+        )delim"
+    );
+
+
+    pygamer.def("estimateMemory_distgrid",
+        [](AtomArray xyz, AtomArray radii, float radius, bool useEDT,
+           const GridResolution &resolution){
+            std::size_t n = checkAtomArrays(xyz, radii);
+            return estimateMemory_distgrid(
+                pdbreader_detail::makeAtoms(xyz.data(), radii.data(), n), radius,
+                useEDT, resolution);
+        },
+        py::arg("xyz"), py::arg("radii"),
+        py::arg("radius") = 1.4,
+        py::arg("use_edt") = false,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Estimate the grid and memory of meshAtoms_distgrid
+
+            Args:
+                xyz (:py:class:`numpy.ndarray`): (nAtoms, 3) array of atom coordinates.
+                radii (:py:class:`numpy.ndarray`): (nAtoms,) array of atom radii.
+                radius (:py:class:`float`): Radius in Angstroms of ball to roll over surface.
+                use_edt (:py:class:`bool`): Build the distance grids with linear time Euclidean distance transforms.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`GridMemoryEstimate`: Grid that would be allocated.
+        )delim"
+    );
+
+
+    pygamer.def("meshTrajectory_gauss",
+        [](AtomArray xyz, AtomArray radii, py::function callback, float blobbyness,
+           float isovalue, const GridResolution &resolution){
+            if (xyz.ndim() != 3 || xyz.shape(2) != 3)
+                throw std::invalid_argument("xyz must have shape (nFrames, nAtoms, 3).");
+            if (radii.ndim() != 1 || radii.shape(0) != xyz.shape(1))
+                throw std::invalid_argument("radii must have shape (nAtoms,).");
+            return meshTrajectory_gauss(xyz.data(), radii.data(), xyz.shape(1),
+                                        xyz.shape(0), blobbyness, isovalue,
+                                        trajectoryCallback(callback), resolution);
+        },
+        py::arg("xyz"), py::arg("radii"), py::arg("callback"),
+        py::arg("blobbyness") = -0.2,
+        py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Mesh each frame of a trajectory using a Gaussian kernel
+
+            All frames are meshed on one grid containing every frame, so
+            the grid and mesh buffers are allocated once.
+
+            Args:
+                xyz (:py:class:`numpy.ndarray`): (nFrames, nAtoms, 3) array of atom coordinates.
+                radii (:py:class:`numpy.ndarray`): (nAtoms,) array of atom radii.
+                callback (callable): Called as callback(index, vertices, faces) with (nVertices, 3) and (nFaces, 3) arrays for each frame. Return False to stop.
+                blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
+                isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`int`: Number of frames meshed.
+        )delim"
+    );
+
+
+    pygamer.def("readPDBTrajectory_gauss",
+        [](const std::string &filename, py::function callback, float blobbyness,
+           float isovalue, const GridResolution &resolution){
+            return readPDBTrajectory_gauss(filename, blobbyness, isovalue,
+                                           trajectoryCallback(callback), resolution);
+        },
+        py::arg("filename"), py::arg("callback"),
+        py::arg("blobbyness") = -0.2,
+        py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Mesh each model of a multi-model PDB file using a Gaussian kernel
+
+            Args:
+                filename (:py:class:`str`): PDB file to read.
+                callback (callable): Called as callback(index, vertices, faces) with (nVertices, 3) and (nFaces, 3) arrays for each model. Return False to stop.
+                blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
+                isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`int`: Number of models meshed, 0 if the file could not be read.
+        )delim"
+    );
+
+
+    pygamer.def("readPQRTrajectory_gauss",
+        [](const std::string &filename, py::function callback, float blobbyness,
+           float isovalue, const GridResolution &resolution){
+            return readPQRTrajectory_gauss(filename, blobbyness, isovalue,
+                                           trajectoryCallback(callback), resolution);
+        },
+        py::arg("filename"), py::arg("callback"),
+        py::arg("blobbyness") = -0.2,
+        py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Mesh each model of a multi-model PQR file using a Gaussian kernel
+
+            Args:
+                filename (:py:class:`str`): PQR file to read.
+                callback (callable): Called as callback(index, vertices, faces) with (nVertices, 3) and (nFaces, 3) arrays for each model. Return False to stop.
+                blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
+                isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`int`: Number of models meshed, 0 if the file could not be read.
+        )delim"
+    );
+
+
+    pygamer.def("readCIFTrajectory_gauss",
+        [](const std::string &filename, py::function callback, float blobbyness,
+           float isovalue, const GridResolution &resolution){
+            return readCIFTrajectory_gauss(filename, blobbyness, isovalue,
+                                           trajectoryCallback(callback), resolution);
+        },
+        py::arg("filename"), py::arg("callback"),
+        py::arg("blobbyness") = -0.2,
+        py::arg("isovalue") = 2.5,
+        py::arg("resolution") = GridResolution(),
+        R"delim(
+            Mesh each model of a multi-model mmCIF file using a Gaussian kernel
+
+            Args:
+                filename (:py:class:`str`): mmCIF file to read.
+                callback (callable): Called as callback(index, vertices, faces) with (nVertices, 3) and (nFaces, 3) arrays for each model. Return False to stop.
+                blobbyness (:py:class:`float`): Blobbiness of the Gaussian.
+                isovalue (:py:class:`float`): The isocontour value to mesh.
+                resolution (:py:class:`GridResolution`): Grid resolution and memory budget.
+
+            Returns:
+                :py:class:`int`: Number of models meshed, 0 if the file could not be read.
+        )delim"
+    );
+
+
     pygamer.def("writeOFF", py::overload_cast<const std::string&, const SurfaceMesh&>(&writeOFF),
         py::arg("filename"), py::arg("mesh"),
         R"delim(
@@ -22,15 +22,20 @@
 #include <array>
 #include <cmath>
 #include <iomanip>
+#include <iostream>
+#include <limits>
 #include <map>
+#include <numeric>
 #include <ostream>
 #include <stdexcept>
 #include <strstream>
 #include <vector>
 
 #include "gamer/EigenDiagonalization.h"
+#include "gamer/FlatSurfaceMesh.h"
 #include "gamer/OsculatingJets.h"
 #include "gamer/SurfaceMesh.h"
+#include "gamer/parallel.h"
 
 /// Namespace for all things gamer
 namespace gamer {
@@ -38,165 +43,107 @@ std::tuple<
     REAL *, REAL *, REAL *, REAL *,
     std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType>>
 curvatureViaMDSB(const SurfaceMesh &mesh) {
-  std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType> sigma;
-
-  REAL *Amix = new REAL[mesh.size<1>()];
-  REAL *kg = new REAL[mesh.size<1>()];
-  REAL *kh = new REAL[mesh.size<1>()];
-  REAL *k1 = new REAL[mesh.size<1>()];
-  REAL *k2 = new REAL[mesh.size<1>()];
-  Vector *Kh = new Vector[mesh.size<1>()];
-  Vector *normals = new Vector[mesh.size<1>()];
-
-  // Map VertexIDs to indices
-  std::size_t i = 0;
-  for (const auto vertexID : mesh.get_level_id<1>()) {
-    Amix[i] = 0;
-    kg[i] = 0;
-    kh[i] = 0;
-    k1[i] = 0;
-    k2[i] = 0;
-    normals[i] = getNormal(mesh, vertexID);
-    sigma[vertexID.indices()[0]] = i++;
-  }
-
-  for (const auto faceID : mesh.get_level_id<3>()) {
-    auto indices = faceID.indices(); // Face vertex indices
-    std::array<Vertex, 3> vertices;  // Vertex data for indices
-    std::array<typename SurfaceMesh::KeyType, 2> keysDown; // Tmp to store
-                                                           // keys
-
-    // Fill vertices in order corresponding to indices
-    for (std::size_t skip = 0; skip < 3; ++skip) {
-      std::size_t j = 0;
-      std::size_t k = 0;
-      while (k < 2) {
-        if (j == skip)
-          ++j;
-        else {
-          keysDown[k++] = indices[j++];
-        }
-      }
-      vertices[skip] = *mesh.get_simplex_down(faceID, keysDown);
-    }
-
-    // TODO: (15) This section computes the same distances a bunch of time
-    std::array<REAL, 3> dist;
-    dist[0] = distance(vertices[0], vertices[1]);
-    dist[1] = distance(vertices[1], vertices[2]);
-    dist[2] = distance(vertices[0], vertices[2]);
-    std::sort(dist.begin(), dist.end());
-
-    // Check if the triangle is obtuse...
-    bool obtuse = dist[0] * dist[0] + dist[1] * dist[1] < dist[2] * dist[2];
-
-    REAL t_area = 0; // Area of the face
-    // Populate t_area if obtuse
-    if (obtuse)
-      t_area = getArea(vertices[0], vertices[1], vertices[2]);
-
-    // List of indices to rotate
-    std::array<std::size_t, 3> idxmap = {0, 1, 2};
-    for (std::size_t i = 0; i < 3; ++i) {
-      // idxmap[0] is the current vertex
-      REAL ang =
-          angle(vertices[idxmap[2]], vertices[idxmap[0]], vertices[idxmap[1]]);
-
-      std::size_t i0 = sigma[indices[idxmap[0]]];
-      std::size_t i1 = sigma[indices[idxmap[1]]];
-      std::size_t i2 = sigma[indices[idxmap[2]]];
-
-      // Add angle to Gaussian Curvature
-      kg[i0] += ang;
-
-      // Vectors of other edges
-      Vector v1 = vertices[idxmap[1]] - vertices[idxmap[2]];
-      Vector v2 = vertices[idxmap[2]] - vertices[idxmap[1]];
-
-      REAL cot = 1.0 / tan(ang);
+  // Operate on a flat copy to avoid the key lookups per face
+  return curvatureViaMDSB(flatten(mesh));
+}
 
-      if (obtuse) {
-        if (ang > M_PI / 2.0) {
-          Amix[i0] += t_area / 2.0;
-        } else {
-          Amix[i0] += t_area / 4.0;
+Curvatures curvaturesViaJets(const FlatSurfaceMesh &mesh, std::size_t dJet,
+                             std::size_t dPrime, std::size_t nthreads) {
+  const auto &X = mesh.positions;
+  const std::size_t nv = mesh.nVertices();
+  const std::size_t minPoints = (dJet + 1) * (dJet + 2) / 2;
+
+  const std::vector<Vector> normals = vertexNormals(mesh);
+  const VertexAdjacency adj = vertexAdjacency(mesh);
+  const auto &offsets = adj.offsets;
+  const auto &nbors = adj.nbors;
+
+  Curvatures result;
+  const REAL nan = std::numeric_limits<REAL>::quiet_NaN();
+  result.kh.assign(nv, nan);
+  result.kg.assign(nv, nan);
+  result.k1.assign(nv, nan);
+  result.k2.assign(nv, nan);
+
+  std::vector<std::size_t> skipped(parallel::numThreads(nthreads, nv), 0);
+  parallel::for_each_chunk(
+      0, nv, nthreads, [&](std::size_t tid, std::size_t begin,
+                           std::size_t end) {
+        Monge_via_jet_fitting monge_fit;
+        // visited[j] == i once vertex j is gathered for vertex i
+        std::vector<std::size_t> visited(nv, nv);
+        std::vector<const Vector *> points;
+        std::vector<int> ring, next;
+        points.reserve(minPoints);
+
+        for (std::size_t i = begin; i < end; ++i) {
+          // Gather rings of neighbors until there are enough points
+          points.assign(1, &X[i]);
+          visited[i] = i;
+          ring.assign(1, static_cast<int>(i));
+          while (points.size() < minPoints && !ring.empty()) {
+            next.clear();
+            for (auto v : ring) {
+              for (auto k = offsets[v];
+                   k < offsets[v + 1] && points.size() < minPoints; ++k) {
+                const int nbor = nbors[k];
+                if (visited[nbor] != i) {
+                  visited[nbor] = i;
+                  points.push_back(&X[nbor]);
+                  next.push_back(nbor);
+                }
+              }
+            }
+            ring.swap(next);
+          }
+
+          if (points.size() < minPoints) {
+            ++skipped[tid];
+            continue;
+          }
+
+          auto mongeForm =
+              monge_fit(points.begin(), points.end(), dJet, dPrime);
+          mongeForm.comply_wrt_given_normal(normals[i]);
+
+          REAL tk1 = mongeForm.principal_curvatures(0);
+          REAL tk2 = mongeForm.principal_curvatures(1);
+
+          result.k1[i] = tk1;
+          result.k2[i] = tk2;
+          result.kg[i] = tk1 * tk2;
+          result.kh[i] = (tk1 + tk2) / 2.;
         }
-      } else {
-        REAL tmp = cot / 8.0;
-        REAL lenSq = length(v1);
-        lenSq *= lenSq;
-        Amix[i1] += tmp * lenSq;
-        Amix[i2] += tmp * lenSq;
-      }
-
-      // Add value to Mean Curvature
-      Kh[i1] += cot * v1;
-      Kh[i2] += cot * v2;
-
-      std::rotate(idxmap.begin(), idxmap.begin() + 1, idxmap.end());
-    }
-  }
-
-  for (std::size_t i = 0; i < mesh.size<1>(); ++i) {
-    Kh[i] = Kh[i] / (2.0 * Amix[i]);
-    kh[i] = std::copysign(length(Kh[i]) / 2.0, -dot(Kh[i], normals[i]));
-    kg[i] = (2.0 * M_PI - kg[i]) / Amix[i];
-
-    REAL kh2 = kh[i] * kh[i];
-    REAL tmp = kh2 < kg[i] ? 0 : std::sqrt(kh2 - kg[i]);
-
-    k1[i] = kh[i] + tmp;
-    k2[i] = kh[i] - tmp;
+      });
+
+  const std::size_t nSkipped =
+      std::accumulate(skipped.begin(), skipped.end(), std::size_t(0));
+  if (nSkipped > 0) {
+    std::cerr << "Not enough points (need: " << minPoints << ") to fit "
+              << nSkipped << " vertices, their curvatures are NaN."
+              << std::endl;
   }
-
-  delete[] Amix;
-  delete[] Kh;
-  delete[] normals;
-  return std::make_tuple(kh, kg, k1, k2, sigma);
+  return result;
 }
 
 std::tuple<
     REAL *, REAL *, REAL *, REAL *,
     std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType>>
-curvatureViaJets(const SurfaceMesh &mesh, std::size_t dJet,
-                 std::size_t dPrime) {
+curvatureViaJets(const SurfaceMesh &mesh, std::size_t dJet, std::size_t dPrime,
+                 std::size_t nthreads) {
+  FlatSurfaceMesh flat = flatten(mesh);
   std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType> sigma;
-
-  REAL *kg = new REAL[mesh.size<1>()];
-  REAL *kh = new REAL[mesh.size<1>()];
-  REAL *k1 = new REAL[mesh.size<1>()];
-  REAL *k2 = new REAL[mesh.size<1>()];
-
-  int min_nb_points = (dJet + 1) * (dJet + 2) / 2;
-
-  // Map VertexIDs to indices
-  std::size_t i = 0;
-  for (const auto vertexID : mesh.get_level_id<1>()) {
-    std::vector<SurfaceMesh::SimplexID<1>> nbors;
-    nbors.push_back(vertexID);
-    surfacemesh_detail::vertexGrabber(mesh, min_nb_points - 1, nbors, vertexID);
-
-    if (nbors.size() < min_nb_points) {
-      std::cerr << "Not enough pts (have: " << nbors.size()
-                << ", need: " << min_nb_points
-                << ") for fitting this vertex: " << vertexID << std::endl;
-      continue;
-    }
-
-    Monge_via_jet_fitting monge_fit;
-    auto mongeForm = monge_fit(nbors.begin(), nbors.end(), dJet, dPrime);
-    mongeForm.comply_wrt_given_normal(getNormal(mesh, vertexID));
-
-    REAL tk1 = mongeForm.principal_curvatures(0);
-    REAL tk2 = mongeForm.principal_curvatures(1);
-
-    k1[i] = tk1;
-    k2[i] = tk2;
-
-    kg[i] = tk1 * tk2;
-    kh[i] = (tk1 + tk2) / 2.;
-    sigma[vertexID.indices()[0]] = i++;
+  for (std::size_t i = 0; i < flat.nVertices(); ++i) {
+    sigma.emplace_hint(sigma.end(), flat.vertexKeys[i], i);
   }
-  return std::make_tuple(kh, kg, k1, k2, sigma);
+
+  Curvatures curvatures = curvaturesViaJets(flat, dJet, dPrime, nthreads);
+  auto copy = [](const std::vector<REAL> &values) {
+    REAL *out = new REAL[values.size()];
+    std::copy(values.begin(), values.end(), out);
+    return out;
+  };
+  return std::make_tuple(copy(curvatures.kh), copy(curvatures.kg),
+                         copy(curvatures.k1), copy(curvatures.k2), sigma);
 }
 } // namespace gamer
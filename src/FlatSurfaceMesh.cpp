@@ -0,0 +1,574 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "gamer/EigenDiagonalization.h"
+#include "gamer/FlatSurfaceMesh.h"
+#include "gamer/SurfaceMesh.h"
+#include "gamer/Vertex.h"
+#include "gamer/parallel.h"
+
+/// Namespace for all things gamer
+namespace gamer {
+
+FlatSurfaceMesh flatten(const SurfaceMesh &mesh) {
+  FlatSurfaceMesh flat;
+  const std::size_t nv = mesh.size<1>();
+  const std::size_t ne = mesh.size<2>();
+  const std::size_t nf = mesh.size<3>();
+
+  std::unordered_map<SurfaceMesh::KeyType, int> sigma;
+  sigma.reserve(nv);
+
+  flat.positions.reserve(nv);
+  flat.vertexMarkers.reserve(nv);
+  flat.vertexSelected.reserve(nv);
+  flat.vertexKeys.reserve(nv);
+  for (const auto vertexID : mesh.get_level_id<1>()) {
+    auto key = mesh.get_name(vertexID)[0];
+    sigma[key] = flat.positions.size();
+    const auto &vertex = *vertexID;
+    flat.positions.push_back(vertex.position);
+    flat.vertexMarkers.push_back(vertex.marker);
+    flat.vertexSelected.push_back(vertex.selected);
+    flat.vertexKeys.push_back(key);
+  }
+
+  flat.edges.reserve(ne);
+  for (const auto edgeID : mesh.get_level_id<2>()) {
+    auto name = mesh.get_name(edgeID);
+    flat.edges.push_back({sigma[name[0]], sigma[name[1]]});
+  }
+
+  flat.faces.reserve(nf);
+  flat.faceOrientations.reserve(nf);
+  flat.faceMarkers.reserve(nf);
+  flat.faceSelected.reserve(nf);
+  for (const auto faceID : mesh.get_level_id<3>()) {
+    auto name = mesh.get_name(faceID);
+    const auto &face = *faceID;
+    flat.faces.push_back({sigma[name[0]], sigma[name[1]], sigma[name[2]]});
+    flat.faceOrientations.push_back(face.orientation);
+    flat.faceMarkers.push_back(face.marker);
+    flat.faceSelected.push_back(face.selected);
+  }
+  return flat;
+}
+
+void generateHistogram(const FlatSurfaceMesh &mesh) {
+  const auto &X = mesh.positions;
+
+  // compute angle distribution
+  std::array<double, 18> histogram;
+  histogram.fill(0);
+  for (const auto &f : mesh.faces) {
+    const auto &a = X[f[0]];
+    const auto &b = X[f[1]];
+    const auto &c = X[f[2]];
+
+    // A degenerate 180 degree angle belongs in the last bin
+    auto binAngle = [&](double angle) -> std::size_t {
+      return std::min<std::size_t>(
+          static_cast<std::size_t>(std::floor(angle / 10)), 17);
+    };
+    histogram[binAngle(angleDeg(a - b, c - b))]++;
+    histogram[binAngle(angleDeg(b - a, c - a))]++;
+    histogram[binAngle(angleDeg(c - a, b - a))]++;
+  }
+
+  std::size_t factor = mesh.nFaces() * 3;
+  std::for_each(histogram.begin(), histogram.end(),
+                [&factor](double &n) { n = 100.0 * n / factor; });
+
+  std::cout << "Angle Distribution:" << std::endl;
+  for (std::size_t x = 0; x < 18; x++)
+    std::cout << x * 10 << "-" << (x + 1) * 10 << ": " << std::setprecision(2)
+              << std::fixed << histogram[x] << std::endl;
+  std::cout << std::endl << std::endl;
+
+  // compute the edge length distribution
+  std::cout << "Edge Length Distribution:" << std::endl;
+  std::vector<double> lengths;
+  lengths.reserve(mesh.nEdges());
+  // Valence is the number of edges incident to each vertex
+  std::vector<std::size_t> valence(mesh.nVertices(), 0);
+  for (const auto &e : mesh.edges) {
+    lengths.push_back(length(X[e[1]] - X[e[0]]));
+    ++valence[e[0]];
+    ++valence[e[1]];
+  }
+  std::sort(lengths.begin(), lengths.end());
+
+  std::array<double, 20> histogramLength;
+  histogramLength.fill(0);
+  double interval = (lengths.back() - lengths.front()) / 20;
+  double low = lengths.front();
+
+  if (interval <= 0.0000001) // floating point roundoff prevention
+  {
+    std::cout << lengths.front() << ": " << 100 << std::endl << std::endl;
+  } else {
+    for (auto length : lengths) {
+      // The longest edge lands exactly on the upper bound
+      const auto bin =
+          static_cast<std::size_t>(std::floor((length - low) / interval));
+      histogramLength[std::min<std::size_t>(bin, 19)]++;
+    }
+
+    factor = mesh.nEdges();
+    std::for_each(histogramLength.begin(), histogramLength.end(),
+                  [&factor](double &n) { n = 100.0 * n / factor; });
+
+    for (std::size_t x = 0; x < 20; x++)
+      std::cout << x * interval << "-" << (x + 1) * interval << ": "
+                << std::setprecision(2) << std::fixed << histogramLength[x]
+                << std::endl;
+    std::cout << std::endl << std::endl;
+  }
+
+  // Compute the valence distribution
+  std::array<double, 20> histogramValence;
+  histogramValence.fill(0);
+  // Valences of 19 and above share the last bin
+  for (auto v : valence) {
+    histogramValence[std::min<std::size_t>(v, 19)]++;
+  }
+
+  std::cout << "Valence distribution:" << std::endl;
+  for (int x = 0; x < 19; x++)
+    std::cout << x << ": " << histogramValence[x] << std::endl;
+  std::cout << "19+: " << histogramValence[19] << std::endl;
+  std::cout << std::endl << std::endl;
+}
+
+std::tuple<double, double, int, int>
+getMinMaxAngles(const FlatSurfaceMesh &mesh, double maxMinAngle,
+                double minMaxAngle) {
+  const auto &X = mesh.positions;
+  double minAngle = 360;
+  double maxAngle = 0;
+  int small = 0;
+  int large = 0;
+
+  // for each triangle
+  for (const auto &f : mesh.faces) {
+    const auto &a = X[f[0]];
+    const auto &b = X[f[1]];
+    const auto &c = X[f[2]];
+    std::array<double, 3> angles;
+    try {
+      angles[0] = angleDeg(a - b, c - b);
+      angles[1] = angleDeg(b - a, c - a);
+      angles[2] = angleDeg(a - c, b - c);
+    } catch (std::runtime_error &e) {
+      std::cout << e.what() << std::endl;
+      gamer_runtime_error("ERROR(getMinMaxAngles): Cannot compute angles "
+                          "of face with zero area.");
+    }
+
+    for (double angle : angles) {
+      if (angle < minAngle) {
+        minAngle = angle;
+      }
+      if (angle > maxAngle) {
+        maxAngle = angle;
+      }
+      if (angle < maxMinAngle) {
+        ++small;
+      }
+      if (angle > minMaxAngle) {
+        ++large;
+      }
+    }
+  }
+  return std::make_tuple(minAngle, maxAngle, small, large);
+}
+
+double getArea(const FlatSurfaceMesh &mesh) {
+  const auto &X = mesh.positions;
+  double area = 0.0;
+  for (const auto &f : mesh.faces) {
+    auto wedge = (X[f[1]] - X[f[0]]) ^ (X[f[1]] - X[f[2]]);
+    area += std::sqrt(wedge | wedge) / 2;
+  }
+  return area;
+}
+
+double getVolume(const FlatSurfaceMesh &mesh) {
+  const auto &X = mesh.positions;
+  bool orientError = false;
+  double volume = 0;
+  for (std::size_t i = 0; i < mesh.nFaces(); ++i) {
+    const auto &f = mesh.faces[i];
+    const auto &a = X[f[0]];
+    const auto &b = X[f[1]];
+    const auto &c = X[f[2]];
+
+    if (mesh.faceOrientations[i] == 1) {
+      // a->b->c
+      volume += dot(a, cross(b, c));
+    } else if (mesh.faceOrientations[i] == -1) {
+      // c->b->a
+      volume += dot(c, cross(b, a));
+    } else {
+      orientError = true;
+    }
+  }
+  if (orientError) {
+    std::cerr << "ERROR getVolume(): Orientation undefined for one or more "
+              << "simplices. Did you call compute_orientation()?" << std::endl;
+  }
+  return volume / 6;
+}
+
+VertexAdjacency vertexAdjacency(const FlatSurfaceMesh &mesh) {
+  const std::size_t nv = mesh.nVertices();
+  VertexAdjacency adj;
+  adj.offsets.assign(nv + 1, 0);
+  for (const auto &edge : mesh.edges) {
+    ++adj.offsets[edge[0] + 1];
+    ++adj.offsets[edge[1] + 1];
+  }
+  std::partial_sum(adj.offsets.begin(), adj.offsets.end(),
+                   adj.offsets.begin());
+  adj.nbors.resize(adj.offsets[nv]);
+  std::vector<std::size_t> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+  for (const auto &edge : mesh.edges) {
+    adj.nbors[fill[edge[0]]++] = edge[1];
+    adj.nbors[fill[edge[1]]++] = edge[0];
+  }
+  for (std::size_t i = 0; i < nv; ++i) {
+    std::sort(adj.nbors.begin() + adj.offsets[i],
+              adj.nbors.begin() + adj.offsets[i + 1]);
+  }
+  return adj;
+}
+
+std::vector<Vector> vertexNormals(const FlatSurfaceMesh &mesh) {
+  const auto &X = mesh.positions;
+  std::vector<Vector> normals(mesh.nVertices());
+  for (std::size_t i = 0; i < mesh.nFaces(); ++i) {
+    if (mesh.faceOrientations[i] == 0) {
+      gamer_runtime_error("Orientation undefined, cannot compute normal. Did "
+                          "you call compute_orientation()?");
+    }
+    auto f = mesh.orientedFace(i);
+    Vector norm = cross(X[f[2]] - X[f[1]], X[f[0]] - X[f[1]]);
+    normals[f[0]] += norm;
+    normals[f[1]] += norm;
+    normals[f[2]] += norm;
+  }
+  return normals;
+}
+
+CoarseScores coarseScores(const FlatSurfaceMesh &mesh, REAL flatRate,
+                          REAL denseWeight, std::size_t rings,
+                          std::size_t nthreads) {
+  const auto &X = mesh.positions;
+  const std::size_t nv = mesh.nVertices();
+  const VertexAdjacency adj = vertexAdjacency(mesh);
+
+  CoarseScores scores;
+  scores.sparseness.assign(nv, 1);
+  scores.flatness.assign(nv, 1);
+  scores.score.assign(nv, std::numeric_limits<REAL>::quiet_NaN());
+
+  // Sparseness as coarsening criteria
+  if (denseWeight > 0) {
+    double avgLen = 0;
+    for (const auto &edge : mesh.edges) {
+      avgLen += length(X[edge[0]] - X[edge[1]]);
+    }
+    scores.avgLen = avgLen / static_cast<double>(mesh.nEdges());
+
+    parallel::for_each_chunk(
+        0, nv, nthreads, [&](std::size_t, std::size_t begin, std::size_t end) {
+          for (std::size_t i = begin; i < end; ++i) {
+            double maxLen = 0;
+            for (auto k = adj.offsets[i]; k < adj.offsets[i + 1]; ++k) {
+              maxLen = std::max<double>(maxLen, length(X[adj.nbors[k]] - X[i]));
+            }
+            scores.sparseness[i] =
+                std::pow(maxLen / scores.avgLen, denseWeight);
+          }
+        });
+  }
+
+  // Curvature as coarsening criteria
+  if (flatRate > 0) {
+    using Traits = EigenDiagonalizeTraits<REAL, 3>;
+    const std::vector<Vector> normals = vertexNormals(mesh);
+    std::vector<Traits::CovarianceMatrix> lst(nv);
+
+    parallel::for_each_chunk(
+        0, nv, nthreads, [&](std::size_t, std::size_t begin, std::size_t end) {
+          // visited[j] == i once vertex j is gathered for vertex i
+          std::vector<std::size_t> visited(nv, nv);
+          std::vector<int> ring, next;
+          for (std::size_t i = begin; i < end; ++i) {
+            Traits::CovarianceMatrix cov = {{0, 0, 0, 0, 0, 0}};
+            auto add = [&](int j) {
+              Vector norm = normals[j];
+              auto mag = std::sqrt(norm | norm);
+              if (mag <= 0)
+                return;
+              norm /= mag;
+              cov[0] += norm[0] * norm[0];
+              cov[1] += norm[0] * norm[1];
+              cov[2] += norm[0] * norm[2];
+              cov[3] += norm[1] * norm[1];
+              cov[4] += norm[1] * norm[2];
+              cov[5] += norm[2] * norm[2];
+            };
+
+            visited[i] = i;
+            add(i);
+            ring.assign(1, static_cast<int>(i));
+            for (std::size_t r = 0; r < rings && !ring.empty(); ++r) {
+              next.clear();
+              for (auto v : ring) {
+                for (auto k = adj.offsets[v]; k < adj.offsets[v + 1]; ++k) {
+                  const int nbor = adj.nbors[k];
+                  if (visited[nbor] != i) {
+                    visited[nbor] = i;
+                    add(nbor);
+                    next.push_back(nbor);
+                  }
+                }
+              }
+              ring.swap(next);
+            }
+            lst[i] = cov;
+          }
+        });
+
+    std::vector<EigenVector> eigenvalues(nv);
+    std::vector<EigenMatrix> eigenvectors(nv);
+    Traits::diagonalizeSelfAdjointCovMatrices(
+        lst.data(), nv, eigenvalues.data(), eigenvectors.data(), nthreads);
+
+    // The closer this ratio is to 0 the flatter the local region.
+    for (std::size_t i = 0; i < nv; ++i) {
+      scores.flatness[i] =
+          std::pow(eigenvalues[i][1] / eigenvalues[i][2], flatRate);
+    }
+  }
+
+  for (std::size_t i = 0; i < nv; ++i) {
+    if (mesh.vertexSelected[i]) {
+      scores.score[i] = scores.sparseness[i] * scores.flatness[i];
+    }
+  }
+  return scores;
+}
+
+namespace {
+/// Per vertex sums of the MDSB face terms
+struct MDSBAccumulator {
+  std::vector<REAL> Amix;
+  std::vector<REAL> angles;
+  std::vector<Vector> Kh;
+  std::vector<Vector> normals;
+
+  explicit MDSBAccumulator(std::size_t nv)
+      : Amix(nv, 0), angles(nv, 0), Kh(nv), normals(nv) {}
+};
+
+/// Accumulate the MDSB terms of the given faces into the vertices in
+/// [vbegin, vend). Terms of other vertices are dropped.
+void accumulateMDSB(const FlatSurfaceMesh &mesh,
+                    const std::vector<std::size_t> &faces, std::size_t vbegin,
+                    std::size_t vend, MDSBAccumulator &acc) {
+  const auto &X = mesh.positions;
+  auto owned = [vbegin, vend](std::size_t v) {
+    return v >= vbegin && v < vend;
+  };
+  for (auto fi : faces) {
+    const auto &indices = mesh.faces[fi];
+
+    // Vertex normals are the sum of the incident face normals
+    auto f = mesh.orientedFace(fi);
+    Vector norm = cross(X[f[2]] - X[f[1]], X[f[0]] - X[f[1]]);
+    for (auto v : f) {
+      if (owned(v))
+        acc.normals[v] += norm;
+    }
+
+    std::array<Vector, 3> vertices = {X[indices[0]], X[indices[1]],
+                                      X[indices[2]]};
+
+    // TODO: (15) This section computes the same distances a bunch of time
+    std::array<REAL, 3> dist;
+    dist[0] = length(vertices[0] - vertices[1]);
+    dist[1] = length(vertices[1] - vertices[2]);
+    dist[2] = length(vertices[0] - vertices[2]);
+    std::sort(dist.begin(), dist.end());
+
+    // Check if the triangle is obtuse...
+    bool obtuse = dist[0] * dist[0] + dist[1] * dist[1] < dist[2] * dist[2];
+
+    REAL t_area = 0; // Area of the face
+    // Populate t_area if obtuse
+    if (obtuse) {
+      auto wedge = (vertices[1] - vertices[0]) ^ (vertices[1] - vertices[2]);
+      t_area = std::sqrt(wedge | wedge) / 2;
+    }
+
+    // List of indices to rotate
+    std::array<std::size_t, 3> idxmap = {0, 1, 2};
+    for (std::size_t i = 0; i < 3; ++i) {
+      // idxmap[0] is the current vertex
+      REAL ang = angle(vertices[idxmap[2]] - vertices[idxmap[0]],
+                       vertices[idxmap[1]] - vertices[idxmap[0]]);
+
+      std::size_t i0 = indices[idxmap[0]];
+      std::size_t i1 = indices[idxmap[1]];
+      std::size_t i2 = indices[idxmap[2]];
+
+      // Add angle to Gaussian Curvature
+      if (owned(i0))
+        acc.angles[i0] += ang;
+
+      // Vectors of other edges
+      Vector v1 = vertices[idxmap[1]] - vertices[idxmap[2]];
+      Vector v2 = vertices[idxmap[2]] - vertices[idxmap[1]];
+
+      REAL cot = 1.0 / tan(ang);
+
+      if (obtuse) {
+        if (owned(i0))
+          acc.Amix[i0] += (ang > M_PI / 2.0) ? t_area / 2.0 : t_area / 4.0;
+      } else {
+        REAL tmp = cot / 8.0;
+        REAL lenSq = length(v1);
+        lenSq *= lenSq;
+        if (owned(i1))
+          acc.Amix[i1] += tmp * lenSq;
+        if (owned(i2))
+          acc.Amix[i2] += tmp * lenSq;
+      }
+
+      // Add value to Mean Curvature
+      if (owned(i1))
+        acc.Kh[i1] += cot * v1;
+      if (owned(i2))
+        acc.Kh[i2] += cot * v2;
+
+      std::rotate(idxmap.begin(), idxmap.begin() + 1, idxmap.end());
+    }
+  }
+}
+} // namespace
+
+Curvatures curvaturesViaMDSB(const FlatSurfaceMesh &mesh,
+                             std::size_t nthreads) {
+  const std::size_t nv = mesh.nVertices();
+  const std::size_t nf = mesh.nFaces();
+  for (std::size_t i = 0; i < nf; ++i) {
+    if (mesh.faceOrientations[i] == 0) {
+      gamer_runtime_error("Orientation undefined, cannot compute normal. Did "
+                          "you call compute_orientation()?");
+    }
+  }
+
+  // Faces incident to each vertex, in ascending order
+  std::vector<std::size_t> offsets(nv + 1, 0);
+  for (const auto &face : mesh.faces) {
+    for (auto v : face)
+      ++offsets[v + 1];
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<std::size_t> incident(offsets[nv]);
+  std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+  for (std::size_t i = 0; i < nf; ++i) {
+    for (auto v : mesh.faces[i])
+      incident[fill[v]++] = i;
+  }
+
+  // Each thread owns a range of vertices and visits the faces around them in
+  // ascending order, so every vertex sums its terms in the serial order.
+  MDSBAccumulator acc(nv);
+  parallel::for_each_chunk(
+      0, nv, nthreads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::vector<std::size_t> faces(incident.begin() + offsets[begin],
+                                       incident.begin() + offsets[end]);
+        std::sort(faces.begin(), faces.end());
+        faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+        accumulateMDSB(mesh, faces, begin, end, acc);
+      });
+
+  Curvatures result;
+  result.kh.resize(nv);
+  result.kg.resize(nv);
+  result.k1.resize(nv);
+  result.k2.resize(nv);
+  parallel::for_each_chunk(
+      0, nv, nthreads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const REAL Amix = acc.Amix[i];
+          const REAL angles = acc.angles[i];
+          const Vector &normal = acc.normals[i];
+          Vector Kh = acc.Kh[i] / (2.0 * Amix);
+          REAL kh = std::copysign(length(Kh) / 2.0, -dot(Kh, normal));
+          REAL kg = (2.0 * M_PI - angles) / Amix;
+
+          REAL kh2 = kh * kh;
+          REAL tmp = kh2 < kg ? 0 : std::sqrt(kh2 - kg);
+
+          result.kh[i] = kh;
+          result.kg[i] = kg;
+          result.k1[i] = kh + tmp;
+          result.k2[i] = kh - tmp;
+        }
+      });
+  return result;
+}
+
+std::tuple<
+    REAL *, REAL *, REAL *, REAL *,
+    std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType>>
+curvatureViaMDSB(const FlatSurfaceMesh &mesh) {
+  const std::size_t nv = mesh.nVertices();
+  std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType> sigma;
+  for (std::size_t i = 0; i < nv; ++i) {
+    sigma.emplace_hint(sigma.end(), mesh.vertexKeys[i], i);
+  }
+
+  Curvatures curvatures = curvaturesViaMDSB(mesh);
+  auto copy = [](const std::vector<REAL> &values) {
+    REAL *out = new REAL[values.size()];
+    std::copy(values.begin(), values.end(), out);
+    return out;
+  };
+  return std::make_tuple(copy(curvatures.kh), copy(curvatures.kg),
+                         copy(curvatures.k1), copy(curvatures.k2), sigma);
+}
+} // end namespace gamer
@@ -0,0 +1,243 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+
+#include <casc/casc>
+
+#include "gamer/KRingCache.h"
+#include "gamer/SurfaceMesh.h"
+#include "gamer/parallel.h"
+
+/// Namespace for all things gamer
+namespace gamer {
+
+KRingCache::KRingCache(const SurfaceMesh &mesh, std::size_t rings,
+                       std::size_t nthreads) {
+  rebuild(mesh, rings, nthreads);
+}
+
+void KRingCache::rebuild(const SurfaceMesh &mesh, std::size_t rings,
+                         std::size_t nthreads) {
+  _rings = rings;
+  _vertices.clear();
+  _index.clear();
+  for (auto vertexID : mesh.get_level_id<1>()) {
+    _index[mesh.get_name(vertexID)[0]] = _vertices.size();
+    _vertices.push_back(vertexID);
+  }
+  const std::size_t n = _vertices.size();
+  _begin.assign(n, 0);
+  _end.assign(n, 0);
+  _dirty.assign(n, 0);
+  _erased.assign(n, 0);
+  _queued.assign(n, 0);
+  _dirtyList.clear();
+  _nbors.clear();
+
+  // Gather each chunk into its own buffer then concatenate in order so that
+  // the layout does not depend on the number of threads.
+  const std::size_t nt = parallel::numThreads(nthreads, n);
+  std::vector<std::vector<std::uint32_t>> buffers(nt);
+  std::vector<std::size_t> chunkBegin(nt);
+  parallel::for_each_chunk(
+      0, n, nt, [&](std::size_t tid, std::size_t begin, std::size_t end) {
+        chunkBegin[tid] = begin;
+        for (std::size_t i = begin; i < end; ++i) {
+          _begin[i] = buffers[tid].size();
+          gather(mesh, i, buffers[tid]);
+          _end[i] = buffers[tid].size();
+        }
+      });
+
+  for (std::size_t tid = 0; tid < nt; ++tid) {
+    const std::size_t offset = _nbors.size();
+    const std::size_t end = (tid + 1 < nt) ? chunkBegin[tid + 1] : n;
+    for (std::size_t i = chunkBegin[tid]; i < end; ++i) {
+      _begin[i] += offset;
+      _end[i] += offset;
+    }
+    _nbors.insert(_nbors.end(), buffers[tid].begin(), buffers[tid].end());
+    std::vector<std::uint32_t>().swap(buffers[tid]);
+  }
+  _used = _nbors.size();
+}
+
+std::uint32_t KRingCache::index(const SurfaceMesh &mesh,
+                                SurfaceMesh::SimplexID<1> vertexID) const {
+  auto it = _index.find(mesh.get_name(vertexID)[0]);
+  if (it == _index.end()) {
+    gamer_runtime_error("Vertex is not in the KRingCache. The cache must be "
+                        "rebuilt after adding vertices.");
+  }
+  return it->second;
+}
+
+void KRingCache::gather(const SurfaceMesh &mesh, std::uint32_t i,
+                        std::vector<std::uint32_t> &out) const {
+  std::set<SurfaceMesh::SimplexID<1>> nbors;
+  casc::kneighbors_up(mesh, _vertices[i], _rings, nbors);
+  // Preserve the iteration order of the set so that LST sums are unchanged
+  for (auto nid : nbors) {
+    out.push_back(index(mesh, nid));
+  }
+}
+
+void KRingCache::invalidate(const SurfaceMesh &mesh,
+                            SurfaceMesh::SimplexID<1> vertexID) {
+  // A neighborhood affected by a change in the one ring of vertexID contains
+  // a vertex of that one ring, so its center lies within rings+1 of vertexID.
+  std::set<SurfaceMesh::SimplexID<1>> nbors;
+  casc::kneighbors_up(mesh, vertexID, _rings + 1, nbors);
+  for (auto nid : nbors) {
+    auto i = index(mesh, nid);
+    if (!_dirty[i] && !_erased[i]) {
+      _dirty[i] = 1;
+      _used -= _end[i] - _begin[i];
+      if (!_queued[i]) {
+        _queued[i] = 1;
+        _dirtyList.push_back(i);
+      }
+    }
+  }
+}
+
+void KRingCache::erase(const SurfaceMesh &mesh,
+                       SurfaceMesh::SimplexID<1> vertexID) {
+  auto it = _index.find(mesh.get_name(vertexID)[0]);
+  if (it == _index.end())
+    return;
+  auto i = it->second;
+  _index.erase(it);
+  if (!_dirty[i])
+    _used -= _end[i] - _begin[i];
+  _erased[i] = 1;
+  _dirty[i] = 0;
+  _begin[i] = _end[i] = 0;
+}
+
+void KRingCache::update(const SurfaceMesh &mesh, std::size_t nthreads) {
+  // Drop entries which were refreshed or erased since being queued
+  _dirtyList.erase(std::remove_if(_dirtyList.begin(), _dirtyList.end(),
+                                  [&](std::uint32_t i) {
+                                    _queued[i] = 0;
+                                    return !_dirty[i];
+                                  }),
+                   _dirtyList.end());
+  const std::size_t n = _dirtyList.size();
+  if (n == 0)
+    return;
+
+  const std::size_t nt = parallel::numThreads(nthreads, n);
+  std::vector<std::vector<std::uint32_t>> buffers(nt);
+  std::vector<std::size_t> offsets(n);
+  std::vector<std::size_t> chunkBegin(nt);
+  parallel::for_each_chunk(
+      0, n, nt, [&](std::size_t tid, std::size_t begin, std::size_t end) {
+        chunkBegin[tid] = begin;
+        for (std::size_t k = begin; k < end; ++k) {
+          offsets[k] = buffers[tid].size();
+          gather(mesh, _dirtyList[k], buffers[tid]);
+        }
+      });
+
+  // Append the refreshed neighborhoods in dirty list order
+  for (std::size_t tid = 0; tid < nt; ++tid) {
+    const std::size_t base = _nbors.size();
+    const std::size_t end = (tid + 1 < nt) ? chunkBegin[tid + 1] : n;
+    for (std::size_t k = chunkBegin[tid]; k < end; ++k) {
+      auto i = _dirtyList[k];
+      _begin[i] = base + offsets[k];
+      _end[i] = base + ((k + 1 < end) ? offsets[k + 1] : buffers[tid].size());
+      _dirty[i] = 0;
+    }
+    _used += buffers[tid].size();
+    _nbors.insert(_nbors.end(), buffers[tid].begin(), buffers[tid].end());
+  }
+  _dirtyList.clear();
+
+  if (_used * 2 < _nbors.size())
+    compact();
+}
+
+void KRingCache::update(const SurfaceMesh &mesh, std::uint32_t i) {
+  if (!_dirty[i])
+    return;
+  _begin[i] = _nbors.size();
+  gather(mesh, i, _nbors);
+  _end[i] = _nbors.size();
+  _used += _end[i] - _begin[i];
+  _dirty[i] = 0;
+  // The queued entry in _dirtyList is skipped by the next bulk update.
+  if (_used * 2 < _nbors.size())
+    compact();
+}
+
+void KRingCache::compact() {
+  std::vector<std::uint32_t> packed;
+  packed.reserve(_used);
+  for (std::size_t i = 0; i < _vertices.size(); ++i) {
+    if (_erased[i] || _dirty[i]) {
+      _begin[i] = _end[i] = packed.size();
+      continue;
+    }
+    auto begin = packed.size();
+    packed.insert(packed.end(), _nbors.begin() + _begin[i],
+                  _nbors.begin() + _end[i]);
+    _begin[i] = begin;
+    _end[i] = packed.size();
+  }
+  _nbors.swap(packed);
+  _used = _nbors.size();
+}
+
+namespace surfacemesh_detail {
+tensor<double, 3, 2> computeLocalStructureTensor(const SurfaceMesh &mesh,
+                                                 const KRingCache &cache,
+                                                 std::uint32_t i) {
+  // local structure tensor
+  tensor<double, 3, 2> lst = tensor<double, 3, 2>();
+  for (auto j : cache.neighbors(i)) {
+    auto norm = getNormal(mesh, cache.vertex(j)); // Get Vector normal
+    auto mag = std::sqrt(norm | norm);
+    if (mag <= 0) {
+      continue;
+    }
+    norm /= mag;        // normalize
+    lst += norm * norm; // tensor product
+  }
+  return lst;
+}
+
+tensor<double, 3, 2> computeLSTFromCache(const SurfaceMesh &mesh,
+                                         const KRingCache &cache,
+                                         std::uint32_t i) {
+  // local structure tensor
+  tensor<double, 3, 2> lst = tensor<double, 3, 2>();
+  for (auto j : cache.neighbors(i)) {
+    auto norm = (*cache.vertex(j)).normal; // Get Vector normal
+    lst += norm * norm;                    // tensor product
+  }
+  return lst;
+}
+} // end namespace surfacemesh_detail
+} // end namespace gamer
@@ -24,6 +24,7 @@
 #include <memory>
 #include <ostream>
 #include <regex>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -50,9 +51,8 @@ int get_marker(float r, float g, float b) {
 
 // http://www.geomview.org/docs/html/OFF.html
 std::unique_ptr<SurfaceMesh> readOFF(const std::string &filename) {
-  // Instantiate mesh!
-  // auto mesh = new SurfaceMesh();
-  std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
+  // The mesh is built in one go once the whole file has been parsed
+  std::unique_ptr<SurfaceMesh> mesh;
 
   std::ifstream fin(filename);
   if (!fin.is_open()) {
@@ -156,6 +156,13 @@ std::unique_ptr<SurfaceMesh> readOFF(const std::string &filename) {
 
   // NOTE:: Assume there are no more comments...
 
+  std::vector<REAL> vertices;
+  std::vector<int> faces;
+  std::vector<int> markers;
+  vertices.reserve(3 * numVertices);
+  faces.reserve(3 * numFaces);
+  markers.reserve(numFaces);
+
   // Parse the vertices
   /*
      x[0]  y[0]  z[0]
@@ -182,7 +189,9 @@ std::unique_ptr<SurfaceMesh> readOFF(const std::string &filename) {
     double x = std::stod(arr[0]);
     double y = std::stod(arr[1]);
     double z = std::stod(arr[2]);
-    mesh->insert<1>({i}, SMVertex(x, y, z));
+    vertices.push_back(x);
+    vertices.push_back(y);
+    vertices.push_back(z);
   }
 
   // Parse Faces
@@ -207,7 +216,8 @@ std::unique_ptr<SurfaceMesh> readOFF(const std::string &filename) {
       auto v0 = std::stoi(arr[1]);
       auto v1 = std::stoi(arr[2]);
       auto v2 = std::stoi(arr[3]);
-      mesh->insert<3>({v0, v1, v2});
+      faces.insert(faces.end(), {v0, v1, v2});
+      markers.push_back(-1);
     } else if (arr.size() == dimension + 5) {
       auto v0 = std::stoi(arr[1]);
       auto v1 = std::stoi(arr[2]);
@@ -217,7 +227,8 @@ std::unique_ptr<SurfaceMesh> readOFF(const std::string &filename) {
       auto g = std::stod(arr[5]);
       auto b = std::stod(arr[6]);
       // auto k = std::stod(arr[7]);
-      mesh->insert<3>({v0, v1, v2}, SMFace(get_marker(r, g, b), false));
+      faces.insert(faces.end(), {v0, v1, v2});
+      markers.push_back(get_marker(r, g, b));
     } else {
       std::cerr << "Parse Error: Couldn't interpret face: '" << line << "'."
                 << std::endl;
@@ -226,7 +237,14 @@ std::unique_ptr<SurfaceMesh> readOFF(const std::string &filename) {
     }
   }
   fin.close();
-  compute_orientation(*mesh);
+
+  try {
+    mesh = buildSurfaceMesh(vertices.data(), numVertices, faces.data(),
+                            numFaces, markers.data());
+  } catch (std::runtime_error &e) {
+    std::cerr << "Parse Error: " << e.what() << std::endl;
+    mesh.reset();
+  }
   return mesh;
 }
 
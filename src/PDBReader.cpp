@@ -17,14 +17,24 @@
 // or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
 // Boston, MA 02111-1307 USA
 
+#include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <regex>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "gamer/MarchingCube.h"
@@ -32,130 +42,1091 @@
 #include "gamer/SurfaceMesh.h"
 #include "gamer/Vertex.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GAMER_HAVE_MMAP
+#endif
+
 /// Namespace for all things gamer
 namespace gamer {
 
-std::unique_ptr<SurfaceMesh> readPDB_distgrid(const std::string &filename,
-                                              const float radius) {
-  std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
+/// @cond detail
+namespace pdbreader_detail {
+namespace {
+/**
+ * @brief      Read-only view of the contents of a file. The file is memory
+ *             mapped where supported and read into a buffer otherwise.
+ */
+class FileView {
+public:
+  explicit FileView(const std::string &filename) {
+#ifdef GAMER_HAVE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+      _size = st.st_size;
+      if (_size == 0) {
+        _ok = true;
+      } else {
+        void *addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+          ::madvise(addr, _size, MADV_SEQUENTIAL);
+          _map = addr;
+          _data = static_cast<const char *>(addr);
+          _ok = true;
+        }
+      }
+    }
+    ::close(fd);
+#else
+    std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+    if (!fin.is_open())
+      return;
+    _buffer.resize(static_cast<std::size_t>(fin.tellg()));
+    fin.seekg(0);
+    fin.read(_buffer.data(), _buffer.size());
+    _data = _buffer.data();
+    _size = _buffer.size();
+    _ok = true;
+#endif
+  }
 
-  std::vector<Atom> atoms;
-  // If readPDB errors return nullptr
-  if (!readPDB(filename, std::back_inserter(atoms))) {
-    mesh.reset();
-    return mesh;
+  ~FileView() {
+#ifdef GAMER_HAVE_MMAP
+    if (_map)
+      ::munmap(_map, _size);
+#endif
   }
-  std::cout << "Atoms: " << atoms.size() << std::endl;
-  Vector3f min, max;
-  getMinMax(atoms.cbegin(), atoms.cend(), min, max,
-            [&radius](const float atomRadius) -> float {
-              return DIM_SCALE * (atomRadius + radius);
-            });
 
-  float min_dimension = std::min(
-      (max[0] - min[0]), std::min((max[1] - min[1]), (max[2] - min[2])));
-  std::cout << "Min Dimension: " << min_dimension << std::endl;
+  FileView(const FileView &) = delete;
+  FileView &operator=(const FileView &) = delete;
 
-  Vector3i dim;
-  Vector3f maxMin = max - min;
+  bool is_open() const { return _ok; }
+  const char *begin() const { return _data; }
+  const char *end() const { return _data + _size; }
 
-  dim = static_cast<Vector3i>((maxMin) + Vector3f({1, 1, 1})) * DIM_SCALE;
+private:
+  bool _ok = false;
+  const char *_data = nullptr;
+  std::size_t _size = 0;
+#ifdef GAMER_HAVE_MMAP
+  void *_map = nullptr;
+#else
+  std::vector<char> _buffer;
+#endif
+};
 
-  std::cout << "Dimension: " << dim << std::endl;
-  std::cout << "Min:" << min << std::endl;
-  std::cout << "Max:" << max << std::endl;
+/// Fixed width field of a line, truncated at the end of the line
+struct Field {
+  const char *data;
+  std::size_t size;
 
-  Vector3f span = (maxMin).ElementwiseDivision(static_cast<Vector3f>(dim) -
-                                               Vector3f({1, 1, 1}));
-  std::cout << "Delta: " << span << std::endl;
+  std::string str() const { return std::string(data, size); }
+};
 
-  // Move dataset to positive octant and scale
-  for (auto &atom : atoms) {
-    atom.pos = (atom.pos - min).ElementwiseDivision(span);
-    atom.radius =
-        (atom.radius + radius) / ((span[0] + span[1] + span[2]) / 3.0);
-  }
+inline Field field(const char *line, std::size_t len, std::size_t col,
+                   std::size_t width) {
+  if (col >= len)
+    return Field{line + len, 0};
+  return Field{line + col, std::min(width, len - col)};
+}
 
-  float *dataset = new float[dim[0] * dim[1] * dim[2]];
-  for (int i = 0; i < dim[0] * dim[1] * dim[2]; ++i) {
-    dataset[i] = -5.0f;
+/// Parse a field the same way std::atof would
+inline double toReal(Field f) {
+  char buf[32];
+  std::size_t n = std::min(f.size, sizeof(buf) - 1);
+  std::copy_n(f.data, n, buf);
+  buf[n] = '\0';
+  return std::strtod(buf, nullptr);
+}
+
+/// Pack a field of up to 4 characters into an integer
+inline std::uint32_t pack(Field f) {
+  std::uint32_t key = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    key <<= 8;
+    if (i < f.size)
+      key |= static_cast<unsigned char>(f.data[i]);
   }
-  gridSAS(atoms.cbegin(), atoms.cend(), dim, dataset);
+  return key;
+}
 
-  std::vector<Vertex> holelist;
-  std::unique_ptr<SurfaceMesh> SASmesh = std::move(marchingCubes(
-      dataset, 5.0f, dim, span, 0.0f, std::back_inserter(holelist)));
+inline std::uint64_t radiusKey(std::uint32_t residue, std::uint32_t atom) {
+  return (static_cast<std::uint64_t>(residue) << 32) | atom;
+}
+
+struct RadiusEntry {
+  std::uint64_t key;
+  float radius;
+
+  bool operator<(const RadiusEntry &rhs) const { return key < rhs.key; }
+};
+
+/// Field without its leading and trailing spaces
+inline Field trim(Field f) {
+  while (f.size > 0 && f.data[0] == ' ') {
+    ++f.data;
+    --f.size;
+  }
+  while (f.size > 0 && f.data[f.size - 1] == ' ')
+    --f.size;
+  return f;
+}
 
-  for (auto curr = atoms.cbegin(); curr != atoms.cend(); ++curr) {
-    Vector3f pos = curr->pos;
-    // compute the dataset coordinates of the atom's center
-    Vector3i c;
-    std::transform(pos.begin(), pos.end(), c.begin(),
-                   [](float v) -> int { return round(v); });
+/**
+ * @brief      PDBelementTable sorted by residue and atom name. Later duplicates
+ *             win.
+ *
+ * @param[in]  trimmed  Key atoms by their name without the PDB column
+ *                      padding, as they are written in mmCIF
+ */
+std::vector<RadiusEntry> sortedRadiusTable(bool trimmed) {
+  std::vector<RadiusEntry> entries;
+  for (std::size_t i = 0; i < MAX_BIOCHEM_ELEMENTS; ++i) {
+    const auto &elem = PDBelementTable[i];
+    Field residue{elem.residueName, std::strlen(elem.residueName)};
+    Field atom{elem.atomName, std::strlen(elem.atomName)};
+    if (trimmed)
+      atom = trim(atom);
+    entries.push_back({radiusKey(pack(residue), pack(atom)), elem.radius});
+  }
+  std::stable_sort(entries.begin(), entries.end());
+  std::vector<RadiusEntry> unique;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    if (i + 1 < entries.size() && entries[i + 1].key == entries[i].key)
+      continue;
+    unique.push_back(entries[i]);
   }
+  return unique;
+}
 
-  // Reset dataset
-  for (int i = 0; i < dim[0] * dim[1] * dim[2]; ++i) {
-    dataset[i] = -5.0f;
+/// Radius table keyed by PDB atom names
+const std::vector<RadiusEntry> &radiusTable() {
+  static const std::vector<RadiusEntry> table = sortedRadiusTable(false);
+  return table;
+}
+
+/// Radius table keyed by mmCIF atom names
+const std::vector<RadiusEntry> &cifRadiusTable() {
+  static const std::vector<RadiusEntry> table = sortedRadiusTable(true);
+  return table;
+}
+
+/**
+ * @brief      Radius lookup by residue and atom name which counts the names
+ *             that are not found
+ */
+class RadiusLookup {
+public:
+  explicit RadiusLookup(const std::vector<RadiusEntry> &table)
+      : _table(table) {}
+
+  /// Radius of an atom, 1 if it is not in the table
+  float operator()(Field residueName, Field atomName) {
+    std::uint32_t residue = pack(residueName);
+    RadiusEntry query{radiusKey(residue, pack(atomName)), 0};
+    auto it = std::lower_bound(_table.begin(), _table.end(), query);
+    if (it != _table.end() && it->key == query.key)
+      return it->radius;
+
+    // Entries of a residue are contiguous so a known residue has an entry on
+    // either side of the insertion point.
+    bool knownResidue =
+        (it != _table.end() && (it->key >> 32) == residue) ||
+        (it != _table.begin() && (std::prev(it)->key >> 32) == residue);
+    if (knownResidue)
+      ++_unknownAtoms[std::make_pair(residueName.str(), atomName.str())];
+    else
+      ++_unknownResidues[residueName.str()];
+    return 1.0f; // default radius
   }
 
-  auto SASverts = SASmesh->get_level<1>();
-  gridSES(SASverts.begin(), SASverts.end(), dim, dataset, radius);
-  // for(int i = 0; i < dim[0]*dim[1]*dim[2]; ++i){
-  //     std::cout << dataset[i] << std::endl;
-  // }
+  /// Report the unknown names once each with a count
+  void report() const {
+    for (const auto &entry : _unknownAtoms) {
+      std::cout << "Could not find atomtype of '" << entry.first.second
+                << "' in residue '" << entry.first.first << "' for "
+                << entry.second << " atoms. "
+                << "Using default radius." << std::endl;
+    }
+    for (const auto &entry : _unknownResidues) {
+      std::cout << "Could not find ResidueName '" << entry.first
+                << "' in table for " << entry.second << " atoms. "
+                << "Using default radius." << std::endl;
+    }
+  }
 
-  mesh = std::move(marchingCubes(dataset, 5.0f, dim, span, 0.0f,
-                                 std::back_inserter(holelist)));
-  delete[] dataset;
+private:
+  const std::vector<RadiusEntry> &_table;
+  std::map<std::pair<std::string, std::string>, std::size_t> _unknownAtoms;
+  std::map<std::string, std::size_t> _unknownResidues;
+};
 
-  // Translate back to the original position from the positive octant
-  for (auto &v : mesh->get_level<1>()) {
-    v += min;
+/// Whether a field equals a string, ignoring ASCII case
+inline bool iequals(Field f, const char *str) {
+  std::size_t n = std::strlen(str);
+  if (f.size != n)
+    return false;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (std::tolower(static_cast<unsigned char>(f.data[i])) !=
+        std::tolower(static_cast<unsigned char>(str[i])))
+      return false;
   }
-  return mesh;
+  return true;
+}
+
+/// Whether a field starts with a string, ignoring ASCII case
+inline bool istartsWith(Field f, const char *str) {
+  std::size_t n = std::strlen(str);
+  return f.size >= n && iequals(Field{f.data, n}, str);
 }
 
 /**
- * @brief      Reads a pdb gauss.
- *
- * @param[in]  filename    The filename
- * @param[in]  blobbyness  The blobbyness
- * @param[in]  isovalue    The isovalue
+ * @brief      Token of a CIF file
+ */
+struct CIFToken {
+  Field text;
+  /// Quoted strings and text fields are never keywords, tags, or null
+  bool quoted;
+
+  /// Whether the token is a data name such as _atom_site.Cartn_x
+  bool tag() const { return !quoted && text.size > 0 && text.data[0] == '_'; }
+
+  /// Whether the token is a reserved word which ends a loop
+  bool keyword() const {
+    return !quoted && (iequals(text, "loop_") || iequals(text, "stop_") ||
+                       iequals(text, "global_") ||
+                       istartsWith(text, "data_") || istartsWith(text, "save_"));
+  }
+
+  /// Whether the token is the inapplicable '.' or unknown '?' value
+  bool null() const {
+    return !quoted && text.size == 1 && (text.data[0] == '.' || text.data[0] == '?');
+  }
+};
+
+/**
+ * @brief      Splits a CIF buffer into tokens without copying
  *
- * @return     { description_of_the_return_value }
+ * Handles comments, quoted strings which end at a matching quote followed by
+ * whitespace, and text fields delimited by semicolons at the start of a line.
  */
-std::unique_ptr<SurfaceMesh> readPDB_gauss(const std::string &filename,
-                                           const float blobbyness,
-                                           float isovalue) {
-  std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
+class CIFTokenizer {
+public:
+  CIFTokenizer(const char *begin, const char *end) : _curr(begin), _end(end) {}
 
+  /// Read the next token. Returns false at the end of the buffer.
+  bool next(CIFToken &token) {
+    if (_peeked) {
+      _peeked = false;
+      token = _peek;
+      return true;
+    }
+    return read(token);
+  }
+
+  /// Look at the next token without consuming it
+  bool peek(CIFToken &token) {
+    if (!_peeked) {
+      if (!read(_peek))
+        return false;
+      _peeked = true;
+    }
+    token = _peek;
+    return true;
+  }
+
+private:
+  static bool space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  bool read(CIFToken &token) {
+    while (_curr < _end) {
+      const char c = *_curr;
+      if (c == '\n') {
+        _lineStart = true;
+        ++_curr;
+      } else if (space(c)) {
+        _lineStart = false;
+        ++_curr;
+      } else if (c == '#') {
+        const char *eol =
+            static_cast<const char *>(std::memchr(_curr, '\n', _end - _curr));
+        _curr = eol ? eol : _end;
+      } else {
+        break;
+      }
+    }
+    if (_curr >= _end)
+      return false;
+
+    const char c = *_curr;
+    if (c == ';' && _lineStart) {
+      // Text field up to the next line starting with a semicolon
+      const char *begin = _curr + 1;
+      const char *p = begin;
+      while (true) {
+        p = static_cast<const char *>(std::memchr(p, '\n', _end - p));
+        if (!p || p + 1 >= _end || p[1] == ';')
+          break;
+        ++p;
+      }
+      const char *last = p ? p : _end;
+      token = CIFToken{Field{begin, static_cast<std::size_t>(last - begin)},
+                       true};
+      _curr = p ? p + 2 : _end;
+    } else if (c == '\'' || c == '"') {
+      // A quote only closes the string if whitespace follows
+      const char *begin = _curr + 1;
+      const char *p = begin;
+      while (p < _end && *p != '\n' &&
+             !(*p == c && (p + 1 == _end || space(p[1]))))
+        ++p;
+      token = CIFToken{Field{begin, static_cast<std::size_t>(p - begin)},
+                       true};
+      _curr = (p < _end && *p == c) ? p + 1 : p;
+    } else {
+      const char *begin = _curr;
+      while (_curr < _end && !space(*_curr))
+        ++_curr;
+      token = CIFToken{
+          Field{begin, static_cast<std::size_t>(_curr - begin)}, false};
+    }
+    _lineStart = false;
+    return true;
+  }
+
+  const char *_curr;
+  const char *_end;
+  bool _lineStart = true;
+  bool _peeked = false;
+  CIFToken _peek;
+};
+
+/// Columns of _atom_site used to build atoms
+enum AtomSiteColumn {
+  GROUP,
+  X,
+  Y,
+  Z,
+  RESIDUE,
+  ATOM_NAME,
+  AUTH_RESIDUE,
+  AUTH_ATOM_NAME,
+  MODEL,
+  N_ATOM_SITE_COLUMNS
+};
+
+/// Column of an _atom_site tag or N_ATOM_SITE_COLUMNS if it is not used
+AtomSiteColumn atomSiteColumn(Field tag) {
+  static const char *const names[N_ATOM_SITE_COLUMNS] = {
+      "_atom_site.group_PDB",      "_atom_site.Cartn_x",
+      "_atom_site.Cartn_y",        "_atom_site.Cartn_z",
+      "_atom_site.label_comp_id",  "_atom_site.label_atom_id",
+      "_atom_site.auth_comp_id",   "_atom_site.auth_atom_id",
+      "_atom_site.pdbx_PDB_model_num"};
+  for (int c = 0; c < N_ATOM_SITE_COLUMNS; ++c) {
+    if (iequals(tag, names[c]))
+      return static_cast<AtomSiteColumn>(c);
+  }
+  return N_ATOM_SITE_COLUMNS;
+}
+
+/**
+ * @brief      Builds the models of a CIF file from the rows of _atom_site
+ */
+class AtomSiteReader {
+public:
+  AtomSiteReader(const std::function<bool(const std::vector<Atom> &)> &model)
+      : _model(model), _radius(cifRadiusTable()) {}
+
+  /**
+   * @brief      Add a row of _atom_site
+   *
+   * @param[in]  values  Value of each used column, or nullptr if the column
+   *                     is missing
+   *
+   * @return     False to stop reading
+   */
+  bool row(const CIFToken *const values[N_ATOM_SITE_COLUMNS]) {
+    for (int c : {X, Y, Z}) {
+      if (!values[c] || values[c]->null()) {
+        gamer_runtime_error("mmCIF _atom_site is missing Cartn_x, Cartn_y, "
+                            "or Cartn_z.");
+      }
+    }
+    // Only ATOM records, as for PDB files
+    if (values[GROUP] && !iequals(values[GROUP]->text, "ATOM"))
+      return true;
+
+    bool more = true;
+    if (values[MODEL]) {
+      Field model = values[MODEL]->text;
+      if (!_atoms.empty() && !(model.size == _lastModel.size() &&
+                               std::equal(model.data, model.data + model.size,
+                                          _lastModel.begin()))) {
+        more = flush();
+      }
+      _lastModel.assign(model.data, model.size);
+    }
+
+    auto name = [&](int label, int auth) {
+      const CIFToken *token = values[label] ? values[label] : values[auth];
+      return (token && !token->null()) ? token->text : Field{"", 0};
+    };
+    Atom atom;
+    atom.pos = Vector3f({static_cast<float>(toReal(values[X]->text)),
+                         static_cast<float>(toReal(values[Y]->text)),
+                         static_cast<float>(toReal(values[Z]->text))});
+    atom.radius = _radius(name(RESIDUE, AUTH_RESIDUE),
+                          name(ATOM_NAME, AUTH_ATOM_NAME));
+    _atoms.push_back(atom);
+    return more;
+  }
+
+  /// Emit the current model. Returns false to stop reading.
+  bool flush() {
+    if (_atoms.empty())
+      return true;
+    bool more = _model(_atoms);
+    _atoms.clear();
+    return more;
+  }
+
+  const RadiusLookup &radius() const { return _radius; }
+
+private:
+  const std::function<bool(const std::vector<Atom> &)> &_model;
+  RadiusLookup _radius;
+  std::vector<Atom> _atoms;
+  std::string _lastModel;
+};
+} // end anonymous namespace
+
+bool readModels(const std::string &filename, bool pqr,
+                const std::function<bool(const std::vector<Atom> &)> &model,
+                bool report) {
+  FileView file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Unable to open \"" << filename << "\"" << std::endl;
+    return false;
+  }
+
+  RadiusLookup radius(radiusTable());
+
+  // Atoms of the current model, reused by the next one
   std::vector<Atom> atoms;
-  // If readPDB errors return nullptr
-  if (!readPDB(filename, std::back_inserter(atoms))) {
-    mesh.reset();
-    return mesh;
+  bool more = true;
+
+  const char *curr = file.begin();
+  const char *last = file.end();
+  while (curr < last && more) {
+    const char *eol =
+        static_cast<const char *>(std::memchr(curr, '\n', last - curr));
+    if (!eol)
+      eol = last;
+    const char *line = curr;
+    std::size_t len = eol - curr;
+    curr = eol + 1;
+    if (len > 0 && line[len - 1] == '\r')
+      --len;
+
+    if (len >= 6 && std::memcmp(line, "ENDMDL", 6) == 0) {
+      more = model(atoms);
+      atoms.clear();
+      continue;
+    }
+    if (len < 4 || std::memcmp(line, "ATOM", 4) != 0)
+      continue;
+
+    Atom atom;
+    // See PDB file formatting guidelines
+    float x = toReal(field(line, len, 30, 8));
+    float y = toReal(field(line, len, 38, 8));
+    float z = toReal(field(line, len, 46, 8));
+    atom.pos = Vector3f({x, y, z});
+
+    if (pqr) {
+      atom.radius = toReal(field(line, len, 62, 7));
+    } else {
+      atom.radius =
+          radius(field(line, len, 17, 3), field(line, len, 12, 4));
+    }
+    atoms.push_back(atom);
   }
+  // Atoms after the last ENDMDL, or all atoms of a file without models
+  if (more && !atoms.empty())
+    model(atoms);
 
-  std::cout << "Atoms: " << atoms.size() << std::endl;
+  if (report)
+    radius.report();
+  return true;
+}
 
-  Vector3f min, max;
+bool readCIFModels(const std::string &filename,
+                   const std::function<bool(const std::vector<Atom> &)> &model,
+                   bool report) {
+  FileView file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Unable to open \"" << filename << "\"" << std::endl;
+    return false;
+  }
+
+  AtomSiteReader reader(model);
+  CIFTokenizer tokens(file.begin(), file.end());
+  // Values of a row, and the position of each used column within the row
+  std::vector<CIFToken> values;
+  const CIFToken *row[N_ATOM_SITE_COLUMNS];
+  std::vector<AtomSiteColumn> columns;
+  auto setRow = [&]() {
+    std::fill_n(row, static_cast<int>(N_ATOM_SITE_COLUMNS), nullptr);
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+      if (columns[i] != N_ATOM_SITE_COLUMNS)
+        row[columns[i]] = &values[i];
+    }
+  };
+
+  bool more = true;
+  CIFToken token;
+  while (more && tokens.next(token)) {
+    if (!token.quoted && iequals(token.text, "loop_")) {
+      columns.clear();
+      bool atomSite = false;
+      while (tokens.peek(token) && token.tag()) {
+        tokens.next(token);
+        atomSite = istartsWith(token.text, "_atom_site.");
+        columns.push_back(atomSiteColumn(token.text));
+      }
+      // Values of a loop continue up to the next tag or reserved word
+      values.resize(columns.size());
+      setRow();
+      std::size_t n = 0;
+      while (more && tokens.peek(token) && !token.tag() && !token.keyword()) {
+        tokens.next(token);
+        if (!atomSite || columns.empty())
+          continue;
+        values[n++] = token;
+        if (n == columns.size()) {
+          more = reader.row(row);
+          n = 0;
+        }
+      }
+    } else if (token.tag() && istartsWith(token.text, "_atom_site.")) {
+      // A single atom written as tag and value pairs
+      columns.clear();
+      values.clear();
+      while (true) {
+        columns.push_back(atomSiteColumn(token.text));
+        CIFToken value{Field{"", 0}, false};
+        if (tokens.peek(value) && !value.tag() && !value.keyword())
+          tokens.next(value);
+        values.push_back(value);
+        if (!tokens.peek(token) || !token.tag() ||
+            !istartsWith(token.text, "_atom_site."))
+          break;
+        tokens.next(token);
+      }
+      setRow();
+      more = reader.row(row);
+    }
+  }
+  if (more)
+    reader.flush();
+
+  if (report)
+    reader.radius().report();
+  return true;
+}
+
+bool readAtoms(const std::string &filename, bool pqr,
+               std::vector<Atom> &atoms) {
+  return readModels(filename, pqr, [&atoms](const std::vector<Atom> &model) {
+    atoms.insert(atoms.end(), model.begin(), model.end());
+    return true;
+  });
+}
+
+bool readCIFAtoms(const std::string &filename, std::vector<Atom> &atoms) {
+  return readCIFModels(filename, [&atoms](const std::vector<Atom> &model) {
+    atoms.insert(atoms.end(), model.begin(), model.end());
+    return true;
+  });
+}
+
+std::vector<Atom> makeAtoms(const float *xyz, const float *radii,
+                            std::size_t nAtoms) {
+  if (nAtoms == 0) {
+    gamer_runtime_error("Cannot mesh an empty set of atoms.");
+  }
+  if (xyz == nullptr || radii == nullptr) {
+    gamer_runtime_error("Atom coordinate and radius buffers must not be null.");
+  }
+  std::vector<Atom> atoms(nAtoms);
+  for (std::size_t i = 0; i < nAtoms; ++i) {
+    atoms[i].pos = Vector3f({xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]});
+    atoms[i].radius = radii[i];
+  }
+  return atoms;
+}
+
+double estimateSurfaceArea(const std::vector<Atom> &atoms) {
+  // Bins wider than the gaps between neighboring atoms so that the inside of
+  // a molecule is filled.
+  const float bin = 4;
+  if (atoms.empty())
+    return 0;
+
+  Vector3f lo = atoms[0].pos;
+  for (const auto &atom : atoms) {
+    for (std::size_t i = 0; i < 3; ++i) {
+      lo[i] = std::min(lo[i], atom.pos[i]);
+    }
+  }
+
+  // Keys leave room for a one bin border on every side
+  const std::uint64_t stride = std::uint64_t(1) << 21;
+  auto key = [&](std::uint64_t i, std::uint64_t j, std::uint64_t k) {
+    return (k * stride + j) * stride + i;
+  };
+  std::unordered_set<std::uint64_t> occupied;
+  std::vector<std::array<std::uint64_t, 3>> bins;
+  for (const auto &atom : atoms) {
+    std::array<std::uint64_t, 3> b;
+    for (std::size_t i = 0; i < 3; ++i) {
+      b[i] = std::min(static_cast<std::uint64_t>((atom.pos[i] - lo[i]) / bin),
+                      stride - 3) +
+             1;
+    }
+    if (occupied.insert(key(b[0], b[1], b[2])).second) {
+      bins.push_back(b);
+    }
+  }
+
+  std::size_t exposed = 0;
+  for (const auto &b : bins) {
+    exposed += !occupied.count(key(b[0] - 1, b[1], b[2]));
+    exposed += !occupied.count(key(b[0] + 1, b[1], b[2]));
+    exposed += !occupied.count(key(b[0], b[1] - 1, b[2]));
+    exposed += !occupied.count(key(b[0], b[1] + 1, b[2]));
+    exposed += !occupied.count(key(b[0], b[1], b[2] - 1));
+    exposed += !occupied.count(key(b[0], b[1], b[2] + 1));
+  }
+  return exposed * bin * bin;
+}
+
+GridMemoryEstimate chooseGrid(const Vector3f &extent, double area,
+                              const GridCost &cost,
+                              const GridResolution &resolution) {
+  auto estimate = [&](double scale) {
+    GridMemoryEstimate rval;
+    rval.scale = scale;
+    double voxels = 1;
+    for (std::size_t i = 0; i < 3; ++i) {
+      rval.dim[i] = static_cast<int>((extent[i] + 1) * scale);
+      voxels *= rval.dim[i];
+    }
+    // Marching cubes yields about one vertex per voxel crossed by the surface
+    const double vertices = area * scale * scale;
+    rval.gridBytes = static_cast<std::size_t>(
+        voxels * cost.bytesPerVoxel + vertices * cost.bytesPerSurfaceVoxel);
+    rval.meshBytes =
+        static_cast<std::size_t>(vertices * MESH_BYTES_PER_VERTEX);
+    return rval;
+  };
+  auto tooCoarse = [](const GridMemoryEstimate &grid) {
+    return grid.dim[0] < 3 || grid.dim[1] < 3 || grid.dim[2] < 3;
+  };
+
+  const double scale =
+      (resolution.scale > 0) ? resolution.scale : cost.defaultScale;
+  GridMemoryEstimate grid = estimate(scale);
+  if (resolution.memoryBudget == 0 || grid.total() <= resolution.memoryBudget) {
+    if (tooCoarse(grid)) {
+      gamer_runtime_error("A grid scale of", scale,
+                          "points per Angstrom is too coarse for the atoms.");
+    }
+    return grid;
+  }
+
+  // Coarsest scale with at least three points along every axis
+  double lo = 3 / (std::min(extent[0], std::min(extent[1], extent[2])) + 1);
+  GridMemoryEstimate coarsest = estimate(lo);
+  if (lo >= scale || tooCoarse(coarsest) ||
+      coarsest.total() > resolution.memoryBudget) {
+    gamer_runtime_error("A memory budget of", resolution.memoryBudget,
+                        "bytes is too small for the atoms.");
+  }
+
+  // Bisect for the finest scale which fits
+  double hi = scale;
+  for (int i = 0; i < 50; ++i) {
+    const double mid = (lo + hi) / 2;
+    if (estimate(mid).total() <= resolution.memoryBudget) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return estimate(lo);
+}
+} // end namespace pdbreader_detail
+/// @endcond
+
+std::ostream &operator<<(std::ostream &output,
+                         const GridMemoryEstimate &estimate) {
+  const double MB = 1024 * 1024;
+  output << "Grid " << estimate.dim << " at " << estimate.scale
+         << " points per Angstrom, estimated memory: grid "
+         << estimate.gridBytes / MB << " MB, mesh " << estimate.meshBytes / MB
+         << " MB";
+  return output;
+}
+
+/// @cond detail
+namespace {
+// Multiplying the integer dimension by DIM_SCALE truncated the scale to one,
+// so one point per Angstrom is the default grid of gauss and distgrid.
+
+/// Sparse density and its union-find parents and components, and triangles.
+/// An upper bound since only the bricks covered by atoms are allocated.
+const pdbreader_detail::GridCost GAUSS_COST = {
+    1, sizeof(float) + 2 * sizeof(std::uint32_t),
+    sizeof(Vector) + 2 * sizeof(std::array<int, 3>)};
+
+/// Dataset, marching cubes mask and component labels, and triangles. The SAS
+/// mesh is alive while the SES is meshed.
+const pdbreader_detail::GridCost DISTGRID_COST = {
+    1, sizeof(float) + sizeof(bool) + sizeof(std::uint32_t),
+    GAUSS_COST.bytesPerSurfaceVoxel + pdbreader_detail::MESH_BYTES_PER_VERTEX};
+
+/// Dataset, SAS copy, and the distance transform values and labels
+const pdbreader_detail::GridCost DISTGRID_EDT_COST = {
+    1, 3 * sizeof(float) + sizeof(int), GAUSS_COST.bytesPerSurfaceVoxel};
+
+/// Dense dataset, marching cubes mask and component labels, and triangles.
+/// Frames are returned as flat buffers rather than a SurfaceMesh.
+const pdbreader_detail::GridCost GAUSS_TRAJECTORY_COST = {
+    1, sizeof(float) + sizeof(char) + sizeof(std::uint32_t),
+    GAUSS_COST.bytesPerSurfaceVoxel};
+
+void gaussBounds(const std::vector<Atom> &atoms, const float blobbyness,
+                 Vector3f &min, Vector3f &max) {
   getMinMax(atoms.cbegin(), atoms.cend(), min, max,
             [&blobbyness](const float atomRadius) -> float {
               return atomRadius *
                      sqrt(1.0 + log(pdbreader_detail::EPSILON) / blobbyness);
             });
+}
+
+void distgridBounds(const std::vector<Atom> &atoms, const float radius,
+                    Vector3f &min, Vector3f &max) {
+  getMinMax(atoms.cbegin(), atoms.cend(), min, max,
+            [&radius](const float atomRadius) -> float {
+              return DIM_SCALE * (atomRadius + radius);
+            });
+}
+
+/// Grow the box [min, max] to contain [lo, hi]
+void expandBounds(const Vector3f &lo, const Vector3f &hi, Vector3f &min,
+                  Vector3f &max) {
+  for (std::size_t i = 0; i < 3; ++i) {
+    min[i] = std::min(min[i], lo[i]);
+    max[i] = std::max(max[i], hi[i]);
+  }
+}
+
+/**
+ * @brief      Gauss surfaces of successive frames on one grid
+ *
+ * The density grid, the marching cubes workspace, and the output buffers are
+ * allocated by the first frame and reused by the following ones.
+ */
+class GaussTrajectory {
+public:
+  /**
+   * @param[in]  min         Lower corner of the grid, containing all frames
+   * @param[in]  max         Upper corner of the grid, containing all frames
+   * @param[in]  area        Estimated surface area of a frame
+   * @param[in]  blobbyness  Blobbyness of the applied Gaussian
+   * @param[in]  isovalue    Isovalue to extract
+   * @param[in]  resolution  Grid resolution and memory budget
+   */
+  GaussTrajectory(const Vector3f &min, const Vector3f &max, double area,
+                  float blobbyness, float isovalue,
+                  const GridResolution &resolution)
+      : _min(min), _maxMin(max - min), _offset(static_cast<Vector>(min)),
+        _blobbyness(blobbyness), _isovalue(isovalue) {
+    GridMemoryEstimate grid = pdbreader_detail::chooseGrid(
+        _maxMin, area, GAUSS_TRAJECTORY_COST, resolution);
+    std::cout << grid << std::endl;
+    _dim = grid.dim;
+    _span = _maxMin.ElementwiseDivision(static_cast<Vector3f>(_dim) -
+                                        Vector3f({1, 1, 1}));
+  }
+
+  /**
+   * @brief      Mesh a frame and pass it to the callback
+   *
+   * @param[in]  index     Index of the frame
+   * @param[in]  atoms     Atoms of the frame, within the grid
+   * @param[in]  callback  The callback
+   *
+   * @return     The result of the callback
+   */
+  bool operator()(std::size_t index, const std::vector<Atom> &atoms,
+                  const TrajectoryCallback &callback) {
+    _dataset.assign(static_cast<std::size_t>(_dim[0]) * _dim[1] * _dim[2], 0);
+    float maxval = blurAtoms(atoms.cbegin(), atoms.cend(), _dataset.data(),
+                             _min, _maxMin, _dim, _blobbyness, 0)
+                       .max;
+    // Same isovalue override as meshAtoms_gauss
+    float isovalue = std::min(_isovalue, 0.44f * maxval);
+
+    _holes.clear();
+    marchingCubes(_dataset.data(), maxval, _dim, _span, isovalue,
+                  std::back_inserter(_holes), _workspace, 0);
+    for (auto &v : _workspace.vertices) {
+      v += _offset;
+    }
+    return callback(
+        TrajectoryFrame{index, _workspace.vertices, _workspace.triangles});
+  }
+
+private:
+  Vector3f _min;
+  Vector3f _maxMin;
+  Vector _offset;
+  float _blobbyness;
+  float _isovalue;
+  Vector3i _dim;
+  Vector3f _span;
+  std::vector<float> _dataset;
+  std::vector<Vector> _holes;
+  MarchingCubesWorkspace _workspace;
+};
+
+/**
+ * @brief      Mesh the models of a file as a trajectory
+ *
+ * The file is read twice, first for the bounds of all models and the surface
+ * area of the first, then to mesh each model. Models without atoms have no
+ * bounds and are skipped in both passes.
+ *
+ * @param[in]  readModels  readModels(model, report) reads the models of the
+ *                         file as pdbreader_detail::readModels
+ *
+ * @tparam     ReadModels  Typename of the model reader
+ */
+template <typename ReadModels>
+std::size_t readTrajectory_gauss(const ReadModels &readModels,
+                                 const float blobbyness, float isovalue,
+                                 const TrajectoryCallback &callback,
+                                 const GridResolution &resolution) {
+  Vector3f min, max;
+  double area = 0;
+  std::size_t nFrames = 0;
+  bool read = readModels(
+      [&](const std::vector<Atom> &atoms) {
+        if (atoms.empty())
+          return true;
+        Vector3f lo, hi;
+        gaussBounds(atoms, blobbyness, lo, hi);
+        if (nFrames++ == 0) {
+          min = lo;
+          max = hi;
+          area = pdbreader_detail::estimateSurfaceArea(atoms);
+        } else {
+          expandBounds(lo, hi, min, max);
+        }
+        return true;
+      },
+      false);
+  if (!read || nFrames == 0) {
+    return 0;
+  }
+  std::cout << "Frames: " << nFrames << std::endl;
+
+  GaussTrajectory trajectory(min, max, area, blobbyness, isovalue,
+                             resolution);
+  std::size_t index = 0;
+  readModels(
+      [&](const std::vector<Atom> &atoms) {
+        return atoms.empty() || trajectory(index++, atoms, callback);
+      },
+      true);
+  return index;
+}
+
+/// Scratch space for the lower envelope along one grid line
+struct EnvelopeLine {
+  explicit EnvelopeLine(std::size_t n) : f(n), labels(n), v(n), z(n + 1) {}
+
+  std::vector<float> f;
+  std::vector<int> labels;
+  /// Locations of the parabolas in the lower envelope
+  std::vector<int> v;
+  /// Boundaries between consecutive parabolas
+  std::vector<double> z;
+};
+
+/**
+ * @brief      One dimensional distance transform of a grid line
+ *
+ * @param      f       First sample of the line, overwritten with the result
+ * @param      labels  Labels of the line, overwritten with the minimizing one
+ * @param[in]  n       Number of samples
+ * @param[in]  stride  Distance between consecutive samples
+ * @param      s       Scratch space for at least n samples
+ */
+void transformLine(float *f, int *labels, const std::size_t n,
+                   const std::size_t stride, EnvelopeLine &s) {
+  for (std::size_t i = 0; i < n; ++i) {
+    s.f[i] = f[i * stride];
+    s.labels[i] = labels[i * stride];
+  }
+
+  int k = -1;
+  for (int q = 0; q < static_cast<int>(n); ++q) {
+    const double fq = s.f[q];
+    if (std::isinf(fq))
+      continue;
+    double sq = 0;
+    while (k >= 0) {
+      const int vk = s.v[k];
+      sq = ((fq + static_cast<double>(q) * q) -
+            (s.f[vk] + static_cast<double>(vk) * vk)) /
+           (2.0 * (q - vk));
+      if (sq > s.z[k])
+        break;
+      --k;
+    }
+    ++k;
+    s.v[k] = q;
+    s.z[k] = (k == 0) ? -std::numeric_limits<double>::infinity() : sq;
+    s.z[k + 1] = std::numeric_limits<double>::infinity();
+  }
+
+  if (k < 0) {
+    // No seeds along this line
+    for (std::size_t i = 0; i < n; ++i)
+      labels[i * stride] = -1;
+    return;
+  }
+
+  k = 0;
+  for (int p = 0; p < static_cast<int>(n); ++p) {
+    while (s.z[k + 1] < p)
+      ++k;
+    const int q = s.v[k];
+    f[p * stride] = static_cast<float>(
+        static_cast<double>(p - q) * (p - q) + s.f[q]);
+    labels[p * stride] = s.labels[q];
+  }
+}
+} // end anonymous namespace
+/// @endcond
+
+void distanceTransform(float *f, int *labels, const Vector3i &dim,
+                       std::size_t nthreads) {
+  if (dim[0] <= 0 || dim[1] <= 0 || dim[2] <= 0)
+    return;
+  const std::size_t nx = dim[0];
+  const std::size_t ny = dim[1];
+  const std::size_t nz = dim[2];
+  const std::size_t length[3] = {nx, ny, nz};
+  const std::size_t stride[3] = {1, nx, nx * ny};
+
+  for (int axis = 0; axis < 3; ++axis) {
+    // Lines along an axis are indexed by the two remaining coordinates
+    const std::size_t nlines = nx * ny * nz / length[axis];
+    parallel::for_each_chunk(
+        0, nlines, nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end) {
+          EnvelopeLine scratch(length[axis]);
+          for (std::size_t l = begin; l < end; ++l) {
+            std::size_t start;
+            if (axis == 0)
+              start = l * nx;
+            else if (axis == 1)
+              start = (l / nx) * nx * ny + l % nx;
+            else
+              start = l;
+            transformLine(f + start, labels + start, length[axis],
+                          stride[axis], scratch);
+          }
+        });
+  }
+}
+
+void gridSES_EDT(const float *sas, const Vector3i &dim, float *dataset,
+                 const float radius, std::size_t nthreads) {
+  const std::size_t n = static_cast<std::size_t>(dim[0]) * dim[1] * dim[2];
+  std::vector<float> f(n);
+  std::vector<int> labels(n);
+  parallel::for_each_chunk(
+      0, n, nthreads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const bool outside = sas[i] <= 0;
+          f[i] = outside ? 0 : std::numeric_limits<float>::infinity();
+          labels[i] = outside ? static_cast<int>(i) : -1;
+        }
+      });
+
+  distanceTransform(f.data(), labels.data(), dim, nthreads);
+
+  parallel::for_each_chunk(
+      0, n, nthreads, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const int q = labels[i];
+          if (q < 0)
+            continue;
+          // Near the boundary -sas[q] approximates the distance from the
+          // outside voxel q to the SAS.
+          float dist = std::sqrt(f[i]) + sas[q] - radius;
+          if (dist > dataset[i]) {
+            dataset[i] = dist;
+          }
+        }
+      });
+}
+
+GridMemoryEstimate estimateMemory_distgrid(const std::vector<Atom> &atoms,
+                                           const float radius,
+                                           const bool useEDT,
+                                           const GridResolution &resolution) {
+  Vector3f min, max;
+  distgridBounds(atoms, radius, min, max);
+  return pdbreader_detail::chooseGrid(
+      max - min, pdbreader_detail::estimateSurfaceArea(atoms),
+      useEDT ? DISTGRID_EDT_COST : DISTGRID_COST, resolution);
+}
+
+std::unique_ptr<SurfaceMesh>
+meshAtoms_distgrid(const std::vector<Atom> &input, const float radius,
+                   const bool useEDT, const GridResolution &resolution) {
+  // Atoms are moved into grid coordinates below so work on a copy
+  std::vector<Atom> atoms(input);
+  std::cout << "Atoms: " << atoms.size() << std::endl;
+  Vector3f min, max;
+  distgridBounds(atoms, radius, min, max);
 
   float min_dimension = std::min(
       (max[0] - min[0]), std::min((max[1] - min[1]), (max[2] - min[2])));
-
   std::cout << "Min Dimension: " << min_dimension << std::endl;
 
-  Vector3i dim;
-
   Vector3f maxMin = max - min;
 
-  dim = static_cast<Vector3i>((maxMin) + Vector3f({1, 1, 1})) * DIM_SCALE;
+  GridMemoryEstimate grid = pdbreader_detail::chooseGrid(
+      maxMin, pdbreader_detail::estimateSurfaceArea(atoms),
+      useEDT ? DISTGRID_EDT_COST : DISTGRID_COST, resolution);
+  std::cout << grid << std::endl;
+  Vector3i dim = grid.dim;
 
   std::cout << "Dimension: " << dim << std::endl;
   std::cout << "Min:" << min << std::endl;
@@ -165,83 +1136,126 @@ std::unique_ptr<SurfaceMesh> readPDB_gauss(const std::string &filename,
                                                Vector3f({1, 1, 1}));
   std::cout << "Delta: " << span << std::endl;
 
-  float *dataset = new float[dim[0] * dim[1] * dim[2]]();
+  // Move dataset to positive octant and scale
+  for (auto &atom : atoms) {
+    atom.pos = (atom.pos - min).ElementwiseDivision(span);
+    atom.radius =
+        (atom.radius + radius) / ((span[0] + span[1] + span[2]) / 3.0);
+  }
 
-  // Bring atoms to +++ quadrant
-  // for(auto& atom : atoms){
-  //     atom.pos = (atom.pos-min).ElementwiseDivision(span);
-  // }
+  float *dataset = new float[dim[0] * dim[1] * dim[2]];
+  for (int i = 0; i < dim[0] * dim[1] * dim[2]; ++i) {
+    dataset[i] = -5.0f;
+  }
 
-  std::cout << "Begin blurring coordinates" << std::endl;
-  blurAtoms(atoms.cbegin(), atoms.cend(), dataset, min, maxMin, dim,
-            blobbyness);
-  std::cout << "Done blurring coords" << std::endl;
+  std::vector<Vertex> holelist;
+  if (useEDT) {
+    gridSAS_EDT(atoms.cbegin(), atoms.cend(), dim, dataset, 0);
+    std::vector<float> sas(dataset, dataset + dim[0] * dim[1] * dim[2]);
+
+    // Reset dataset
+    std::fill(dataset, dataset + dim[0] * dim[1] * dim[2], -5.0f);
+
+    // Atom radii were scaled to grid units above, do the same for the probe
+    gridSES_EDT(sas.data(), dim, dataset,
+                radius / ((span[0] + span[1] + span[2]) / 3.0), 0);
+  } else {
+    gridSAS(atoms.cbegin(), atoms.cend(), dim, dataset);
 
-  float minval = std::numeric_limits<float>::infinity();
-  float maxval = -std::numeric_limits<float>::infinity();
+    std::unique_ptr<SurfaceMesh> SASmesh = std::move(marchingCubes(
+        dataset, 5.0f, dim, span, 0.0f, std::back_inserter(holelist), 0));
 
-  for (int i = 0; i < dim[2] * dim[1] * dim[0]; ++i) {
-    float cval = dataset[i];
-    if (cval < minval) {
-      minval = cval;
+    for (auto curr = atoms.cbegin(); curr != atoms.cend(); ++curr) {
+      Vector3f pos = curr->pos;
+      // compute the dataset coordinates of the atom's center
+      Vector3i c;
+      std::transform(pos.begin(), pos.end(), c.begin(),
+                     [](float v) -> int { return round(v); });
     }
-    if (cval > maxval) {
-      maxval = cval;
+
+    // Reset dataset
+    for (int i = 0; i < dim[0] * dim[1] * dim[2]; ++i) {
+      dataset[i] = -5.0f;
     }
+
+    auto SASverts = SASmesh->get_level<1>();
+    gridSES(SASverts.begin(), SASverts.end(), dim, dataset, radius);
+    // for(int i = 0; i < dim[0]*dim[1]*dim[2]; ++i){
+    //     std::cout << dataset[i] << std::endl;
+    // }
   }
-  // std::cout << "Min Density: " << minval << ", Max Density: " << maxval <<
-  // std::endl;
-  float data_isoval = 0.44 * maxval; // Override the user's isovalue... is
-                                     // this a good idea?
-  if (data_isoval < isovalue) {
-    isovalue = data_isoval;
-  }
-  std::cout << "Isovalue: " << isovalue << std::endl;
 
-  std::vector<Vertex> holelist;
-  mesh = std::move(marchingCubes(dataset, maxval, dim, span, isovalue,
-                                 std::back_inserter(holelist)));
+  std::unique_ptr<SurfaceMesh> mesh = std::move(marchingCubes(
+      dataset, 5.0f, dim, span, 0.0f, std::back_inserter(holelist), 0));
   delete[] dataset;
 
   // Translate back to the original position from the positive octant
   for (auto &v : mesh->get_level<1>()) {
     v += min;
   }
-  // TODO: (50) What to do with holelist...
   return mesh;
 }
 
-std::unique_ptr<SurfaceMesh> readPQR_gauss(const std::string &filename,
-                                           const float blobbyness,
-                                           float isovalue) {
-  std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
+std::unique_ptr<SurfaceMesh>
+meshAtoms_distgrid(const float *xyz, const float *radii, std::size_t nAtoms,
+                   const float radius, const bool useEDT,
+                   const GridResolution &resolution) {
+  return meshAtoms_distgrid(pdbreader_detail::makeAtoms(xyz, radii, nAtoms),
+                            radius, useEDT, resolution);
+}
 
+std::unique_ptr<SurfaceMesh>
+readPDB_distgrid(const std::string &filename, const float radius,
+                 const bool useEDT, const GridResolution &resolution) {
   std::vector<Atom> atoms;
   // If readPDB errors return nullptr
-  if (!readPQR(filename, std::back_inserter(atoms))) {
-    mesh.reset();
-    return mesh;
+  if (!readPDB(filename, std::back_inserter(atoms))) {
+    return nullptr;
+  }
+  return meshAtoms_distgrid(atoms, radius, useEDT, resolution);
+}
+
+std::unique_ptr<SurfaceMesh>
+readCIF_distgrid(const std::string &filename, const float radius,
+                 const bool useEDT, const GridResolution &resolution) {
+  std::vector<Atom> atoms;
+  // If readCIF errors return nullptr
+  if (!readCIF(filename, std::back_inserter(atoms))) {
+    return nullptr;
   }
+  return meshAtoms_distgrid(atoms, radius, useEDT, resolution);
+}
 
+GridMemoryEstimate estimateMemory_gauss(const std::vector<Atom> &atoms,
+                                        const float blobbyness,
+                                        const GridResolution &resolution) {
+  Vector3f min, max;
+  gaussBounds(atoms, blobbyness, min, max);
+  return pdbreader_detail::chooseGrid(
+      max - min, pdbreader_detail::estimateSurfaceArea(atoms), GAUSS_COST,
+      resolution);
+}
+
+std::unique_ptr<SurfaceMesh>
+meshAtoms_gauss(const std::vector<Atom> &atoms, const float blobbyness,
+                float isovalue, const GridResolution &resolution) {
   std::cout << "Atoms: " << atoms.size() << std::endl;
 
   Vector3f min, max;
-  getMinMax(atoms.cbegin(), atoms.cend(), min, max,
-            [&blobbyness](const float atomRadius) -> float {
-              return atomRadius *
-                     sqrt(1.0 + log(pdbreader_detail::EPSILON) / blobbyness);
-            });
+  gaussBounds(atoms, blobbyness, min, max);
 
   float min_dimension = std::min(
       (max[0] - min[0]), std::min((max[1] - min[1]), (max[2] - min[2])));
 
   std::cout << "Min Dimension: " << min_dimension << std::endl;
 
-  Vector3i dim;
-
   Vector3f maxMin = max - min;
 
-  dim = static_cast<Vector3i>((maxMin) + Vector3f({1, 1, 1})) * DIM_SCALE;
+  GridMemoryEstimate grid = pdbreader_detail::chooseGrid(
+      maxMin, pdbreader_detail::estimateSurfaceArea(atoms), GAUSS_COST,
+      resolution);
+  std::cout << grid << std::endl;
+  Vector3i dim = grid.dim;
 
   std::cout << "Dimension: " << dim << std::endl;
   std::cout << "Min:" << min << std::endl;
@@ -251,7 +1265,7 @@ std::unique_ptr<SurfaceMesh> readPQR_gauss(const std::string &filename,
                                                Vector3f({1, 1, 1}));
   std::cout << "Delta: " << span << std::endl;
 
-  float *dataset = new float[dim[0] * dim[1] * dim[2]]();
+  SparseVolume<float> volume(dim);
 
   // Bring atoms to +++ quadrant
   // for(auto& atom : atoms){
@@ -259,26 +1273,16 @@ std::unique_ptr<SurfaceMesh> readPQR_gauss(const std::string &filename,
   // }
 
   std::cout << "Begin blurring coordinates" << std::endl;
-  blurAtoms(atoms.cbegin(), atoms.cend(), dataset, min, maxMin, dim,
-            blobbyness);
+  // The brick ranges are reduced while splatting and reused below
+  const BrickRanges<float> ranges = blurAtoms(
+      atoms.cbegin(), atoms.cend(), volume, min, maxMin, blobbyness, 0);
   std::cout << "Done blurring coords" << std::endl;
+  std::cout << "Allocated bricks: " << volume.allocatedBricks() << " of "
+            << volume.size() << std::endl;
 
-  // float minval;
-  float maxval;
-  // minval = std::numeric_limits<float>::infinity();
-  maxval = -std::numeric_limits<float>::infinity();
-
-  for (int i = 0; i < dim[2] * dim[1] * dim[0]; ++i) {
-    float cval = dataset[i];
-    // if (cval < minval){
-    //     minval = cval;
-    // }
-    if (cval > maxval) {
-      maxval = cval;
-    }
-  }
-  // std::cout << "Min Density: " << minval << ", Max Density: " << maxval <<
-  // std::endl;
+  float maxval = ranges.total.max;
+  // std::cout << "Min Density: " << ranges.total.min
+  //           << ", Max Density: " << maxval << std::endl;
   float data_isoval = 0.44 * maxval; // Override the user's isovalue... is
                                      // this a good idea?
   if (data_isoval < isovalue) {
@@ -287,9 +1291,9 @@ std::unique_ptr<SurfaceMesh> readPQR_gauss(const std::string &filename,
   std::cout << "Isovalue: " << isovalue << std::endl;
 
   std::vector<Vertex> holelist;
-  mesh = std::move(marchingCubes(dataset, maxval, dim, span, isovalue,
-                                 std::back_inserter(holelist)));
-  delete[] dataset;
+  std::unique_ptr<SurfaceMesh> mesh =
+      std::move(marchingCubes(volume, ranges, span, isovalue,
+                              std::back_inserter(holelist), 0));
 
   // Translate back to the original position from the positive octant
   for (auto &v : mesh->get_level<1>()) {
@@ -299,4 +1303,135 @@ std::unique_ptr<SurfaceMesh> readPQR_gauss(const std::string &filename,
   return mesh;
 }
 
+std::unique_ptr<SurfaceMesh>
+meshAtoms_gauss(const float *xyz, const float *radii, std::size_t nAtoms,
+                const float blobbyness, float isovalue,
+                const GridResolution &resolution) {
+  return meshAtoms_gauss(pdbreader_detail::makeAtoms(xyz, radii, nAtoms),
+                         blobbyness, isovalue, resolution);
+}
+
+/**
+ * @brief      Reads a pdb gauss.
+ *
+ * @param[in]  filename    The filename
+ * @param[in]  blobbyness  The blobbyness
+ * @param[in]  isovalue    The isovalue
+ * @param[in]  resolution  Grid resolution and memory budget
+ *
+ * @return     { description_of_the_return_value }
+ */
+std::unique_ptr<SurfaceMesh>
+readPDB_gauss(const std::string &filename, const float blobbyness,
+              float isovalue, const GridResolution &resolution) {
+  std::vector<Atom> atoms;
+  // If readPDB errors return nullptr
+  if (!readPDB(filename, std::back_inserter(atoms))) {
+    return nullptr;
+  }
+  return meshAtoms_gauss(atoms, blobbyness, isovalue, resolution);
+}
+
+std::unique_ptr<SurfaceMesh>
+readPQR_gauss(const std::string &filename, const float blobbyness,
+              float isovalue, const GridResolution &resolution) {
+  std::vector<Atom> atoms;
+  // If readPQR errors return nullptr
+  if (!readPQR(filename, std::back_inserter(atoms))) {
+    return nullptr;
+  }
+  return meshAtoms_gauss(atoms, blobbyness, isovalue, resolution);
+}
+
+std::unique_ptr<SurfaceMesh>
+readCIF_gauss(const std::string &filename, const float blobbyness,
+              float isovalue, const GridResolution &resolution) {
+  std::vector<Atom> atoms;
+  // If readCIF errors return nullptr
+  if (!readCIF(filename, std::back_inserter(atoms))) {
+    return nullptr;
+  }
+  return meshAtoms_gauss(atoms, blobbyness, isovalue, resolution);
+}
+
+std::unique_ptr<SurfaceMesh> TrajectoryFrame::mesh() const {
+  return marchingcubes_detail::buildMesh(vertices, triangles);
+}
+
+std::size_t meshTrajectory_gauss(const float *xyz, const float *radii,
+                                 std::size_t nAtoms, std::size_t nFrames,
+                                 const float blobbyness, float isovalue,
+                                 const TrajectoryCallback &callback,
+                                 const GridResolution &resolution) {
+  if (nFrames == 0) {
+    gamer_runtime_error("Cannot mesh a trajectory without frames.");
+  }
+  std::vector<Atom> atoms = pdbreader_detail::makeAtoms(xyz, radii, nAtoms);
+  auto setFrame = [&](std::size_t frame) {
+    const float *pos = xyz + 3 * nAtoms * frame;
+    for (std::size_t i = 0; i < nAtoms; ++i) {
+      atoms[i].pos = Vector3f({pos[3 * i], pos[3 * i + 1], pos[3 * i + 2]});
+    }
+  };
+
+  // The grid contains every frame
+  Vector3f min, max;
+  gaussBounds(atoms, blobbyness, min, max);
+  for (std::size_t frame = 1; frame < nFrames; ++frame) {
+    setFrame(frame);
+    Vector3f lo, hi;
+    gaussBounds(atoms, blobbyness, lo, hi);
+    expandBounds(lo, hi, min, max);
+  }
+  setFrame(0);
+  std::cout << "Atoms: " << nAtoms << ", Frames: " << nFrames << std::endl;
+
+  GaussTrajectory trajectory(min, max,
+                             pdbreader_detail::estimateSurfaceArea(atoms),
+                             blobbyness, isovalue, resolution);
+  for (std::size_t frame = 0; frame < nFrames; ++frame) {
+    setFrame(frame);
+    if (!trajectory(frame, atoms, callback)) {
+      return frame + 1;
+    }
+  }
+  return nFrames;
+}
+
+std::size_t readPDBTrajectory_gauss(const std::string &filename,
+                                    const float blobbyness, float isovalue,
+                                    const TrajectoryCallback &callback,
+                                    const GridResolution &resolution) {
+  return readTrajectory_gauss(
+      [&filename](const std::function<bool(const std::vector<Atom> &)> &model,
+                  bool report) {
+        return pdbreader_detail::readModels(filename, false, model, report);
+      },
+      blobbyness, isovalue, callback, resolution);
+}
+
+std::size_t readPQRTrajectory_gauss(const std::string &filename,
+                                    const float blobbyness, float isovalue,
+                                    const TrajectoryCallback &callback,
+                                    const GridResolution &resolution) {
+  return readTrajectory_gauss(
+      [&filename](const std::function<bool(const std::vector<Atom> &)> &model,
+                  bool report) {
+        return pdbreader_detail::readModels(filename, true, model, report);
+      },
+      blobbyness, isovalue, callback, resolution);
+}
+
+std::size_t readCIFTrajectory_gauss(const std::string &filename,
+                                    const float blobbyness, float isovalue,
+                                    const TrajectoryCallback &callback,
+                                    const GridResolution &resolution) {
+  return readTrajectory_gauss(
+      [&filename](const std::function<bool(const std::vector<Atom> &)> &model,
+                  bool report) {
+        return pdbreader_detail::readCIFModels(filename, model, report);
+      },
+      blobbyness, isovalue, callback, resolution);
+}
+
 } // end namespace gamer
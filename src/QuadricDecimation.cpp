@@ -0,0 +1,669 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <casc/casc>
+
+#include "gamer/EigenDiagonalization.h"
+#include "gamer/FlatSurfaceMesh.h"
+#include "gamer/KRingCache.h"
+#include "gamer/SurfaceMesh.h"
+
+/// Namespace for all things gamer
+namespace gamer {
+namespace {
+/// Weight of the planes constraining boundary and marker boundary edges
+constexpr double FeatureWeight = 1000;
+
+/**
+ * @brief      Quadric error of a point with respect to a set of planes
+ *
+ * The symmetric 4x4 matrix is stored as its upper triangle: a2, ab, ac, ad,
+ * b2, bc, bd, c2, cd, d2 for planes ax + by + cz + d = 0.
+ */
+struct Quadric {
+  std::array<double, 10> q = {{0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+
+  /// Quadric of a plane through a point with unit normal n
+  static Quadric plane(const Vector &n, const Vector &point, double weight) {
+    const double a = n[0], b = n[1], c = n[2];
+    const double d = -dot(n, point);
+    Quadric Q;
+    Q.q = {{weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+            weight * b * b, weight * b * c, weight * b * d, weight * c * c,
+            weight * c * d, weight * d * d}};
+    return Q;
+  }
+
+  Quadric &operator+=(const Quadric &other) {
+    for (std::size_t i = 0; i < q.size(); ++i)
+      q[i] += other.q[i];
+    return *this;
+  }
+
+  /// Sum of the weighted squared distances of a point to the planes
+  double error(const Vector &p) const {
+    const double x = p[0], y = p[1], z = p[2];
+    return x * (q[0] * x + 2 * (q[1] * y + q[2] * z + q[3])) +
+           y * (q[4] * y + 2 * (q[5] * z + q[6])) +
+           z * (q[7] * z + 2 * q[8]) + q[9];
+  }
+
+  /**
+   * @brief      Find the point of least error
+   *
+   * @param      p     The point, unchanged if the system is singular
+   *
+   * @return     Whether the system could be solved
+   */
+  bool minimize(Vector &p) const {
+    // Cofactors of the symmetric 3x3 block
+    const double c00 = q[4] * q[7] - q[5] * q[5];
+    const double c01 = q[2] * q[5] - q[1] * q[7];
+    const double c02 = q[1] * q[5] - q[2] * q[4];
+    const double det = q[0] * c00 + q[1] * c01 + q[2] * c02;
+    const double scale = q[0] + q[4] + q[7];
+    if (std::abs(det) <= 1e-12 * scale * scale * scale)
+      return false;
+    const double c11 = q[0] * q[7] - q[2] * q[2];
+    const double c12 = q[1] * q[2] - q[0] * q[5];
+    const double c22 = q[0] * q[4] - q[1] * q[1];
+    p[0] = -(c00 * q[3] + c01 * q[6] + c02 * q[8]) / det;
+    p[1] = -(c01 * q[3] + c11 * q[6] + c12 * q[8]) / det;
+    p[2] = -(c02 * q[3] + c12 * q[6] + c22 * q[8]) / det;
+    return true;
+  }
+};
+
+/**
+ * @brief      Indexed binary min heap of edges keyed by collapse cost.
+ *
+ * The heap slot of every queued edge is tracked so costs can be changed and
+ * edges removed in O(log n). Ties are broken by edge index.
+ */
+class EdgeHeap {
+public:
+  bool empty() const { return _heap.empty(); }
+
+  /// Edge with the least cost
+  int top() const { return _heap.front().edge; }
+
+  /// Least cost
+  double topCost() const { return _heap.front().cost; }
+
+  bool contains(int edge) const {
+    return static_cast<std::size_t>(edge) < _slot.size() && _slot[edge] >= 0;
+  }
+
+  /// Insert an edge or change its cost
+  void set(int edge, double cost) {
+    if (static_cast<std::size_t>(edge) >= _slot.size())
+      _slot.resize(std::max<std::size_t>(edge + 1, 2 * _slot.size()), -1);
+    if (_slot[edge] < 0) {
+      _heap.push_back(Entry{cost, edge});
+      _slot[edge] = _heap.size() - 1;
+      siftUp(_heap.size() - 1);
+      return;
+    }
+    const int i = _slot[edge];
+    const Entry old = _heap[i];
+    _heap[i].cost = cost;
+    if (_heap[i] < old)
+      siftUp(i);
+    else
+      siftDown(i);
+  }
+
+  /// Remove an edge if it is queued
+  void remove(int edge) {
+    if (!contains(edge))
+      return;
+    const int i = _slot[edge];
+    _slot[edge] = -1;
+    const Entry last = _heap.back();
+    _heap.pop_back();
+    if (static_cast<std::size_t>(i) == _heap.size())
+      return;
+    place(i, last);
+    siftUp(i);
+    siftDown(_slot[last.edge]);
+  }
+
+private:
+  struct Entry {
+    double cost;
+    int edge;
+    bool operator<(const Entry &rhs) const {
+      return cost < rhs.cost || (cost == rhs.cost && edge < rhs.edge);
+    }
+  };
+
+  void place(std::size_t i, const Entry &e) {
+    _heap[i] = e;
+    _slot[e.edge] = i;
+  }
+
+  void siftUp(std::size_t i) {
+    const Entry e = _heap[i];
+    while (i > 0) {
+      const std::size_t parent = (i - 1) / 2;
+      if (!(e < _heap[parent]))
+        break;
+      place(i, _heap[parent]);
+      i = parent;
+    }
+    place(i, e);
+  }
+
+  void siftDown(std::size_t i) {
+    const Entry e = _heap[i];
+    const std::size_t n = _heap.size();
+    while (2 * i + 1 < n) {
+      std::size_t child = 2 * i + 1;
+      if (child + 1 < n && _heap[child + 1] < _heap[child])
+        ++child;
+      if (!(_heap[child] < e))
+        break;
+      place(i, _heap[child]);
+      i = child;
+    }
+    place(i, e);
+  }
+
+  std::vector<Entry> _heap;
+  std::vector<int> _slot;
+};
+
+/**
+ * @brief      Edge collapse decimation of an oriented triangle soup with
+ *             vertex to face incidence.
+ */
+class QuadricDecimator {
+public:
+  QuadricDecimator(const FlatSurfaceMesh &mesh,
+                   const std::vector<REAL> &weights)
+      : _mesh(mesh), _positions(mesh.positions), _quadrics(mesh.nVertices()),
+        _weights(weights), _faces(mesh.nFaces()),
+        _faceAlive(mesh.nFaces(), 1), _vertexFaces(mesh.nVertices()),
+        _featureDegree(mesh.nVertices(), 0), _stamp(mesh.nVertices(), 0) {
+    if (_weights.empty())
+      _weights.assign(mesh.nVertices(), 1);
+    for (std::size_t i = 0; i < mesh.nFaces(); ++i) {
+      if (mesh.faceOrientations[i] == 0) {
+        gamer_runtime_error("Orientation undefined, cannot decimate. Did "
+                            "you call compute_orientation()?");
+      }
+      _faces[i] = mesh.orientedFace(i);
+      for (auto v : _faces[i])
+        _vertexFaces[v].push_back(i);
+    }
+    _nFaces = mesh.nFaces();
+    initQuadrics();
+    for (std::size_t v = 0; v < mesh.nVertices(); ++v)
+      updateFeatureDegree(v);
+
+    for (const auto &edge : mesh.edges)
+      addEdge(edge[0], edge[1]);
+    for (std::size_t e = 0; e < _edges.size(); ++e)
+      evaluate(e);
+  }
+
+  /**
+   * @brief      Collapse edges in order of increasing cost
+   *
+   * @param[in]  targetFaces  Stop once there are no more faces than this
+   * @param[in]  maxError     Stop once the least cost exceeds this
+   */
+  void run(std::size_t targetFaces, double maxError) {
+    while (_nFaces > targetFaces && !_heap.empty()) {
+      const int e = _heap.top();
+      const double cost = _heap.topCost();
+      // Neighborhoods change as nearby edges collapse, refresh before use
+      if (!evaluate(e) || _edges[e].cost != cost)
+        continue;
+      if (cost > maxError)
+        break;
+      const Edge edge = _edges[e];
+      if (!collapsible(edge.remove, edge.keep, edge.target)) {
+        _heap.remove(e);
+        continue;
+      }
+      collapse(edge.remove, edge.keep, edge.target);
+    }
+  }
+
+  /// Surviving vertices and faces, in input order
+  FlatSurfaceMesh result() const {
+    FlatSurfaceMesh out;
+    std::vector<int> index(_mesh.nVertices(), -1);
+    for (std::size_t i = 0; i < _mesh.nVertices(); ++i) {
+      if (_vertexFaces[i].empty() && !isolated(i))
+        continue;
+      index[i] = out.positions.size();
+      out.positions.push_back(_positions[i]);
+      out.vertexMarkers.push_back(_mesh.vertexMarkers[i]);
+      out.vertexSelected.push_back(_mesh.vertexSelected[i]);
+      out.vertexKeys.push_back(_mesh.vertexKeys[i]);
+    }
+
+    for (std::size_t i = 0; i < _faces.size(); ++i) {
+      if (!_faceAlive[i])
+        continue;
+      std::array<int, 3> f = {
+          {index[_faces[i][0]], index[_faces[i][1]], index[_faces[i][2]]}};
+      // Store in sorted order with the parity of the permutation
+      const int inversions = (f[0] > f[1]) + (f[0] > f[2]) + (f[1] > f[2]);
+      std::sort(f.begin(), f.end());
+      out.faces.push_back(f);
+      out.faceOrientations.push_back(inversions % 2 ? -1 : 1);
+      out.faceMarkers.push_back(_mesh.faceMarkers[i]);
+      out.faceSelected.push_back(_mesh.faceSelected[i]);
+      out.edges.push_back({{f[0], f[1]}});
+      out.edges.push_back({{f[1], f[2]}});
+      out.edges.push_back({{f[0], f[2]}});
+    }
+    std::sort(out.edges.begin(), out.edges.end());
+    out.edges.erase(std::unique(out.edges.begin(), out.edges.end()),
+                    out.edges.end());
+    return out;
+  }
+
+private:
+  struct Edge {
+    int a, b;
+    /// Vertex removed and vertex kept by the collapse
+    int remove, keep;
+    double cost;
+    Vector target;
+  };
+
+  static std::uint64_t edgeKey(int a, int b) {
+    if (a > b)
+      std::swap(a, b);
+    return (static_cast<std::uint64_t>(a) << 32) |
+           static_cast<std::uint32_t>(b);
+  }
+
+  /// Whether a vertex without faces was isolated in the input
+  bool isolated(std::size_t v) const { return _isolated[v]; }
+
+  void initQuadrics() {
+    _isolated.assign(_mesh.nVertices(), 0);
+    for (std::size_t v = 0; v < _mesh.nVertices(); ++v)
+      _isolated[v] = _vertexFaces[v].empty();
+
+    for (const auto &f : _faces) {
+      Vector n = faceNormal(f);
+      const double len = length(n);
+      if (len == 0)
+        continue;
+      n /= len;
+      const Quadric Q = Quadric::plane(n, _positions[f[0]], 1);
+      for (auto v : f)
+        _quadrics[v] += Q;
+    }
+
+    // Planes through feature edges perpendicular to each incident face keep
+    // boundaries and marker boundaries in place
+    for (const auto &edge : _mesh.edges) {
+      const int a = edge[0], b = edge[1];
+      edgeFaces(a, b, _shared);
+      if (!featureEdge(_shared))
+        continue;
+      for (auto f : _shared) {
+        Vector m = cross(_positions[b] - _positions[a], faceNormal(_faces[f]));
+        const double len = length(m);
+        if (len == 0)
+          continue;
+        m /= len;
+        const Quadric Q = Quadric::plane(m, _positions[a], FeatureWeight);
+        _quadrics[a] += Q;
+        _quadrics[b] += Q;
+      }
+    }
+  }
+
+  Vector faceNormal(const std::array<int, 3> &f) const {
+    return cross(_positions[f[1]] - _positions[f[0]],
+                 _positions[f[2]] - _positions[f[0]]);
+  }
+
+  /// Faces incident to both a and b
+  void edgeFaces(int a, int b, std::vector<int> &out) const {
+    out.clear();
+    for (auto f : _vertexFaces[a]) {
+      const auto &face = _faces[f];
+      if (face[0] == b || face[1] == b || face[2] == b)
+        out.push_back(f);
+    }
+  }
+
+  /// Boundary, non manifold, or separating two face markers
+  bool featureEdge(const std::vector<int> &shared) const {
+    return shared.size() != 2 ||
+           _mesh.faceMarkers[shared[0]] != _mesh.faceMarkers[shared[1]];
+  }
+
+  /// Vertices sharing a face with v
+  void neighbors(int v, std::vector<int> &out) {
+    out.clear();
+    ++_round;
+    _stamp[v] = _round;
+    for (auto f : _vertexFaces[v]) {
+      for (auto w : _faces[f]) {
+        if (_stamp[w] != _round) {
+          _stamp[w] = _round;
+          out.push_back(w);
+        }
+      }
+    }
+  }
+
+  /// Recount the feature edges incident to v
+  void updateFeatureDegree(int v) {
+    neighbors(v, _ringW);
+    int count = 0;
+    for (auto w : _ringW) {
+      edgeFaces(v, w, _shared);
+      count += featureEdge(_shared);
+    }
+    _featureDegree[v] = count;
+  }
+
+  void addEdge(int a, int b) {
+    const auto key = edgeKey(a, b);
+    if (_edgeIndex.count(key))
+      return;
+    _edgeIndex.emplace(key, _edges.size());
+    _edges.push_back(Edge{a, b, -1, -1, 0, Vector()});
+  }
+
+  void removeEdge(int a, int b) {
+    auto it = _edgeIndex.find(edgeKey(a, b));
+    if (it == _edgeIndex.end())
+      return;
+    _heap.remove(it->second);
+    _edgeIndex.erase(it);
+  }
+
+  /**
+   * @brief      Choose the collapse of an edge and queue it
+   *
+   * @param[in]  e     Edge index
+   *
+   * @return     Whether the edge may be collapsed
+   */
+  bool evaluate(int e) {
+    Edge &edge = _edges[e];
+    const int a = edge.a, b = edge.b;
+    if (_mesh.vertexMarkers[a] != _mesh.vertexMarkers[b]) {
+      _heap.remove(e);
+      return false;
+    }
+
+    edgeFaces(a, b, _shared);
+    const bool onFeature = featureEdge(_shared);
+    // A vertex must stay in place if it is not selected, if it is a corner
+    // of the feature lines, or if the edge leaves its feature line
+    auto pinned = [&](int v) {
+      if (!_mesh.vertexSelected[v])
+        return true;
+      const int degree = _featureDegree[v];
+      return degree > 2 || (degree > 0 && !onFeature);
+    };
+    const bool pinA = pinned(a);
+    const bool pinB = pinned(b);
+    if (pinA && pinB) {
+      _heap.remove(e);
+      return false;
+    }
+
+    Quadric Q = _quadrics[a];
+    Q += _quadrics[b];
+    Vector target;
+    if (pinA) {
+      target = _positions[a];
+    } else if (pinB) {
+      target = _positions[b];
+    } else if (!Q.minimize(target)) {
+      // Fall back to the best of the endpoints and the midpoint
+      target = _positions[a];
+      for (const Vector &p :
+           {_positions[b], 0.5 * (_positions[a] + _positions[b])}) {
+        if (Q.error(p) < Q.error(target))
+          target = p;
+      }
+    }
+
+    edge.keep = pinB ? b : a;
+    edge.remove = pinB ? a : b;
+    edge.target = target;
+    edge.cost =
+        std::max(0.0, Q.error(target)) * 0.5 * (_weights[a] + _weights[b]);
+    _heap.set(e, edge.cost);
+    return true;
+  }
+
+  /**
+   * @brief      Whether collapsing u into v at p keeps the mesh manifold and
+   *             does not flip faces
+   */
+  bool collapsible(int u, int v, const Vector &p) {
+    const auto &nu = _ringU, &nv = _ringV;
+    neighbors(u, _ringU);
+    neighbors(v, _ringV);
+    edgeFaces(u, v, _shared);
+    if (_shared.empty())
+      return false;
+
+    // Link condition: the common neighbors are the opposite vertices of the
+    // faces sharing the edge
+    ++_round;
+    for (auto w : nv)
+      _stamp[w] = _round;
+    std::size_t common = 0;
+    for (auto w : nu)
+      common += (_stamp[w] == _round);
+    if (common != _shared.size())
+      return false;
+
+    // Opposite vertices must keep at least three neighbors
+    for (auto f : _shared) {
+      for (auto w : _faces[f]) {
+        if (w == u || w == v)
+          continue;
+        neighbors(w, _ringW);
+        if (_ringW.size() <= 3)
+          return false;
+      }
+    }
+
+    // Faces which remain must not flip or become degenerate
+    for (int x : {u, v}) {
+      for (auto f : _vertexFaces[x]) {
+        const auto &face = _faces[f];
+        const bool hasU = face[0] == u || face[1] == u || face[2] == u;
+        const bool hasV = face[0] == v || face[1] == v || face[2] == v;
+        if (hasU && hasV)
+          continue;
+        const Vector before = faceNormal(face);
+        std::array<Vector, 3> moved;
+        for (int k = 0; k < 3; ++k)
+          moved[k] = (face[k] == x) ? p : _positions[face[k]];
+        const Vector after = cross(moved[1] - moved[0], moved[2] - moved[0]);
+        if (dot(before, after) <= 0)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  /// Collapse u into v and move v to p
+  void collapse(int u, int v, const Vector &p) {
+    const auto &nu = _ringU;
+    neighbors(u, _ringU);
+
+    for (auto f : _vertexFaces[u]) {
+      auto &face = _faces[f];
+      if (face[0] == v || face[1] == v || face[2] == v) {
+        _faceAlive[f] = 0;
+        --_nFaces;
+        for (auto w : face) {
+          if (w == u)
+            continue;
+          auto &list = _vertexFaces[w];
+          list.erase(std::find(list.begin(), list.end(), f));
+        }
+      } else {
+        for (auto &w : face) {
+          if (w == u)
+            w = v;
+        }
+        _vertexFaces[v].push_back(f);
+      }
+    }
+    _vertexFaces[u].clear();
+
+    _positions[v] = p;
+    _quadrics[v] += _quadrics[u];
+    _weights[v] = std::max(_weights[v], _weights[u]);
+
+    // Only edges of the faces around u changed their faces, so only the
+    // feature degrees of v and the former neighbors of u can change
+    for (auto w : nu) {
+      removeEdge(u, w);
+      if (w != v)
+        addEdge(v, w);
+    }
+    for (auto w : nu)
+      updateFeatureDegree(w);
+    _featureDegree[u] = 0;
+
+    neighbors(v, _ringV);
+    for (auto w : _ringV)
+      evaluate(_edgeIndex.at(edgeKey(v, w)));
+  }
+
+  const FlatSurfaceMesh &_mesh;
+  std::vector<Vector> _positions;
+  std::vector<Quadric> _quadrics;
+  std::vector<REAL> _weights;
+  std::vector<std::array<int, 3>> _faces;
+  std::vector<char> _faceAlive;
+  std::vector<std::vector<int>> _vertexFaces;
+  /// Number of feature edges incident to each vertex
+  std::vector<int> _featureDegree;
+  std::vector<char> _isolated;
+  std::size_t _nFaces = 0;
+
+  std::vector<Edge> _edges;
+  std::unordered_map<std::uint64_t, int> _edgeIndex;
+  EdgeHeap _heap;
+
+  /// Scratch marks for neighbor queries
+  std::vector<std::size_t> _stamp;
+  std::size_t _round = 0;
+  /// Scratch lists reused across queries
+  std::vector<int> _shared, _ringU, _ringV, _ringW;
+};
+} // end anonymous namespace
+
+FlatSurfaceMesh decimateQuadric(const FlatSurfaceMesh &mesh,
+                                std::size_t targetFaces, REAL maxError,
+                                const std::vector<REAL> &weights,
+                                bool verbose) {
+  if (!weights.empty() && weights.size() != mesh.nVertices()) {
+    gamer_runtime_error("Number of weights must match the number of "
+                        "vertices.");
+  }
+  QuadricDecimator decimator(mesh, weights);
+  decimator.run(targetFaces, maxError);
+  FlatSurfaceMesh out = decimator.result();
+  if (verbose) {
+    std::cout << "Decimated " << mesh.nFaces() << " faces to "
+              << out.nFaces() << " faces and " << mesh.nVertices()
+              << " vertices to " << out.nVertices() << " vertices."
+              << std::endl;
+  }
+  return out;
+}
+
+std::unique_ptr<SurfaceMesh> decimateQuadric(const SurfaceMesh &mesh,
+                                             std::size_t targetFaces,
+                                             REAL maxError, REAL flatRate,
+                                             std::size_t rings,
+                                             bool verbose) {
+  FlatSurfaceMesh flat = flatten(mesh);
+
+  // Weight the error by the LST flatness ratio as in coarse
+  std::vector<REAL> weights;
+  if (flatRate > 0) {
+    KRingCache cache(mesh, rings);
+    weights.reserve(flat.nVertices());
+    for (auto vertexID : mesh.get_level_id<1>()) {
+      auto lst = surfacemesh_detail::computeLocalStructureTensor(
+          mesh, cache, cache.index(mesh, vertexID));
+
+      EigenVector eigenvalues;
+      EigenMatrix eigenvectors;
+      EigenDiagonalizeTraits<REAL, 3>::diagonalizeSelfAdjointMatrix(
+          lst, eigenvalues, eigenvectors);
+
+      // The closer this ratio is to 0 the flatter the local region.
+      weights.push_back(std::pow(eigenvalues[1] / eigenvalues[2], flatRate));
+    }
+  }
+
+  FlatSurfaceMesh out =
+      decimateQuadric(flat, targetFaces, maxError, weights, verbose);
+
+  std::vector<SMVertex> vertices;
+  vertices.reserve(out.nVertices());
+  for (std::size_t i = 0; i < out.nVertices(); ++i) {
+    const Vector &p = out.positions[i];
+    vertices.push_back(SMVertex(p[0], p[1], p[2], out.vertexMarkers[i],
+                                out.vertexSelected[i]));
+  }
+  std::vector<SMFace> faceData;
+  faceData.reserve(out.nFaces());
+  for (std::size_t i = 0; i < out.nFaces(); ++i) {
+    faceData.push_back(SMFace(out.faceOrientations[i], out.faceMarkers[i],
+                              out.faceSelected[i]));
+  }
+  auto result = buildSurfaceMesh(vertices, out.faces, faceData);
+
+  // Keep the orientation of the input rather than the one chosen by
+  // compute_orientation
+  for (std::size_t i = 0; i < out.nFaces(); ++i) {
+    const auto &f = out.faces[i];
+    (*result->get_simplex_up({f[0], f[1], f[2]})).orientation =
+        out.faceOrientations[i];
+  }
+  *result->get_simplex_up() = *mesh.get_simplex_up();
+  return result;
+}
+} // end namespace gamer
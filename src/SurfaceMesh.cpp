@@ -25,16 +25,22 @@
 #include <iomanip>
 #include <map>
 #include <ostream>
+#include <set>
+#include <sstream>
 #include <stdexcept>
 #include <strstream>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 
 #include "gamer/EigenDiagonalization.h"
+#include "gamer/FlatSurfaceMesh.h"
+#include "gamer/KRingCache.h"
 #include "gamer/SurfaceMesh.h"
 #include "gamer/Vertex.h"
+#include "gamer/parallel.h"
 
 /// Namespace for all things gamer
 namespace gamer {
@@ -416,7 +422,7 @@ Vector getNormal(const SurfaceMesh &mesh, SurfaceMesh::SimplexID<3> faceID) {
 }
 
 void smoothMesh(SurfaceMesh &mesh, int maxIter, bool preserveRidges,
-                std::size_t rings, bool verbose) {
+                std::size_t rings, bool verbose, std::size_t nthreads) {
   double maxMinAngle = 15;
   double minMaxAngle = 165;
   double minAngle, maxAngle;
@@ -433,38 +439,56 @@ void smoothMesh(SurfaceMesh &mesh, int maxIter, bool preserveRidges,
               << std::endl;
   }
 
-  std::vector<std::pair<SurfaceMesh::SimplexID<1>, Vector>> delta;
+  std::vector<SurfaceMesh::SimplexID<1>> selected;
+  std::vector<Vector> delta;
 
-  // Cache normals before entering loop
+  // Cache normals and k-ring neighborhoods before entering loop
   cacheNormals(mesh);
+  KRingCache kring(mesh, rings, nthreads);
   for (int nIter = 1; nIter <= maxIter; ++nIter) {
     for (auto vertex : mesh.get_level_id<1>()) {
       if ((*vertex).selected == true) {
-        // surfacemesh_detail::weightedVertexSmooth(mesh, vertex,
-        // rings);
-        delta.push_back(std::make_pair(
-            vertex, surfacemesh_detail::weightedVertexSmoothCache(mesh, vertex,
-                                                                  rings)));
+        selected.push_back(vertex);
       }
-      // barycenterVertexSmooth(mesh, vertex);
     }
+    delta.resize(selected.size());
+
+    // Jacobi style update: displacements only read the mesh so each thread
+    // fills its own slice of delta before anything is moved.
+    parallel::for_each_chunk(
+        0, selected.size(), nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end) {
+          for (std::size_t i = begin; i < end; ++i) {
+            // surfacemesh_detail::weightedVertexSmooth(mesh, vertex,
+            // rings);
+            delta[i] = surfacemesh_detail::weightedVertexSmoothCache(
+                mesh, kring, selected[i]);
+          }
+        });
 
-    for (auto pair : delta) {
-      *pair.first += pair.second;
+    for (std::size_t i = 0; i < selected.size(); ++i) {
+      *selected[i] += delta[i];
     }
-    delta.clear();
+    selected.clear();
     cacheNormals(mesh);
 
     // ATOMIC EDGE FLIP
     std::vector<SurfaceMesh::SimplexID<2>> edgesToFlip;
     // Get set of good, non-interfering edges to flip according to the
-    // Angle based criteria.
-    surfacemesh_detail::selectFlipEdges(mesh, preserveRidges,
-                                        surfacemesh_detail::checkFlipAngle,
-                                        std::back_inserter(edgesToFlip));
+    // Angle based criteria. Only the candidate pre-check runs in parallel,
+    // the set is built serially and the flips are applied one at a time.
+    surfacemesh_detail::selectFlipEdges(
+        mesh, preserveRidges, surfacemesh_detail::checkFlipAngle,
+        std::back_inserter(edgesToFlip), nthreads);
+    // Only neighborhoods near a flipped edge need to be recomputed
+    for (auto edgeID : edgesToFlip) {
+      auto name = mesh.get_name(edgeID);
+      kring.invalidate(mesh, mesh.get_simplex_up({name[0]}));
+    }
     for (auto edgeID : edgesToFlip) {
       surfacemesh_detail::edgeFlipCache(mesh, edgeID);
     }
+    kring.update(mesh, nthreads);
 
     if (verbose) {
       std::tie(minAngle, maxAngle, nSmall, nLarge) =
@@ -479,6 +503,93 @@ void smoothMesh(SurfaceMesh &mesh, int maxIter, bool preserveRidges,
   }
 }
 
+namespace {
+/**
+ * @brief      Shared implementation of buildSurfaceMesh
+ *
+ * @param[in]  nVertices   Number of vertices
+ * @param[in]  nFaces      Number of faces
+ * @param[in]  vertexData  Functor returning the SMVertex of index i
+ * @param[in]  faceIndices Functor returning the vertex indices of face i
+ * @param[in]  faceData    Functor returning the SMFace of face i
+ * @param[in]  orient      Whether to compute the orientation
+ */
+template <typename VertexFunc, typename IndexFunc, typename FaceFunc>
+std::unique_ptr<SurfaceMesh>
+buildSurfaceMeshImpl(std::size_t nVertices, std::size_t nFaces,
+                     VertexFunc &&vertexData, IndexFunc &&faceIndices,
+                     FaceFunc &&faceData, bool orient) {
+  // Validate everything before touching the complex so that a bad buffer
+  // does not leave behind a half built mesh.
+  for (std::size_t i = 0; i < nFaces; ++i) {
+    const std::array<int, 3> f = faceIndices(i);
+    for (auto v : f) {
+      if (v < 0 || static_cast<std::size_t>(v) >= nVertices) {
+        std::stringstream ss;
+        ss << "Face " << i << " references vertex " << v
+           << " which is out of range [0, " << nVertices << ").";
+        gamer_runtime_error(ss.str());
+      }
+    }
+    if (f[0] == f[1] || f[1] == f[2] || f[0] == f[2]) {
+      std::stringstream ss;
+      ss << "Face " << i << " is degenerate (" << f[0] << ", " << f[1] << ", "
+         << f[2] << ").";
+      gamer_runtime_error(ss.str());
+    }
+  }
+
+  std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
+  for (std::size_t i = 0; i < nVertices; ++i) {
+    mesh->insert<1>({static_cast<int>(i)}, vertexData(i));
+  }
+  for (std::size_t i = 0; i < nFaces; ++i) {
+    mesh->insert<3>(faceIndices(i), faceData(i));
+  }
+  if (orient) {
+    casc::compute_orientation(*mesh);
+  }
+  return mesh;
+}
+} // end anonymous namespace
+
+std::unique_ptr<SurfaceMesh>
+buildSurfaceMesh(const REAL *vertices, std::size_t nVertices, const int *faces,
+                 std::size_t nFaces, const int *markers, bool orient) {
+  return buildSurfaceMeshImpl(
+      nVertices, nFaces,
+      [vertices](std::size_t i) {
+        return SMVertex(vertices[3 * i], vertices[3 * i + 1],
+                        vertices[3 * i + 2]);
+      },
+      [faces](std::size_t i) {
+        return std::array<int, 3>{faces[3 * i], faces[3 * i + 1],
+                                  faces[3 * i + 2]};
+      },
+      [markers](std::size_t i) {
+        return markers ? SMFace(markers[i], false) : SMFace();
+      },
+      orient);
+}
+
+std::unique_ptr<SurfaceMesh>
+buildSurfaceMesh(const std::vector<SMVertex> &vertices,
+                 const std::vector<std::array<int, 3>> &faces,
+                 const std::vector<SMFace> &faceData, bool orient) {
+  if (!faceData.empty() && faceData.size() != faces.size()) {
+    gamer_runtime_error("Number of face data entries must match the number "
+                        "of faces.");
+  }
+  return buildSurfaceMeshImpl(
+      vertices.size(), faces.size(),
+      [&vertices](std::size_t i) { return vertices[i]; },
+      [&faces](std::size_t i) { return faces[i]; },
+      [&faceData](std::size_t i) {
+        return faceData.empty() ? SMFace() : faceData[i];
+      },
+      orient);
+}
+
 /**
  * @brief      Refine the mesh by quadrisection.
  *
@@ -509,7 +620,7 @@ std::unique_ptr<SurfaceMesh> refineMesh(const SurfaceMesh &mesh) {
     edgeMap.emplace(std::make_pair(edgeName, newVertex));
   }
 
-  // Connect edges and face and copy data
+  // Connect faces and copy data, inserting a face also inserts its edges
   for (auto face : mesh.get_level_id<3>()) {
     auto name = mesh.get_name(face);
     int a, b, c;
@@ -524,15 +635,6 @@ std::unique_ptr<SurfaceMesh> refineMesh(const SurfaceMesh &mesh) {
     it = edgeMap.find({name[0], name[2]});
     c = it->second;
 
-    refinedMesh->insert({name[0], a});
-    refinedMesh->insert({a, name[1]});
-
-    refinedMesh->insert({name[1], b});
-    refinedMesh->insert({b, name[2]});
-
-    refinedMesh->insert({name[0], c});
-    refinedMesh->insert({c, name[2]});
-
     refinedMesh->insert({a, b, c});
     refinedMesh->insert({name[0], a, c}, *face);
     refinedMesh->insert({name[1], a, b}, *face);
@@ -541,24 +643,83 @@ std::unique_ptr<SurfaceMesh> refineMesh(const SurfaceMesh &mesh) {
   return refinedMesh;
 }
 
-void coarse(SurfaceMesh &mesh, double coarseRate, double flatRate,
-            double denseWeight, std::size_t rings, bool verbose) {
-  // TODO: Check if all polygons are closed (0)
-
-  // Compute the average edge length
-  double avgLen = 0;
+namespace {
+/**
+ * @brief      Evaluate the coarse criteria of one vertex on the live mesh
+ *
+ * @param[in]  mesh         The mesh
+ * @param[in]  vertexID     The vertex
+ * @param[in]  flatRate     The flat rate
+ * @param[in]  denseWeight  The dense weight
+ * @param[in]  rings        Number of neighborhood rings to consider for LST
+ * @param      scores       Scores to update at index i
+ * @param[in]  i            Index of the vertex in the scores
+ */
+void rescore(const SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID,
+             double flatRate, double denseWeight, std::size_t rings,
+             CoarseScores &scores, std::size_t i) {
+  // Sparseness as coarsening criteria
   if (denseWeight > 0) {
-    for (auto edgeID : mesh.get_level_id<2>()) {
+    // Get max length of edges.
+    double maxLen = 0;
+    for (auto edgeID : mesh.up(vertexID)) {
       auto name = mesh.get_name(edgeID);
       auto v = *mesh.get_simplex_down(edgeID, name[0]) -
                *mesh.get_simplex_down(edgeID, name[1]);
-      avgLen += length(v);
+      maxLen = std::max<double>(maxLen, std::sqrt(v | v));
     }
-    avgLen /= static_cast<double>(mesh.size<2>());
+    scores.sparseness[i] = std::pow(maxLen / scores.avgLen, denseWeight);
   }
 
-  double sparsenessRatio = 1;
-  double flatnessRatio = 1;
+  // Curvature as coarsening criteria
+  if (flatRate > 0) {
+    auto lst =
+        surfacemesh_detail::computeLocalStructureTensor(mesh, vertexID, rings);
+
+    EigenVector eigenvalues;
+    EigenMatrix eigenvectors;
+
+    EigenDiagonalizeTraits<REAL, 3>::diagonalizeSelfAdjointMatrix(
+        lst, eigenvalues, eigenvectors);
+
+    // The closer this ratio is to 0 the flatter the local region.
+    scores.flatness[i] = std::pow(eigenvalues[1] / eigenvalues[2], flatRate);
+  }
+  scores.score[i] = scores.sparseness[i] * scores.flatness[i];
+}
+
+/**
+ * @brief      Flag the scores which a decimation of vertexID may change
+ *
+ * The decimation changes the star of vertexID and moves its one ring, so
+ * normals change up to two rings away and local structure tensors up to
+ * rings+2 away.
+ */
+void markStale(const SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID,
+               std::size_t rings,
+               const std::unordered_map<int, std::size_t> &index,
+               std::vector<char> &stale) {
+  std::set<SurfaceMesh::SimplexID<1>> nbors;
+  casc::kneighbors_up(mesh, vertexID, rings + 2, nbors);
+  for (auto nid : nbors) {
+    stale[index.at(mesh.get_name(nid)[0])] = 1;
+  }
+}
+} // end anonymous namespace
+
+void coarse(SurfaceMesh &mesh, double coarseRate, double flatRate,
+            double denseWeight, std::size_t rings, bool verbose) {
+  // TODO: Check if all polygons are closed (0)
+
+  // Score every vertex up front, then only rescore those near a decimation
+  FlatSurfaceMesh flat = flatten(mesh);
+  CoarseScores scores = coarseScores(flat, flatRate, denseWeight, rings);
+  std::unordered_map<int, std::size_t> index;
+  for (std::size_t i = 0; i < flat.nVertices(); ++i) {
+    index[flat.vertexKeys[i]] = i;
+  }
+  std::vector<char> stale(flat.nVertices(), 0);
+  std::size_t nRemoved = 0;
 
   auto range = mesh.get_level_id<1>();
 
@@ -572,42 +733,23 @@ void coarse(SurfaceMesh &mesh, double coarseRate, double flatRate,
       continue;
     }
 
-    // Sparseness as coarsening criteria
-    if (denseWeight > 0) {
-      // Get max length of edges.
-      auto edges = mesh.up(vertexID);
-      double maxLen = 0;
-      for (auto edgeID : edges) {
-        auto name = mesh.get_name(edgeID);
-        auto v = *mesh.get_simplex_down(edgeID, name[0]) -
-                 *mesh.get_simplex_down(edgeID, name[1]);
-        double tmpLen = std::sqrt(v | v);
-        if (tmpLen > maxLen)
-          maxLen = tmpLen;
-      }
-      sparsenessRatio = std::pow(maxLen / avgLen, denseWeight);
-    }
-
-    // Curvature as coarsening criteria
-    if (flatRate > 0) {
-      auto lst = surfacemesh_detail::computeLocalStructureTensor(mesh, vertexID,
-                                                                 rings);
-
-      EigenVector eigenvalues;
-      EigenMatrix eigenvectors;
-
-      EigenDiagonalizeTraits<REAL, 3>::diagonalizeSelfAdjointMatrix(
-          lst, eigenvalues, eigenvectors);
-
-      // The closer this ratio is to 0 the flatter the local region.
-      flatnessRatio = std::pow(eigenvalues[1] / eigenvalues[2], flatRate);
+    auto i = index.at(mesh.get_name(vertexID)[0]);
+    if (stale[i]) {
+      rescore(mesh, vertexID, flatRate, denseWeight, rings, scores, i);
+      stale[i] = 0;
     }
 
     // Add vertex to delete list
-    if (sparsenessRatio * flatnessRatio < coarseRate) {
+    if (scores.score[i] < coarseRate) {
+      markStale(mesh, vertexID, rings, index, stale);
       surfacemesh_detail::decimateVertex(mesh, vertexID);
+      ++nRemoved;
     }
   }
+
+  if (verbose) {
+    std::cout << "Removed " << nRemoved << " vertices." << std::endl;
+  }
 }
 
 void coarse_dense(SurfaceMesh &mesh, REAL threshold, REAL weight,
@@ -690,6 +832,148 @@ void coarse_flat(SurfaceMesh &mesh, REAL threshold, REAL weight,
   }
 }
 
+void coarse_parallel(SurfaceMesh &mesh, double coarseRate, double flatRate,
+                     double denseWeight, std::size_t rings, bool verbose,
+                     std::size_t nthreads) {
+  // Smooth filled holes as deep as coarse does through the default of
+  // decimateVertex. The LST rings only drive the scores.
+  const std::size_t smoothRings = 2;
+
+  // Smoothing after a decimation reads up to smoothRings+2 from the removed
+  // vertex and writes its one ring, so two decimations commute once their
+  // centers are smoothRings+4 apart. Claiming disjoint zones of this radius
+  // guarantees it.
+  const std::size_t radius = (smoothRings + 5) / 2;
+
+  // Score every vertex up front, then only rescore those near a decimation
+  FlatSurfaceMesh flat = flatten(mesh);
+  CoarseScores scores =
+      coarseScores(flat, flatRate, denseWeight, rings, nthreads);
+  std::unordered_map<int, std::size_t> index;
+  for (std::size_t i = 0; i < flat.nVertices(); ++i) {
+    index[flat.vertexKeys[i]] = i;
+  }
+  std::vector<char> stale(flat.nVertices(), 0);
+
+  // Vertices in flat order
+  std::vector<SurfaceMesh::SimplexID<1>> vertices;
+  vertices.reserve(flat.nVertices());
+  for (auto vertexID : mesh.get_level_id<1>()) {
+    vertices.push_back(vertexID);
+  }
+
+  std::vector<std::size_t> pending;
+  for (std::size_t i = 0; i < flat.nVertices(); ++i) {
+    if (flat.vertexSelected[i]) {
+      pending.push_back(i);
+    }
+  }
+
+  std::vector<std::vector<int>> zones;
+  std::vector<std::size_t> order, chosen, blocked;
+  std::vector<std::set<SurfaceMesh::SimplexID<1>>> boundaries;
+  std::set<int> claimed;
+  std::size_t nRemoved = 0, nRounds = 0;
+
+  while (!pending.empty()) {
+    zones.assign(pending.size(), {});
+
+    // Rescore vertices near earlier decimations and gather the zones of the
+    // candidates, reading the mesh only
+    parallel::for_each_chunk(
+        0, pending.size(), nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end) {
+          for (std::size_t k = begin; k < end; ++k) {
+            const auto i = pending[k];
+            auto vertexID = vertices[i];
+            if (stale[i]) {
+              rescore(mesh, vertexID, flatRate, denseWeight, rings, scores,
+                      i);
+              stale[i] = 0;
+            }
+
+            if (scores.score[i] < coarseRate) {
+              std::set<SurfaceMesh::SimplexID<1>> nbors;
+              casc::kneighbors_up(mesh, vertexID, radius, nbors);
+              zones[k].push_back(mesh.get_name(vertexID)[0]);
+              for (auto nid : nbors) {
+                zones[k].push_back(mesh.get_name(nid)[0]);
+              }
+            }
+          }
+        });
+
+    // Greedily pick candidates with the lowest scores first whose zones do
+    // not overlap. Vertices above the threshold are done, like a single
+    // pass of coarse, and blocked candidates are reconsidered next round.
+    order.clear();
+    for (std::size_t k = 0; k < pending.size(); ++k) {
+      if (scores.score[pending[k]] < coarseRate) {
+        order.push_back(k);
+      }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t lhs, std::size_t rhs) {
+                       return scores.score[pending[lhs]] <
+                              scores.score[pending[rhs]];
+                     });
+
+    chosen.clear();
+    blocked.clear();
+    claimed.clear();
+    for (auto k : order) {
+      const auto &zone = zones[k];
+      bool isFree = std::none_of(zone.begin(), zone.end(), [&](int key) {
+        return claimed.count(key) > 0;
+      });
+      if (isFree) {
+        claimed.insert(zone.begin(), zone.end());
+        chosen.push_back(pending[k]);
+      } else {
+        blocked.push_back(pending[k]);
+      }
+    }
+
+    // Flag the affected scores while distances are still those of the
+    // scored mesh
+    for (auto i : chosen) {
+      markStale(mesh, vertices[i], rings, index, stale);
+    }
+
+    // Changing the complex is not thread safe, retriangulate serially
+    boundaries.clear();
+    for (auto i : chosen) {
+      boundaries.push_back(
+          surfacemesh_detail::removeAndTriangulate(mesh, vertices[i]));
+    }
+
+    // Zones are disjoint so each hole can be smoothed by its own thread
+    parallel::for_each_chunk(
+        0, boundaries.size(), nthreads,
+        [&](std::size_t, std::size_t begin, std::size_t end) {
+          for (std::size_t k = begin; k < end; ++k) {
+            for (auto v : boundaries[k]) {
+              surfacemesh_detail::weightedVertexSmooth(mesh, v, smoothRings);
+            }
+          }
+        });
+
+    nRemoved += chosen.size();
+    ++nRounds;
+    if (verbose) {
+      std::cout << "Round " << nRounds << ": removed " << chosen.size()
+                << " vertices, " << blocked.size() << " deferred."
+                << std::endl;
+    }
+    pending.swap(blocked);
+  }
+
+  if (verbose) {
+    std::cout << "Removed " << nRemoved << " vertices in " << nRounds
+              << " rounds." << std::endl;
+  }
+}
+
 void fillHoles(SurfaceMesh &mesh) {
   std::vector<std::vector<SurfaceMesh::SimplexID<2>>> holeList;
   surfacemesh_detail::findHoles(mesh, holeList);
@@ -30,6 +30,7 @@
 #include <casc/casc>
 
 #include "gamer/EigenDiagonalization.h"
+#include "gamer/KRingCache.h"
 #include "gamer/SurfaceMesh.h"
 #include "gamer/Vertex.h"
 
@@ -84,6 +85,16 @@ computeLSTFromCache(const SurfaceMesh &mesh,
 
 void decimateVertex(SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID,
                     std::size_t rings) {
+  auto boundary = removeAndTriangulate(mesh, vertexID);
+
+  // Smooth vertices around the filled hole
+  for (auto v : boundary) {
+    weightedVertexSmooth(mesh, v, rings);
+  }
+}
+
+std::set<SurfaceMesh::SimplexID<1>>
+removeAndTriangulate(SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID) {
   // TODO: (10) Come up with a better scheme
   // Pick an arbitrary face's data
   auto fdata = **mesh.up(std::move(mesh.up(vertexID))).begin();
@@ -154,11 +165,7 @@ void decimateVertex(SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID,
   }
 
   triangulateHole(mesh, sortedVerts, fdata, edgeList);
-
-  // Smooth vertices around the filled hole
-  for (auto v : backupBoundary) {
-    weightedVertexSmooth(mesh, v, rings);
-  }
+  return backupBoundary;
 }
 
 void triangulateHoleHelper(
@@ -442,9 +449,21 @@ void weightedVertexSmooth(SurfaceMesh &mesh, SurfaceMesh::SimplexID<1> vertexID,
   center.position += newPos;
 }
 
-Vector weightedVertexSmoothCache(SurfaceMesh &mesh,
-                                 SurfaceMesh::SimplexID<1> vertexID,
-                                 std::size_t rings) {
+/**
+ * @brief      Compute the weightedVertexSmooth displacement of a vertex
+ *
+ * @param      mesh      SurfaceMesh of interest.
+ * @param[in]  vertexID  SimplexID of the vertex to move.
+ * @param      getLST    Functor returning the local structure tensor
+ *
+ * @tparam     LSTFunc   Typename of the functor
+ *
+ * @return     Displacement of the vertex
+ */
+template <typename LSTFunc>
+static Vector weightedVertexDisplacement(SurfaceMesh &mesh,
+                                         SurfaceMesh::SimplexID<1> vertexID,
+                                         LSTFunc &&getLST) {
   auto centerName = mesh.get_name(vertexID)[0];
   auto &center = *vertexID; // get the vertex data
 
@@ -534,7 +553,7 @@ Vector weightedVertexSmoothCache(SurfaceMesh &mesh,
    * \bar{x} = x + \sum_{k=1}^3 \frac{1}{1+\lambda_k}((\bar{x} - x)\cdot
    * \vec{e_k})\vec{e_k}
    */
-  auto lst = computeLocalStructureTensor(mesh, vertexID, rings);
+  auto lst = getLST();
 
   EigenVector eigenvalues;
   EigenMatrix eigenvectors;
@@ -560,6 +579,22 @@ Vector weightedVertexSmoothCache(SurfaceMesh &mesh,
   return newPos;
 }
 
+Vector weightedVertexSmoothCache(SurfaceMesh &mesh,
+                                 SurfaceMesh::SimplexID<1> vertexID,
+                                 std::size_t rings) {
+  return weightedVertexDisplacement(mesh, vertexID, [&]() {
+    return computeLocalStructureTensor(mesh, vertexID, rings);
+  });
+}
+
+Vector weightedVertexSmoothCache(SurfaceMesh &mesh, const KRingCache &cache,
+                                 SurfaceMesh::SimplexID<1> vertexID) {
+  return weightedVertexDisplacement(mesh, vertexID, [&]() {
+    return computeLocalStructureTensor(mesh, cache,
+                                       cache.index(mesh, vertexID));
+  });
+}
+
 /**
  * @brief      Perona-Malik normal based smoothing algorithm
  *
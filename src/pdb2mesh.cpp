@@ -32,14 +32,18 @@
 
 #include "gamer/PDBReader.h"
 #include "gamer/SurfaceMesh.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <vector>
 
 /// Namespace for all things gamer
 namespace gamer {
 
-#define IndexVect1(i, j, k) ((k)*xdim1 * ydim1 + (j)*xdim1 + (i))
+namespace {
+
 #define MaxVal 999999
 #define MaxAtom 10
 
@@ -50,9 +54,9 @@ struct MOL_VERTEX {
   unsigned char neigh; // first bit: +x; second bit: -x
                        // third bit: +y; fourth bit: -y
                        // fifth bit: +z; sixth  bit: -z
-  unsigned short px;   // the corresponding index
-  unsigned short py;
-  unsigned short pz;
+  std::int32_t px;     // the corresponding index
+  std::int32_t py;
+  std::int32_t pz;
 };
 
 /** @brief Other data structure FLTVECT (float) */
@@ -78,16 +82,159 @@ struct INT4VECT {
   int d; /**< @brief fourth integer */
 };
 
-/** @brief Other data structure MinHeapS */
-struct MinHeapS {
-  unsigned short *x; /**< @brief x-coordinate */
-  unsigned short *y; /**< @brief y-coordinate */
-  unsigned short *z; /**< @brief z-coordinate */
-  int *seed;         /**< @brief seed */
-  float *dist;       /**< @brief distance */
-  int size;          /**< @brief size */
+/** @brief Voxel queued in the fast marching heap */
+struct HeapEntry {
+  std::int32_t x; /**< @brief x-coordinate */
+  std::int32_t y; /**< @brief y-coordinate */
+  std::int32_t z; /**< @brief z-coordinate */
+  int seed;       /**< @brief seed */
+  float dist;     /**< @brief distance */
 };
 
+/**
+ * @brief      Indexed binary min heap of voxels keyed by distance.
+ *
+ * The heap slot of every queued voxel is kept in a caller provided grid so
+ * that the key of a queued voxel is changed in O(log n). Entries of the grid
+ * which do not belong to queued voxels are left untouched and may encode
+ * other voxel states.
+ */
+class MinHeapS {
+public:
+  /**
+   * @brief      Empty the heap and attach it to a slot grid
+   *
+   * @param      slots     Grid receiving the heap slot of queued voxels
+   * @param[in]  xdim      Grid dimension along x
+   * @param[in]  ydim      Grid dimension along y
+   * @param[in]  capacity  Expected number of entries
+   */
+  void reset(int *slots, int xdim, int ydim, std::size_t capacity) {
+    _slots = slots;
+    _xdim = xdim;
+    _ydim = ydim;
+    _size = 0;
+    _entries.assign(capacity, HeapEntry{0, 0, 0, 0, 0});
+  }
+
+  /// Number of entries
+  int size() const { return _size; }
+
+  /// Entry in a heap slot
+  const HeapEntry &operator[](int i) const { return _entries[i]; }
+
+  /// Insert a voxel
+  void push(int x, int y, int z, int seed, float dist);
+
+  /// Change the key of a queued voxel
+  void update(int x, int y, int z, int seed, float dist);
+
+  /// Remove the minimum. The slot of the removed voxel is not cleared.
+  void pop();
+
+  /// Append a voxel without ordering or slot bookkeeping
+  void append(int x, int y, int z) {
+    reserve(_size + 1);
+    _entries[_size++] = HeapEntry{x, y, z, 0, 0};
+  }
+
+private:
+  int &slot(const HeapEntry &e) {
+    return _slots[(static_cast<std::size_t>(e.z) * _ydim + e.y) * _xdim +
+                  e.x];
+  }
+
+  /// Move the entry of slot `from` to slot `to`
+  void move(int from, int to) {
+    _entries[to] = _entries[from];
+    slot(_entries[to]) = to;
+  }
+
+  /// Place an entry at a slot after sifting
+  void place(int i, const HeapEntry &e) {
+    _entries[i] = e;
+    slot(_entries[i]) = i;
+  }
+
+  /// Move the hole at 1-based position pointer down past smaller children
+  int siftDown(int pointer, float dist);
+
+  void reserve(std::size_t n) {
+    // Keep the slot after the last entry readable for siftDown
+    if (n + 1 > _entries.size())
+      _entries.resize(std::max(n + 1, 2 * _entries.size()));
+  }
+
+  std::vector<HeapEntry> _entries;
+  int _size = 0;
+  int *_slots = nullptr;
+  int _xdim = 0;
+  int _ydim = 0;
+};
+
+int MinHeapS::siftDown(int pointer, float dist) {
+  while (pointer <= _size / 2) {
+    const int left = 2 * pointer;
+    const int right = 2 * pointer + 1;
+
+    if ((_entries[left - 1].dist <= _entries[right - 1].dist) &&
+        (_entries[left - 1].dist < dist)) {
+      move(left - 1, pointer - 1);
+      pointer = left;
+    } else if ((_entries[left - 1].dist > _entries[right - 1].dist) &&
+               (_entries[right - 1].dist < dist)) {
+      move(right - 1, pointer - 1);
+      pointer = right;
+    } else {
+      break;
+    }
+  }
+  return pointer;
+}
+
+void MinHeapS::pop() {
+  _size--;
+  const HeapEntry last = _entries[_size];
+  place(siftDown(1, last.dist) - 1, last);
+}
+
+void MinHeapS::push(int x, int y, int z, int seed, float dist) {
+  reserve(_size + 1);
+  _size++;
+  int pointer = _size;
+
+  while (pointer > 1) {
+    const int parent = pointer / 2;
+    if (dist < _entries[parent - 1].dist) {
+      move(parent - 1, pointer - 1);
+      pointer = parent;
+    } else {
+      break;
+    }
+  }
+  place(pointer - 1, HeapEntry{x, y, z, seed, dist});
+}
+
+void MinHeapS::update(int x, int y, int z, int seed, float dist) {
+  HeapEntry e{x, y, z, seed, dist};
+  int pointer = slot(e) + 1;
+
+  // checking the upper elements
+  while (pointer > 1) {
+    const int parent = pointer / 2;
+    if (dist < _entries[parent - 1].dist) {
+      move(parent - 1, pointer - 1);
+      pointer = parent;
+    } else {
+      break;
+    }
+  }
+
+  // checking the lower elements
+  pointer = siftDown(pointer, dist);
+  place(pointer - 1, e);
+}
+
 /** @brief Other data structure SEEDS */
 struct SEEDS {
   float seedx;       /**< @brief x-coordinate */
@@ -104,49 +251,64 @@ struct ATOM {
   float radius; /**< @brief radius */
 };
 
-int GLOBAL_xdim, GLOBAL_ydim, GLOBAL_zdim;
-
-// GRID variables
-int *GLOBAL_segment_index;
-int *GLOBAL_atom_index;
-
-// Border variables
-INT4VECT *GLOBAL_quads;
-int GLOBAL_vert_num;
-MOL_VERTEX *GLOBAL_vertex;
-int GLOBAL_quad_num;
-
-#undef IndexVect
-#define IndexVect(i, j, k) (((k)*GLOBAL_ydim + (j)) * GLOBAL_xdim + (i))
-
-int CheckFaceCorner(float x, float y, float z);
+#define MaxDist 29999
+#define IndexVect(i, j, k) (((k)*ydim + (j)) * xdim + (i))
 
-void SetAtomIndex(int, int, int, int);
-int ExtractSAS(int atom_num, ATOM *atom_list);
-char CheckManifold(int i, int j, int k);
-float GetAngle(int a, int b, int c);
+/**
+ * @brief      Working state of a single molsurf run.
+ *
+ * The grids, heap and mesh buffers are owned by the context and released
+ * when it goes out of scope, including when an exception is thrown. Runs
+ * with separate contexts share no state and may proceed concurrently.
+ */
+class MolSurf {
+public:
+  /**
+   * @brief      Mesh the molecular surface of a set of atoms
+   *
+   * @param[in]  atoms  Atom positions and radii
+   *
+   * @return     Meshed object
+   */
+  std::unique_ptr<SurfaceMesh> run(const std::vector<Atom> &atoms,
+                                   const GridResolution &resolution);
+
+private:
+  int ExtractSAS(int atom_num);
+  void ExtractSES(float thresh);
+  void GetMinimum(void);
+  void Marching(void);
+  bool MarchNeighbor(int x, int y, int z, float seedx, float seedy,
+                     float seedz);
+  FLTVECT FindSeed(float, float, float, int);
+  char CheckManifold(int i, int j, int k);
+  int CheckFaceCorner(float x, float y, float z);
+  float GetAngle(int a, int b, int c);
+
+  int xdim, ydim, zdim;
+
+  // GRID variables
+  std::vector<int> segment_index;
+  std::vector<int> atom_index;
+
+  // Border variables
+  std::vector<INT4VECT> quads;
+  std::vector<MOL_VERTEX> vertex;
+
+  // Fast marching variables
+  MinHeapS min_heap;
+  std::vector<SEEDS> AllSeeds;
+  int *heap_pointer;
+  const ATOM *atom_list;
+  float threshold;
+  int min_x, min_y, min_z;
+  int min_seed;
+  float min_dist;
+};
 
-#define MaxDist 29999
+FLT2VECT FindIntersection(int n, int m, int j, int k, const ATOM *atom_list);
 
-int xdim1, ydim1, zdim1;
-MinHeapS *min_heap;
-SEEDS *AllSeeds;
-int *heap_pointer;
-ATOM *atom_list;
-float threshold;
-unsigned short min_x, min_y, min_z;
-int min_seed;
-float min_dist;
-
-void GetMinimum(void);
-void InsertHeap(int, int, int, float);
-void UpdateHeap(int, int, int, float);
-void Marching(void);
-FLTVECT FindSeed(float, float, float, int);
-
-void ExtractSES(MinHeapS *mheap, SEEDS *all_seeds, int *heappointer, int xd,
-                int yd, int zd, int *atom_index, int atom_num, ATOM *atomlist,
-                float thresh) {
+void MolSurf::ExtractSES(float thresh) {
   int i, j, k;
   int m, n, l, num, c;
   int index, index1;
@@ -154,23 +316,16 @@ void ExtractSES(MinHeapS *mheap, SEEDS *all_seeds, int *heappointer, int xd,
   FLTVECT seed;
   char visited;
 
-  xdim1 = xd;
-  ydim1 = yd;
-  zdim1 = zd;
-  atom_list = atomlist;
-  min_heap = mheap;
-  AllSeeds = all_seeds;
-  heap_pointer = heappointer;
+  heap_pointer = segment_index.data();
   threshold = thresh;
 
   /* Initialize */
   index = 0;
-  min_heap->size = 0;
 
-  for (k = 0; k < zdim1; k++) {
-    for (j = 0; j < ydim1; j++) {
-      for (i = 0; i < xdim1; i++) {
-        if (atom_index[IndexVect1(i, j, k)] < 0) {
+  for (k = 0; k < zdim; k++) {
+    for (j = 0; j < ydim; j++) {
+      for (i = 0; i < xdim; i++) {
+        if (atom_index[IndexVect(i, j, k)] < 0) {
           for (num = 0; num < MaxAtom; num++) {
             AllSeeds[index].atom[num] = -1;
           }
@@ -180,7 +335,7 @@ void ExtractSES(MinHeapS *mheap, SEEDS *all_seeds, int *heappointer, int xd,
             for (n = j - 1; n <= j + 1; n++) {
               for (m = i - 1; m <= i + 1; m++) {
                 if ((m == i) || (n == j) || (l == k)) {
-                  index1 = atom_index[IndexVect1(m, n, l)];
+                  index1 = atom_index[IndexVect(m, n, l)];
 
                   if (index1 < 0) {
                     index1 = -index1 - 1;
@@ -213,13 +368,13 @@ void ExtractSES(MinHeapS *mheap, SEEDS *all_seeds, int *heappointer, int xd,
           dist = (seed.x - i) * (seed.x - i) + (seed.y - j) * (seed.y - j) +
                  (seed.z - k) * (seed.z - k);
           min_seed = index;
-          InsertHeap(i, j, k, dist);
+          min_heap.push(i, j, k, min_seed, dist);
 
           index++;
-        } else if (atom_index[IndexVect1(i, j, k)] > 0) {
-          heap_pointer[IndexVect1(i, j, k)] = MaxVal;
+        } else if (atom_index[IndexVect(i, j, k)] > 0) {
+          heap_pointer[IndexVect(i, j, k)] = MaxVal;
         } else {
-          heap_pointer[IndexVect1(i, j, k)] = -11;
+          heap_pointer[IndexVect(i, j, k)] = -11;
         }
       }
     }
@@ -237,467 +392,86 @@ void ExtractSES(MinHeapS *mheap, SEEDS *all_seeds, int *heappointer, int xd,
   }
 }
 
-void GetMinimum(void) {
-  int pointer, left, right;
-  float dist;
-
-  min_x = min_heap->x[0];
-  min_y = min_heap->y[0];
-  min_z = min_heap->z[0];
-  min_seed = min_heap->seed[0];
-  min_dist = min_heap->dist[0];
+void MolSurf::GetMinimum(void) {
+  const HeapEntry &top = min_heap[0];
+  min_x = top.x;
+  min_y = top.y;
+  min_z = top.z;
+  min_seed = top.seed;
+  min_dist = top.dist;
 
   if (min_dist == MaxDist) {
     return;
   }
 
-  heap_pointer[IndexVect1(min_heap->x[0], min_heap->y[0], min_heap->z[0])] = -3;
-
-  min_heap->size--;
-  dist = min_heap->dist[min_heap->size];
-
-  pointer = 1;
-
-  while (pointer <= min_heap->size / 2) {
-    left = 2 * pointer;
-    right = 2 * pointer + 1;
-
-    if ((min_heap->dist[left - 1] <= min_heap->dist[right - 1]) &&
-        (min_heap->dist[left - 1] < dist)) {
-      min_heap->x[pointer - 1] = min_heap->x[left - 1];
-      min_heap->y[pointer - 1] = min_heap->y[left - 1];
-      min_heap->z[pointer - 1] = min_heap->z[left - 1];
-      min_heap->seed[pointer - 1] = min_heap->seed[left - 1];
-      min_heap->dist[pointer - 1] = min_heap->dist[left - 1];
-      heap_pointer[IndexVect1(min_heap->x[pointer - 1],
-                              min_heap->y[pointer - 1],
-                              min_heap->z[pointer - 1])] = pointer - 1;
-      pointer = left;
-    } else if ((min_heap->dist[left - 1] > min_heap->dist[right - 1]) &&
-               (min_heap->dist[right - 1] < dist)) {
-      min_heap->x[pointer - 1] = min_heap->x[right - 1];
-      min_heap->y[pointer - 1] = min_heap->y[right - 1];
-      min_heap->z[pointer - 1] = min_heap->z[right - 1];
-      min_heap->seed[pointer - 1] = min_heap->seed[right - 1];
-      min_heap->dist[pointer - 1] = min_heap->dist[right - 1];
-      heap_pointer[IndexVect1(min_heap->x[pointer - 1],
-                              min_heap->y[pointer - 1],
-                              min_heap->z[pointer - 1])] = pointer - 1;
-      pointer = right;
-    } else {
-      break;
-    }
-  }
-
-  min_heap->x[pointer - 1] = min_heap->x[min_heap->size];
-  min_heap->y[pointer - 1] = min_heap->y[min_heap->size];
-  min_heap->z[pointer - 1] = min_heap->z[min_heap->size];
-  min_heap->seed[pointer - 1] = min_heap->seed[min_heap->size];
-  min_heap->dist[pointer - 1] = dist;
-  heap_pointer[IndexVect1(min_heap->x[min_heap->size],
-                          min_heap->y[min_heap->size],
-                          min_heap->z[min_heap->size])] = pointer - 1;
-}
-
-void InsertHeap(int x, int y, int z, float dist) {
-  int parent = 0;
-
-  min_heap->size++;
-  int pointer = min_heap->size;
-
-  while (pointer > 1) {
-    if (pointer % 2 == 0) {
-      parent = pointer / 2;
-    } else if (pointer % 2 == 1) {
-      parent = (pointer - 1) / 2;
-    }
-
-    if (dist < min_heap->dist[parent - 1]) {
-      min_heap->x[pointer - 1] = min_heap->x[parent - 1];
-      min_heap->y[pointer - 1] = min_heap->y[parent - 1];
-      min_heap->z[pointer - 1] = min_heap->z[parent - 1];
-      min_heap->seed[pointer - 1] = min_heap->seed[parent - 1];
-      min_heap->dist[pointer - 1] = min_heap->dist[parent - 1];
-
-      int index = IndexVect1(min_heap->x[pointer - 1], min_heap->y[pointer - 1],
-                             min_heap->z[pointer - 1]);
-      heap_pointer[index] = pointer - 1;
-
-      pointer = parent;
-    } else {
-      break;
-    }
-  }
-  min_heap->x[pointer - 1] = x;
-  min_heap->y[pointer - 1] = y;
-  min_heap->z[pointer - 1] = z;
-  min_heap->seed[pointer - 1] = min_seed;
-  min_heap->dist[pointer - 1] = dist;
-
-  heap_pointer[IndexVect1(x, y, z)] = pointer - 1;
-}
-
-void UpdateHeap(int x, int y, int z, float dist) {
-  int parent = 0;
-  int left, right;
-  char up = 0;
-
-  int pointer = heap_pointer[IndexVect1(x, y, z)] + 1;
-
-  // checking the upper elements
-  while (pointer > 1) {
-    if (pointer % 2 == 0) {
-      parent = pointer / 2;
-    } else if (pointer % 2 == 1) {
-      parent = (pointer - 1) / 2;
-    }
-
-    if (dist < min_heap->dist[parent - 1]) {
-      min_heap->x[pointer - 1] = min_heap->x[parent - 1];
-      min_heap->y[pointer - 1] = min_heap->y[parent - 1];
-      min_heap->z[pointer - 1] = min_heap->z[parent - 1];
-      min_heap->seed[pointer - 1] = min_heap->seed[parent - 1];
-      min_heap->dist[pointer - 1] = min_heap->dist[parent - 1];
-
-      int index = IndexVect1(min_heap->x[pointer - 1], min_heap->y[pointer - 1],
-                             min_heap->z[pointer - 1]);
-      heap_pointer[index] = pointer - 1;
-
-      pointer = parent;
-    } else {
-      break;
-    }
-  }
-
-  if (up == 0) {
-    // checking the lower elements
-    while (pointer <= min_heap->size / 2) {
-      left = 2 * pointer;
-      right = 2 * pointer + 1;
-
-      if ((min_heap->dist[left - 1] <= min_heap->dist[right - 1]) &&
-          (min_heap->dist[left - 1] < dist)) {
-        min_heap->x[pointer - 1] = min_heap->x[left - 1];
-        min_heap->y[pointer - 1] = min_heap->y[left - 1];
-        min_heap->z[pointer - 1] = min_heap->z[left - 1];
-        min_heap->seed[pointer - 1] = min_heap->seed[left - 1];
-        min_heap->dist[pointer - 1] = min_heap->dist[left - 1];
-        heap_pointer[IndexVect1(min_heap->x[pointer - 1],
-                                min_heap->y[pointer - 1],
-                                min_heap->z[pointer - 1])] = pointer - 1;
-        pointer = left;
-      } else if ((min_heap->dist[left - 1] > min_heap->dist[right - 1]) &&
-                 (min_heap->dist[right - 1] < dist)) {
-        min_heap->x[pointer - 1] = min_heap->x[right - 1];
-        min_heap->y[pointer - 1] = min_heap->y[right - 1];
-        min_heap->z[pointer - 1] = min_heap->z[right - 1];
-        min_heap->seed[pointer - 1] = min_heap->seed[right - 1];
-        min_heap->dist[pointer - 1] = min_heap->dist[right - 1];
-        heap_pointer[IndexVect1(min_heap->x[pointer - 1],
-                                min_heap->y[pointer - 1],
-                                min_heap->z[pointer - 1])] = pointer - 1;
-        pointer = right;
-      } else {
-        break;
-      }
-    }
-  }
-
-  min_heap->x[pointer - 1] = x;
-  min_heap->y[pointer - 1] = y;
-  min_heap->z[pointer - 1] = z;
-  min_heap->seed[pointer - 1] = min_seed;
-  min_heap->dist[pointer - 1] = dist;
-
-  heap_pointer[IndexVect1(x, y, z)] = pointer - 1;
+  heap_pointer[IndexVect(min_x, min_y, min_z)] = -3;
+  min_heap.pop();
 }
 
-void Marching(void) {
-  int tempt_x, tempt_y, tempt_z;
-  float dt, dist;
-  int neighbor, seed;
-  char boundary;
-  float min_seedx, min_seedy, min_seedz;
-  float seedx, seedy, seedz;
-
-  min_seedx = AllSeeds[min_seed].seedx;
-  min_seedy = AllSeeds[min_seed].seedy;
-  min_seedz = AllSeeds[min_seed].seedz;
-
-  boundary = 0;
-
-  /* ============================ */
-  tempt_x = std::max(min_x - 1, 0);
-  tempt_y = min_y;
-  tempt_z = min_z;
-
-  if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] == MaxVal) {
-    dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-           (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-           (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-    if (dist <= threshold) {
-      InsertHeap(tempt_x, tempt_y, tempt_z, dist);
-    } else {
-      boundary = 1;
-    }
-  } else if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] > -1) {
-    neighbor = heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)];
-    dt = min_heap->dist[neighbor];
-
-    if (dt < MaxDist) {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-      if (dist < dt) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, dist);
-      }
-    } else {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-      seed = min_heap->seed[neighbor];
-      seedx = AllSeeds[seed].seedx;
-      seedy = AllSeeds[seed].seedy;
-      seedz = AllSeeds[seed].seedz;
-
-      if (dist < (tempt_x - seedx) * (tempt_x - seedx) +
-                     (tempt_y - seedy) * (tempt_y - seedy) +
-                     (tempt_z - seedz) * (tempt_z - seedz)) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, MaxDist);
-      }
-    }
-  }
-
-  // else if (heap_pointer[IndexVect1(tempt_x,tempt_y,tempt_z)] > -11) {
-
-  /* ============================ */
-  tempt_x = std::min(min_x + 1, xdim1 - 1);
-  tempt_y = min_y;
-  tempt_z = min_z;
-
-  if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] == MaxVal) {
-    dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-           (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-           (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-    if (dist <= threshold) {
-      InsertHeap(tempt_x, tempt_y, tempt_z, dist);
-    } else {
-      boundary = 1;
-    }
-  } else if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] > -1) {
-    neighbor = heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)];
-    dt = min_heap->dist[neighbor];
-
-    if (dt < MaxDist) {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-      if (dist < dt) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, dist);
-      }
-    } else {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-      seed = min_heap->seed[neighbor];
-      seedx = AllSeeds[seed].seedx;
-      seedy = AllSeeds[seed].seedy;
-      seedz = AllSeeds[seed].seedz;
-
-      if (dist < (tempt_x - seedx) * (tempt_x - seedx) +
-                     (tempt_y - seedy) * (tempt_y - seedy) +
-                     (tempt_z - seedz) * (tempt_z - seedz)) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, MaxDist);
-      }
-    }
-  }
-
-  /* ============================ */
-  tempt_y = std::max(min_y - 1, 0);
-  tempt_x = min_x;
-  tempt_z = min_z;
-
-  if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] == MaxVal) {
-    dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-           (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-           (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-    if (dist <= threshold) {
-      InsertHeap(tempt_x, tempt_y, tempt_z, dist);
-    } else {
-      boundary = 1;
-    }
-  } else if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] > -1) {
-    neighbor = heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)];
-    dt = min_heap->dist[neighbor];
-
-    if (dt < MaxDist) {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-      if (dist < dt) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, dist);
-      }
-    } else {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-      seed = min_heap->seed[neighbor];
-      seedx = AllSeeds[seed].seedx;
-      seedy = AllSeeds[seed].seedy;
-      seedz = AllSeeds[seed].seedz;
-
-      if (dist < (tempt_x - seedx) * (tempt_x - seedx) +
-                     (tempt_y - seedy) * (tempt_y - seedy) +
-                     (tempt_z - seedz) * (tempt_z - seedz)) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, MaxDist);
-      }
-    }
-  }
-
-  /* ============================ */
-  tempt_y = std::min(min_y + 1, ydim1 - 1);
-  tempt_x = min_x;
-  tempt_z = min_z;
-
-  if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] == MaxVal) {
-    dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-           (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-           (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-    if (dist <= threshold) {
-      InsertHeap(tempt_x, tempt_y, tempt_z, dist);
-    } else {
-      boundary = 1;
-    }
-  } else if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] > -1) {
-    neighbor = heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)];
-    dt = min_heap->dist[neighbor];
-
-    if (dt < MaxDist) {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-      if (dist < dt) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, dist);
-      }
-    } else {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-      seed = min_heap->seed[neighbor];
-      seedx = AllSeeds[seed].seedx;
-      seedy = AllSeeds[seed].seedy;
-      seedz = AllSeeds[seed].seedz;
-
-      if (dist < (tempt_x - seedx) * (tempt_x - seedx) +
-                     (tempt_y - seedy) * (tempt_y - seedy) +
-                     (tempt_z - seedz) * (tempt_z - seedz)) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, MaxDist);
-      }
-    }
-  }
-
-  /* ============================ */
-  tempt_z = std::max(min_z - 1, 0);
-  tempt_x = min_x;
-  tempt_y = min_y;
-
-  if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] == MaxVal) {
-    dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-           (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-           (tempt_z - min_seedz) * (tempt_z - min_seedz);
+/**
+ * @brief      Propagate the current seed to a neighbor of the current voxel
+ *
+ * @return     True if the neighbor is beyond the threshold, making the current
+ *             voxel a boundary voxel
+ */
+bool MolSurf::MarchNeighbor(int x, int y, int z, float seedx, float seedy,
+                            float seedz) {
+  const int state = heap_pointer[IndexVect(x, y, z)];
+  const float dist = (x - seedx) * (x - seedx) + (y - seedy) * (y - seedy) +
+                     (z - seedz) * (z - seedz);
 
+  if (state == MaxVal) {
     if (dist <= threshold) {
-      InsertHeap(tempt_x, tempt_y, tempt_z, dist);
+      min_heap.push(x, y, z, min_seed, dist);
     } else {
-      boundary = 1;
+      return true;
     }
-  } else if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] > -1) {
-    neighbor = heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)];
-    dt = min_heap->dist[neighbor];
-
-    if (dt < MaxDist) {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
+  } else if (state > -1) {
+    const HeapEntry &neighbor = min_heap[state];
 
-      if (dist < dt) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, dist);
+    if (neighbor.dist < MaxDist) {
+      if (dist < neighbor.dist) {
+        min_heap.update(x, y, z, min_seed, dist);
       }
     } else {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-      seed = min_heap->seed[neighbor];
-      seedx = AllSeeds[seed].seedx;
-      seedy = AllSeeds[seed].seedy;
-      seedz = AllSeeds[seed].seedz;
-
-      if (dist < (tempt_x - seedx) * (tempt_x - seedx) +
-                     (tempt_y - seedy) * (tempt_y - seedy) +
-                     (tempt_z - seedz) * (tempt_z - seedz)) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, MaxDist);
+      const SEEDS &other = AllSeeds[neighbor.seed];
+      if (dist < (x - other.seedx) * (x - other.seedx) +
+                     (y - other.seedy) * (y - other.seedy) +
+                     (z - other.seedz) * (z - other.seedz)) {
+        min_heap.update(x, y, z, min_seed, MaxDist);
       }
     }
   }
+  return false;
+}
 
-  /* ============================ */
-  tempt_z = std::min(min_z + 1, zdim1 - 1);
-  tempt_x = min_x;
-  tempt_y = min_y;
-
-  if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] == MaxVal) {
-    dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-           (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-           (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-    if (dist <= threshold) {
-      InsertHeap(tempt_x, tempt_y, tempt_z, dist);
-    } else {
-      boundary = 1;
-    }
-  } else if (heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)] > -1) {
-    neighbor = heap_pointer[IndexVect1(tempt_x, tempt_y, tempt_z)];
-    dt = min_heap->dist[neighbor];
-
-    if (dt < MaxDist) {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-
-      if (dist < dt) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, dist);
-      }
-    } else {
-      dist = (tempt_x - min_seedx) * (tempt_x - min_seedx) +
-             (tempt_y - min_seedy) * (tempt_y - min_seedy) +
-             (tempt_z - min_seedz) * (tempt_z - min_seedz);
-      seed = min_heap->seed[neighbor];
-      seedx = AllSeeds[seed].seedx;
-      seedy = AllSeeds[seed].seedy;
-      seedz = AllSeeds[seed].seedz;
-
-      if (dist < (tempt_x - seedx) * (tempt_x - seedx) +
-                     (tempt_y - seedy) * (tempt_y - seedy) +
-                     (tempt_z - seedz) * (tempt_z - seedz)) {
-        UpdateHeap(tempt_x, tempt_y, tempt_z, MaxDist);
-      }
+void MolSurf::Marching(void) {
+  const float seedx = AllSeeds[min_seed].seedx;
+  const float seedy = AllSeeds[min_seed].seedy;
+  const float seedz = AllSeeds[min_seed].seedz;
+
+  // Face neighbors, clamped to the grid
+  const int neighbors[6][3] = {
+      {std::max(min_x - 1, 0), min_y, min_z},
+      {std::min(min_x + 1, xdim - 1), min_y, min_z},
+      {min_x, std::max(min_y - 1, 0), min_z},
+      {min_x, std::min(min_y + 1, ydim - 1), min_z},
+      {min_x, min_y, std::max(min_z - 1, 0)},
+      {min_x, min_y, std::min(min_z + 1, zdim - 1)}};
+
+  bool boundary = false;
+  for (const auto &n : neighbors) {
+    if (MarchNeighbor(n[0], n[1], n[2], seedx, seedy, seedz)) {
+      boundary = true;
     }
   }
 
   if (boundary) {
-    InsertHeap(min_x, min_y, min_z, MaxDist);
+    min_heap.push(min_x, min_y, min_z, min_seed, MaxDist);
   }
 }
 
-FLTVECT FindSeed(float x, float y, float z, int index) {
+FLTVECT MolSurf::FindSeed(float x, float y, float z, int index) {
   double cx1, cy1, cz1;
   double cx2, cy2, cz2;
   double cx3, cy3, cz3;
@@ -906,25 +680,28 @@ void getMinMax(Iterator begin, Iterator end, float min[3], float max[3]) {
   }
 }
 
-std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
-  int i, j, k;
-  int a, b, c, d;
-  float orig[3], span[3];
-  int dim[3];
-  int m, n, l, num;
-  double threshold;
-  double nx, ny, nz;
-  int xydim, xyzdim;
-  clock_t begin, finish;
-  std::vector<Atom> atoms;
-  std::vector<ATOM> atom_list;
-  float min[3], max[3];
-  SEEDS *AllSeeds; // Border variable
-  MinHeapS *min_heap;
-
-  // Read in the PDB file
-  readPDB(input_name, std::back_inserter(atoms));
+/// Grid arrays, and the heap, seeds, and quads of each boundary voxel
+const pdbreader_detail::GridCost MOLSURF_COST = {
+    DIM_SCALE, 2 * sizeof(int),
+    3 * sizeof(HeapEntry) + sizeof(SEEDS) + 8 * sizeof(MOL_VERTEX) +
+        6 * sizeof(INT4VECT)};
 
+/**
+ * @brief      Convert atoms and pick the molsurf grid
+ *
+ * @param[in]  atoms        The atoms
+ * @param[in]  resolution   Grid resolution and memory budget
+ * @param      atom_vector  The converted atoms
+ * @param      min          Minimum corner of the padded bounding box
+ * @param      max          Maximum corner of the padded bounding box
+ *
+ * @return     The grid
+ */
+GridMemoryEstimate chooseMolsurfGrid(const std::vector<Atom> &atoms,
+                                     const GridResolution &resolution,
+                                     std::vector<ATOM> &atom_vector,
+                                     float min[3], float max[3]) {
+  atom_vector.clear();
   for (auto atom : atoms) {
 
     ATOM new_atom;
@@ -933,52 +710,71 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
     new_atom.z = atom.pos[2];
     new_atom.radius = atom.radius;
 
-    atom_list.push_back(new_atom);
+    atom_vector.push_back(new_atom);
   }
 
-  getMinMax(atom_list.begin(), atom_list.end(), min, max);
+  getMinMax(atom_vector.begin(), atom_vector.end(), min, max);
 
-  GLOBAL_xdim = (int)(((max[0] - min[0]) + 1) * DIM_SCALE);
-  GLOBAL_ydim = (int)(((max[1] - min[1]) + 1) * DIM_SCALE);
-  GLOBAL_zdim = (int)(((max[2] - min[2]) + 1) * DIM_SCALE);
-  xydim = GLOBAL_xdim * GLOBAL_ydim;
-  xyzdim = xydim * GLOBAL_zdim;
+  return pdbreader_detail::chooseGrid(
+      Vector3f({max[0] - min[0], max[1] - min[1], max[2] - min[2]}),
+      pdbreader_detail::estimateSurfaceArea(atoms), MOLSURF_COST, resolution);
+}
 
-  // printf("dimension: %d X %d X %d\n",xdim,ydim,zdim);
+std::unique_ptr<SurfaceMesh> MolSurf::run(const std::vector<Atom> &atoms,
+                                          const GridResolution &resolution) {
+  int i, j, k;
+  int a, b, c, d;
+  float orig[3], span[3];
+  int dim[3];
+  int m, n, l, num;
+  double thresh;
+  double nx, ny, nz;
+  int xydim, xyzdim;
+  clock_t begin, finish;
+  std::vector<ATOM> atom_vector;
+  float min[3], max[3];
 
-  GLOBAL_atom_index = (int *)malloc(sizeof(int) * xyzdim);
-  GLOBAL_segment_index = (int *)malloc(sizeof(int) * xyzdim);
+  const GridMemoryEstimate grid =
+      chooseMolsurfGrid(atoms, resolution, atom_vector, min, max);
 
-  for (k = 0; k < xyzdim; k++) {
-    GLOBAL_atom_index[k] = 0;
-  }
+  xdim = grid.dim[0];
+  ydim = grid.dim[1];
+  zdim = grid.dim[2];
+  xydim = xdim * ydim;
+  xyzdim = xydim * zdim;
+
+  // printf("dimension: %d X %d X %d\n",xdim,ydim,zdim);
+
+  atom_index.assign(xyzdim, 0);
+  segment_index.assign(xyzdim, 0);
 
   orig[0] = min[0];
   orig[1] = min[1];
   orig[2] = min[2];
-  span[0] = (max[0] - min[0]) / (double)(GLOBAL_xdim - 1);
-  span[1] = (max[1] - min[1]) / (double)(GLOBAL_ydim - 1);
-  span[2] = (max[2] - min[2]) / (double)(GLOBAL_zdim - 1);
-  dim[0] = GLOBAL_xdim;
-  dim[1] = GLOBAL_ydim;
-  dim[2] = GLOBAL_zdim;
-
-  for (m = 0; m < atom_list.size(); m++) {
-    atom_list[m].x = (atom_list[m].x - orig[0]) / span[0];
-    atom_list[m].y = (atom_list[m].y - orig[1]) / span[1];
-    atom_list[m].z = (atom_list[m].z - orig[2]) / span[2];
-    atom_list[m].radius =
-        (atom_list[m].radius + 1.5) / ((span[0] + span[1] + span[2]) / 3.0);
+  span[0] = (max[0] - min[0]) / (double)(xdim - 1);
+  span[1] = (max[1] - min[1]) / (double)(ydim - 1);
+  span[2] = (max[2] - min[2]) / (double)(zdim - 1);
+  dim[0] = xdim;
+  dim[1] = ydim;
+  dim[2] = zdim;
+
+  for (m = 0; m < atom_vector.size(); m++) {
+    atom_vector[m].x = (atom_vector[m].x - orig[0]) / span[0];
+    atom_vector[m].y = (atom_vector[m].y - orig[1]) / span[1];
+    atom_vector[m].z = (atom_vector[m].z - orig[2]) / span[2];
+    atom_vector[m].radius =
+        (atom_vector[m].radius + 1.5) / ((span[0] + span[1] + span[2]) / 3.0);
   }
 
   begin = clock();
-  num = ExtractSAS(atom_list.size(), atom_list.data());
+  atom_list = atom_vector.data();
+  num = ExtractSAS(atom_vector.size());
   finish = clock();
 
-  // for(int q=0; q < GLOBAL_xdim; ++q){
-  //     for(int r=0; r < GLOBAL_ydim; ++r){
-  //         for(int s=0; s < GLOBAL_zdim; ++s){
-  //             std::cout << GLOBAL_atom_index[IndexVect(q,r,s)] <<
+  // for(int q=0; q < xdim; ++q){
+  //     for(int r=0; r < ydim; ++r){
+  //         for(int s=0; s < zdim; ++s){
+  //             std::cout << atom_index[IndexVect(q,r,s)] <<
   // std::endl;
   //         }
   //     }
@@ -989,17 +785,10 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
   // printf("   Number of boundary voxels: %d\n\n",num);
 
   begin = clock();
-  threshold = 1.5 / ((span[0] + span[1] + span[2]) / 3.0);
-  min_heap = (MinHeapS *)malloc(sizeof(MinHeapS));
-  min_heap->x = (unsigned short *)malloc(sizeof(unsigned short) * num * 3);
-  min_heap->y = (unsigned short *)malloc(sizeof(unsigned short) * num * 3);
-  min_heap->z = (unsigned short *)malloc(sizeof(unsigned short) * num * 3);
-  min_heap->seed = (int *)malloc(sizeof(int) * num * 3);
-  min_heap->dist = (float *)malloc(sizeof(float) * num * 3);
-  AllSeeds = (SEEDS *)malloc(sizeof(SEEDS) * num);
-  ExtractSES(min_heap, AllSeeds, GLOBAL_segment_index, GLOBAL_xdim, GLOBAL_ydim,
-             GLOBAL_zdim, GLOBAL_atom_index, atom_list.size(), atom_list.data(),
-             threshold * threshold);
+  thresh = 1.5 / ((span[0] + span[1] + span[2]) / 3.0);
+  min_heap.reset(segment_index.data(), xdim, ydim, num * 3);
+  AllSeeds.resize(num);
+  ExtractSES(thresh * thresh);
   finish = clock();
 
   // printf("   Extract SES voxels: CPU Time = %f seconds
@@ -1011,17 +800,14 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
 
     int index = 0;
 
-    for (k = 0; k < GLOBAL_zdim; k++) {
-      for (j = 0; j < GLOBAL_ydim; j++) {
-        for (i = 0; i < GLOBAL_xdim; i++, ++index) {
-          if (GLOBAL_segment_index[index] == MaxVal) {
+    for (k = 0; k < zdim; k++) {
+      for (j = 0; j < ydim; j++) {
+        for (i = 0; i < xdim; i++, ++index) {
+          if (segment_index[index] == MaxVal) {
             if (!CheckManifold(i, j, k)) // non-manifold occurs
             {
-              GLOBAL_segment_index[index] = 0;
-              min_heap->x[min_heap->size] = i;
-              min_heap->y[min_heap->size] = j;
-              min_heap->z[min_heap->size] = k;
-              min_heap->size++;
+              segment_index[index] = 0;
+              min_heap.append(i, j, k);
               b++;
             }
           }
@@ -1036,207 +822,176 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
   }
 
   // generate the surface mesh
-  GLOBAL_vertex = (MOL_VERTEX *)malloc(sizeof(MOL_VERTEX) * num * 8);
-  GLOBAL_quads = (INT4VECT *)malloc(sizeof(INT4VECT) * num * 6);
-
-  for (k = 0; k < num * 8; k++) {
-    GLOBAL_vertex[k].neigh = 0;
-  }
-
-  for (k = 0; k < xyzdim; k++) {
-    GLOBAL_atom_index[k] = -1;
-  }
+  vertex.clear();
+  vertex.reserve(num * 8);
+  quads.clear();
+  quads.reserve(num * 6);
+  std::fill(atom_index.begin(), atom_index.end(), -1);
   begin = clock();
-  GLOBAL_vert_num = 0;
-  GLOBAL_quad_num = 0;
 
-  for (num = 0; num < min_heap->size; num++) {
-    i = min_heap->x[num];
-    j = min_heap->y[num];
-    k = min_heap->z[num];
+  for (num = 0; num < min_heap.size(); num++) {
+    i = min_heap[num].x;
+    j = min_heap[num].y;
+    k = min_heap[num].z;
 
     // back face
-    if (GLOBAL_segment_index[IndexVect(i - 1, j, k)] == MaxVal) {
+    if (segment_index[IndexVect(i - 1, j, k)] == MaxVal) {
       a = CheckFaceCorner(i - 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 40; // +y and +z
+      vertex[a].neigh |= 40; // +y and +z
       b = CheckFaceCorner(i - 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[b].neigh |= 24; // +y and -z
+      vertex[b].neigh |= 24; // +y and -z
       c = CheckFaceCorner(i - 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 20; // -y and -z
+      vertex[c].neigh |= 20; // -y and -z
       d = CheckFaceCorner(i - 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[d].neigh |= 36; // -y and +z
+      vertex[d].neigh |= 36; // -y and +z
 
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
+      quads.push_back({a, b, c, d});
     }
 
     // front face
-    if (GLOBAL_segment_index[IndexVect(i + 1, j, k)] == MaxVal) {
+    if (segment_index[IndexVect(i + 1, j, k)] == MaxVal) {
       a = CheckFaceCorner(i + 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 40; // +y and +z
+      vertex[a].neigh |= 40; // +y and +z
       b = CheckFaceCorner(i + 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[b].neigh |= 36; // -y and +z
+      vertex[b].neigh |= 36; // -y and +z
       c = CheckFaceCorner(i + 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 20; // -y and -z
+      vertex[c].neigh |= 20; // -y and -z
       d = CheckFaceCorner(i + 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[d].neigh |= 24; // +y and -z
+      vertex[d].neigh |= 24; // +y and -z
 
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
+      quads.push_back({a, b, c, d});
     }
 
     // left face
-    if (GLOBAL_segment_index[IndexVect(i, j - 1, k)] == MaxVal) {
+    if (segment_index[IndexVect(i, j - 1, k)] == MaxVal) {
       a = CheckFaceCorner(i + 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 33; // -x and +z
+      vertex[a].neigh |= 33; // -x and +z
       b = CheckFaceCorner(i + 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[b].neigh |= 17; // -x and -z
+      vertex[b].neigh |= 17; // -x and -z
       c = CheckFaceCorner(i - 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 18; // +x and -z
+      vertex[c].neigh |= 18; // +x and -z
       d = CheckFaceCorner(i - 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[d].neigh |= 34; // +x and +z
+      vertex[d].neigh |= 34; // +x and +z
 
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
+      quads.push_back({a, b, c, d});
     }
 
     // right face
-    if (GLOBAL_segment_index[IndexVect(i, j + 1, k)] == MaxVal) {
+    if (segment_index[IndexVect(i, j + 1, k)] == MaxVal) {
       a = CheckFaceCorner(i + 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 33; // -x and +z
+      vertex[a].neigh |= 33; // -x and +z
       b = CheckFaceCorner(i - 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[b].neigh |= 34; // +x and +z
+      vertex[b].neigh |= 34; // +x and +z
       c = CheckFaceCorner(i - 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 18; // +x and -z
+      vertex[c].neigh |= 18; // +x and -z
       d = CheckFaceCorner(i + 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[d].neigh |= 17; // -x and -z
+      vertex[d].neigh |= 17; // -x and -z
 
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
+      quads.push_back({a, b, c, d});
     }
 
     // bottom face
-    if (GLOBAL_segment_index[IndexVect(i, j, k - 1)] == MaxVal) {
+    if (segment_index[IndexVect(i, j, k - 1)] == MaxVal) {
       a = CheckFaceCorner(i + 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 9; // -x and +y
+      vertex[a].neigh |= 9; // -x and +y
       b = CheckFaceCorner(i - 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[b].neigh |= 10; // +x and +y
+      vertex[b].neigh |= 10; // +x and +y
       c = CheckFaceCorner(i - 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[c].neigh |= 6; // +x and -y
+      vertex[c].neigh |= 6; // +x and -y
       d = CheckFaceCorner(i + 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[d].neigh |= 5; // -x and -y
+      vertex[d].neigh |= 5; // -x and -y
 
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
+      quads.push_back({a, b, c, d});
     }
 
     // top face
-    if (GLOBAL_segment_index[IndexVect(i, j, k + 1)] == MaxVal) {
+    if (segment_index[IndexVect(i, j, k + 1)] == MaxVal) {
       a = CheckFaceCorner(i + 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[a].neigh |= 9; // -x and +y
+      vertex[a].neigh |= 9; // -x and +y
       b = CheckFaceCorner(i + 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[b].neigh |= 5; // -x and -y
+      vertex[b].neigh |= 5; // -x and -y
       c = CheckFaceCorner(i - 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 6; // +x and -y
+      vertex[c].neigh |= 6; // +x and -y
       d = CheckFaceCorner(i - 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[d].neigh |= 10; // +x and +y
+      vertex[d].neigh |= 10; // +x and +y
 
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
+      quads.push_back({a, b, c, d});
     }
   }
   finish = clock();
 
   // printf("   Generate quad meshes: CPU Time = %f seconds
   // \n",(double)(finish-begin)/CLOCKS_PER_SEC);
-  // printf("   vert-num : %d -- quad-num: %d \n\n",vert_num,GLOBAL_quad_num);
+  // printf("   vert-num : %d -- quad-num: %d \n\n",vert_num,quad_num);
 
   // Smooth the mesh
   begin = clock();
   unsigned char neighbor;
 
   for (num = 0; num < 3; num++) {
-    for (n = 0; n < GLOBAL_vert_num; n++) {
+    for (n = 0; n < static_cast<int>(vertex.size()); n++) {
       nx = 0;
       ny = 0;
       nz = 0;
       m = 0;
-      neighbor = GLOBAL_vertex[n].neigh;
+      neighbor = vertex[n].neigh;
 
-      i = GLOBAL_vertex[n].px;
-      j = GLOBAL_vertex[n].py;
-      k = GLOBAL_vertex[n].pz;
+      i = vertex[n].px;
+      j = vertex[n].py;
+      k = vertex[n].pz;
 
       if (neighbor & 1) {
         m++;
-        l = GLOBAL_atom_index[IndexVect(i - 1, j, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
+        l = atom_index[IndexVect(i - 1, j, k)];
+        nx += vertex[l].x;
+        ny += vertex[l].y;
+        nz += vertex[l].z;
       }
 
       if (neighbor & 2) {
         m++;
-        l = GLOBAL_atom_index[IndexVect(i + 1, j, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
+        l = atom_index[IndexVect(i + 1, j, k)];
+        nx += vertex[l].x;
+        ny += vertex[l].y;
+        nz += vertex[l].z;
       }
 
       if (neighbor & 4) {
         m++;
-        l = GLOBAL_atom_index[IndexVect(i, j - 1, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
+        l = atom_index[IndexVect(i, j - 1, k)];
+        nx += vertex[l].x;
+        ny += vertex[l].y;
+        nz += vertex[l].z;
       }
 
       if (neighbor & 8) {
         m++;
-        l = GLOBAL_atom_index[IndexVect(i, j + 1, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
+        l = atom_index[IndexVect(i, j + 1, k)];
+        nx += vertex[l].x;
+        ny += vertex[l].y;
+        nz += vertex[l].z;
       }
 
       if (neighbor & 16) {
         m++;
-        l = GLOBAL_atom_index[IndexVect(i, j, k - 1)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
+        l = atom_index[IndexVect(i, j, k - 1)];
+        nx += vertex[l].x;
+        ny += vertex[l].y;
+        nz += vertex[l].z;
       }
 
       if (neighbor & 32) {
         m++;
-        l = GLOBAL_atom_index[IndexVect(i, j, k + 1)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
+        l = atom_index[IndexVect(i, j, k + 1)];
+        nx += vertex[l].x;
+        ny += vertex[l].y;
+        nz += vertex[l].z;
       }
 
       // update the position
-      GLOBAL_vertex[n].x = nx / (float)m;
-      GLOBAL_vertex[n].y = ny / (float)m;
-      GLOBAL_vertex[n].z = nz / (float)m;
+      vertex[n].x = nx / (float)m;
+      vertex[n].y = ny / (float)m;
+      vertex[n].z = nz / (float)m;
     }
   }
   finish = clock();
@@ -1248,10 +1003,10 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
   std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
 
   // write vertices
-  for (int i = 0; i < GLOBAL_vert_num; i++) {
-    float x = GLOBAL_vertex[i].x * span[0] + orig[0];
-    float y = GLOBAL_vertex[i].y * span[1] + orig[1];
-    float z = GLOBAL_vertex[i].z * span[2] + orig[2];
+  for (int i = 0; i < static_cast<int>(vertex.size()); i++) {
+    float x = vertex[i].x * span[0] + orig[0];
+    float y = vertex[i].y * span[1] + orig[1];
+    float z = vertex[i].z * span[2] + orig[2];
 
     mesh->insert<1>({i}, SMVertex({x, y, z}));
   }
@@ -1259,11 +1014,11 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
   // write triangles
   float angle, angle1, angle2;
 
-  for (i = 0; i < GLOBAL_quad_num; i++) {
-    a = GLOBAL_quads[i].a;
-    b = GLOBAL_quads[i].b;
-    c = GLOBAL_quads[i].c;
-    d = GLOBAL_quads[i].d;
+  for (i = 0; i < static_cast<int>(quads.size()); i++) {
+    a = quads[i].a;
+    b = quads[i].b;
+    c = quads[i].c;
+    d = quads[i].d;
 
     angle1 = -999.0;
     angle2 = -999.0;
@@ -1327,8 +1082,8 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
 
      fprintf(fout, "OFF\n");
      fprintf(fout, "%d %d
-        %d\n",GLOBAL_vert_num,quad_num*2,GLOBAL_vert_num+quad_num*2-2);
-     for (i = 0; i < GLOBAL_vert_num; i++)
+        %d\n",vert_num,quad_num*2,vert_num+quad_num*2-2);
+     for (i = 0; i < vert_num; i++)
      fprintf(fout, "%f %f %f
         \n",surfmesh->vertex[i].x,surfmesh->vertex[i].y,surfmesh->vertex[i].z);
 
@@ -1339,30 +1094,18 @@ std::unique_ptr<SurfaceMesh> readPDB_molsurf(const std::string &input_name) {
      fclose(fout);
    */
 
-  free(AllSeeds);
-  free(GLOBAL_segment_index);
-  free(GLOBAL_atom_index);
-  free(min_heap->x);
-  free(min_heap->y);
-  free(min_heap->z);
-  free(min_heap->seed);
-  free(min_heap->dist);
-  free(min_heap);
-  free(GLOBAL_vertex);
-  free(GLOBAL_quads);
-
   compute_orientation(*mesh);
   return mesh;
 }
 
-float GetAngle(int a, int b, int c) {
+float MolSurf::GetAngle(int a, int b, int c) {
   float ax, ay, az;
   float bx, by, bz;
   float dist;
 
-  ax = GLOBAL_vertex[b].x - GLOBAL_vertex[a].x;
-  ay = GLOBAL_vertex[b].y - GLOBAL_vertex[a].y;
-  az = GLOBAL_vertex[b].z - GLOBAL_vertex[a].z;
+  ax = vertex[b].x - vertex[a].x;
+  ay = vertex[b].y - vertex[a].y;
+  az = vertex[b].z - vertex[a].z;
   dist = sqrt(ax * ax + ay * ay + az * az);
 
   if (dist > 0) {
@@ -1370,9 +1113,9 @@ float GetAngle(int a, int b, int c) {
     ay /= dist;
     az /= dist;
   }
-  bx = GLOBAL_vertex[c].x - GLOBAL_vertex[a].x;
-  by = GLOBAL_vertex[c].y - GLOBAL_vertex[a].y;
-  bz = GLOBAL_vertex[c].z - GLOBAL_vertex[a].z;
+  bx = vertex[c].x - vertex[a].x;
+  by = vertex[c].y - vertex[a].y;
+  bz = vertex[c].z - vertex[a].z;
   dist = sqrt(bx * bx + by * by + bz * bz);
 
   if (dist > 0) {
@@ -1384,7 +1127,7 @@ float GetAngle(int a, int b, int c) {
   return ax * bx + ay * by + az * bz;
 }
 
-char CheckManifold(int i, int j, int k) {
+char MolSurf::CheckManifold(int i, int j, int k) {
   char manifold, nonmanifold;
   int m, n, l;
 
@@ -1402,21 +1145,21 @@ char CheckManifold(int i, int j, int k) {
 
       for (m = i - 1; m <= i + 1; m++) {
         if ((m != i) || (n != j) || (l != k)) {
-          if (GLOBAL_segment_index[IndexVect(m, n, l)] == MaxVal) {
+          if (segment_index[IndexVect(m, n, l)] == MaxVal) {
             nonmanifold = 1;
 
             if ((m != i) &&
-                (GLOBAL_segment_index[IndexVect(m, j, k)] == MaxVal)) {
+                (segment_index[IndexVect(m, j, k)] == MaxVal)) {
               nonmanifold = 0;
             }
 
             if ((n != j) &&
-                (GLOBAL_segment_index[IndexVect(i, n, k)] == MaxVal)) {
+                (segment_index[IndexVect(i, n, k)] == MaxVal)) {
               nonmanifold = 0;
             }
 
             if ((l != k) &&
-                (GLOBAL_segment_index[IndexVect(i, j, l)] == MaxVal)) {
+                (segment_index[IndexVect(i, j, l)] == MaxVal)) {
               nonmanifold = 0;
             }
 
@@ -1436,7 +1179,7 @@ char CheckManifold(int i, int j, int k) {
   return manifold;
 }
 
-int CheckFaceCorner(float x, float y, float z) {
+int MolSurf::CheckFaceCorner(float x, float y, float z) {
   int m, n, l;
   int a;
 
@@ -1444,24 +1187,18 @@ int CheckFaceCorner(float x, float y, float z) {
   n = (int)y;
   l = (int)z;
 
-  if (GLOBAL_atom_index[IndexVect(m, n, l)] < 0) {
-    GLOBAL_vertex[GLOBAL_vert_num].x = x;
-    GLOBAL_vertex[GLOBAL_vert_num].y = y;
-    GLOBAL_vertex[GLOBAL_vert_num].z = z;
-    GLOBAL_vertex[GLOBAL_vert_num].px = m;
-    GLOBAL_vertex[GLOBAL_vert_num].py = n;
-    GLOBAL_vertex[GLOBAL_vert_num].pz = l;
-    GLOBAL_atom_index[IndexVect(m, n, l)] = GLOBAL_vert_num;
-    a = GLOBAL_vert_num;
-    GLOBAL_vert_num++;
+  if (atom_index[IndexVect(m, n, l)] < 0) {
+    a = static_cast<int>(vertex.size());
+    vertex.push_back({x, y, z, 0, m, n, l});
+    atom_index[IndexVect(m, n, l)] = a;
   } else {
-    a = GLOBAL_atom_index[IndexVect(m, n, l)];
+    a = atom_index[IndexVect(m, n, l)];
   }
 
   return a;
 }
 
-FLT2VECT FindIntersection(int n, int m, int j, int k, ATOM *atom_list) {
+FLT2VECT FindIntersection(int n, int m, int j, int k, const ATOM *atom_list) {
   FLT2VECT intersect;
   int i;
   char reorder;
@@ -1528,7 +1265,7 @@ FLT2VECT FindIntersection(int n, int m, int j, int k, ATOM *atom_list) {
   return intersect;
 }
 
-int ExtractSAS(int atom_num, ATOM *atom_list) {
+int MolSurf::ExtractSAS(int atom_num) {
   int i, j, k;
   int m, n, l;
   int dim[3], c[3];
@@ -1537,9 +1274,9 @@ int ExtractSAS(int atom_num, ATOM *atom_list) {
   float x, y, z;
   FLT2VECT intersect;
 
-  dim[0] = GLOBAL_xdim;
-  dim[1] = GLOBAL_ydim;
-  dim[2] = GLOBAL_zdim;
+  dim[0] = xdim;
+  dim[1] = ydim;
+  dim[2] = zdim;
 
   for (m = 0; m < atom_num; m++) {
     radius = atom_list[m].radius;
@@ -1574,16 +1311,16 @@ int ExtractSAS(int atom_num, ATOM *atom_list) {
                   (y - atom_list[m].y) * (y - atom_list[m].y) +
                   (z - atom_list[m].z) * (z - atom_list[m].z) <=
               radius) {
-            if (GLOBAL_atom_index[IndexVect(i, j, k)] > 0) {
+            if (atom_index[IndexVect(i, j, k)] > 0) {
               intersect =
-                  FindIntersection(GLOBAL_atom_index[IndexVect(i, j, k)], m + 1,
+                  FindIntersection(atom_index[IndexVect(i, j, k)], m + 1,
                                    j, k, atom_list);
 
               if ((i >= intersect.x) && (i <= intersect.y)) {
-                GLOBAL_atom_index[IndexVect(i, j, k)] = m + 1;
+                atom_index[IndexVect(i, j, k)] = m + 1;
               }
             } else {
-              GLOBAL_atom_index[IndexVect(i, j, k)] = m + 1;
+              atom_index[IndexVect(i, j, k)] = m + 1;
             }
           }
         }
@@ -1594,22 +1331,22 @@ int ExtractSAS(int atom_num, ATOM *atom_list) {
   // find voxels on the border
   int total = 0;
 
-  for (l = 1; l < GLOBAL_zdim - 1; l++) {
-    for (n = 1; n < GLOBAL_ydim - 1; n++) {
-      for (m = 1; m < GLOBAL_xdim - 1; m++) {
-        if (GLOBAL_atom_index[IndexVect(m, n, l)]) {
+  for (l = 1; l < zdim - 1; l++) {
+    for (n = 1; n < ydim - 1; n++) {
+      for (m = 1; m < xdim - 1; m++) {
+        if (atom_index[IndexVect(m, n, l)]) {
           int count = 0;
 
           // Look at neighbor voxels
-          for (k = std::max(l - 1, 0); k <= std::min(l + 1, GLOBAL_zdim - 1);
+          for (k = std::max(l - 1, 0); k <= std::min(l + 1, zdim - 1);
                k++) {
-            for (j = std::max(n - 1, 0); j <= std::min(n + 1, GLOBAL_ydim - 1);
+            for (j = std::max(n - 1, 0); j <= std::min(n + 1, ydim - 1);
                  j++) {
               for (i = std::max(m - 1, 0);
-                   i <= std::min(m + 1, GLOBAL_xdim - 1); i++) {
+                   i <= std::min(m + 1, xdim - 1); i++) {
                 if ((((i == m) && (j == n)) || ((i == m) && (k == l)) ||
                      ((k == l) && (j == n))) &&
-                    (GLOBAL_atom_index[IndexVect(i, j, k)] == 0)) {
+                    (atom_index[IndexVect(i, j, k)] == 0)) {
                   count = 1;
                 }
               }
@@ -1617,8 +1354,8 @@ int ExtractSAS(int atom_num, ATOM *atom_list) {
           }
 
           if (count) {
-            GLOBAL_atom_index[IndexVect(m, n, l)] =
-                -GLOBAL_atom_index[IndexVect(m, n, l)];
+            atom_index[IndexVect(m, n, l)] =
+                -atom_index[IndexVect(m, n, l)];
             total++;
           }
         }
@@ -1629,453 +1366,59 @@ int ExtractSAS(int atom_num, ATOM *atom_list) {
   return total;
 }
 
-std::unique_ptr<SurfaceMesh> readPQR_molsurf(const std::string &input_name) {
-  int i, j, k;
-  int a, b, c, d;
-  float orig[3], span[3];
-  int dim[3];
-  int m, n, l, num;
-  double threshold;
-  double nx, ny, nz;
-  int xydim, xyzdim;
-  clock_t begin, finish;
-  std::vector<Atom> atoms;
-  std::vector<ATOM> atom_list;
-  float min[3], max[3];
-  SEEDS *AllSeeds; // Border variable
-  MinHeapS *min_heap;
-
-  // Read in the PQR file
-  readPQR(input_name, std::back_inserter(atoms));
-
-  for (auto atom : atoms) {
-
-    ATOM new_atom;
-    new_atom.x = atom.pos[0];
-    new_atom.y = atom.pos[1];
-    new_atom.z = atom.pos[2];
-    new_atom.radius = atom.radius;
-
-    atom_list.push_back(new_atom);
-  }
-
-  getMinMax(atom_list.begin(), atom_list.end(), min, max);
+} // end anonymous namespace
 
-  GLOBAL_xdim = (int)(((max[0] - min[0]) + 1) * DIM_SCALE);
-  GLOBAL_ydim = (int)(((max[1] - min[1]) + 1) * DIM_SCALE);
-  GLOBAL_zdim = (int)(((max[2] - min[2]) + 1) * DIM_SCALE);
-  xydim = GLOBAL_xdim * GLOBAL_ydim;
-  xyzdim = xydim * GLOBAL_zdim;
-
-  // printf("dimension: %d X %d X %d\n",xdim,ydim,zdim);
-
-  GLOBAL_atom_index = (int *)malloc(sizeof(int) * xyzdim);
-  GLOBAL_segment_index = (int *)malloc(sizeof(int) * xyzdim);
-
-  for (k = 0; k < xyzdim; k++) {
-    GLOBAL_atom_index[k] = 0;
-  }
-
-  orig[0] = min[0];
-  orig[1] = min[1];
-  orig[2] = min[2];
-  span[0] = (max[0] - min[0]) / (double)(GLOBAL_xdim - 1);
-  span[1] = (max[1] - min[1]) / (double)(GLOBAL_ydim - 1);
-  span[2] = (max[2] - min[2]) / (double)(GLOBAL_zdim - 1);
-  dim[0] = GLOBAL_xdim;
-  dim[1] = GLOBAL_ydim;
-  dim[2] = GLOBAL_zdim;
-
-  for (m = 0; m < atom_list.size(); m++) {
-    atom_list[m].x = (atom_list[m].x - orig[0]) / span[0];
-    atom_list[m].y = (atom_list[m].y - orig[1]) / span[1];
-    atom_list[m].z = (atom_list[m].z - orig[2]) / span[2];
-    atom_list[m].radius =
-        (atom_list[m].radius + 1.5) / ((span[0] + span[1] + span[2]) / 3.0);
-  }
-
-  begin = clock();
-  num = ExtractSAS(atom_list.size(), atom_list.data());
-  finish = clock();
-
-  // for(int q=0; q < GLOBAL_xdim; ++q){
-  //     for(int r=0; r < GLOBAL_ydim; ++r){
-  //         for(int s=0; s < GLOBAL_zdim; ++s){
-  //             std::cout << GLOBAL_atom_index[IndexVect(q,r,s)] <<
-  // std::endl;
-  //         }
-  //     }
-  // }
-
-  // printf("   Extract SAS voxels: CPU Time = %f seconds
-  // \n",(double)(finish-begin)/CLOCKS_PER_SEC);
-  // printf("   Number of boundary voxels: %d\n\n",num);
-
-  begin = clock();
-  threshold = 1.5 / ((span[0] + span[1] + span[2]) / 3.0);
-  min_heap = (MinHeapS *)malloc(sizeof(MinHeapS));
-  min_heap->x = (unsigned short *)malloc(sizeof(unsigned short) * num * 3);
-  min_heap->y = (unsigned short *)malloc(sizeof(unsigned short) * num * 3);
-  min_heap->z = (unsigned short *)malloc(sizeof(unsigned short) * num * 3);
-  min_heap->seed = (int *)malloc(sizeof(int) * num * 3);
-  min_heap->dist = (float *)malloc(sizeof(float) * num * 3);
-  AllSeeds = (SEEDS *)malloc(sizeof(SEEDS) * num);
-  ExtractSES(min_heap, AllSeeds, GLOBAL_segment_index, GLOBAL_xdim, GLOBAL_ydim,
-             GLOBAL_zdim, GLOBAL_atom_index, atom_list.size(), atom_list.data(),
-             threshold * threshold);
-  finish = clock();
-
-  // printf("   Extract SES voxels: CPU Time = %f seconds
-  // \n\n",(double)(finish-begin)/CLOCKS_PER_SEC);
-
-  // detect and fix non-manifolds !
-  while (1) {
-    b = 0;
-
-    int index = 0;
-
-    for (k = 0; k < GLOBAL_zdim; k++) {
-      for (j = 0; j < GLOBAL_ydim; j++) {
-        for (i = 0; i < GLOBAL_xdim; i++, ++index) {
-          if (GLOBAL_segment_index[index] == MaxVal) {
-            if (!CheckManifold(i, j, k)) // non-manifold occurs
-            {
-              GLOBAL_segment_index[index] = 0;
-              min_heap->x[min_heap->size] = i;
-              min_heap->y[min_heap->size] = j;
-              min_heap->z[min_heap->size] = k;
-              min_heap->size++;
-              b++;
-            }
-          }
-        }
-      }
-    }
-
-    // printf("non-manifold = %d \n",b);
-    if (b == 0) {
-      break;
-    }
-  }
-
-  // generate the surface mesh
-  GLOBAL_vertex = (MOL_VERTEX *)malloc(sizeof(MOL_VERTEX) * num * 8);
-  GLOBAL_quads = (INT4VECT *)malloc(sizeof(INT4VECT) * num * 6);
-
-  for (k = 0; k < num * 8; k++) {
-    GLOBAL_vertex[k].neigh = 0;
-  }
-
-  for (k = 0; k < xyzdim; k++) {
-    GLOBAL_atom_index[k] = -1;
-  }
-  begin = clock();
-  GLOBAL_vert_num = 0;
-  GLOBAL_quad_num = 0;
-
-  for (num = 0; num < min_heap->size; num++) {
-    i = min_heap->x[num];
-    j = min_heap->y[num];
-    k = min_heap->z[num];
-
-    // back face
-    if (GLOBAL_segment_index[IndexVect(i - 1, j, k)] == MaxVal) {
-      a = CheckFaceCorner(i - 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 40; // +y and +z
-      b = CheckFaceCorner(i - 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[b].neigh |= 24; // +y and -z
-      c = CheckFaceCorner(i - 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 20; // -y and -z
-      d = CheckFaceCorner(i - 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[d].neigh |= 36; // -y and +z
-
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
-    }
-
-    // front face
-    if (GLOBAL_segment_index[IndexVect(i + 1, j, k)] == MaxVal) {
-      a = CheckFaceCorner(i + 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 40; // +y and +z
-      b = CheckFaceCorner(i + 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[b].neigh |= 36; // -y and +z
-      c = CheckFaceCorner(i + 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 20; // -y and -z
-      d = CheckFaceCorner(i + 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[d].neigh |= 24; // +y and -z
-
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
-    }
-
-    // left face
-    if (GLOBAL_segment_index[IndexVect(i, j - 1, k)] == MaxVal) {
-      a = CheckFaceCorner(i + 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 33; // -x and +z
-      b = CheckFaceCorner(i + 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[b].neigh |= 17; // -x and -z
-      c = CheckFaceCorner(i - 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 18; // +x and -z
-      d = CheckFaceCorner(i - 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[d].neigh |= 34; // +x and +z
-
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
-    }
-
-    // right face
-    if (GLOBAL_segment_index[IndexVect(i, j + 1, k)] == MaxVal) {
-      a = CheckFaceCorner(i + 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 33; // -x and +z
-      b = CheckFaceCorner(i - 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[b].neigh |= 34; // +x and +z
-      c = CheckFaceCorner(i - 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 18; // +x and -z
-      d = CheckFaceCorner(i + 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[d].neigh |= 17; // -x and -z
-
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
-    }
-
-    // bottom face
-    if (GLOBAL_segment_index[IndexVect(i, j, k - 1)] == MaxVal) {
-      a = CheckFaceCorner(i + 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[a].neigh |= 9; // -x and +y
-      b = CheckFaceCorner(i - 0.5, j - 0.5, k - 0.5);
-      GLOBAL_vertex[b].neigh |= 10; // +x and +y
-      c = CheckFaceCorner(i - 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[c].neigh |= 6; // +x and -y
-      d = CheckFaceCorner(i + 0.5, j + 0.5, k - 0.5);
-      GLOBAL_vertex[d].neigh |= 5; // -x and -y
-
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
-    }
-
-    // top face
-    if (GLOBAL_segment_index[IndexVect(i, j, k + 1)] == MaxVal) {
-      a = CheckFaceCorner(i + 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[a].neigh |= 9; // -x and +y
-      b = CheckFaceCorner(i + 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[b].neigh |= 5; // -x and -y
-      c = CheckFaceCorner(i - 0.5, j + 0.5, k + 0.5);
-      GLOBAL_vertex[c].neigh |= 6; // +x and -y
-      d = CheckFaceCorner(i - 0.5, j - 0.5, k + 0.5);
-      GLOBAL_vertex[d].neigh |= 10; // +x and +y
-
-      GLOBAL_quads[GLOBAL_quad_num].a = a;
-      GLOBAL_quads[GLOBAL_quad_num].b = b;
-      GLOBAL_quads[GLOBAL_quad_num].c = c;
-      GLOBAL_quads[GLOBAL_quad_num].d = d;
-      GLOBAL_quad_num++;
-    }
-  }
-  finish = clock();
-
-  // printf("   Generate quad meshes: CPU Time = %f seconds
-  // \n",(double)(finish-begin)/CLOCKS_PER_SEC);
-  // printf("   vert-num : %d -- quad-num: %d \n\n",vert_num,GLOBAL_quad_num);
-
-  // Smooth the mesh
-  begin = clock();
-  unsigned char neighbor;
-
-  for (num = 0; num < 3; num++) {
-    for (n = 0; n < GLOBAL_vert_num; n++) {
-      nx = 0;
-      ny = 0;
-      nz = 0;
-      m = 0;
-      neighbor = GLOBAL_vertex[n].neigh;
-
-      i = GLOBAL_vertex[n].px;
-      j = GLOBAL_vertex[n].py;
-      k = GLOBAL_vertex[n].pz;
-
-      if (neighbor & 1) {
-        m++;
-        l = GLOBAL_atom_index[IndexVect(i - 1, j, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
-      }
-
-      if (neighbor & 2) {
-        m++;
-        l = GLOBAL_atom_index[IndexVect(i + 1, j, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
-      }
-
-      if (neighbor & 4) {
-        m++;
-        l = GLOBAL_atom_index[IndexVect(i, j - 1, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
-      }
-
-      if (neighbor & 8) {
-        m++;
-        l = GLOBAL_atom_index[IndexVect(i, j + 1, k)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
-      }
+GridMemoryEstimate estimateMemory_molsurf(const std::vector<Atom> &atoms,
+                                          const GridResolution &resolution) {
+  std::vector<ATOM> atom_vector;
+  float min[3], max[3];
+  return chooseMolsurfGrid(atoms, resolution, atom_vector, min, max);
+}
 
-      if (neighbor & 16) {
-        m++;
-        l = GLOBAL_atom_index[IndexVect(i, j, k - 1)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
-      }
+std::unique_ptr<SurfaceMesh>
+meshAtoms_molsurf(const std::vector<Atom> &atoms,
+                  const GridResolution &resolution) {
+  return MolSurf().run(atoms, resolution);
+}
 
-      if (neighbor & 32) {
-        m++;
-        l = GLOBAL_atom_index[IndexVect(i, j, k + 1)];
-        nx += GLOBAL_vertex[l].x;
-        ny += GLOBAL_vertex[l].y;
-        nz += GLOBAL_vertex[l].z;
-      }
+std::unique_ptr<SurfaceMesh>
+meshAtoms_molsurf(const float *xyz, const float *radii, std::size_t nAtoms,
+                  const GridResolution &resolution) {
+  return meshAtoms_molsurf(pdbreader_detail::makeAtoms(xyz, radii, nAtoms),
+                           resolution);
+}
 
-      // update the position
-      GLOBAL_vertex[n].x = nx / (float)m;
-      GLOBAL_vertex[n].y = ny / (float)m;
-      GLOBAL_vertex[n].z = nz / (float)m;
-    }
+std::unique_ptr<SurfaceMesh>
+readPDB_molsurf(const std::string &input_name,
+                const GridResolution &resolution) {
+  std::vector<Atom> atoms;
+  // If readPDB errors return nullptr
+  if (!readPDB(input_name, std::back_inserter(atoms))) {
+    return nullptr;
   }
-  finish = clock();
-
-  // printf("   Smooth the quad meshes: CPU Time = %f seconds
-  // \n\n",(double)(finish-begin)/CLOCKS_PER_SEC);
-
-  // Allocate memory
-  std::unique_ptr<SurfaceMesh> mesh(new SurfaceMesh);
-
-  // write vertices
-  for (int i = 0; i < GLOBAL_vert_num; i++) {
-    float x = GLOBAL_vertex[i].x * span[0] + orig[0];
-    float y = GLOBAL_vertex[i].y * span[1] + orig[1];
-    float z = GLOBAL_vertex[i].z * span[2] + orig[2];
+  return meshAtoms_molsurf(atoms, resolution);
+}
 
-    mesh->insert<1>({i}, SMVertex({x, y, z}));
+std::unique_ptr<SurfaceMesh>
+readPQR_molsurf(const std::string &input_name,
+                const GridResolution &resolution) {
+  std::vector<Atom> atoms;
+  // If readPQR errors return nullptr
+  if (!readPQR(input_name, std::back_inserter(atoms))) {
+    return nullptr;
   }
+  return meshAtoms_molsurf(atoms, resolution);
+}
 
-  // write triangles
-  float angle, angle1, angle2;
-
-  for (i = 0; i < GLOBAL_quad_num; i++) {
-    a = GLOBAL_quads[i].a;
-    b = GLOBAL_quads[i].b;
-    c = GLOBAL_quads[i].c;
-    d = GLOBAL_quads[i].d;
-
-    angle1 = -999.0;
-    angle2 = -999.0;
-    angle = GetAngle(a, b, c);
-
-    if (angle > angle1) {
-      angle1 = angle;
-    }
-    angle = GetAngle(a, d, c);
-
-    if (angle > angle1) {
-      angle1 = angle;
-    }
-    angle = GetAngle(c, a, b);
-
-    if (angle > angle1) {
-      angle1 = angle;
-    }
-    angle = GetAngle(c, a, d);
-
-    if (angle > angle1) {
-      angle1 = angle;
-    }
-
-    angle = GetAngle(b, a, d);
-
-    if (angle > angle2) {
-      angle2 = angle;
-    }
-    angle = GetAngle(b, c, d);
-
-    if (angle > angle2) {
-      angle2 = angle;
-    }
-    angle = GetAngle(d, a, b);
-
-    if (angle > angle2) {
-      angle2 = angle;
-    }
-    angle = GetAngle(d, b, c);
-
-    if (angle > angle2) {
-      angle2 = angle;
-    }
-
-    if (angle1 <= angle2) {
-      mesh->insert<3>({a, b, c});
-      mesh->insert<3>({a, c, d});
-    } else {
-      mesh->insert<3>({a, b, d});
-      mesh->insert<3>({b, c, d});
-    }
+std::unique_ptr<SurfaceMesh>
+readCIF_molsurf(const std::string &input_name,
+                const GridResolution &resolution) {
+  std::vector<Atom> atoms;
+  // If readCIF errors return nullptr
+  if (!readCIF(input_name, std::back_inserter(atoms))) {
+    return nullptr;
   }
-
-  /* write to disk
-     FILE *fout;
-     if ((fout=fopen("output1.off", "wb"))==NULL){
-     printf("write error...\n");
-     exit(0);
-     };
-
-     fprintf(fout, "OFF\n");
-     fprintf(fout, "%d %d
-        %d\n",GLOBAL_vert_num,quad_num*2,GLOBAL_vert_num+quad_num*2-2);
-     for (i = 0; i < GLOBAL_vert_num; i++)
-     fprintf(fout, "%f %f %f
-        \n",surfmesh->vertex[i].x,surfmesh->vertex[i].y,surfmesh->vertex[i].z);
-
-     for (i = 0; i < quad_num*2; i++) {
-     fprintf(fout, "3 %d %d
-        %d\n",surfmesh->face[i].a,surfmesh->face[i].b,surfmesh->face[i].c);
-     }
-     fclose(fout);
-   */
-
-  free(AllSeeds);
-  free(GLOBAL_segment_index);
-  free(GLOBAL_atom_index);
-  free(min_heap->x);
-  free(min_heap->y);
-  free(min_heap->z);
-  free(min_heap->seed);
-  free(min_heap->dist);
-  free(min_heap);
-  free(GLOBAL_vertex);
-  free(GLOBAL_quads);
-
-  compute_orientation(*mesh);
-  return mesh;
+  return meshAtoms_molsurf(atoms, resolution);
 }
 
 } // end namespace gamer
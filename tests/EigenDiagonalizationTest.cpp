@@ -0,0 +1,69 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include "gamer/EigenDiagonalization.h"
+#include "gtest/gtest.h"
+
+/// Namespace for all things gamer
+namespace gamer
+{
+
+TEST(EigenDiagonalizationTest, BatchMatchesDirect){
+    using Traits = EigenDiagonalizeTraits<double, 3>;
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    std::vector<Traits::CovarianceMatrix> cov(101);
+    for(auto &c : cov){
+        for(auto &v : c) v = dist(gen);
+    }
+    // Degenerate cases
+    cov[0] = {1, 0, 0, 1, 0, 1};
+    cov[1] = {0, 0, 0, 0, 0, 0};
+    cov[2] = {2, 0, 0, 1, 0, 1};
+
+    std::vector<Eigen::Vector3d> evals(cov.size());
+    std::vector<Eigen::Matrix3d> evecs(cov.size());
+    Traits::diagonalizeSelfAdjointCovMatrices(cov.data(), cov.size(),
+            evals.data(), evecs.data(), 3);
+
+    for(std::size_t i = 0; i < cov.size(); ++i){
+        Eigen::Vector3d e;
+        Eigen::Matrix3d v;
+        Traits::diagonalizeSelfAdjointCovMatrix(cov[i], e, v);
+
+        Eigen::Matrix3d m;
+        m << cov[i][0], cov[i][1], cov[i][2],
+             cov[i][1], cov[i][3], cov[i][4],
+             cov[i][2], cov[i][4], cov[i][5];
+        for(int j = 0; j < 3; ++j){
+            EXPECT_NEAR(e[j], evals[i][j], 1e-12);
+        }
+        EXPECT_LT((m*evecs[i] - evecs[i]*evals[i].asDiagonal())
+                .cwiseAbs().maxCoeff(), 1e-12);
+        EXPECT_LT((evecs[i].transpose()*evecs[i] - Eigen::Matrix3d::Identity())
+                .cwiseAbs().maxCoeff(), 1e-12);
+    }
+}
+
+} // end namespace gamer
@@ -0,0 +1,246 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <vector>
+#include "gamer/MarchingCube.h"
+#include "gamer/FlatSurfaceMesh.h"
+#include "gtest/gtest.h"
+
+/// Namespace for all things gamer
+namespace gamer
+{
+
+namespace
+{
+/// Expect two meshes to have the same vertices and oriented faces
+void expectSameMesh(const FlatSurfaceMesh &a, const FlatSurfaceMesh &b)
+{
+    ASSERT_EQ(a.nVertices(), b.nVertices());
+    ASSERT_EQ(a.nFaces(), b.nFaces());
+    for (std::size_t i = 0; i < a.nVertices(); ++i){
+        EXPECT_EQ(a.vertexKeys[i], b.vertexKeys[i]);
+        for (int c = 0; c < 3; ++c)
+            EXPECT_EQ(a.positions[i][c], b.positions[i][c]);
+    }
+    for (std::size_t i = 0; i < a.nFaces(); ++i)
+        EXPECT_EQ(a.orientedFace(i), b.orientedFace(i));
+}
+} // end anonymous namespace
+
+TEST(MarchingCubeTest, ThreadedMatchesSerial){
+    Vector3i dim({24, 21, 19});
+    Vector3f span({0.5, 1.0, 1.5});
+    std::vector<float> base(dim[0]*dim[1]*dim[2]);
+    for (int k = 0; k < dim[2]; ++k){
+        for (int j = 0; j < dim[1]; ++j){
+            for (int i = 0; i < dim[0]; ++i){
+                bool border = i == 0 || j == 0 || k == 0 ||
+                              i == dim[0]-1 || j == dim[1]-1 || k == dim[2]-1;
+                base[Vect2Index(i, j, k, dim)] = border ? -1 :
+                    std::sin(0.37*i)*std::cos(0.41*j) + 0.7*std::sin(0.29*k + 0.2*i);
+            }
+        }
+    }
+
+    std::vector<Vector> holes;
+    std::vector<float> data = base;
+    auto serial = flatten(*marchingCubes(data.data(), 1.0f, dim, span, 0.0f,
+                                         std::back_inserter(holes), 1));
+    ASSERT_GT(serial.nFaces(), 0u);
+
+    for (std::size_t nthreads : {2, 3, 7}){
+        data = base;
+        auto threaded = flatten(*marchingCubes(data.data(), 1.0f, dim, span, 0.0f,
+                                               std::back_inserter(holes), nthreads));
+        expectSameMesh(serial, threaded);
+    }
+}
+TEST(MarchingCubeTest, MatchesBaseline){
+    // Four voxels inside an empty grid. The expected surface was produced by
+    // the serial implementation which preceded the slab extraction. Vertices
+    // are compared sorted and triangles without orientation.
+    Vector3i dim({7, 6, 6});
+    std::vector<float> data(dim[0]*dim[1]*dim[2], -1);
+    data[Vect2Index(2, 2, 2, dim)] = 1.0f;
+    data[Vect2Index(3, 2, 2, dim)] = 3.0f;
+    data[Vect2Index(3, 3, 2, dim)] = 0.5f;
+    data[Vect2Index(2, 2, 3, dim)] = 2.0f;
+
+    const std::vector<std::array<double, 3>> expectedPositions = {
+        {0.6666666716337204, 2, 4.5},
+        {0.75, 2, 3},
+        {1, 1.3333333432674408, 4.5},
+        {1, 1.5, 3},
+        {1, 2, 2.25},
+        {1, 2, 5.5000000298023224},
+        {1, 2.5, 3},
+        {1, 2.6666666865348816, 4.5},
+        {1.3333333432674408, 2, 4.5},
+        {1.3333333432674408, 3, 3},
+        {1.5, 1.25, 3},
+        {1.5, 2, 1.875},
+        {1.5, 2, 4.125},
+        {1.5, 3, 2.5000000298023224},
+        {1.5, 3, 3.5000000149011612},
+        {1.5, 3.3333333432674408, 3},
+        {1.6666666716337204, 3, 3},
+        {1.875, 2, 3}
+    };
+    const std::vector<std::array<int, 3>> expectedFaces = {
+        {0, 1, 2}, {0, 1, 6}, {0, 2, 5}, {0, 5, 7}, {0, 6, 7}, {1, 2, 3}, {1, 3, 4},
+        {1, 4, 6}, {2, 3, 10}, {2, 5, 8}, {2, 8, 10}, {3, 4, 11}, {3, 10, 11},
+        {4, 6, 9}, {4, 9, 13}, {4, 11, 13}, {5, 7, 8}, {6, 7, 9}, {7, 8, 12},
+        {7, 9, 12}, {8, 10, 12}, {9, 12, 14}, {9, 13, 15}, {9, 14, 15},
+        {10, 11, 17}, {10, 12, 17}, {11, 13, 17}, {12, 14, 16}, {12, 16, 17},
+        {13, 15, 16}, {13, 16, 17}, {14, 15, 16}
+    };
+
+    std::vector<Vector> holes;
+    auto mesh = flatten(*marchingCubes(data.data(), 3.0f, dim, Vector3f({0.5, 1, 1.5}),
+                                       0.0f, std::back_inserter(holes), 2));
+    EXPECT_TRUE(holes.empty());
+    ASSERT_EQ(mesh.nVertices(), expectedPositions.size());
+    ASSERT_EQ(mesh.nFaces(), expectedFaces.size());
+
+    std::vector<std::array<double, 3>> positions;
+    for (const auto &p : mesh.positions)
+        positions.push_back({p[0], p[1], p[2]});
+    std::vector<std::array<double, 3>> sorted = positions;
+    std::sort(sorted.begin(), sorted.end());
+    for (std::size_t i = 0; i < sorted.size(); ++i){
+        for (int c = 0; c < 3; ++c)
+            EXPECT_FLOAT_EQ(sorted[i][c], expectedPositions[i][c]);
+    }
+
+    // Faces as sorted ranks of their vertices
+    std::vector<std::array<int, 3>> faces;
+    for (std::size_t i = 0; i < mesh.nFaces(); ++i){
+        std::array<int, 3> face;
+        for (int v = 0; v < 3; ++v){
+            const auto &p = positions[mesh.faces[i][v]];
+            face[v] = std::lower_bound(sorted.begin(), sorted.end(), p) - sorted.begin();
+        }
+        std::sort(face.begin(), face.end());
+        faces.push_back(face);
+    }
+    std::sort(faces.begin(), faces.end());
+    EXPECT_EQ(faces, expectedFaces);
+}
+TEST(MarchingCubeTest, LabelComponents){
+    // Solid block with a 2x2x2 cavity and a single voxel cavity inside
+    Vector3i dim({12, 10, 9});
+    std::vector<float> data(dim[0]*dim[1]*dim[2], -1);
+    for (int k = 2; k < 7; ++k)
+        for (int j = 2; j < 8; ++j)
+            for (int i = 2; i < 10; ++i)
+                data[Vect2Index(i, j, k, dim)] = 1;
+    for (int k = 3; k < 5; ++k)
+        for (int j = 3; j < 5; ++j)
+            for (int i = 3; i < 5; ++i)
+                data[Vect2Index(i, j, k, dim)] = -1;
+    data[Vect2Index(8, 6, 5, dim)] = -1;
+
+    for (std::size_t nthreads : {1, 2, 4}){
+        VoxelComponents components = labelComponents(data.data(), dim, 0.0f, nthreads);
+        ASSERT_EQ(components.size(), 3u);
+        EXPECT_EQ(components.sizes[0], 12u*10u*9u - 8u*6u*5u);
+        EXPECT_EQ(components.sizes[1], 8u);
+        EXPECT_EQ(components.sizes[2], 1u);
+        EXPECT_EQ(components.representatives[1], Vector3i({3, 3, 3}));
+        EXPECT_EQ(components.representatives[2], Vector3i({8, 6, 5}));
+        EXPECT_EQ(components.labels[Vect2Index(4, 4, 4, dim)], 1u);
+        EXPECT_TRUE(components.labels[Vect2Index(5, 5, 5, dim)] == VoxelComponents::NoComponent);
+    }
+}
+TEST(MarchingCubeTest, CavityVolumeThreshold){
+    // A shell around a 77x117x37 cavity of exactly MIN_VOLUME voxels
+    static_assert(MIN_VOLUME == 77*117*37, "cavity does not match MIN_VOLUME");
+    Vector3i dim({81, 121, 41});
+    Vector3f span({1, 1, 1});
+    std::vector<float> base(dim[0]*dim[1]*dim[2], -1);
+    for (int k = 1; k < dim[2]-1; ++k)
+        for (int j = 1; j < dim[1]-1; ++j)
+            for (int i = 1; i < dim[0]-1; ++i)
+                if (i == 1 || j == 1 || k == 1 ||
+                    i == dim[0]-2 || j == dim[1]-2 || k == dim[2]-2)
+                    base[Vect2Index(i, j, k, dim)] = 1;
+
+    // Cavities of MIN_VOLUME voxels are holes, smaller ones are filled
+    for (std::size_t size : {std::size_t(MIN_VOLUME), std::size_t(MIN_VOLUME-1)}){
+        std::vector<float> data = base;
+        if (size < MIN_VOLUME)
+            data[Vect2Index(2, 2, 2, dim)] = 1;
+        SparseVolume<float> sparse(dim, -1);
+        for (int k = 0; k < dim[2]; ++k)
+            for (int j = 0; j < dim[1]; ++j)
+                for (int i = 0; i < dim[0]; ++i)
+                    if (data[Vect2Index(i, j, k, dim)] != -1)
+                        sparse.at(i, j, k) = 1;
+
+        std::vector<Vector> denseHoles, sparseHoles;
+        MarchingCubesWorkspace workspace;
+        marchingCubes(data.data(), 1.0f, dim, span, 0.0f,
+                      std::back_inserter(denseHoles), workspace, 2);
+        auto sparseInserter = std::back_inserter(sparseHoles);
+        marchingcubes_detail::fillCavities(sparse, 1.0f, span, 0.0f, sparseInserter);
+
+        std::size_t nHoles = size < MIN_VOLUME ? 0 : 1;
+        EXPECT_EQ(denseHoles.size(), nHoles);
+        EXPECT_EQ(sparseHoles.size(), nHoles);
+        float cavity = size < MIN_VOLUME ? 1 : -1;
+        EXPECT_EQ(data[Vect2Index(40, 60, 20, dim)], cavity);
+        EXPECT_EQ(sparse(40, 60, 20), cavity);
+    }
+}
+TEST(MarchingCubeTest, SparseMatchesDense){
+    // Two overlapping balls, one with a small cavity, in a grid which is not
+    // a multiple of the brick size
+    Vector3i dim({37, 29, 22});
+    Vector3f span({0.5, 1.0, 1.5});
+    std::vector<float> dense(dim[0]*dim[1]*dim[2]);
+    SparseVolume<float> sparse(dim, -1);
+    for (int k = 0; k < dim[2]; ++k){
+        for (int j = 0; j < dim[1]; ++j){
+            for (int i = 0; i < dim[0]; ++i){
+                float r0 = std::sqrt((i-12)*(i-12) + (j-14)*(j-14) + (k-10)*(k-10));
+                float r1 = std::sqrt((i-24)*(i-24) + (j-13)*(j-13) + (k-11)*(k-11));
+                float v = std::max(std::min(8 - r0, r0 - 1.5f), 7 - r1);
+                v = std::max(v, -1.0f);
+                dense[Vect2Index(i, j, k, dim)] = v;
+                if (v != -1)
+                    sparse.at(i, j, k) = v;
+            }
+        }
+    }
+
+    std::vector<Vector> denseHoles, sparseHoles;
+    auto expected = flatten(*marchingCubes(dense.data(), 8.0f, dim, span, 0.0f,
+                                           std::back_inserter(denseHoles), 1));
+    auto actual = flatten(*marchingCubes(sparse, 8.0f, span, 0.0f,
+                                         std::back_inserter(sparseHoles), 3));
+    ASSERT_GT(expected.nFaces(), 0u);
+    EXPECT_LT(sparse.allocatedBricks(), sparse.size());
+    EXPECT_EQ(denseHoles.size(), sparseHoles.size());
+    expectSameMesh(expected, actual);
+}
+} // end namespace gamer
@@ -0,0 +1,496 @@
+// This file is part of the GAMer software.
+// Copyright (C) 2016-2021
+// by Christopher T. Lee and contributors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, see <http://www.gnu.org/licenses/>
+// or write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+// Boston, MA 02111-1307 USA
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gamer/PDBReader.h"
+#include "gamer/FlatSurfaceMesh.h"
+#include "gamer/MarchingCube.h"
+#include "gtest/gtest.h"
+
+/// Namespace for all things gamer
+namespace gamer
+{
+
+namespace
+{
+/// Write one PQR ATOM record per atom
+void writePQRAtoms(std::ostream &out, const std::vector<float> &xyz,
+                   const std::vector<float> &radii)
+{
+    char line[96];
+    for (std::size_t i = 0; i < radii.size(); ++i){
+        std::snprintf(line, sizeof(line),
+            "ATOM  %5d  C   ALA A   1    %8.3f%8.3f%8.3f %7.4f%7.4f\n",
+            static_cast<int>(i+1), xyz[3*i], xyz[3*i+1], xyz[3*i+2],
+            0.0, radii[i]);
+        out << line;
+    }
+}
+
+/// Expect two meshes to have the same vertices and oriented faces
+void expectSameMesh(const FlatSurfaceMesh &a, const FlatSurfaceMesh &b)
+{
+    ASSERT_EQ(a.nVertices(), b.nVertices());
+    ASSERT_EQ(a.nFaces(), b.nFaces());
+    for (std::size_t i = 0; i < a.nVertices(); ++i){
+        for (int c = 0; c < 3; ++c)
+            EXPECT_EQ(a.positions[i][c], b.positions[i][c]);
+    }
+    for (std::size_t i = 0; i < a.nFaces(); ++i)
+        EXPECT_EQ(a.orientedFace(i), b.orientedFace(i));
+}
+} // end anonymous namespace
+
+TEST(PDBReaderTest, MeshAtomsMatchesPQR){
+    // Values are exact at the precision written to the PQR file
+    std::vector<float> xyz = {0.0, 0.0, 0.0,   2.5, 0.0, 0.0,
+                              1.25, 2.0, 0.0,  1.25, 0.75, 2.0};
+    std::vector<float> radii = {1.5, 1.75, 1.5, 1.25};
+
+    std::string filename = testing::TempDir() + "gamer_atoms.pqr";
+    {
+        std::ofstream out(filename);
+        writePQRAtoms(out, xyz, radii);
+    }
+    auto fromFile = readPQR_gauss(filename, -0.2, 2.5);
+    auto fromBuffers = meshAtoms_gauss(xyz.data(), radii.data(), radii.size(),
+                                       -0.2, 2.5);
+    std::remove(filename.c_str());
+    ASSERT_TRUE(fromFile != nullptr);
+    ASSERT_TRUE(fromBuffers != nullptr);
+
+    auto a = flatten(*fromFile);
+    ASSERT_GT(a.nFaces(), 0u);
+    expectSameMesh(a, flatten(*fromBuffers));
+}
+
+TEST(PDBReaderTest, TrajectoryMatchesSingleFrames){
+    std::vector<float> xyz = {0.0, 0.0, 0.0,   2.5, 0.0, 0.0,
+                              1.25, 2.0, 0.0,  1.25, 0.75, 2.0};
+    std::vector<float> radii = {1.5, 1.75, 1.5, 1.25};
+    const std::size_t nFrames = 3;
+
+    std::string filename = testing::TempDir() + "gamer_models.pqr";
+    {
+        std::ofstream out(filename);
+        for (std::size_t m = 0; m < nFrames; ++m){
+            out << "MODEL     " << m+1 << "\n";
+            writePQRAtoms(out, xyz, radii);
+            out << "ENDMDL\n";
+        }
+    }
+
+    std::vector<std::size_t> modelSizes;
+    ASSERT_TRUE(pdbreader_detail::readModels(filename, true,
+        [&](const std::vector<Atom> &atoms){
+            modelSizes.push_back(atoms.size());
+            return true;
+        }));
+    EXPECT_EQ(modelSizes, std::vector<std::size_t>(nFrames, radii.size()));
+
+    // Identical frames share the grid of a single frame
+    auto expected = flatten(*meshAtoms_gauss(xyz.data(), radii.data(),
+                                             radii.size(), -0.2, 2.5));
+    ASSERT_GT(expected.nFaces(), 0u);
+    auto check = [&](const TrajectoryFrame &frame){
+        EXPECT_EQ(frame.vertices.size(), expected.nVertices());
+        EXPECT_EQ(frame.triangles.size(), expected.nFaces());
+        expectSameMesh(flatten(*frame.mesh()), expected);
+    };
+
+    std::vector<std::size_t> indices;
+    std::size_t nMeshed = readPQRTrajectory_gauss(filename, -0.2, 2.5,
+        [&](const TrajectoryFrame &frame){
+            indices.push_back(frame.index);
+            check(frame);
+            return true;
+        });
+    EXPECT_EQ(nMeshed, nFrames);
+    EXPECT_EQ(indices, std::vector<std::size_t>({0, 1, 2}));
+
+    // Returning false stops after the current frame
+    nMeshed = readPQRTrajectory_gauss(filename, -0.2, 2.5,
+        [](const TrajectoryFrame &frame){ return frame.index < 1; });
+    EXPECT_EQ(nMeshed, 2u);
+    std::remove(filename.c_str());
+
+    std::vector<float> frames;
+    for (std::size_t m = 0; m < nFrames; ++m)
+        frames.insert(frames.end(), xyz.begin(), xyz.end());
+    indices.clear();
+    nMeshed = meshTrajectory_gauss(frames.data(), radii.data(), radii.size(),
+        nFrames, -0.2, 2.5,
+        [&](const TrajectoryFrame &frame){
+            indices.push_back(frame.index);
+            check(frame);
+            return true;
+        });
+    EXPECT_EQ(nMeshed, nFrames);
+    EXPECT_EQ(indices, std::vector<std::size_t>({0, 1, 2}));
+    EXPECT_THROW(meshTrajectory_gauss(frames.data(), radii.data(), radii.size(),
+                                      0, -0.2, 2.5,
+                                      [](const TrajectoryFrame &){ return true; }),
+                 std::runtime_error);
+}
+
+TEST(PDBReaderTest, TrajectorySkipsEmptyModels){
+    std::vector<float> xyz = {0.0, 0.0, 0.0,   2.5, 0.0, 0.0,
+                              1.25, 2.0, 0.0,  1.25, 0.75, 2.0};
+    std::vector<float> radii = {1.5, 1.75, 1.5, 1.25};
+
+    // The second model has no ATOM records
+    std::string filename = testing::TempDir() + "gamer_empty_model.pqr";
+    {
+        std::ofstream out(filename);
+        out << "MODEL        1\n";
+        writePQRAtoms(out, xyz, radii);
+        out << "ENDMDL\nMODEL        2\nREMARK empty\nENDMDL\nMODEL        3\n";
+        writePQRAtoms(out, xyz, radii);
+        out << "ENDMDL\n";
+    }
+
+    auto expected = flatten(*meshAtoms_gauss(xyz.data(), radii.data(),
+                                             radii.size(), -0.2, 2.5));
+    std::vector<std::size_t> indices;
+    std::size_t nMeshed = readPQRTrajectory_gauss(filename, -0.2, 2.5,
+        [&](const TrajectoryFrame &frame){
+            indices.push_back(frame.index);
+            expectSameMesh(flatten(*frame.mesh()), expected);
+            return true;
+        });
+    EXPECT_EQ(nMeshed, 2u);
+    EXPECT_EQ(indices, std::vector<std::size_t>({0, 1}));
+
+    // Nothing to mesh
+    {
+        std::ofstream out(filename);
+        out << "MODEL        1\nENDMDL\n";
+    }
+    nMeshed = readPQRTrajectory_gauss(filename, -0.2, 2.5,
+        [](const TrajectoryFrame &){ return true; });
+    EXPECT_EQ(nMeshed, 0u);
+    std::remove(filename.c_str());
+}
+
+TEST(PDBReaderTest, ReadCIFMatchesPDB){
+    struct Record { const char *atom; const char *residue; float x, y, z; };
+    std::vector<Record> records = {
+        {"N", "ALA", 0.0, 0.0, 0.0}, {"CA", "ALA", 1.458, 0.0, 0.0},
+        {"C", "ALA", 2.009, 1.42, 0.0}, {"CB", "ALA", 1.988, -0.773, -1.199},
+        {"XX", "ALA", 3.0, 2.0, 1.0}, {"C1", "UNK", -1.5, 0.5, 2.25}};
+
+    std::string pdbname = testing::TempDir() + "gamer_atoms.pdb";
+    std::string cifname = testing::TempDir() + "gamer_atoms.cif";
+    {
+        std::ofstream pdb(pdbname);
+        std::ofstream cif(cifname);
+        cif << "data_test\n"
+            << "# A loop of another category with quotes and a text field\n"
+            << "loop_\n_struct_keywords.entry_id\n_struct_keywords.text\n"
+            << "test 'it''s \"quoted\"'\n"
+            << "test\n;_atom_site.Cartn_x 1 2 3\n;\n"
+            << "loop_\n"
+            << "_atom_site.group_PDB\n_atom_site.id\n_atom_site.label_atom_id\n"
+            << "_atom_site.label_alt_id\n_atom_site.label_comp_id\n"
+            << "_atom_site.Cartn_x\n_atom_site.Cartn_y\n_atom_site.Cartn_z\n"
+            << "_atom_site.pdbx_PDB_model_num\n";
+        char line[96];
+        for (int model = 1; model <= 2; ++model){
+            for (std::size_t i = 0; i < records.size(); ++i){
+                const auto &r = records[i];
+                // PDB atom names with a one letter element start in column 13
+                std::snprintf(line, sizeof(line),
+                    "ATOM  %5d  %-3s %3s A   1    %8.3f%8.3f%8.3f\n",
+                    static_cast<int>(i+1), r.atom, r.residue, r.x, r.y, r.z);
+                if (model == 1)
+                    pdb << line;
+                std::snprintf(line, sizeof(line), "ATOM %d \"%s\" . %s %.3f %.3f %.3f %d\n",
+                    static_cast<int>(i+1), r.atom, r.residue, r.x, r.y, r.z, model);
+                cif << line;
+            }
+            cif << "HETATM 99 O . HOH 5.0 5.0 5.0 " << model << "\n";
+        }
+        cif << "#\nloop_\n_atom_type.symbol\nC\nN\n";
+    }
+
+    std::vector<Atom> fromPDB, fromCIF;
+    ASSERT_TRUE(readPDB(pdbname, std::back_inserter(fromPDB)));
+    ASSERT_TRUE(readCIF(cifname, std::back_inserter(fromCIF)));
+    ASSERT_EQ(fromPDB.size(), records.size());
+    ASSERT_EQ(fromCIF.size(), 2*records.size());
+    for (std::size_t i = 0; i < fromCIF.size(); ++i){
+        const auto &expected = fromPDB[i % records.size()];
+        for (int c = 0; c < 3; ++c)
+            EXPECT_EQ(fromCIF[i].pos[c], expected.pos[c]);
+        EXPECT_EQ(fromCIF[i].radius, expected.radius);
+    }
+    // Known atoms use the table, unknown ones the default
+    EXPECT_NE(fromCIF[1].radius, 1.0f);
+    EXPECT_EQ(fromCIF[4].radius, 1.0f);
+
+    std::vector<std::size_t> modelSizes;
+    ASSERT_TRUE(pdbreader_detail::readCIFModels(cifname,
+        [&](const std::vector<Atom> &atoms){
+            modelSizes.push_back(atoms.size());
+            return true;
+        }));
+    EXPECT_EQ(modelSizes, std::vector<std::size_t>(2, records.size()));
+
+    // A single atom written as tag and value pairs
+    {
+        std::ofstream cif(cifname);
+        cif << "data_single\n_atom_site.group_PDB ATOM\n"
+            << "_atom_site.label_atom_id CA\n_atom_site.label_comp_id ALA\n"
+            << "_atom_site.Cartn_x 1.458\n_atom_site.Cartn_y 0.0\n"
+            << "_atom_site.Cartn_z 0.0\n";
+    }
+    fromCIF.clear();
+    ASSERT_TRUE(readCIF(cifname, std::back_inserter(fromCIF)));
+    ASSERT_EQ(fromCIF.size(), 1u);
+    EXPECT_EQ(fromCIF[0].pos[0], fromPDB[1].pos[0]);
+    EXPECT_EQ(fromCIF[0].radius, fromPDB[1].radius);
+    std::remove(pdbname.c_str());
+    std::remove(cifname.c_str());
+}
+
+TEST(PDBReaderTest, MeshAtomsRejectsEmptyBuffers){
+    float xyz[3] = {0, 0, 0};
+    EXPECT_THROW(meshAtoms_gauss(xyz, nullptr, 1, -0.2, 2.5), std::runtime_error);
+    EXPECT_THROW(meshAtoms_molsurf(xyz, xyz, 0), std::runtime_error);
+}
+
+TEST(PDBReaderTest, MolsurfIsReentrant){
+    std::vector<std::vector<Atom>> inputs(4);
+    for (std::size_t t = 0; t < inputs.size(); ++t){
+        for (int a = 0; a < 20 + 10*static_cast<int>(t); ++a){
+            Atom atom;
+            atom.pos = Vector3f({3.0f*std::sin(0.7f*a), 3.0f*std::cos(1.3f*a), 0.4f*a});
+            atom.radius = 1.5 + 0.1*(a % 4);
+            inputs[t].push_back(atom);
+        }
+    }
+
+    std::vector<std::unique_ptr<SurfaceMesh>> serial, threaded(inputs.size());
+    for (const auto &atoms : inputs)
+        serial.push_back(meshAtoms_molsurf(atoms));
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < inputs.size(); ++t){
+        workers.emplace_back([&, t](){
+            threaded[t] = meshAtoms_molsurf(inputs[t]);
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+
+    for (std::size_t t = 0; t < inputs.size(); ++t){
+        auto a = flatten(*serial[t]);
+        ASSERT_GT(a.nFaces(), 0u);
+        expectSameMesh(a, flatten(*threaded[t]));
+    }
+}
+
+TEST(PDBReaderTest, MemoryBudgetCoarsensGrid){
+    std::vector<Atom> atoms;
+    for (int a = 0; a < 60; ++a){
+        Atom atom;
+        atom.pos = Vector3f({3.0f*std::sin(0.7f*a), 3.0f*std::cos(1.3f*a), 0.8f*a});
+        atom.radius = 1.5 + 0.1*(a % 4);
+        atoms.push_back(atom);
+    }
+
+    auto full = estimateMemory_molsurf(atoms);
+    EXPECT_EQ(full.scale, DIM_SCALE);
+    EXPECT_GT(full.gridBytes, 0u);
+    EXPECT_GT(full.meshBytes, 0u);
+
+    GridResolution resolution;
+    resolution.memoryBudget = full.total()/4;
+    auto budgeted = estimateMemory_molsurf(atoms, resolution);
+    EXPECT_LE(budgeted.total(), resolution.memoryBudget);
+    EXPECT_LT(budgeted.scale, full.scale);
+    for (int c = 0; c < 3; ++c)
+        EXPECT_LT(budgeted.dim[c], full.dim[c]);
+
+    // Budgets above the default never refine the grid
+    resolution.memoryBudget = 2*full.total();
+    EXPECT_EQ(estimateMemory_molsurf(atoms, resolution).scale, DIM_SCALE);
+
+    resolution.memoryBudget = 1;
+    EXPECT_THROW(estimateMemory_molsurf(atoms, resolution), std::runtime_error);
+    EXPECT_THROW(meshAtoms_gauss(atoms, -0.2, 2.5, resolution), std::runtime_error);
+
+    resolution.memoryBudget = full.total()/4;
+    auto mesh = meshAtoms_molsurf(atoms, resolution);
+    EXPECT_GT(flatten(*mesh).nFaces(), 0u);
+}
+
+TEST(PDBReaderTest, DistanceTransformMatchesBruteForce){
+    Vector3i dim({11, 7, 9});
+    const int n = dim[0]*dim[1]*dim[2];
+    std::vector<float> f(n, std::numeric_limits<float>::infinity());
+    std::vector<int> labels(n, -1);
+    const int seeds[4] = {0, 100, 345, n-1};
+    const float values[4] = {0, -4, 2.5, -1};
+    for (int s = 0; s < 4; ++s){
+        f[seeds[s]] = values[s];
+        labels[seeds[s]] = s;
+    }
+    distanceTransform(f.data(), labels.data(), dim, 3);
+
+    for (int k = 0; k < dim[2]; ++k){
+        for (int j = 0; j < dim[1]; ++j){
+            for (int i = 0; i < dim[0]; ++i){
+                float best = std::numeric_limits<float>::infinity();
+                for (int s = 0; s < 4; ++s){
+                    int si = seeds[s] % dim[0];
+                    int sj = (seeds[s] / dim[0]) % dim[1];
+                    int sk = seeds[s] / (dim[0]*dim[1]);
+                    float d = (i-si)*(i-si) + (j-sj)*(j-sj) + (k-sk)*(k-sk) + values[s];
+                    best = std::min(best, d);
+                }
+                int idx = Vect2Index(i, j, k, dim);
+                EXPECT_FLOAT_EQ(f[idx], best);
+                ASSERT_GE(labels[idx], 0);
+            }
+        }
+    }
+}
+
+TEST(PDBReaderTest, GridSASEDTMatchesGridSAS){
+    Vector3i dim({20, 16, 18});
+    std::vector<Atom> atoms(3);
+    atoms[0].pos = Vector3f({6.3, 7.1, 8.4});   atoms[0].radius = 3.2;
+    atoms[1].pos = Vector3f({10.8, 8.2, 9.0});  atoms[1].radius = 2.6;
+    atoms[2].pos = Vector3f({8.4, 10.5, 6.7});  atoms[2].radius = 3.7;
+
+    std::vector<float> brute(dim[0]*dim[1]*dim[2], -5.0f);
+    std::vector<float> edt(brute);
+    gridSAS(atoms.begin(), atoms.end(), dim, brute.data());
+    gridSAS_EDT(atoms.begin(), atoms.end(), dim, edt.data(), 2);
+    for (std::size_t i = 0; i < brute.size(); ++i)
+        EXPECT_EQ(brute[i] > 0, edt[i] > 0);
+}
+
+TEST(PDBReaderTest, GridSESEDTMatchesGridSES){
+    Vector3i dim({24, 20, 22});
+    const std::size_t n = dim[0]*dim[1]*dim[2];
+    const float probe = 1.4f;
+    std::vector<Atom> atoms(3);
+    atoms[0].pos = Vector3f({8.3, 9.1, 10.4});  atoms[0].radius = 4.6;
+    atoms[1].pos = Vector3f({14.8, 10.2, 11.0}); atoms[1].radius = 4.0;
+    atoms[2].pos = Vector3f({11.4, 13.5, 8.7});  atoms[2].radius = 5.1;
+
+    std::vector<float> sas(n, -5.0f);
+    gridSAS(atoms.begin(), atoms.end(), dim, sas.data());
+
+    // The existing path rolls the probe over the vertices of the SAS mesh
+    std::vector<float> sasCopy(sas);
+    std::vector<Vector> holes;
+    MarchingCubesWorkspace workspace;
+    marchingCubes(sasCopy.data(), 5.0f, dim, Vector3f({1, 1, 1}), 0.0f,
+                  std::back_inserter(holes), workspace);
+    std::vector<Vertex> sasVertices;
+    for (auto &v : workspace.vertices)
+        sasVertices.emplace_back(v);
+    std::vector<float> band(n, -5.0f);
+    gridSES(sasVertices.begin(), sasVertices.end(), dim, band.data(), probe);
+
+    std::vector<float> edt(n, -5.0f);
+    gridSES_EDT(sas.data(), dim, edt.data(), probe, 2);
+
+    // Inside the SAS, the SES is the part the probe band does not reach.
+    // Within a voxel of its boundary the two discretizations may differ.
+    std::size_t nInside = 0, nBand = 0;
+    for (std::size_t i = 0; i < n; ++i){
+        if (sas[i] <= 0 || std::abs(edt[i]) < 1)
+            continue;
+        ++(edt[i] > 0 ? nInside : nBand);
+        EXPECT_EQ(edt[i] > 0, band[i] <= 0);
+    }
+    EXPECT_GT(nInside, 25u);
+    EXPECT_GT(nBand, 25u);
+}
+
+TEST(PDBReaderTest, BlurIsThreadIndependent){
+    Vector3i dim({23, 19, 31});
+    Vector3f min({-4, -4, -4});
+    Vector3f maxMin({16, 13, 22});
+    std::vector<Atom> atoms;
+    for (int a = 0; a < 40; ++a){
+        Atom atom;
+        atom.pos = Vector3f({4.0f + 3.0f*std::sin(0.7f*a),
+                             2.5f + 3.0f*std::cos(1.3f*a), 0.35f*a});
+        atom.radius = 1.2 + 0.2*(a % 5);
+        atoms.push_back(atom);
+    }
+
+    std::vector<float> serial(dim[0]*dim[1]*dim[2], 0.0f);
+    blurAtoms(atoms.begin(), atoms.end(), serial.data(), min, maxMin, dim,
+              -0.2f, 1);
+    for (std::size_t nthreads : {2, 3, 7}){
+        std::vector<float> threaded(serial.size(), 0.0f);
+        blurAtoms(atoms.begin(), atoms.end(), threaded.data(), min, maxMin,
+                  dim, -0.2f, nthreads);
+        // Bitwise, not just within rounding
+        EXPECT_EQ(std::memcmp(serial.data(), threaded.data(),
+                              serial.size()*sizeof(float)), 0);
+    }
+}
+
+TEST(PDBReaderTest, BlurRangesMatchVolume){
+    // Grid which is not a multiple of the brick size
+    Vector3i dim({27, 21, 30});
+    Vector3f min({-2, -3, -2});
+    Vector3f maxMin({13, 10, 14.5});
+    std::vector<Atom> atoms(3);
+    atoms[0].pos = Vector3f({2.5, 1.0, 3.0});   atoms[0].radius = 1.8;
+    atoms[1].pos = Vector3f({5.0, 2.5, 6.5});   atoms[1].radius = 1.4;
+    atoms[2].pos = Vector3f({8.0, 4.0, 9.0});   atoms[2].radius = 2.1;
+
+    std::vector<float> dense(dim[0]*dim[1]*dim[2], 0.0f);
+    auto denseRange = blurAtoms(atoms.begin(), atoms.end(), dense.data(), min,
+                                maxMin, dim, -0.2f, 3);
+    EXPECT_EQ(*std::min_element(dense.begin(), dense.end()), denseRange.min);
+    EXPECT_EQ(*std::max_element(dense.begin(), dense.end()), denseRange.max);
+
+    SparseVolume<float> sparse(dim);
+    auto ranges = blurAtoms(atoms.begin(), atoms.end(), sparse, min, maxMin,
+                            -0.2f, 2);
+    ASSERT_EQ(sparse.size(), ranges.bricks.size());
+    EXPECT_EQ(denseRange.min, ranges.total.min);
+    EXPECT_EQ(denseRange.max, ranges.total.max);
+    for (std::size_t b = 0; b < sparse.size(); ++b){
+        auto expected = brickRange(sparse, b);
+        EXPECT_EQ(expected.min, ranges.bricks[b].min);
+        EXPECT_EQ(expected.max, ranges.bricks[b].max);
+    }
+}
+
+} // end namespace gamer
@@ -24,7 +24,13 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <limits>
+#include <set>
+#include <tuple>
 #include "gamer/SurfaceMesh.h"
+#include "gamer/EigenDiagonalization.h"
+#include "gamer/FlatSurfaceMesh.h"
+#include "gamer/KRingCache.h"
 #include "gtest/gtest.h"
 
 /// Namespace for all things gamer
@@ -51,6 +57,29 @@ TEST_F(SurfaceMeshTest, Refinement){
     EXPECT_EQ(fbefore*4, fafter);
 }
 
+TEST_F(SurfaceMeshTest, BuildFromBuffers){
+    FlatSurfaceMesh flat = flatten(*mesh);
+    std::vector<int> faces;
+    for (std::size_t i = 0; i < flat.nFaces(); ++i){
+        auto face = flat.orientedFace(i);
+        faces.insert(faces.end(), face.begin(), face.end());
+    }
+    auto built = buildSurfaceMesh(
+        reinterpret_cast<const REAL*>(flat.positions.data()), flat.nVertices(),
+        faces.data(), flat.nFaces());
+
+    EXPECT_EQ(mesh->size<1>(), built->size<1>());
+    EXPECT_EQ(mesh->size<2>(), built->size<2>());
+    EXPECT_EQ(mesh->size<3>(), built->size<3>());
+    EXPECT_NEAR(getArea(*mesh), getArea(*built), 1e-10);
+    EXPECT_NEAR(std::abs(getVolume(*mesh)), std::abs(getVolume(*built)), 1e-10);
+
+    faces[0] = flat.nVertices();
+    EXPECT_THROW(buildSurfaceMesh(
+        reinterpret_cast<const REAL*>(flat.positions.data()), flat.nVertices(),
+        faces.data(), flat.nFaces()), std::runtime_error);
+}
+
 TEST_F(SurfaceMeshTest, FillHoles){
     int vbefore = mesh->size<1>();
     int ebefore = mesh->size<2>();
@@ -83,4 +112,229 @@ TEST_F(SurfaceMeshTest, Smooth){
     EXPECT_EQ(fbefore, 80);
 }
 
+TEST_F(SurfaceMeshTest, SmoothThreaded){
+    auto threaded = sphere(2);
+    auto serial = sphere(2);
+    for(auto m : {serial.get(), threaded.get()}){
+        for(auto vertexID : m->get_level_id<1>()){
+            (*vertexID).selected = true;
+        }
+    }
+    smoothMesh(*serial, 3, true, 2, false, 1);
+    smoothMesh(*threaded, 3, true, 2, false, 4);
+
+    ASSERT_EQ(serial->size<1>(), threaded->size<1>());
+    ASSERT_EQ(serial->size<3>(), threaded->size<3>());
+    for(auto vertexID : serial->get_level_id<1>()){
+        auto name = serial->get_name(vertexID);
+        auto other = threaded->get_simplex_up(name);
+        for(std::size_t i = 0; i < 3; ++i){
+            EXPECT_EQ((*vertexID)[i], (*other)[i]);
+        }
+    }
+}
+
+TEST_F(SurfaceMeshTest, SelectFlipEdgesThreaded){
+    mesh = sphere(2);
+    // Perturb the sphere so that some edges are worth flipping
+    for(auto vertexID : mesh->get_level_id<1>()){
+        auto key = mesh->get_name(vertexID)[0];
+        (*vertexID).position *= 1 + 0.2*std::sin(3.0*key);
+    }
+    for(auto edgeID : mesh->get_level_id<2>())
+        (*edgeID).selected = true;
+
+    std::vector<SurfaceMesh::SimplexID<2>> serial, threaded;
+    surfacemesh_detail::selectFlipEdges(*mesh, false,
+        surfacemesh_detail::checkFlipAngle, std::back_inserter(serial), 1);
+    surfacemesh_detail::selectFlipEdges(*mesh, false,
+        surfacemesh_detail::checkFlipAngle, std::back_inserter(threaded), 4);
+
+    EXPECT_FALSE(serial.empty());
+    EXPECT_EQ(serial, threaded);
+}
+
+TEST_F(SurfaceMeshTest, FlatSnapshot){
+    mesh = sphere(2);
+    auto flat = flatten(*mesh);
+
+    EXPECT_EQ(flat.nVertices(), mesh->size<1>());
+    EXPECT_EQ(flat.nEdges(), mesh->size<2>());
+    EXPECT_EQ(flat.nFaces(), mesh->size<3>());
+    EXPECT_DOUBLE_EQ(getArea(flat), getArea(*mesh));
+    EXPECT_DOUBLE_EQ(getVolume(flat), getVolume(*mesh));
+    EXPECT_EQ(getMinMaxAngles(flat, 15, 165), getMinMaxAngles(*mesh, 15, 165));
+}
+
+TEST_F(SurfaceMeshTest, CurvatureMDSBThreaded){
+    mesh = sphere(2);
+    auto flat = flatten(*mesh);
+    auto serial = curvaturesViaMDSB(flat, 1);
+    auto threaded = curvaturesViaMDSB(flat, 4);
+
+    REAL *kh, *kg, *k1, *k2;
+    std::map<typename SurfaceMesh::KeyType, typename SurfaceMesh::KeyType> sigma;
+    std::tie(kh, kg, k1, k2, sigma) = curvatureViaMDSB(*mesh);
+
+    ASSERT_EQ(serial.kh.size(), flat.nVertices());
+    ASSERT_EQ(threaded.kh.size(), flat.nVertices());
+    for(std::size_t i = 0; i < flat.nVertices(); ++i){
+        EXPECT_EQ(kh[i], serial.kh[i]);
+        EXPECT_EQ(kg[i], serial.kg[i]);
+        EXPECT_EQ(k1[i], serial.k1[i]);
+        EXPECT_EQ(k2[i], serial.k2[i]);
+        EXPECT_EQ(serial.kh[i], threaded.kh[i]);
+        EXPECT_EQ(serial.kg[i], threaded.kg[i]);
+        EXPECT_EQ(serial.k1[i], threaded.k1[i]);
+        EXPECT_EQ(serial.k2[i], threaded.k2[i]);
+    }
+    delete[] kh;
+    delete[] kg;
+    delete[] k1;
+    delete[] k2;
+}
+
+TEST_F(SurfaceMeshTest, CurvatureJetsThreaded){
+    mesh = sphere(2);
+    auto flat = flatten(*mesh);
+    auto serial = curvaturesViaJets(flat, 4, 2, 1);
+    auto threaded = curvaturesViaJets(flat, 4, 2, 4);
+
+    ASSERT_EQ(serial.kh.size(), flat.nVertices());
+    for(std::size_t i = 0; i < flat.nVertices(); ++i){
+        // Every vertex of the sphere has enough neighbors
+        EXPECT_FALSE(std::isnan(serial.kh[i]));
+        EXPECT_EQ(serial.kh[i], threaded.kh[i]);
+        EXPECT_EQ(serial.kg[i], threaded.kg[i]);
+        EXPECT_EQ(serial.k1[i], threaded.k1[i]);
+        EXPECT_EQ(serial.k2[i], threaded.k2[i]);
+    }
+}
+
+TEST_F(SurfaceMeshTest, DecimateQuadric){
+    mesh = sphere(3);
+    for(auto faceID : mesh->get_level_id<3>()){
+        auto name = mesh->get_name(faceID);
+        REAL z = 0;
+        for(auto key : name)
+            z += (*mesh->get_simplex_up({key})).position[2];
+        (*faceID).marker = (z > 0) ? 1 : 2;
+    }
+    for(auto vertexID : mesh->get_level_id<1>())
+        (*vertexID).selected = true;
+    auto pinned = mesh->get_simplex_up({0});
+    (*pinned).selected = false;
+    Vector position = (*pinned).position;
+
+    auto result = decimateQuadric(*mesh, 200,
+        std::numeric_limits<REAL>::infinity(), 1);
+    EXPECT_LE(result->size<3>(), 200);
+    EXPECT_FALSE(hasHole(*result));
+    EXPECT_EQ(result->size<1>() - result->size<2>() + result->size<3>(), 2u);
+    EXPECT_NEAR(getVolume(*result), getVolume(*mesh), 0.05*getVolume(*mesh));
+
+    // The unselected vertex is kept in place
+    int unselected = 0;
+    for(auto vertexID : result->get_level_id<1>()){
+        if(!(*vertexID).selected){
+            ++unselected;
+            EXPECT_EQ((*vertexID).position, position);
+        }
+    }
+    EXPECT_EQ(unselected, 1);
+
+    std::set<int> markers;
+    for(auto faceID : result->get_level_id<3>())
+        markers.insert((*faceID).marker);
+    EXPECT_EQ(markers, (std::set<int>{1, 2}));
+}
+
+TEST_F(SurfaceMeshTest, CoarseParallelThreaded){
+    auto serial = sphere(3);
+    auto threaded = sphere(3);
+    for(auto vertexID : serial->get_level_id<1>())
+        (*vertexID).selected = true;
+    for(auto vertexID : threaded->get_level_id<1>())
+        (*vertexID).selected = true;
+
+    coarse_parallel(*serial, 2, 0, 1, 2, false, 1);
+    coarse_parallel(*threaded, 2, 0, 1, 2, false, 4);
+
+    EXPECT_LT(serial->size<1>(), sphere(3)->size<1>());
+    EXPECT_FALSE(hasHole(*serial));
+    ASSERT_EQ(serial->size<1>(), threaded->size<1>());
+    ASSERT_EQ(serial->size<3>(), threaded->size<3>());
+    for(auto vertexID : serial->get_level_id<1>()){
+        auto key = serial->get_name(vertexID)[0];
+        EXPECT_EQ((*vertexID).position,
+                  (*threaded->get_simplex_up({key})).position);
+    }
+}
+
+TEST_F(SurfaceMeshTest, CoarseScores){
+    mesh = sphere(2);
+    for(auto vertexID : mesh->get_level_id<1>())
+        (*vertexID).selected = true;
+    (*mesh->get_simplex_up({0})).selected = false;
+    auto flat = flatten(*mesh);
+    auto serial = coarseScores(flat, 0.5, 2, 2, 1);
+    auto threaded = coarseScores(flat, 0.5, 2, 2, 4);
+
+    // Compare against the per vertex criteria of the live mesh
+    std::size_t i = 0;
+    for(auto vertexID : mesh->get_level_id<1>()){
+        auto lst = surfacemesh_detail::computeLocalStructureTensor(
+            *mesh, vertexID, 2);
+        EigenVector eigenvalues;
+        EigenMatrix eigenvectors;
+        EigenDiagonalizeTraits<REAL, 3>::diagonalizeSelfAdjointMatrix(
+            lst, eigenvalues, eigenvectors);
+        REAL flatness = std::pow(eigenvalues[1]/eigenvalues[2], 0.5);
+
+        REAL maxLen = 0;
+        for(auto edgeID : mesh->up(vertexID)){
+            auto name = mesh->get_name(edgeID);
+            auto v = *mesh->get_simplex_down(edgeID, name[0]) -
+                     *mesh->get_simplex_down(edgeID, name[1]);
+            maxLen = std::max(maxLen, length(v));
+        }
+        REAL sparseness = std::pow(maxLen/serial.avgLen, 2);
+
+        EXPECT_NEAR(serial.flatness[i], flatness, 1e-6*flatness);
+        EXPECT_NEAR(serial.sparseness[i], sparseness, 1e-9*sparseness);
+        EXPECT_EQ(serial.flatness[i], threaded.flatness[i]);
+        EXPECT_EQ(serial.sparseness[i], threaded.sparseness[i]);
+        if((*vertexID).selected)
+            EXPECT_EQ(serial.score[i],
+                      serial.flatness[i]*serial.sparseness[i]);
+        else
+            EXPECT_TRUE(std::isnan(serial.score[i]));
+        ++i;
+    }
+}
+
+TEST_F(SurfaceMeshTest, KRingCacheInvalidate){
+    mesh = sphere(2);
+    KRingCache cache(*mesh, 2);
+
+    auto vertexID = mesh->get_simplex_up({0});
+    cache.invalidate(*mesh, vertexID);
+    cache.erase(*mesh, vertexID);
+    surfacemesh_detail::decimateVertex(*mesh, vertexID);
+    cache.update(*mesh);
+
+    KRingCache fresh(*mesh, 2);
+    for(auto vID : mesh->get_level_id<1>()){
+        std::set<int> expected, actual;
+        auto i = fresh.index(*mesh, vID);
+        for(auto j : fresh.neighbors(i))
+            expected.insert(mesh->get_name(fresh.vertex(j))[0]);
+        auto k = cache.index(*mesh, vID);
+        EXPECT_FALSE(cache.dirty(k));
+        for(auto j : cache.neighbors(k))
+            actual.insert(mesh->get_name(cache.vertex(j))[0]);
+        EXPECT_EQ(expected, actual);
+    }
+}
+
 } // end namespace gamer